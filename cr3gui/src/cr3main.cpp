@@ -8,6 +8,7 @@
 #include <crengine.h>
 #include <crgui.h>
 #include <crtrace.h>
+#include <crconcurrent.h>
 
 #include "cr3main.h"
 #include "mainwnd.h"
@@ -228,6 +229,13 @@ bool InitCREngine( const char * exename, lString16Collection & fontDirs )
     lString8 fontDir8 = UnicodeToLocal(fontDir);
     //const char * fontDir8s = fontDir8.c_str();
     //InitFontManager( fontDir8 );
+#if defined(_LINUX)
+    // engine mutexes and background decoding of images of next pages
+    if ( !concurrencyProvider ) {
+        concurrencyProvider = new CRPosixConcurrencyProvider();
+        CRSetupEngineConcurrency();
+    }
+#endif
     InitFontManager(lString8::empty_str);
 
     // Load font definitions into font manager
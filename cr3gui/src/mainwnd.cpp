@@ -522,8 +522,8 @@ bool V3DocViewWin::loadHistory( lString16 filename )
 {
 	CRLog::trace("V3DocViewWin::loadHistory( %s )", UnicodeToUtf8(filename).c_str());
     _historyFileName = filename;
-    LVStreamRef stream = LVOpenFileStream( filename.c_str(), LVOM_READ );
-    return loadHistory( stream );
+    // history file with changes journal appended by saveHistory()
+    return _docview->getHistory()->loadFromFile( filename );
 }
 
 void V3DocViewWin::closing()
@@ -567,15 +567,17 @@ bool V3DocViewWin::saveHistory( lString16 filename, bool exportBookmarks )
     }
     _historyFileName = filename;
     log << "V3DocViewWin::saveHistory(" << filename << ")";
-    LVStreamRef stream = LVOpenFileStream( filename.c_str(), LVOM_WRITE );
-    if ( !stream ) {
+    _docview->getHistory()->limit( 32 );
+    // only changed records are appended to journal
+    bool saved = _docview->getHistory()->saveChanges( filename );
+    if ( !saved ) {
         lString16 path16 = LVExtractPath( filename );
         lString8 path = UnicodeToLocal( path16 );
 #ifdef _WIN32
         if ( !CreateDirectoryW( path16.c_str(), NULL ) ) {
             CRLog::error("Cannot create directory %s", path.c_str() );
         } else {
-            stream = LVOpenFileStream( filename.c_str(), LVOM_WRITE );
+            saved = _docview->getHistory()->saveChanges( filename );
         }
 #else
         path.erase( path.length()-1, 1 );
@@ -583,15 +585,15 @@ bool V3DocViewWin::saveHistory( lString16 filename, bool exportBookmarks )
         if ( mkdir(path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) ) {
             CRLog::error("Cannot create directory %s", path.c_str() );
         } else {
-            stream = LVOpenFileStream( filename.c_str(), LVOM_WRITE );
+            saved = _docview->getHistory()->saveChanges( filename );
         }
 #endif
     }
-    if ( stream.isNull() ) {
+    if ( !saved ) {
     	CRLog::error("Error while creating history file %s - position will be lost", UnicodeToUtf8(filename).c_str() );
     	return false;
     }
-    return saveHistory( stream );
+    return true;
 }
 
 void V3DocViewWin::flush()
@@ -9,6 +9,7 @@
 #endif
 #include "../crengine/include/crengine.h"
 #include "../crengine/include/cr3version.h"
+#include "../crengine/include/crconcurrent.h"
 #include "mainwindow.h"
 #if QT_VERSION >= 0x050000
 #include <QtCore/QTranslator>
@@ -364,6 +365,13 @@ bool InitCREngine( const char * exename, lString16Collection & fontDirs )
     lString8 fontDir8 = UnicodeToLocal(fontDir);
     //const char * fontDir8s = fontDir8.c_str();
     //InitFontManager( fontDir8 );
+#if defined(_LINUX)
+    // engine mutexes and background decoding of images of next pages
+    if ( !concurrencyProvider ) {
+        concurrencyProvider = new CRPosixConcurrencyProvider();
+        CRSetupEngineConcurrency();
+    }
+#endif
     InitFontManager(lString8::empty_str);
 
 #ifdef _WIN32
@@ -149,7 +149,7 @@ void RecentBooksDlg::on_actionRemoveItem_triggered()
     int r = index.row();
     LVPtrVector<CRFileHistRecord> & files = m_docview->getDocView()->getHistory()->getRecords();
     if ( r>=0 && r<files.length()-firstItem ) {
-        files.remove( r + firstItem );
+        m_docview->getDocView()->getHistory()->removeRecord( r + firstItem );
         m_ui->tableWidget->removeRow( r );
     }
 }
@@ -161,7 +161,7 @@ void RecentBooksDlg::on_actionClearAll_triggered()
         int firstItem = m_docview->getDocView()->isDocumentOpened() ? 1 : 0;
         LVPtrVector<CRFileHistRecord> & files = m_docview->getDocView()->getHistory()->getRecords();
         for ( int r=files.length(); r>=firstItem; r-- ) {
-            files.remove( r);
+            m_docview->getDocView()->getHistory()->removeRecord( r );
             m_ui->tableWidget->removeRow( r - firstItem );
         }
         close();
@@ -46,5 +46,18 @@ public:
     virtual void run();
 };
 
+#if defined(_LINUX)
+/// pthread based concurrency provider for frontends without own threading, e.g. headless tools; GUI tasks run synchronously
+class CRPosixConcurrencyProvider : public CRConcurrencyProvider {
+public:
+    virtual CRMutex * createMutex();
+    virtual CRMonitor * createMonitor();
+    virtual CRThread * createThread(CRRunnable * threadTask);
+    virtual void executeGui(CRRunnable * task);
+    virtual void executeGui(CRRunnable * task, int delayMillis);
+    virtual void sleepMs(int durationMs);
+};
+#endif
+
 
 #endif // CRCONCURRENT_H
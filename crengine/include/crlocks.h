@@ -57,6 +57,7 @@ extern CRMutex * _fontManMutex;
 extern CRMutex * _fontGlyphCacheMutex;
 extern CRMutex * _fontLocalGlyphCacheMutex;
 extern CRMutex * _crengineMutex;
+extern CRMutex * _imageCacheMutex;
 
 // use REF_GUARD to acquire LVProtectedRef mutex
 #define REF_GUARD CRGuard _refGuard(_refMutex); CR_UNUSED(_refGuard);
@@ -70,6 +71,8 @@ extern CRMutex * _crengineMutex;
 #define FONT_LOCAL_GLYPH_CACHE_GUARD CRGuard _fontLocalGlyphCacheGuard(_fontLocalGlyphCacheMutex); CR_UNUSED(_fontLocalGlyphCacheGuard);
 // use CRENGINE_GUARD to acquire crengine drawing lock
 #define CRENGINE_GUARD CRGuard _crengineGuard(_crengineMutex); CR_UNUSED(_crengineMutex);
+// use IMAGE_CACHE_GUARD to acquire decoded image cache mutex
+#define IMAGE_CACHE_GUARD CRGuard _imageCacheGuard(_imageCacheMutex); CR_UNUSED(_imageCacheGuard);
 
 /// call to create mutexes for different parts of CoolReader engine
 void CRSetupEngineConcurrency();
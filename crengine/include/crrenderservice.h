@@ -0,0 +1,113 @@
+/** \file crrenderservice.h
+    \brief headless page rendering service for many open documents
+
+    CoolReader Engine
+
+    This source code is distributed under the terms of
+    GNU General Public License
+    See LICENSE file for details
+*/
+
+#ifndef CRRENDERSERVICE_H_INCLUDED
+#define CRRENDERSERVICE_H_INCLUDED
+
+#include "lvdocview.h"
+#include "lvhashtable.h"
+#include "crconcurrent.h"
+
+#ifndef RENDER_SERVICE_MAX_OPEN_DOCUMENTS
+/// more documents are closed, least recently used first, and reopened on demand (can't exceed MAX_DOCUMENT_INSTANCE_COUNT - 2)
+#define RENDER_SERVICE_MAX_OPEN_DOCUMENTS 64
+#endif
+
+#ifndef RENDER_SERVICE_DOC_BUFFER_SIZE
+/// default memory budget for unpacked data of each open document
+#define RENDER_SERVICE_DOC_BUFFER_SIZE 0x200000
+#endif
+
+/// receives results of render service requests; called from worker threads without engine lock, so don't use lString here
+class CRRenderServiceCallback {
+public:
+    virtual ~CRRenderServiceCallback() {}
+    /// document is loaded and rendered, pageCount is -1 if loading failed
+    virtual void onDocumentOpened( const char * tag, const char * docId, int pageCount ) = 0;
+    /// page image is written to file or failed
+    virtual void onPageRendered( const char * tag, const char * docId, int page, bool success ) = 0;
+};
+
+class CRRenderServiceDocument;
+class CRRenderServiceTask;
+
+/// renders pages of many documents on worker threads
+/**
+    Requests for one document are executed in order on the same worker.
+
+    Rendering itself is not concurrent: loading, formatting and drawing of all
+    documents are serialized under engine lock (_crengineMutex). Document instances
+    share engine-wide state, and the global font manager (glyph caches, font
+    instances) is not safe for use by several drawing threads. Workers only overlap
+    image encoding and writing, so extra threads help when PNG encoding is a
+    noticeable part of the request time.
+
+    At most MAX_DOCUMENT_INSTANCE_COUNT - 2 documents are loaded at once, since
+    node handles have 8 bits of document index and two instances are kept spare for
+    documents created while a view is loaded; more documents are closed, least
+    recently used first, and reopened on demand.
+
+    String reference counters and string allocator aren't thread safe, so lString
+    instances are created and destroyed under engine lock only: requests take
+    UTF-8 C strings, tasks keep own copies of them, and callbacks get C strings too.
+    Caller should not use lString without engine lock while service is running.
+*/
+class CRRenderService {
+    friend class CRRenderServiceTask;
+    CRRenderServiceCallback * _callback;
+    LVPtrVector<CRThreadExecutor> _workers;
+    /// all documents ever added, entries are kept until service is destroyed; accessed under engine lock
+    LVPtrVector<CRRenderServiceDocument> _documentList;
+    LVHashTable<lString8, CRRenderServiceDocument *> _documents;
+    CRMonitorRef _pendingMonitor;
+    int _pendingCount;
+    int _maxOpenDocuments;
+    int _openDocumentCount;
+    lUInt32 _accessCounter;
+    lString8 _styleSheet;
+    CRPropRef _props;
+
+    /// call under engine lock
+    CRRenderServiceDocument * getDocument( const char * docId, bool create );
+    void submit( CRRenderServiceTask * task );
+    void taskDone();
+    /// returns loaded view of document, closes least recently used ones if necessary; call under engine lock
+    LVDocView * openView( CRRenderServiceDocument * doc );
+    /// call under engine lock
+    void closeView( CRRenderServiceDocument * doc );
+public:
+    /// creates service, engine concurrency should be set up (concurrencyProvider, CRSetupEngineConcurrency()); maxOpenDocuments is capped by MAX_DOCUMENT_INSTANCE_COUNT - 2
+    CRRenderService( int threadCount, int maxOpenDocuments = RENDER_SERVICE_MAX_OPEN_DOCUMENTS );
+    /// stops workers, pending requests are dropped
+    ~CRRenderService();
+    void setCallback( CRRenderServiceCallback * callback ) { _callback = callback; }
+    /// stylesheet for documents opened later; set before submitting requests
+    void setStyleSheet( const lString8 & css ) { _styleSheet = css; }
+    /// view properties for documents opened later; set before submitting requests
+    void setProps( CRPropRef props ) { _props = props; }
+    /// adds document or changes parameters of existing one; it's loaded on first request; fileName is UTF-8
+    void addDocument( const char * docId, const char * fileName, int dx, int dy,
+        int docBufferSize = RENDER_SERVICE_DOC_BUFFER_SIZE );
+    /// closes document, later requests for docId fail until it's added again
+    bool removeDocument( const char * docId );
+    /// loads document if not loaded yet, result is passed to onDocumentOpened()
+    bool openDocument( const char * tag, const char * docId );
+    /// writes page image to file (PNG, or PPM if file name ends with .ppm), result is passed to onPageRendered(); fileName is UTF-8
+    bool renderPage( const char * tag, const char * docId, int page, const char * fileName );
+    /// waits until all submitted requests are done
+    void flush();
+    /// returns number of documents currently loaded
+    int getOpenDocumentCount() { return _openDocumentCount; }
+};
+
+/// writes 32bpp buffer as PNG (if supported) or binary PPM when file name ends with .ppm; fileName is in local encoding, no engine lock needed
+bool LVWriteDrawBufImage( LVColorDrawBuf * buf, const char * fileName );
+
+#endif // CRRENDERSERVICE_H_INCLUDED
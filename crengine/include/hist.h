@@ -13,6 +13,8 @@
 #define HIST_H_INCLUDED
 
 #include "lvptrvec.h"
+#include "lvhashtable.h"
+#include "lvtinydom.h"
 #include <time.h>
 
 enum bmk_type {
@@ -26,6 +28,8 @@ class CRBookmark {
 private:
     lString16 _startpos;
     lString16 _endpos;
+    ldomCompactXPointer _startcompact;
+    ldomCompactXPointer _endcompact;
     int       _percent;
     int       _type;
 	int       _shortcut;
@@ -34,6 +38,7 @@ private:
     lString16 _commenttext;
     time_t    _timestamp;
     int       _page;
+    static ldomXPointer resolvePos( ldomDocument * doc, const lString16 & pos, ldomCompactXPointer & compact );
 public:
 	static lString16 getChapterName( ldomXPointer p );
 
@@ -54,6 +59,8 @@ public:
     CRBookmark(const CRBookmark & v )
     : _startpos(v._startpos)
     , _endpos(v._endpos)
+    , _startcompact(v._startcompact)
+    , _endcompact(v._endcompact)
     , _percent(v._percent)
     , _type(v._type)
 	, _shortcut(v._shortcut)
@@ -68,6 +75,8 @@ public:
     {
         _startpos = v._startpos;
         _endpos = v._endpos;
+        _startcompact = v._startcompact;
+        _endcompact = v._endcompact;
         _percent = v._percent;
         _type = v._type;
 		_shortcut = v._shortcut;
@@ -89,8 +98,18 @@ public:
     int getType() { return _type; }
     int getPercent() { return _percent; }
     time_t getTimestamp() { return _timestamp; }
-    void setStartPos(const lString16 & s ) { _startpos = s; }
-    void setEndPos(const lString16 & s ) { _endpos = s; }
+    /// compact form of start position, NULL if not known yet
+    const ldomCompactXPointer & getStartCompactPos() { return _startcompact; }
+    /// compact form of end position, NULL if not known yet
+    const ldomCompactXPointer & getEndCompactPos() { return _endcompact; }
+    void setStartPos(const lString16 & s ) { _startpos = s; _startcompact.clear(); }
+    void setEndPos(const lString16 & s ) { _endpos = s; _endcompact.clear(); }
+    void setStartCompactPos( const ldomCompactXPointer & pos ) { _startcompact = pos; }
+    void setEndCompactPos( const ldomCompactXPointer & pos ) { _endcompact = pos; }
+    /// resolves start position in document, using compact form if it matches document
+    ldomXPointer getStartXPointer( ldomDocument * doc ) { return resolvePos( doc, _startpos, _startcompact ); }
+    /// resolves end position in document, using compact form if it matches document
+    ldomXPointer getEndXPointer( ldomDocument * doc ) { return resolvePos( doc, _endpos, _endcompact ); }
     void setPosText(const lString16 & s ) { _postext= s; }
     void setTitleText(const lString16 & s ) { _titletext = s; }
     void setCommentText(const lString16 & s ) { _commenttext = s; }
@@ -207,28 +226,63 @@ public:
 };
 
 
+/// state of history record as stored in history file and changes journal
+class CRFileHistSavedState {
+public:
+    lString16 fileName;
+    lvsize_t fileSize;
+    lUInt32 infoHash;
+    LVArray<lUInt32> bookmarkHashes;
+    CRFileHistSavedState( CRFileHistRecord * rec );
+};
+
+#ifndef HIST_JOURNAL_MIN_COMPACT_SIZE
+/// changes journal is merged into history file when it's bigger than this size and than half of history file
+#define HIST_JOURNAL_MIN_COMPACT_SIZE 0x10000
+#endif
+
 class CRFileHist {
 private:
     LVPtrVector<CRFileHistRecord> _records;
-    int findEntry( const lString16 & fname, const lString16 & fpath, lvsize_t sz );
-    void makeTop( int index );
+    /// records by file name and size, topmost record for duplicates; kept in sync by methods changing _records
+    LVHashTable<lString16, CRFileHistRecord *> _index;
+    /// records as stored in history file and journal, to find changes to append
+    LVPtrVector<CRFileHistSavedState> _saved;
+    /// history file name _saved corresponds to
+    lString16 _savedFileName;
+    CRFileHistRecord * findEntry( const lString16 & fname, const lString16 & fpath, lvsize_t sz );
+    void makeTop( CRFileHistRecord * rec );
+    void insertTop( CRFileHistRecord * rec );
+    bool applyJournalRecord( const lString8 & record );
+    void markSaved( const lString16 & fileName );
 public:
     void limit( int maxItems )
     {
         for ( int i=_records.length()-1; i>maxItems; i-- ) {
-            _records.erase( i, 1 );
+            removeRecord( i );
         }
     }
+    /// records, most recent first; use addRecord()/removeRecord() to change the list
     LVPtrVector<CRFileHistRecord> & getRecords() { return _records; }
+    /// appends record to end of list, takes ownership
+    void addRecord( CRFileHistRecord * rec );
+    /// removes and deletes record
+    void removeRecord( int index );
     bool loadFromStream( LVStreamRef stream );
     bool saveToStream( LVStream * stream );
+    /// loads history file and applies changes journal appended by saveChanges()
+    bool loadFromFile( const lString16 & fileName );
+    /// appends changes made since last loadFromFile()/saveChanges() to journal, merges journal into history file when it grows too big
+    bool saveChanges( const lString16 & fileName );
+    /// writes whole history file and removes changes journal
+    bool saveToFile( const lString16 & fileName );
     CRFileHistRecord * savePosition( lString16 fpathname, size_t sz, 
         const lString16 & title,
         const lString16 & author,
         const lString16 & series,
         ldomXPointer ptr );
     ldomXPointer restorePosition(  ldomDocument * doc, lString16 fpathname, size_t sz );
-    CRFileHist()
+    CRFileHist() : _index(1024)
     {
     }
     ~CRFileHist()
@@ -238,4 +292,9 @@ public:
     void clear();
 };
 
+#ifdef _DEBUG
+/// unit test for history file and changes journal
+void runFileHistUnitTests();
+#endif
+
 #endif //HIST_H_INCLUDED
@@ -52,14 +52,24 @@ public:
 class LDOMNameIdMap
 {
 private:
-    LDOMNameIdMapItem * * m_by_id;
-    LDOMNameIdMapItem * * m_by_name;
+    LDOMNameIdMapItem * * m_by_id;   // own and base map items
+    LDOMNameIdMapItem * * m_by_name; // own items only
+    LDOMNameIdMapItem * * m_hash;    // name index of frozen map, open addressing
+    const LDOMNameIdMap * m_base;    // shared frozen map with predefined items, NULL if none
     lUInt16 m_count; // non-empty count
     lUInt16 m_size;  // max number of ids
+    int     m_hashMask;
     bool    m_sorted;
     bool    m_changed;
 
     void    Sort();
+    /// extends id arrays to hold newsize ids
+    void    Resize( lUInt16 newsize );
+    /// puts items of base map to id array
+    void    FillBaseItems();
+    /// hashed search in frozen map
+    const LDOMNameIdMapItem * findHashedItem( const lChar16 * name ) const;
+    const LDOMNameIdMapItem * findHashedItem( const lChar8 * name ) const;
 public:
     /// Main constructor
     LDOMNameIdMap( lUInt16 maxId );
@@ -74,6 +84,14 @@ public:
 
     void Clear();
 
+    /// sorts map and builds name hash index; map must not be changed after this call
+    void Freeze();
+    /// uses frozen map for predefined items, only items missing in base are stored in this map
+    void SetBase( const LDOMNameIdMap * base );
+    const LDOMNameIdMap * getBase() const { return m_base; }
+    /// returns number of own (not base) items
+    int getOwnItemCount() const { return m_count; }
+
     void AddItem( lUInt16 id, const lString16 & value, const css_elem_def_props_t * data );
 
     void AddItem( LDOMNameIdMapItem * item );
@@ -236,6 +236,33 @@ typedef LVArray<int> LVBookMarkPercentInfo;
 
 #define DEF_COLOR_BUFFER_BPP 32
 
+#ifndef IMAGE_PREFETCH_PAGE_COUNT
+/// number of pages after visible ones to decode images for in background
+#define IMAGE_PREFETCH_PAGE_COUNT 2
+#endif
+
+class CRThreadExecutor;
+
+/// image decoding request of background image prefetch
+/**
+    Decoder is created and released by document view thread; background
+    thread only decodes it through raw pointer, so no reference counters
+    are touched by it.
+*/
+struct LVImagePrefetchJob
+{
+    lUInt8 * data;        // copy of encoded image data
+    LVImageSourceRef img; // decoder reading data
+    bool finished;        // set under IMAGE_CACHE_GUARD when background thread doesn't use decoder anymore
+    LVImagePrefetchJob() : data(NULL), finished(false) { }
+    ~LVImagePrefetchJob()
+    {
+        img.Clear();
+        if ( data )
+            free( data );
+    }
+};
+
 /**
     \brief XML document view
 
@@ -334,6 +361,12 @@ private:
     LVDocViewImageCache m_imageCache;
 #endif
 
+    CRThreadExecutor * m_imagePrefetchExecutor; // background image decoder, created on demand
+    volatile int m_imagePrefetchGeneration; // changed to cancel scheduled image prefetch tasks
+    int m_imagePrefetchPage; // first page of last image prefetch request
+    LVPtrVector<LVImagePrefetchJob> m_imagePrefetchJobs; // decoders passed to background thread
+    int m_docBufferSize; // memory budget for unpacked document data, 0 for default
+
 
     lString8 m_defaultFontFace;
 	lString8 m_statusFontFace;
@@ -376,6 +409,8 @@ private:
     void insertBookmarkPercentInfo(int start_page, int end_y, int percent);
 
     void updateDocStyleSheet();
+    /// requests reading of node data of page from cache file on background thread
+    void prefetchPageData( int pageIndex );
 
 protected:
 
@@ -446,9 +481,9 @@ public:
     /// saves current position to navigation history, to be able return back
     bool savePosToNavigationHistory();
     /// saves position to navigation history, to be able return back
-    bool savePosToNavigationHistory(lString16 path);
-    /// navigate to history path URL
-    bool navigateTo( lString16 historyPath );
+    bool savePosToNavigationHistory(lString16 path, const ldomCompactXPointer & pos = ldomCompactXPointer());
+    /// navigate to history path URL, using compact position if it's valid for document
+    bool navigateTo( lString16 historyPath, const ldomCompactXPointer & pos = ldomCompactXPointer() );
     /// packs current file path and name
     lString16 getNavigationPath();
     /// returns pointer to bookmark/last position containter of currently opened file
@@ -598,6 +633,12 @@ public:
     int getCurrentPageCharCount();
     /// returns number of images on current page
     int getCurrentPageImageCount();
+    /// decodes images of pages [page, page+count) into decoded image cache in background, cancels previous request
+    void prefetchPageImages( int page, int count = IMAGE_PREFETCH_PAGE_COUNT );
+    /// cancels scheduled image prefetch tasks; if stop is true, also waits for running task and stops worker thread
+    void cancelImagePrefetch( bool stop = false );
+    /// releases decoders of image prefetch jobs finished by background thread
+    void releaseImagePrefetchJobs();
     /// calculate page header rectangle
     virtual void getPageHeaderRectangle( int pageIndex, lvRect & headerRc );
     /// calculate page header height
@@ -728,6 +769,8 @@ public:
 
     /// returns document
     ldomDocument * getDocument() { return m_doc; }
+    /// sets memory budget for unpacked data of current and later loaded documents, 0 for default
+    void setDocBufferSize( int size );
     /// return document properties
     CRPropRef getDocProps() { return m_doc_props; }
     /// returns book title
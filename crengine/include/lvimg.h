@@ -59,6 +59,10 @@ public:
     virtual void OnStartDecode( LVImageSource * obj ) = 0;
     virtual bool OnLineDecoded( LVImageSource * obj, int y, lUInt32 * data ) = 0;
     virtual void OnEndDecode( LVImageSource * obj, bool errors ) = 0;
+    /// returns size decoded image is going to be scaled to; decoder may produce reduced image not smaller than it
+    virtual bool GetTargetSize( LVImageSource * obj, int & dx, int & dy ) { CR_UNUSED(obj); dx = dy = 0; return false; }
+    /// called before first OnLineDecoded() if decoder produces reduced image of size dx*dy instead of full size
+    virtual void OnDecodedSizeReduced( LVImageSource * obj, int dx, int dy ) { CR_UNUSED3(obj, dx, dy); }
 };
 
 struct CR9PatchInfo {
@@ -128,6 +132,44 @@ LVImageSourceRef LVCreateColorTransformImageSource(LVImageSourceRef srcImage, lU
 /// creates image source which applies alpha to another image source (0 is no change, 255 is totally transparent)
 LVImageSourceRef LVCreateAlphaTransformImageSource(LVImageSourceRef srcImage, int alpha);
 
+/// creates decoded 32 bpp memory copy of image, scaled to specified size the same way as drawing does
+LVImageSourceRef LVCreateScaledImageSource( LVImageSourceRef srcImage, int dx, int dy );
+
+#ifndef DECODED_IMAGE_CACHE_MAX_SIZE
+/// default byte budget of decoded document images cache
+#define DECODED_IMAGE_CACHE_MAX_SIZE 0x1000000
+#endif
+
+/// process-wide LRU cache of decoded document images, scaled to size they are drawn at
+/**
+    Images are keyed by document index, image id (see ldomDocument::getObjectImageId) and size.
+    Cache keeps plain pixel buffers; returned image sources are new objects
+    referencing buffer, so no LVRef counters are shared between threads.
+    Buffers are referenced and released under IMAGE_CACHE_GUARD only.
+*/
+class LVDecodedImageCache
+{
+public:
+    /// returns cached image for document image and size, NULL if not found
+    static LVImageSourceRef find( int docIndex, lUInt32 imageId, int dx, int dy );
+    /// returns true if document image of this size is cached
+    static bool contains( int docIndex, lUInt32 imageId, int dx, int dy );
+    /// returns cached image, decodes and caches source image if not found; returns source image if it cannot be cached
+    static LVImageSourceRef get( int docIndex, lUInt32 imageId, LVImageSourceRef srcImage, int dx, int dy );
+    /// decodes image scaled to dx*dy and adds it to cache unless already cached; doesn't copy image references, so may be called on background thread
+    static bool add( int docIndex, lUInt32 imageId, LVImageSource * srcImage, int dx, int dy );
+    /// removes all cached images of document
+    static void removeDocument( int docIndex );
+    /// removes all cached images
+    static void clear();
+    /// sets byte budget of cache, 0 to disable caching
+    static void setMaxSize( int maxSize );
+    /// returns byte budget of cache
+    static int getMaxSize();
+    /// returns cache statistics
+    static void getStats( int & hits, int & misses, int & itemCount, int & size );
+};
+
 
 class LVFont;
 class LVDrawBuf;
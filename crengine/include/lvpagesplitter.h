@@ -296,11 +296,15 @@ typedef LVFastRef<LVFootNote> LVFootNoteRef;
 class LVFootNote : public LVRefCounter {
     lString16 id;
     CompactArray<LVRendLineInfo*, 2, 4> lines;
+    bool complete;
 public:
     LVFootNote( lString16 noteId )
-        : id(noteId)
+        : id(noteId), complete(false)
     {
     }
+    /// returns true if all lines of note are rendered
+    bool isComplete() { return complete; }
+    void setComplete() { complete = true; }
     void addLine( LVRendLineInfo * line )
     {
         lines.add( line );
@@ -310,12 +314,24 @@ public:
     void clear() { lines.clear(); }
 };
 
+#ifndef PAGE_SPLIT_RELEASE_LINES
+/// number of lines passed to splitter after which lines it doesn't reference anymore are freed
+#define PAGE_SPLIT_RELEASE_LINES 64
+#endif
+
 class LVDocViewCallback;
+struct PageSplitState;
 class LVRendPageContext
 {
 
-
+    /// lines not passed to splitter yet: last added line (it may get links) and lines waiting for footnotes
     LVPtrVector<LVRendLineInfo> lines;
+    /// lines passed to splitter, freed when splitter doesn't reference them
+    LVPtrVector<LVRendLineInfo> splitLines;
+    /// footnote lines passed to splitter, kept until Finalize() since they are reused for every link
+    LVPtrVector<LVRendLineInfo> noteLines;
+    /// page splitting state, pages are added to page_list while document is rendered
+    PageSplitState * splitState;
 
     LVDocViewCallback * callback;
     int totalFinalBlocks;
@@ -351,7 +367,10 @@ class LVRendPageContext
         return ref.get();
     }
 
-    void split();
+    /// passes lines to splitter; until finalize, last line and lines with links to incomplete footnotes are kept
+    void split( bool finalize );
+    /// frees lines which splitter doesn't reference anymore
+    void releaseSplitLines();
 public:
 
 
@@ -377,6 +396,7 @@ public:
     LVRendPageList * getPageList() { return page_list; }
 
     LVRendPageContext(LVRendPageList * pageList, int pageHeight);
+    ~LVRendPageContext();
 
     /// add source line
     void AddLine( int starty, int endy, int flags );
@@ -68,6 +68,10 @@ void lStr_uppercase( lChar16 * str, int len );
 void lStr_lowercase( lChar16 * str, int len );
 /// calculates CRC32 for buffer contents
 lUInt32 lStr_crc32( lUInt32 prevValue, const void * buf, int size );
+/// returns length of leading run of 7-bit ASCII bytes in buffer
+int lStr_asciiPrefixLength( const lUInt8 * buf, int len );
+/// widens 7-bit ASCII bytes to lChar16
+void lStr_asciiToUnicode( lChar16 * dst, const lUInt8 * src, int count );
 
 // converts 0..15 to 0..f
 char toHexDigit( int c );
@@ -106,21 +110,49 @@ void lStr_findWordBounds( const lChar16 * str, int sz, int pos, int & start, int
 #define CONST_STRING_BUFFER_HASH_MULT 31
 
 
+#ifndef LSTRING_INLINE_BUF_SIZE
+/// size of character buffer inside string chunk, in bytes; short strings are stored there without heap allocation
+/**
+    Inline buffer shares memory with heap buffer pointer and size, so it should be
+    at least sizeof(void*) + sizeof(lInt32) + sizeof(lChar16): its last character
+    is used as heap buffer flag and must not overlap pointer and size.
+*/
+#define LSTRING_INLINE_BUF_SIZE 16
+#endif
+
 struct lstring8_chunk_t {
     friend class lString8;
     friend class lString16;
     friend struct lstring_chunk_slice_t;
 public:
-    lstring8_chunk_t(lChar8 * _buf8) : buf8(_buf8), size(1), len(0), nref(1) {}
-    const lChar8 * data8() const { return buf8; }
+    lstring8_chunk_t(lChar8 * _buf8) : len(0), nref(1) { setHeapBuf( _buf8, 1 ); }
+    const lChar8 * data8() const { return buf8(); }
 private:
-    lChar8  * buf8; // z-string
-    lInt32 size;   // 0 for free chunk
+    union {
+        struct {
+            lChar8 * buf;   // z-string
+            lInt32 size;    // max number of chars in buffer, 0 for free chunk
+        } heap;
+        lChar8 inl8[LSTRING_INLINE_BUF_SIZE]; // z-string for short strings, last char is 0 then
+    };
     lInt32 len;    // count of chars in string
     int nref;      // reference counter
 
     lstring8_chunk_t() {}
 
+    enum { INLINE_SIZE = LSTRING_INLINE_BUF_SIZE / sizeof(lChar8) };
+    inline bool isInline() const { return inl8[INLINE_SIZE-1]==0; }
+    inline lChar8 * buf8() { return isInline() ? inl8 : heap.buf; }
+    inline const lChar8 * buf8() const { return isInline() ? inl8 : heap.buf; }
+    /// returns max number of chars which fit in buffer without trailing zero
+    inline int capacity() const { return isInline() ? INLINE_SIZE-1 : heap.size; }
+    inline void setHeapBuf( lChar8 * buf, int sz ) { heap.buf = buf; heap.size = sz; inl8[INLINE_SIZE-1] = 1; }
+
+    // buffer allocation functions, sz is number of chars without trailing zero
+    void allocBuf( int sz );
+    void reallocBuf( int sz );
+    void freeBuf();
+
     // chunk allocation functions
     static lstring8_chunk_t * alloc();
     static void free( lstring8_chunk_t * pChunk );
@@ -132,16 +164,34 @@ struct lstring16_chunk_t {
     friend class lString16;
     friend struct lstring_chunk_slice_t;
 public:
-    lstring16_chunk_t(lChar16 * _buf16) : buf16(_buf16), size(1), len(0), nref(1) {}
-    const lChar16 * data16() const { return buf16; }
+    lstring16_chunk_t(lChar16 * _buf16) : len(0), nref(1) { setHeapBuf( _buf16, 1 ); }
+    const lChar16 * data16() const { return buf16(); }
 private:
-    lChar16 * buf16; // z-string
-    lInt32 size;   // 0 for free chunk
+    union {
+        struct {
+            lChar16 * buf;  // z-string
+            lInt32 size;    // max number of chars in buffer, 0 for free chunk
+        } heap;
+        lChar16 inl16[LSTRING_INLINE_BUF_SIZE / sizeof(lChar16)]; // same chunk size as lstring8_chunk_t, they share slices
+    };
     lInt32 len;    // count of chars in string
     int nref;      // reference counter
 
     lstring16_chunk_t() {}
 
+    enum { INLINE_SIZE = LSTRING_INLINE_BUF_SIZE / sizeof(lChar16) };
+    inline bool isInline() const { return inl16[INLINE_SIZE-1]==0; }
+    inline lChar16 * buf16() { return isInline() ? inl16 : heap.buf; }
+    inline const lChar16 * buf16() const { return isInline() ? inl16 : heap.buf; }
+    /// returns max number of chars which fit in buffer without trailing zero
+    inline int capacity() const { return isInline() ? INLINE_SIZE-1 : heap.size; }
+    inline void setHeapBuf( lChar16 * buf, int sz ) { heap.buf = buf; heap.size = sz; inl16[INLINE_SIZE-1] = 1; }
+
+    // buffer allocation functions, sz is number of chars without trailing zero
+    void allocBuf( int sz );
+    void reallocBuf( int sz );
+    void freeBuf();
+
     // chunk allocation functions
     static lstring16_chunk_t * alloc();
     static void free( lstring16_chunk_t * pChunk );
@@ -285,13 +335,13 @@ public:
     /// replace fragment with repeated character
     lString8 & replace(size_type p0, size_type n0, size_type count, value_type ch);
     /// compare with another string
-    int compare(const lString8& str) const { return lStr_cmp(pchunk->buf8, str.pchunk->buf8); }
+    int compare(const lString8& str) const { return lStr_cmp(pchunk->buf8(), str.pchunk->buf8()); }
     /// compare part of string with another string
     int compare(size_type p0, size_type n0, const lString8& str) const;
     /// compare part of string with fragment of another string
     int compare(size_type p0, size_type n0, const lString8& str, size_type pos, size_type n) const;
     /// compare with C-string
-    int compare(const value_type *s) const  { return lStr_cmp(pchunk->buf8, s); }
+    int compare(const value_type *s) const  { return lStr_cmp(pchunk->buf8(), s); }
     /// compare part of string with C-string
     int compare(size_type p0, size_type n0, const value_type *s) const;
     /// compare part of string with C-string fragment
@@ -343,14 +393,14 @@ public:
     	return modify()[pos];
     }
     /// get character at specified position without range check
-    value_type operator [] ( size_type pos ) const { return pchunk->buf8[pos]; }
+    value_type operator [] ( size_type pos ) const { return pchunk->buf8()[pos]; }
     /// get reference to character at specified position
     value_type & operator [] ( size_type pos ) { return modify()[pos]; }
 
     /// ensures that reference count is 1
     void  lock( size_type newsize );
     /// returns pointer to modifable string buffer
-    value_type * modify() { if (pchunk->nref>1) lock(pchunk->len); return pchunk->buf8; }
+    value_type * modify() { if (pchunk->nref>1) lock(pchunk->len); return pchunk->buf8(); }
     /// clear string
     void  clear() { release(); pchunk = EMPTY_STR_8; addref(); }
     /// clear string, set buffer size
@@ -362,7 +412,7 @@ public:
     /// changes buffer size
     void  resize(size_type count = 0, value_type e = 0);
     /// returns maximum number of chars that can fit into buffer
-    size_type   capacity() const { return pchunk->size-1; }
+    size_type   capacity() const { return pchunk->capacity(); }
     /// reserve space for specified amount of chars
     void  reserve(size_type count = 0);
     /// returns true if string is empty
@@ -383,9 +433,9 @@ public:
     lInt64 atoi64() const;
 
     /// returns C-string
-    const value_type * c_str() const { return pchunk->buf8; }
+    const value_type * c_str() const { return pchunk->buf8(); }
     /// returns C-string
-    const value_type * data() const { return pchunk->buf8; }
+    const value_type * data() const { return pchunk->buf8(); }
 
     /// append string
     lString8 & operator += ( lString8 s ) { return append(s); }
@@ -518,13 +568,13 @@ public:
     /// make string lowercase
     lString16 & lowercase();
     /// compare with another string
-    int compare(const lString16& str) const { return lStr_cmp(pchunk->buf16, str.pchunk->buf16); }
+    int compare(const lString16& str) const { return lStr_cmp(pchunk->buf16(), str.pchunk->buf16()); }
     /// compare subrange with another string
     int compare(size_type p0, size_type n0, const lString16& str) const;
     /// compare subrange with substring of another string
     int compare(size_type p0, size_type n0, const lString16& str, size_type pos, size_type n) const;
-    int compare(const value_type *s) const  { return lStr_cmp(pchunk->buf16, s); }
-    int compare(const lChar8 *s) const  { return lStr_cmp(pchunk->buf16, s); }
+    int compare(const value_type *s) const  { return lStr_cmp(pchunk->buf16(), s); }
+    int compare(const lChar8 *s) const  { return lStr_cmp(pchunk->buf16(), s); }
     int compare(size_type p0, size_type n0, const value_type *s) const;
     int compare(size_type p0, size_type n0, const value_type *s, size_type pos) const;
 
@@ -600,13 +650,13 @@ public:
     /// returns character at specified position, with index bounds checking, fatal error if fails
     value_type & at( size_type pos ) { if ((unsigned)pos > (unsigned)pchunk->len) crFatalError(); return modify()[pos]; }
     /// returns character at specified position, without index bounds checking
-    value_type operator [] ( size_type pos ) const { return pchunk->buf16[pos]; }
+    value_type operator [] ( size_type pos ) const { return pchunk->buf16()[pos]; }
     /// returns reference to specified character position (lvalue)
     value_type & operator [] ( size_type pos ) { return modify()[pos]; }
     /// resizes string, copies if several references exist
     void  lock( size_type newsize );
     /// returns writable pointer to string buffer
-    value_type * modify() { if (pchunk->nref>1) lock(pchunk->len); return pchunk->buf16; }
+    value_type * modify() { if (pchunk->nref>1) lock(pchunk->len); return pchunk->buf16(); }
     /// clears string contents
     void  clear() { release(); pchunk = EMPTY_STR_16; addref(); }
     /// resets string, allocates space for specified amount of characters
@@ -618,7 +668,7 @@ public:
     /// resizes string buffer, appends with specified character if buffer is being extended
     void  resize(size_type count = 0, value_type e = 0);
     /// returns string buffer size
-    size_type   capacity() const { return pchunk->size-1; }
+    size_type   capacity() const { return pchunk->capacity(); }
     /// ensures string buffer can hold at least count characters
     void  reserve(size_type count = 0);
     /// erase all extra characters from end of string after size
@@ -644,9 +694,9 @@ public:
     /// converts to 64 bit integer, returns true if success
     bool atoi( lInt64 &n ) const;
     /// returns constant c-string pointer
-    const value_type * c_str() const { return pchunk->buf16; }
+    const value_type * c_str() const { return pchunk->buf16(); }
     /// returns constant c-string pointer, same as c_str()
-    const value_type * data() const { return pchunk->buf16; }
+    const value_type * data() const { return pchunk->buf16(); }
     /// appends string
     lString16 & operator += ( lString16 s ) { return append(s); }
     /// appends c-string
@@ -694,6 +744,30 @@ const lString16 & cs16(const char * str);
 /// get reference to atomic constant wide string for string literal e.g. cs16(L"abc") -- fast and memory effective replacement of lString16(L"abc")
 const lString16 & cs16(const lChar16 * str);
 
+#ifndef LSTR_SEARCH_BMH_MIN_PATTERN
+/// shorter patterns are searched by vector scan for first char instead of Boyer-Moore-Horspool skipping
+#define LSTR_SEARCH_BMH_MIN_PATTERN 4
+#endif
+
+/// precompiled substring search pattern, optionally case insensitive (same folding as lString16::lowercase())
+class lString16SearchPattern
+{
+    lString16 _pattern;   ///< pattern text, lowercased if case insensitive
+    bool _caseInsensitive;
+    int _skip[256];       ///< forward shifts by low byte of last char of window
+    int _revSkip[256];    ///< backward shifts by low byte of first char of window
+    lChar16 _first[2];    ///< chars which match first pattern char
+    bool matchAt( const lChar16 * text, int from, int to ) const;
+public:
+    lString16SearchPattern( const lString16 & pattern, bool caseInsensitive );
+    /// returns pattern length
+    int length() const { return _pattern.length(); }
+    /// returns position of first match starting at pos or later, -1 if not found
+    int find( const lChar16 * text, int len, int pos ) const;
+    /// returns position of last match starting at pos or before, -1 if not found
+    int findRev( const lChar16 * text, int len, int pos ) const;
+};
+
 /// collection of wide strings
 class lString16Collection
 {
@@ -1154,6 +1228,11 @@ void free_ls_storage();
 lUInt64 GetCurrentTimeMillis();
 void CRReinitTimer();
 
+#ifdef _DEBUG
+/// lString8 and lString16 unit tests
+void runStringUnitTests();
+#endif
+
 
 
 #ifdef _DEBUG
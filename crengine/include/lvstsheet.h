@@ -46,6 +46,7 @@
 
 #include "cssdef.h"
 #include "lvstyles.h"
+#include "lvhashtable.h"
 
 class lxmlDocBase;
 class ldomNode;
@@ -117,6 +118,8 @@ public:
     LVCssSelectorRule( LVCssSelectorRule & v );
     void setId( lUInt16 id ) { _id = id; }
     void setAttr( lUInt16 id, lString16 value ) { _attrid = id; _value = value; }
+    LVCssSelectorRuleType getType() const { return _type; }
+    const lString16 & getValue() const { return _value; }
     LVCssSelectorRule * getNext() { return _next; }
     void setNext(LVCssSelectorRule * next) { _next = next; }
     ~LVCssSelectorRule() { if (_next) delete _next; }
@@ -158,6 +161,10 @@ public:
     }
     void setDeclaration( LVCssDeclRef decl ) { _decl = decl; }
     int getSpecificity() { return _specificity; }
+    /// returns true if rightmost compound selector requires .class or #id value, sets its rule type and value
+    bool getKey( LVCssSelectorRuleType & type, lString16 & value ) const;
+    /// returns true if selector checks only element name, .class and #id of node itself (no combinators or other attributes)
+    bool isContextFree() const;
     LVCssSelector * getNext() { return _next; }
     void setNext(LVCssSelector * next) { _next = next; }
     lUInt32 getHash();
@@ -177,6 +184,19 @@ class LVStyleSheet {
     lxmlDocBase * _doc;
     LVPtrVector <LVCssSelector> _selectors;
 
+    // index of universal selectors chain (_selectors[0]) by .class or #id of rightmost compound selector
+    bool _indexed;
+    LVArray<LVCssSelector*> _universal;       // universal chain items, in chain order
+    LVArray<int> _unkeyed;                    // positions of universal items to check for any node
+    LVHashTable<lString16, int> _classIndex;  // lowercased class value -> bucket index
+    LVHashTable<lString16, int> _idIndex;     // id value -> bucket index
+    LVPtrVector< LVArray<int> > _buckets;     // positions of keyed universal items
+    bool _universalContextFree;               // universal chain has no context dependent selectors
+    LVArray<bool> _contextFree;               // element id -> element chain has no context dependent selectors
+    lUInt32 _generation;                      // changed on each modification of rules
+    void buildIndex();
+    void invalidateIndex();
+
     LVPtrVector <LVPtrVector <LVCssSelector> > _stack;
     LVPtrVector <LVCssSelector> * dup()
     {
@@ -212,17 +232,21 @@ public:
     }
 
     /// remove all rules from stylesheet
-    void clear() { _selectors.clear(); _stack.clear(); }
+    void clear() { _selectors.clear(); _stack.clear(); invalidateIndex(); }
     /// set document to retrieve ID values from
     void setDocument( lxmlDocBase * doc ) { _doc = doc; }
     /// constructor
-    LVStyleSheet( lxmlDocBase * doc = NULL ) : _doc(doc) { }
+    LVStyleSheet( lxmlDocBase * doc = NULL );
     /// copy constructor
     LVStyleSheet( LVStyleSheet & sheet );
     /// parse stylesheet, compile and add found rules to sheet
     bool parse( const char * str );
     /// apply stylesheet to node style
     void apply( const ldomNode * node, css_style_rec_t * style );
+    /// returns true if result of apply() for element depends only on its name, class, id (not on parents or siblings)
+    bool isContextFree( lUInt16 elementId );
+    /// returns value which is changed on each modification of stylesheet rules
+    lUInt32 getGeneration() const { return _generation; }
     /// calculate hash
     lUInt32 getHash();
 };
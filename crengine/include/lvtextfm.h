@@ -222,6 +222,25 @@ void lvtextAddSourceLine(
    lInt8           letter_spacing
                          );
 
+/** Add source text line in UTF-8
+
+    Text is decoded directly to own buffer of fragment, LTEXT_FLAG_OWNTEXT is always set
+*/
+void lvtextAddSourceLineUtf8(
+   formatted_text_fragment_t * pbuffer,
+   lvfont_handle   font,     /* handle of font to draw string */
+   const lChar8 *  text,     /* pointer to utf-8 text */
+   lUInt32         len,      /* number of bytes in text */
+   lUInt32         color,    /* text color */
+   lUInt32         bgcolor,  /* background color */
+   lUInt32         flags,    /* flags */
+   lUInt8          interval, /* interline space, *16 (16=single, 32=double) */
+   lUInt16         margin,   /* first line margin */
+   void *          object,   /* pointer to custom object */
+   lUInt16         offset,    /* offset from node/object start to start of line */
+   lInt8           letter_spacing
+                         );
+
 /** Add source object
 
     Call this function after lvtextInitFormatter for each source fragment
@@ -298,6 +317,27 @@ public:
             flags, interval, margin, object, (lUInt16)offset, letter_spacing );
     }
 
+    /// adds UTF-8 text, without intermediate wide string copy
+    void AddSourceLineUtf8(
+           const lChar8 *  text,        /* pointer to utf-8 text */
+           lUInt32         len,         /* number of bytes in text */
+           lUInt32         color,       /* text color */
+           lUInt32         bgcolor,     /* background color */
+           LVFont          * font,        /* font to draw string */
+           lUInt32         flags=LTEXT_ALIGN_LEFT|LTEXT_FLAG_OWNTEXT,
+           lUInt8          interval=16, /* interline space, *16 (16=single, 32=double) */
+           lUInt16         margin=0,    /* first line margin */
+           void *          object=NULL,
+           lUInt32         offset=0,
+           lInt8           letter_spacing=0
+        )
+    {
+        lvtextAddSourceLineUtf8(m_pbuffer,
+            font,
+            text, len, color, bgcolor,
+            flags, interval, margin, object, (lUInt16)offset, letter_spacing );
+    }
+
     lUInt32 Format(lUInt16 width, lUInt16 page_height);
 
     int GetSrcCount()
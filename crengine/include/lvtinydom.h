@@ -231,9 +231,40 @@ public:
     LVStreamRef getBlob( lString16 name );
 };
 
+class ldomDataStorageManager;
+
+#ifndef DOC_MEMORY_BUDGET
+/// default process-wide limit of unpacked node data of all documents, 0 to use per-document DOC_BUFFER_SIZE limits
+#define DOC_MEMORY_BUDGET 0
+#endif
+
+/// keeps unpacked node data of all open documents within single budget, dropping least recently used chunks first
+class ldomMemoryGovernor
+{
+    static LVArray<ldomDataStorageManager *> * _storages;
+    static lInt64 _budget;
+    static lUInt64 _accessCounter;
+public:
+    /// sets budget in bytes; when 0, each storage is limited by its own document buffer share
+    static void setBudget( lInt64 bytes ) { _budget = bytes; }
+    /// returns budget in bytes, 0 if disabled
+    static lInt64 getBudget() { return _budget; }
+    /// returns total size of unpacked node data in all storages
+    static lInt64 getUsage();
+    /// returns number of registered storages (four per document)
+    static int getStorageCount() { return _storages ? _storages->length() : 0; }
+    /// returns next chunk access stamp (64-bit, never wraps)
+    static lUInt64 touch() { return ++_accessCounter; }
+    static void registerStorage( ldomDataStorageManager * storage );
+    static void unregisterStorage( ldomDataStorageManager * storage );
+    /// packs least recently used chunks if usage with reservedSpace exceeds budget; cache file may be created for requesting storage's document only
+    static void compact( ldomDataStorageManager * requester, int reservedSpace );
+};
+
 class ldomDataStorageManager
 {
     friend class ldomTextStorageChunk;
+    friend class ldomMemoryGovernor;
 protected:
     tinyNodeCollection * _owner;
     LVPtrVector<ldomTextStorageChunk> _chunks;
@@ -244,7 +275,11 @@ protected:
     int _maxUncompressedSize;
     int _chunkSize;
     char _type;       /// type, to show in log
+    int _lastLoadedChunk; /// index of chunk recently read from cache file
+    int _sequentialLoads; /// number of subsequent chunks read from cache file in a row
     ldomTextStorageChunk * getChunk( lUInt32 address );
+    /// called when chunk is read from cache file, reads next chunks ahead on sequential access
+    void chunkLoaded( int index );
 public:
     /// type
     lUInt16 cacheType();
@@ -257,7 +292,11 @@ public:
     /// checks buffer sizes, compacts most unused chunks
     void compact( int reservedSpace );
     int getUncompressedSize() { return _uncompressedSize; }
+    /// sets limit of unpacked data size; chunks over limit are packed on next compact()
+    void setMaxUncompressedSize( int size ) { _maxUncompressedSize = size; }
 #if BUILD_LITE!=1
+    /// requests reading of packed chunks in range (inclusive) from cache file on background thread
+    void prefetchChunks( int first, int last );
     /// allocates new text node, return its address inside storage
     lUInt32 allocText( lUInt32 dataIndex, lUInt32 parentIndex, const lString8 & text );
     /// allocates storage for new element, returns address address inside storage
@@ -266,6 +305,10 @@ public:
     lString8 getText( lUInt32 address );
     /// get pointer to text data
     TextDataStorageItem * getTextItem( lUInt32 addr );
+    /// get pointer to text data, chunk is not packed until unpinText() is called; NULL (and nothing pinned) if not found
+    TextDataStorageItem * pinText( lUInt32 addr );
+    /// releases chunk pinned by pinText()
+    void unpinText( lUInt32 addr );
     /// get pointer to element data
     ElementDataStorageItem * getElem( lUInt32 addr );
     /// change node's parent, returns true if modified
@@ -296,6 +339,7 @@ public:
 class ldomTextStorageChunk
 {
     friend class ldomDataStorageManager;
+    friend class ldomMemoryGovernor;
     ldomDataStorageManager * _manager;
     ldomTextStorageChunk * _nextRecent;
     ldomTextStorageChunk * _prevRecent;
@@ -305,6 +349,8 @@ class ldomTextStorageChunk
     lUInt16 _index;  /// ? index of chunk in storage
     char _type;       /// type, to show in log
     bool _saved;
+    lUInt64 _lastAccess; /// ldomMemoryGovernor access stamp
+    int _pinCount;       /// number of text references into unpacked data, chunk is not packed while pinned
 
     void setunpacked( const lUInt8 * buf, int bufsize );
     /// pack data, and remove unpacked
@@ -336,6 +382,8 @@ public:
     int addElem( lUInt32 dataIndex, lUInt32 parentIndex, int childCount, int attrCount );
     /// get text item from buffer by offset
     lString8 getText( int offset );
+    /// get pointer to text item by offset, NULL if out of range
+    TextDataStorageItem * getTextItem( int offset );
     /// get node parent by offset
     lUInt32 getParent( int offset );
     /// set node parent by offset
@@ -358,7 +406,271 @@ public:
 // forward declaration
 class ldomNode;
 
-#define TNC_PART_COUNT 1024
+#if BUILD_LITE!=1
+
+#ifndef STYLE_MEMO_MAX_ITEMS
+/// max number of computed styles kept by ldomStyleMemo, memo is reset when exceeded
+#define STYLE_MEMO_MAX_ITEMS 4096
+#endif
+
+/// memo of computed element styles
+/**
+    When none of stylesheet selectors applicable to element checks parents, siblings
+    or attributes other than class and id, computed style depends only on parent style,
+    element name, and class, id, style attribute values, and can be reused for elements
+    with the same values.
+*/
+class ldomStyleMemo
+{
+public:
+    /// memo lookup key
+    class Key {
+        friend class ldomStyleMemo;
+        css_style_ref_t _parentStyle;
+        lUInt16 _elementId;
+        lString16 _class;
+        lString16 _id;
+        lString16 _style;
+        lUInt32 _hash;
+    public:
+        Key() : _elementId(0), _hash(0) { }
+        /// fill key from element and its parent style
+        void init( ldomNode * node, css_style_ref_t & parentStyle );
+        bool operator == ( const Key & v ) const
+        {
+            return _hash==v._hash && _elementId==v._elementId && _parentStyle.get()==v._parentStyle.get()
+                    && _class==v._class && _id==v._id && _style==v._style;
+        }
+    };
+private:
+    struct Item {
+        Key key;
+        css_style_ref_t style;
+        int next; // next item with the same hash table slot, -1 if none
+    };
+    LVPtrVector<Item> _items;
+    LVHashTable<lUInt32, int> _index; // key hash -> index of first item
+    lUInt32 _sheetGeneration;
+    int _baseFontSize;
+    bool _internalStyles;
+    int _hits;
+    int _misses;
+public:
+    ldomStyleMemo() : _index(1024), _sheetGeneration(0), _baseFontSize(0), _internalStyles(false), _hits(0), _misses(0) { }
+    /// resets memo if stylesheet or document settings have been changed since last call
+    void validate( lUInt32 sheetGeneration, int baseFontSize, bool internalStyles );
+    /// finds style remembered for key
+    bool find( const Key & key, css_style_ref_t & style );
+    /// remembers style for key
+    void add( const Key & key, css_style_ref_t & style );
+    /// removes all items
+    void clear();
+};
+
+#ifndef BLOCK_GEOMETRY_CACHE_MAX_SIZE
+/// max memory used by geometry of final blocks kept by document, cache is reset when exceeded
+#define BLOCK_GEOMETRY_CACHE_MAX_SIZE 0x400000
+#endif
+
+/// line and word positions of formatted final block
+/**
+    Compact copy of LFormattedText layout, sufficient to convert point inside
+    final block to text offset and back without formatting of block.
+*/
+class ldomBlockGeometry
+{
+public:
+    /// source fragment
+    struct Src {
+        lUInt32 node;       // data index of source node, 0 if none
+        lUInt32 flags;      // LTEXT_xxx flags
+        lUInt16 offset;     // offset from node start
+        lUInt16 len;        // number of chars
+        lInt8 letterSpacing;
+    };
+    /// formatted line
+    struct Line {
+        lUInt32 y;
+        lUInt16 x;
+        lUInt16 height;
+        lUInt32 firstWord;  // index of first word in words array
+        lUInt32 wordCount;
+    };
+    /// formatted word
+    struct Word {
+        lUInt16 src;        // source fragment index
+        lUInt16 x;
+        lUInt16 width;
+        lUInt16 start;      // start of word in source text (height for object)
+        lUInt16 len;
+    };
+    LVArray<Src> srcs;
+    LVArray<Line> lines;
+    LVArray<Word> words;
+
+    ldomBlockGeometry() { }
+    /// copies layout of formatted text
+    void init( LFormattedText * txtform );
+    /// returns index of first line with bottom below y, last line if none
+    int findLine( int y ) const;
+    /// returns approximate size of memory used
+    int getSize() const;
+    void serialize( SerialBuf & buf ) const;
+    bool deserialize( SerialBuf & buf );
+};
+
+/// geometry of recently used final blocks, by data index of final node
+class ldomBlockGeometryCache
+{
+    LVHashTable<lUInt32, ldomBlockGeometry*> _map;
+    int _size;
+    bool _changed;
+public:
+    ldomBlockGeometryCache() : _map(1024), _size(0), _changed(false) { }
+    ~ldomBlockGeometryCache() { clear(); }
+    /// returns geometry of block, NULL if not found
+    ldomBlockGeometry * get( lUInt32 nodeIndex );
+    /// stores geometry of block (takes ownership)
+    void set( lUInt32 nodeIndex, ldomBlockGeometry * geometry );
+    /// forget geometry of block
+    void remove( lUInt32 nodeIndex );
+    /// removes all items
+    void clear();
+    /// returns true if items were added or removed since last serialization
+    bool isChanged() const { return _changed; }
+    void serialize( SerialBuf & buf );
+    bool deserialize( SerialBuf & buf );
+};
+
+/// content measures of table cells, by data index of table node
+/**
+    Column widths are distributed by text length of cells; it doesn't depend
+    on styles and page size, so tables are measured once per document, and
+    measures are kept in cache file for later renders.
+*/
+class ldomTableCellCache
+{
+    LVHashTable<lUInt32, LVArray<lInt32>*> _map;
+    bool _changed;
+public:
+    ldomTableCellCache() : _map(256), _changed(false) { }
+    ~ldomTableCellCache() { clear(); }
+    /// returns text lengths of cells in table order, NULL if not measured yet
+    LVArray<lInt32> * get( lUInt32 tableIndex );
+    /// stores text lengths of table cells (takes ownership)
+    void set( lUInt32 tableIndex, LVArray<lInt32> * lengths );
+    /// removes all items
+    void clear();
+    /// returns true if items were added or removed since last serialization
+    bool isChanged() const { return _changed; }
+    void serialize( SerialBuf & buf );
+    bool deserialize( SerialBuf & buf );
+};
+
+#ifndef RENDER_POSITION_BLOCK_STEP
+/// min vertical distance between final blocks recorded in ldomRenderPositionIndex, pixels
+#define RENDER_POSITION_BLOCK_STEP 256
+#endif
+
+/// positions of images and final blocks in rendered document, for finding nodes of page without walking document tree
+/**
+    Filled while document is rendered with page splitting and kept in cache
+    file along with page list. Images inside table cells are not recorded.
+    Final blocks are sampled at least RENDER_POSITION_BLOCK_STEP apart,
+    so nodes of page lie between recorded blocks around its y range.
+*/
+class ldomRenderPositionIndex
+{
+public:
+    /// image drawn inside final block
+    struct Image {
+        lInt32 y;       // top of line with image
+        lUInt32 node;   // data index of image element
+        lInt32 dx;      // size image is drawn at
+        lInt32 dy;
+    };
+    /// final block
+    struct Block {
+        lInt32 y;       // top of block
+        lUInt32 node;   // data index of block element
+        lUInt32 text;   // data index of first text node of block
+    };
+private:
+    LVArray<Image> _images;
+    LVArray<Block> _blocks;
+    bool _changed;
+public:
+    ldomRenderPositionIndex() : _changed(false) { }
+    /// adds image drawn at line starting at y
+    void addImage( int y, lUInt32 node, int dx, int dy );
+    /// appends images with line top in range [y0, y1) to list
+    void findImages( int y0, int y1, LVArray<Image> & images ) const;
+    /// returns number of recorded images
+    int getImageCount() const { return _images.length(); }
+    /// adds final block starting at y unless previous recorded block is closer than RENDER_POSITION_BLOCK_STEP
+    void addBlock( int y, lUInt32 node, lUInt32 text );
+    /// finds recorded blocks around range [y0, y1): last one starting at or before y0 and first one starting at or after y1; false if none recorded
+    bool findBlocks( int y0, int y1, Block & first, Block & last ) const;
+    /// returns number of recorded blocks
+    int getBlockCount() const { return _blocks.length(); }
+    /// removes all items
+    void clear();
+    /// returns true if items were added or removed since last serialization
+    bool isChanged() const { return _changed; }
+    void serialize( SerialBuf & buf );
+    bool deserialize( SerialBuf & buf );
+};
+
+#ifndef TEXT_SEARCH_INDEX_MIN_TEXT_NODES
+/// search index is saved to cache file only for documents with at least this number of text nodes
+#define TEXT_SEARCH_INDEX_MIN_TEXT_NODES 1000
+#endif
+
+/// inverted index of words of document text, for fast text search
+/**
+    Maps lowercase words (runs of letters and digits) to text nodes containing them.
+    Text node may contain search pattern only if each run of letters and digits
+    of lowercase pattern is a substring of some word of node, so search can skip
+    other nodes without reading their text.
+*/
+class ldomTextSearchIndex
+{
+    // building state
+    LVHashTable<lString16, int> * _termIds;
+    LVPtrVector< LVArray<lUInt32> > _termNodes;
+    lString8Collection _newTerms;
+    // compact form
+    lString8 _terms;                // UTF8 terms separated by spaces
+    LVArray<lUInt32> _termStart;    // start of each term in _terms
+    LVArray<lUInt32> _postingStart; // start of each term's node list in _postings, with end sentinel
+    LVArray<lUInt8> _postings;      // delta coded text node numbers, 7 bits per byte
+    lUInt32 _maxNode;
+    bool _ready;
+public:
+    ldomTextSearchIndex() : _termIds(NULL), _maxNode(0), _ready(false) { }
+    ~ldomTextSearchIndex() { clear(); }
+    /// returns true if index is built or loaded
+    bool isReady() const { return _ready; }
+    /// adds words of text node to index being built; nodes should be added in ascending order
+    void addText( lUInt32 nodeNumber, lString16 text );
+    /// finishes building, converts index to compact form
+    void finishBuild();
+    /// removes all data
+    void clear();
+    /// sets bits for text nodes which may contain pattern, returns false if index cannot narrow search
+    bool findCandidates( lString16 pattern, LVArray<lUInt32> & nodeBits ) const;
+    /// returns true if text node is set in bitmap filled by findCandidates()
+    static bool isCandidate( const LVArray<lUInt32> & nodeBits, ldomNode * node );
+    void serialize( SerialBuf & buf ) const;
+    bool deserialize( SerialBuf & buf );
+};
+
+#endif
+
+/// initial size of node part lists, they are grown on demand
+#define TNC_PART_COUNT 64
+/// max number of node parts (part index is 16 bit block index in cache file), limits node count to 64M
+#define TNC_PART_COUNT_MAX 0x10000
 #define TNC_PART_SHIFT 10
 #define TNC_PART_INDEX_SHIFT (TNC_PART_SHIFT+4)
 #define TNC_PART_LEN (1<<TNC_PART_SHIFT)
@@ -372,10 +684,12 @@ class tinyNodeCollection
 private:
     int _textCount;
     lUInt32 _textNextFree;
-    ldomNode * _textList[TNC_PART_COUNT];
+    ldomNode ** _textList;
+    int _textListSize;
     int _elemCount;
     lUInt32 _elemNextFree;
-    ldomNode * _elemList[TNC_PART_COUNT];
+    ldomNode ** _elemList;
+    int _elemListSize;
     LVIndexedRefCache<css_style_ref_t> _styles;
     LVIndexedRefCache<font_ref_t> _fonts;
     int _tinyElementCount;
@@ -386,6 +700,12 @@ protected:
 #if BUILD_LITE!=1
     /// final block cache
     CVRendBlockCache _renderedBlockCache;
+    /// line/word geometry of final blocks, for hit testing
+    ldomBlockGeometryCache _blockGeometry;
+    /// measures of table cells, kept between renders
+    ldomTableCellCache _tableCells;
+    /// positions of images on pages, filled by render
+    ldomRenderPositionIndex _renderPositions;
     CacheFile * _cacheFile;
     bool _mapped;
     bool _maperror;
@@ -412,6 +732,9 @@ protected:
     LVStyleSheet  _stylesheet;
 
     LVHashTable<lUInt16, lUInt16> _fontMap; // style index to font index
+#if BUILD_LITE!=1
+    ldomStyleMemo _styleMemo; // computed styles of elements which don't depend on context
+#endif
 
     /// checks buffer sizes, compacts most unused chunks
     ldomBlobCache _blobCache;
@@ -428,6 +751,8 @@ protected:
     bool saveNodeData( lUInt16 type, ldomNode ** list, int nodecount );
     bool loadNodeData();
     bool loadNodeData( lUInt16 type, ldomNode ** list, int nodecount );
+    /// frees node parts of list allocated by loadNodeData()
+    static void freeNodeData( ldomNode ** list, int size );
 
 
     bool openCacheFile();
@@ -463,6 +788,13 @@ public:
     /// called on document loading end
     bool validateDocument();
 
+    /// sets memory budget for unpacked node data, 0 to use default DOC_BUFFER_SIZE
+    void setDocBufferSize( int size );
+    /// returns size of unpacked node data of document
+    int getUnpackedDataSize();
+    /// requests reading of node data chunks for elements and text nodes between given ones (data indexes, 0 to skip) from cache file on background thread
+    void prefetchRange( lUInt32 fromElement, lUInt32 toElement, lUInt32 fromText, lUInt32 toText );
+
 #if BUILD_LITE!=1
     /// swaps to cache file or saves changes, limited by time interval (can be called again to continue after TIMEOUT)
     virtual ContinuousOperationResult swapToCache(CRTimerUtil & maxTime) = 0;
@@ -522,6 +854,8 @@ public:
     ldomNode * getTinyNode( lUInt32 index );
     /// allocate new ldomNode
     ldomNode * allocTinyNode( int type );
+    /// grows node part list to have room for part with specified index
+    static void growNodeList( ldomNode ** & list, int & size, int partIndex );
     /// allocate new tinyElement
     ldomNode * allocTinyElement( ldomNode * parent, lUInt16 nsid, lUInt16 id );
     /// recycle ldomNode on node removing
@@ -568,10 +902,10 @@ public:
 };
 #endif
 
-/// compact 32bit value for node
+/// compact value for node: data index has 28 bits for node index and 4 bits for type
 struct ldomNodeHandle {
     unsigned _docIndex:8;   // index in ldomNode::_documentInstances[MAX_DOCUMENT_INSTANCE_COUNT];
-    unsigned _dataIndex:24; // index of node in document's storage and type
+    unsigned _dataIndex;    // index of node in document's storage and type
 };
 
 /// max number which could be stored in ldomNodeHandle._docIndex
@@ -586,6 +920,7 @@ class ldomNode
     friend class tinyNodeCollection;
     friend class RenderRectAccessor;
     friend class NodeImageProxy;
+    friend class ldomTextRef;
 
 private:
 
@@ -607,10 +942,10 @@ private:
 #endif
     };
 
-    /// 0: packed 32bit data field
+    /// 0: document and data index, 8 bytes
     ldomNodeHandle _handle; // _docIndex, _dataIndex, _type
 
-    /// 4: misc data 4 bytes (8 bytes on x64)
+    /// 8: misc data 4 bytes (8 bytes on x64)
     union {                    // [8] 8 bytes (16 bytes on x64)
         ldomTextNode * _text_ptr;   // NT_TEXT: mutable text node pointer
         tinyElement * _elem_ptr;    // NT_ELEMENT: mutable element pointer
@@ -655,6 +990,11 @@ private:
     void autoboxChildren( int startIndex, int endIndex );
     void removeChildren( int startIndex, int endIndex );
 
+    /// returns UTF-8 text of text node, storage chunk of persistent node is not packed until unpinText(); NULL with len=0 if node has no text
+    const lChar8 * pinText( int & len ) const;
+    /// releases text returned by pinText()
+    void unpinText() const;
+
 public:
 #if BUILD_LITE!=1
     /// if stylesheet file name is set, and file is found, set stylesheet to its value
@@ -772,6 +1112,8 @@ public:
     lString16 getText( lChar16 blockDelimiter = 0, int maxSize=0 ) const;
     /// returns text node text as utf8 string
     lString8 getText8( lChar8 blockDelimiter = 0, int maxSize=0 ) const;
+    /// returns number of characters in node text (same as getText().length()), without conversion of whole text
+    int getTextLength() const;
     /// sets text node text as wide string
     void setText( lString16 );
     /// sets text node text as utf8 string
@@ -850,6 +1192,8 @@ public:
 #if BUILD_LITE!=1
     /// returns object image source
     LVImageSourceRef getObjectImageSource();
+    /// returns object image source decoded and scaled to size it's drawn at, using decoded image cache
+    LVImageSourceRef getObjectImageSource( int dx, int dy );
     /// returns object image ref name
     lString16 getObjectImageRefName();
     /// returns object image stream
@@ -868,6 +1212,32 @@ public:
     bool getNodeListMarker( int & counterValue, lString16 & marker, int & markerWidth );
 };
 
+/// UTF-8 text of text node, accessed in place
+/**
+    Points into unpacked data of persistent text node, or into text of mutable one,
+    so no copy is made. Storage chunk is not packed while object exists, even if
+    other chunks are unpacked meanwhile. Node text must not be changed while in use.
+*/
+class ldomTextRef
+{
+    const ldomNode * _node;
+    const lChar8 * _text;
+    int _len;
+    ldomTextRef( const ldomTextRef & );
+    ldomTextRef & operator = ( const ldomTextRef & );
+public:
+    /// empty text for element node
+    explicit ldomTextRef( const ldomNode * node );
+    ~ldomTextRef();
+    /// returns UTF-8 text, not zero terminated
+    const lChar8 * text() const { return _text; }
+    /// returns length of text in bytes
+    int length() const { return _len; }
+    bool empty() const { return _len==0; }
+    /// decodes text to dst, reusing its buffer
+    void decode( lString16 & dst ) const;
+};
+
 
 // default: 512K
 #define DEF_DOC_DATA_BUFFER_SIZE 0x80000
@@ -1113,6 +1483,8 @@ protected:
     lString16HashedCollection _attrValueTable;
     LVHashTable<lUInt16,lInt32> _idNodeMap; // id to data index map
     LVHashTable<lString16,LVImageSourceRef> _urlImageMap; // url to image source map
+    LVHashTable<lUInt32,lUInt32> _imageNodeIdMap; // image node data index to image id map
+    LVHashTable<lString16,lUInt32> _urlImageIdMap; // url to image id map
     lUInt16 _idAttrId; // Id for "id" attribute name
     lUInt16 _nameAttrId; // Id for "name" attribute name
 
@@ -1158,6 +1530,21 @@ class ldomDocument;
 class ldomDocument;
 
 
+/// compact binary document position, valid only for document with the same content hash
+struct ldomCompactXPointer
+{
+    lUInt32 docHash;   ///< ldomDocument::getContentHash() of document position is taken from
+    lUInt32 dataIndex; ///< node data index
+    lInt32 offset;     ///< offset within node
+    ldomCompactXPointer() : docHash(0), dataIndex(0), offset(0) { }
+    bool isNull() const { return dataIndex==0; }
+    void clear() { docHash = 0; dataIndex = 0; offset = 0; }
+    /// encodes position as hex digits string
+    lString16 toString() const;
+    /// decodes position from toString() result, returns false if string has wrong format
+    bool fromString( const lString16 & s );
+};
+
 /**
  * @brief XPointer/XPath object with reference counting.
  * 
@@ -1234,6 +1621,8 @@ public:
 #endif
     /// returns offset within node
 	inline int getOffset() const { return _data->getOffset(); }
+    /// returns compact binary form of pointer
+    ldomCompactXPointer toCompact() const;
 	/// set pointer node
     inline void setNode( ldomNode * node ) { _data->setNode( node ); }
 	/// set pointer offset within node
@@ -1888,25 +2277,30 @@ class ldomNavigationHistory
 {
     private:
         lString16Collection _links;
+        LVArray<ldomCompactXPointer> _positions; // compact form of link position, if known
         int _pos;
         void clearTail()
         {
-            if (_links.length() > _pos)
+            if (_links.length() > _pos) {
                 _links.erase(_pos, _links.length() - _pos);
+                _positions.erase(_pos, _positions.length() - _pos);
+            }
         }
     public:
         void clear()
         {
             _links.clear();
+            _positions.clear();
             _pos = 0;
         }
-        bool save( lString16 link )
+        bool save( lString16 link, const ldomCompactXPointer & position = ldomCompactXPointer() )
         {
             if (_pos==(int)_links.length() && _pos>0 && _links[_pos-1]==link )
                 return false;
             if ( _pos>=(int)_links.length() || _links[_pos]!=link ) {
                 clearTail();
                 _links.add( link );
+                _positions.add( position );
                 _pos = _links.length();
                 return true;
             } else if (_links[_pos]==link) {
@@ -1927,6 +2321,13 @@ class ldomNavigationHistory
                 return lString16::empty_str;
             return _links[++_pos];
         }
+        /// returns compact position of link returned by last back() or forward() call
+        ldomCompactXPointer getCompactPos()
+        {
+            if (_pos<0 || _pos>=_positions.length())
+                return ldomCompactXPointer();
+            return _positions[_pos];
+        }
         int backCount()
         {
             return _pos;
@@ -1963,6 +2364,11 @@ private:
     int _page_width;
     bool _rendered;
     ldomXRangeList _selections;
+    ldomTextSearchIndex _searchIndex;
+    lUInt32 _searchIndexBuildPos; // next text node to add to index being built
+    bool _searchIndexSaved;       // index is already present in cache file
+    bool _searchIndexLoadTried;
+    lUInt32 _renderTime;          // duration of last full render, ms; recorded in cache index
 #endif
 
     lString16 _docStylesheetFileName;
@@ -1982,6 +2388,8 @@ private:
     bool saveChanges();
     /// saves changes to cache file, limited by time interval (can be called again to continue after TIMEOUT)
     virtual ContinuousOperationResult saveChanges( CRTimerUtil & maxTime );
+    /// adds text nodes to search index, limited by time interval; returns true when index is complete
+    bool buildTextSearchIndex( CRTimerUtil & maxTime );
 #endif
 
 protected:
@@ -2009,6 +2417,8 @@ public:
     LVStreamRef getObjectImageStream( lString16 refName );
     /// returns object image source
     LVImageSourceRef getObjectImageSource( lString16 refName );
+    /// returns id of image referenced by node, same for all nodes referencing the same image, 0 if none
+    lUInt32 getObjectImageId( ldomNode * node );
 
     bool isDefStyleSet()
     {
@@ -2076,6 +2486,8 @@ public:
     font_ref_t getDefaultFont() { return _def_font; }
     /// get default style reference
     css_style_ref_t getDefaultStyle() { return _def_style; }
+    /// get memo of computed element styles
+    ldomStyleMemo & getStyleMemo() { return _styleMemo; }
 
     inline bool parseStyleSheet(lString16 codeBase, lString16 css);
     inline bool parseStyleSheet(lString16 cssFile);
@@ -2090,6 +2502,10 @@ public:
 #endif
     /// create xpointer from pointer string
     ldomXPointer createXPointer( const lString16 & xPointerStr );
+    /// create xpointer from compact binary form, returns NULL pointer if it doesn't match this document
+    ldomXPointer createXPointer( const ldomCompactXPointer & pos );
+    /// returns hash of document content used to validate compact xpointers
+    lUInt32 getContentHash();
     /// create xpointer from pointer string
     ldomNode * nodeFromXPath( const lString16 & xPointerStr )
     {
@@ -2111,8 +2527,22 @@ public:
     ldomXPointer createXPointer( lvPoint pt, int direction=0 );
     /// get rendered block cache object
     CVRendBlockCache & getRendBlockCache() { return _renderedBlockCache; }
+    /// returns line/word geometry of final block, formats block if not cached
+    ldomBlockGeometry * getBlockGeometry( ldomNode * finalNode );
+    /// returns text lengths of table cells measured before, NULL if not cached
+    LVArray<lInt32> * getTableCellTextLengths( ldomNode * table ) { return _tableCells.get( table->getDataIndex() ); }
+    /// stores text lengths of table cells (takes ownership)
+    void setTableCellTextLengths( ldomNode * table, LVArray<lInt32> * lengths ) { _tableCells.set( table->getDataIndex(), lengths ); }
+    /// returns positions of images and blocks recorded by render
+    ldomRenderPositionIndex & getRenderPositions() { return _renderPositions; }
 
     bool findText( lString16 pattern, bool caseInsensitive, bool reverse, int minY, int maxY, LVArray<ldomWord> & words, int maxCount, int maxHeight );
+    /// returns text search index saved in cache file, NULL if not available
+    ldomTextSearchIndex * getTextSearchIndex();
+    /// drops text search index after change of document text
+    void dropTextSearchIndex();
+    /// drops data derived from document text, called by node methods which change text or structure of tree
+    void onTreeModified();
 #endif
 };
 
@@ -2134,6 +2564,10 @@ class ldomElementWriter
     bool _stylesheetIsSet;
     bool _bodyEnterCalled;
     lUInt32 _flags;
+    /// number of section children written so far
+    int _childSectionCount;
+    /// 1-based index of section among sections of parent (for xpath), 0 for other elements
+    int _sectionIndex;
     lUInt32 getFlags();
     void updateTocItem();
     void onBodyEnter();
@@ -2371,6 +2805,17 @@ ldomDocument * LVParseHTMLStream( LVStreamRef stream,
                               const ns_def_t * ns_table=NULL );
 
 /// document cache
+/// document cache statistics; counters are for current process, since ldomDocCache::init()
+struct ldomDocCacheStats
+{
+    int hits;         ///< documents opened from cache
+    int misses;       ///< documents not found in cache
+    int evicted;      ///< files removed to free space
+    int fileCount;    ///< number of files in cache
+    lInt64 totalSize; ///< size of files in cache
+    ldomDocCacheStats() : hits(0), misses(0), evicted(0), fileCount(0), totalSize(0) { }
+};
+
 class ldomDocCache
 {
 public:
@@ -2386,6 +2831,10 @@ public:
     static bool clear();
     /// returns true if cache is enabled (successfully initialized)
     static bool enabled();
+    /// records size and render time of saved cache file, used to choose files to remove when cache is full
+    static bool updateFileInfo( lString16 filename, lUInt32 crc, lUInt32 docFlags, lUInt32 cacheFileSize, lUInt32 renderTime );
+    /// returns hit/miss counters since init() and current size of cache
+    static bool getStats( ldomDocCacheStats & stats );
 };
 
 
@@ -2395,4 +2844,10 @@ void runTinyDomUnitTests();
 /// pass true to enable CRC check for
 void enableCacheFileContentsValidation(bool enable);
 
+/// pass true to compress and write cache file blocks on background thread; needs concurrencyProvider
+void enableCacheFileBackgroundWriting(bool enable);
+
+/// pass false to disable reading ahead of cache file blocks on background thread; needs concurrencyProvider
+void enableCacheFilePrefetch(bool enable);
+
 #endif
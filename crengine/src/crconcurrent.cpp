@@ -2,6 +2,10 @@
 #include "crconcurrent.h"
 #include "lvptrvec.h"
 #include "lvstring.h"
+#if defined(_LINUX)
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 CRMutex * _refMutex = NULL;
 CRMutex * _fontMutex = NULL;
@@ -9,6 +13,7 @@ CRMutex * _fontManMutex = NULL;
 CRMutex * _fontGlyphCacheMutex = NULL;
 CRMutex * _fontLocalGlyphCacheMutex = NULL;
 CRMutex * _crengineMutex = NULL;
+CRMutex * _imageCacheMutex = NULL;
 
 void CRSetupEngineConcurrency() {
     if (!concurrencyProvider) {
@@ -27,6 +32,8 @@ void CRSetupEngineConcurrency() {
         _fontLocalGlyphCacheMutex = concurrencyProvider->createMutex();
     if (!_crengineMutex)
     	_crengineMutex = concurrencyProvider->createMutex();
+    if (!_imageCacheMutex)
+        _imageCacheMutex = concurrencyProvider->createMutex();
 }
 
 CRConcurrencyProvider * concurrencyProvider = NULL;
@@ -90,3 +97,99 @@ void CRThreadExecutor::stop() {
     }
     _thread->join();
 }
+
+#if defined(_LINUX)
+
+class CRPosixMutex : public CRMutex {
+protected:
+    pthread_mutex_t _mutex;
+public:
+    CRPosixMutex() {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        // engine guards may be nested, e.g. font manager calls from font manager
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&_mutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+    virtual ~CRPosixMutex() { pthread_mutex_destroy(&_mutex); }
+    virtual void acquire() { pthread_mutex_lock(&_mutex); }
+    virtual void release() { pthread_mutex_unlock(&_mutex); }
+};
+
+class CRPosixMonitor : public CRMonitor {
+    pthread_mutex_t _mutex;
+    pthread_cond_t _cond;
+public:
+    CRPosixMonitor() {
+        pthread_mutex_init(&_mutex, NULL);
+        pthread_cond_init(&_cond, NULL);
+    }
+    virtual ~CRPosixMonitor() {
+        pthread_cond_destroy(&_cond);
+        pthread_mutex_destroy(&_mutex);
+    }
+    virtual void acquire() { pthread_mutex_lock(&_mutex); }
+    virtual void release() { pthread_mutex_unlock(&_mutex); }
+    virtual void wait() { pthread_cond_wait(&_cond, &_mutex); }
+    virtual void notify() { pthread_cond_signal(&_cond); }
+    virtual void notifyAll() { pthread_cond_broadcast(&_cond); }
+};
+
+class CRPosixThread : public CRThread {
+    CRRunnable * _task;
+    pthread_t _thread;
+    bool _started;
+    static void * start_routine(void * param) {
+        ((CRPosixThread*)param)->_task->run();
+        return NULL;
+    }
+public:
+    CRPosixThread(CRRunnable * task) : _task(task), _started(false) {}
+    virtual ~CRPosixThread() {
+        if (_started)
+            pthread_detach(_thread);
+    }
+    virtual void start() {
+        _started = pthread_create(&_thread, NULL, &start_routine, this) == 0;
+        if (!_started)
+            CRLog::error("CRPosixThread: cannot create thread");
+    }
+    virtual void join() {
+        if (_started) {
+            pthread_join(_thread, NULL);
+            _started = false;
+        }
+    }
+};
+
+CRMutex * CRPosixConcurrencyProvider::createMutex() {
+    return new CRPosixMutex();
+}
+
+CRMonitor * CRPosixConcurrencyProvider::createMonitor() {
+    return new CRPosixMonitor();
+}
+
+CRThread * CRPosixConcurrencyProvider::createThread(CRRunnable * threadTask) {
+    return new CRPosixThread(threadTask);
+}
+
+void CRPosixConcurrencyProvider::executeGui(CRRunnable * task) {
+    if (task) {
+        task->run();
+        delete task;
+    }
+}
+
+void CRPosixConcurrencyProvider::executeGui(CRRunnable * task, int delayMillis) {
+    if (task && delayMillis > 0)
+        sleepMs(delayMillis);
+    executeGui(task);
+}
+
+void CRPosixConcurrencyProvider::sleepMs(int durationMs) {
+    usleep(durationMs * 1000);
+}
+
+#endif
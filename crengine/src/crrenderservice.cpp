@@ -0,0 +1,374 @@
+/*******************************************************
+
+   CoolReader Engine
+
+   crrenderservice.cpp: headless page rendering service
+
+   This source code is distributed under the terms of
+   GNU General Public License
+   See LICENSE file for details
+
+*******************************************************/
+
+#include "../include/crrenderservice.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (USE_LIBPNG==1)
+#include <png.h>
+#endif
+
+/// returns copy of C string allocated with malloc(), to pass strings to worker threads without lString
+static char * copyString( const char * str )
+{
+    if ( !str )
+        str = "";
+    size_t len = strlen( str );
+    char * res = (char *)malloc( len + 1 );
+    memcpy( res, str, len + 1 );
+    return res;
+}
+
+/// document registered in render service
+class CRRenderServiceDocument {
+public:
+    char * id;
+    // fields below are changed by tasks of document worker only, under engine lock
+    lString16 fileName;
+    int dx;
+    int dy;
+    int docBufferSize;
+    bool removed;
+    // fields below are accessed under engine lock
+    LVDocView * view;
+    lUInt32 lastAccess;
+    int worker;
+    CRRenderServiceDocument( const char * docId, int workerIndex )
+    : id(copyString(docId)), dx(0), dy(0), docBufferSize(0), removed(true), view(NULL), lastAccess(0), worker(workerIndex)
+    {
+    }
+    ~CRRenderServiceDocument()
+    {
+        delete view;
+        free( id );
+    }
+};
+
+enum render_service_task_t {
+    RENDER_SERVICE_TASK_CONFIGURE,
+    RENDER_SERVICE_TASK_REMOVE,
+    RENDER_SERVICE_TASK_OPEN,
+    RENDER_SERVICE_TASK_RENDER
+};
+
+/// request for worker; it's deleted by worker thread without engine lock, so it has no lString fields
+class CRRenderServiceTask : public CRRunnable {
+public:
+    CRRenderService * service;
+    CRRenderServiceDocument * doc;
+    render_service_task_t type;
+    char * tag;
+    char * fileName; // UTF-8 document file name for configure task, local encoding output file name for render task
+    int page;
+    int dx;
+    int dy;
+    int docBufferSize;
+    CRRenderServiceTask( CRRenderService * _service, CRRenderServiceDocument * _doc, render_service_task_t _type, const char * _tag )
+    : service(_service), doc(_doc), type(_type), tag(copyString(_tag)), fileName(NULL), page(-1), dx(0), dy(0), docBufferSize(0)
+    {
+    }
+    virtual ~CRRenderServiceTask()
+    {
+        free( tag );
+        free( fileName );
+    }
+    virtual void run()
+    {
+        switch ( type ) {
+        case RENDER_SERVICE_TASK_CONFIGURE:
+            {
+                CRENGINE_GUARD
+                lString16 fn = Utf8ToUnicode( fileName );
+                if ( !doc->removed && doc->fileName==fn && doc->dx==dx && doc->dy==dy && doc->docBufferSize==docBufferSize )
+                    break;
+                service->closeView( doc );
+                doc->fileName = fn;
+                doc->dx = dx;
+                doc->dy = dy;
+                doc->docBufferSize = docBufferSize;
+                doc->removed = false;
+            }
+            break;
+        case RENDER_SERVICE_TASK_REMOVE:
+            {
+                CRENGINE_GUARD
+                service->closeView( doc );
+                doc->removed = true;
+            }
+            break;
+        case RENDER_SERVICE_TASK_OPEN:
+            {
+                int pageCount = -1;
+                {
+                    CRENGINE_GUARD
+                    LVDocView * view = service->openView( doc );
+                    if ( view )
+                        pageCount = view->getPageCount();
+                }
+                if ( service->_callback )
+                    service->_callback->onDocumentOpened( tag, doc->id, pageCount );
+            }
+            break;
+        case RENDER_SERVICE_TASK_RENDER:
+            {
+                LVColorDrawBuf * buf = NULL;
+                {
+                    CRENGINE_GUARD
+                    LVDocView * view = service->openView( doc );
+                    if ( view && page>=0 && page<view->getPageCount() ) {
+                        buf = new LVColorDrawBuf( doc->dx, doc->dy, 32 );
+                        view->Draw( *buf, 0, page, false, false );
+                    }
+                }
+                // encoding doesn't touch engine state and runs in parallel with other workers
+                bool res = buf && LVWriteDrawBufImage( buf, fileName );
+                delete buf;
+                if ( service->_callback )
+                    service->_callback->onPageRendered( tag, doc->id, page, res );
+            }
+            break;
+        }
+        service->taskDone();
+    }
+};
+
+CRRenderService::CRRenderService( int threadCount, int maxOpenDocuments )
+: _callback(NULL)
+, _documents(256)
+, _pendingCount(0)
+, _maxOpenDocuments(maxOpenDocuments)
+, _openDocumentCount(0)
+, _accessCounter(0)
+{
+    if ( _maxOpenDocuments<1 )
+        _maxOpenDocuments = 1;
+    if ( _maxOpenDocuments>MAX_DOCUMENT_INSTANCE_COUNT - 2 )
+        _maxOpenDocuments = MAX_DOCUMENT_INSTANCE_COUNT - 2;
+    if ( threadCount<1 )
+        threadCount = 1;
+    _pendingMonitor = concurrencyProvider->createMonitor();
+    for ( int i=0; i<threadCount; i++ )
+        _workers.add( new CRThreadExecutor() );
+}
+
+CRRenderService::~CRRenderService()
+{
+    for ( int i=0; i<_workers.length(); i++ )
+        _workers[i]->stop();
+    _workers.clear();
+    CRENGINE_GUARD
+    _documentList.clear();
+}
+
+CRRenderServiceDocument * CRRenderService::getDocument( const char * docId, bool create )
+{
+    lString8 key( docId );
+    CRRenderServiceDocument * doc = NULL;
+    if ( !_documents.get( key, doc ) && create ) {
+        // documents are spread over workers; requests for one document are executed in order
+        doc = new CRRenderServiceDocument( docId, (int)(key.getHash() % (lUInt32)_workers.length()) );
+        _documentList.add( doc );
+        _documents.set( key, doc );
+    }
+    return doc;
+}
+
+void CRRenderService::submit( CRRenderServiceTask * task )
+{
+    {
+        CRGuard guard( _pendingMonitor );
+        CR_UNUSED(guard);
+        _pendingCount++;
+    }
+    _workers[task->doc->worker]->execute( task );
+}
+
+void CRRenderService::taskDone()
+{
+    CRGuard guard( _pendingMonitor );
+    CR_UNUSED(guard);
+    if ( --_pendingCount==0 )
+        _pendingMonitor->notifyAll();
+}
+
+void CRRenderService::flush()
+{
+    CRGuard guard( _pendingMonitor );
+    CR_UNUSED(guard);
+    while ( _pendingCount>0 )
+        _pendingMonitor->wait();
+}
+
+void CRRenderService::closeView( CRRenderServiceDocument * doc )
+{
+    if ( !doc->view )
+        return;
+    delete doc->view;
+    doc->view = NULL;
+    _openDocumentCount--;
+}
+
+LVDocView * CRRenderService::openView( CRRenderServiceDocument * doc )
+{
+    if ( doc->removed )
+        return NULL;
+    doc->lastAccess = ++_accessCounter;
+    if ( doc->view )
+        return doc->view;
+    while ( _openDocumentCount>=_maxOpenDocuments ) {
+        CRRenderServiceDocument * oldest = NULL;
+        for ( int i=0; i<_documentList.length(); i++ ) {
+            CRRenderServiceDocument * p = _documentList[i];
+            if ( p->view && (!oldest || p->lastAccess<oldest->lastAccess) )
+                oldest = p;
+        }
+        if ( !oldest )
+            break;
+        CRLog::debug( "CRRenderService: closing least recently used document %s", oldest->id );
+        closeView( oldest );
+    }
+    LVDocView * view = new LVDocView();
+    view->setDocBufferSize( doc->docBufferSize );
+    if ( !_props.isNull() )
+        view->propsApply( _props );
+    if ( !_styleSheet.empty() )
+        view->setStyleSheet( _styleSheet );
+    view->setVisiblePageCount( 1 );
+    view->Resize( doc->dx, doc->dy );
+    if ( !view->LoadDocument( doc->fileName.c_str() ) ) {
+        CRLog::error( "CRRenderService: cannot load document %s", LCSTR(doc->fileName) );
+        delete view;
+        return NULL;
+    }
+    view->Render();
+    doc->view = view;
+    _openDocumentCount++;
+    return view;
+}
+
+void CRRenderService::addDocument( const char * docId, const char * fileName, int dx, int dy, int docBufferSize )
+{
+    CRRenderServiceTask * task;
+    {
+        CRENGINE_GUARD
+        task = new CRRenderServiceTask( this, getDocument( docId, true ), RENDER_SERVICE_TASK_CONFIGURE, NULL );
+    }
+    task->fileName = copyString( fileName );
+    task->dx = dx;
+    task->dy = dy;
+    task->docBufferSize = docBufferSize;
+    submit( task );
+}
+
+bool CRRenderService::removeDocument( const char * docId )
+{
+    CRRenderServiceDocument * doc;
+    {
+        CRENGINE_GUARD
+        doc = getDocument( docId, false );
+    }
+    if ( !doc )
+        return false;
+    submit( new CRRenderServiceTask( this, doc, RENDER_SERVICE_TASK_REMOVE, NULL ) );
+    return true;
+}
+
+bool CRRenderService::openDocument( const char * tag, const char * docId )
+{
+    CRRenderServiceDocument * doc;
+    {
+        CRENGINE_GUARD
+        doc = getDocument( docId, false );
+    }
+    if ( !doc )
+        return false;
+    submit( new CRRenderServiceTask( this, doc, RENDER_SERVICE_TASK_OPEN, tag ) );
+    return true;
+}
+
+bool CRRenderService::renderPage( const char * tag, const char * docId, int page, const char * fileName )
+{
+    CRRenderServiceDocument * doc;
+    char * localFileName;
+    {
+        CRENGINE_GUARD
+        doc = getDocument( docId, false );
+        if ( !doc )
+            return false;
+        localFileName = copyString( UnicodeToLocal( Utf8ToUnicode( fileName ) ).c_str() );
+    }
+    CRRenderServiceTask * task = new CRRenderServiceTask( this, doc, RENDER_SERVICE_TASK_RENDER, tag );
+    task->page = page;
+    task->fileName = localFileName;
+    submit( task );
+    return true;
+}
+
+/// writes 32bpp buffer as PNG (if supported) or binary PPM when file name ends with .ppm
+bool LVWriteDrawBufImage( LVColorDrawBuf * buf, const char * fileName )
+{
+    int dx = buf->GetWidth();
+    int dy = buf->GetHeight();
+    LVArray<lUInt8> row( dx * 3, 0 );
+    size_t len = strlen( fileName );
+    bool ppm = len>=4 && !strcmp( fileName + len - 4, ".ppm" );
+#if (USE_LIBPNG!=1)
+    ppm = true;
+#endif
+    FILE * f = fopen( fileName, "wb" );
+    if ( !f )
+        return false;
+    bool res = true;
+    if ( ppm ) {
+        fprintf( f, "P6\n%d %d\n255\n", dx, dy );
+        for ( int y=0; y<dy && res; y++ ) {
+            lUInt32 * src = (lUInt32 *)buf->GetScanLine( y );
+            for ( int x=0; x<dx; x++ ) {
+                row[x*3] = (lUInt8)(src[x] >> 16);
+                row[x*3+1] = (lUInt8)(src[x] >> 8);
+                row[x*3+2] = (lUInt8)src[x];
+            }
+            res = fwrite( row.get(), 1, dx * 3, f )==(size_t)(dx * 3);
+        }
+    }
+#if (USE_LIBPNG==1)
+    else {
+        png_structp png = png_create_write_struct( PNG_LIBPNG_VER_STRING, NULL, NULL, NULL );
+        png_infop info = png ? png_create_info_struct( png ) : NULL;
+        if ( !info || setjmp( png_jmpbuf( png ) ) ) {
+            res = false;
+        } else {
+            png_init_io( png, f );
+            png_set_IHDR( png, info, dx, dy, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+                PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT );
+            png_write_info( png, info );
+            for ( int y=0; y<dy; y++ ) {
+                lUInt32 * src = (lUInt32 *)buf->GetScanLine( y );
+                for ( int x=0; x<dx; x++ ) {
+                    row[x*3] = (lUInt8)(src[x] >> 16);
+                    row[x*3+1] = (lUInt8)(src[x] >> 8);
+                    row[x*3+2] = (lUInt8)src[x];
+                }
+                png_write_row( png, row.get() );
+            }
+            png_write_end( png, info );
+        }
+        if ( png )
+            png_destroy_write_struct( &png, info ? &info : NULL );
+    }
+#endif
+    if ( fclose( f )!=0 )
+        res = false;
+    return res;
+}
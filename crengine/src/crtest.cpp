@@ -1,6 +1,7 @@
 #include "../include/crtest.h"
 #include "../include/lvtinydom.h"
 #include "../include/chmfmt.h"
+#include "../include/hist.h"
 
 #ifdef _DEBUG
 
@@ -175,6 +176,10 @@ void testTxtSelector();
 
 void runCRUnitTests()
 {
+#ifdef _DEBUG
+    runStringUnitTests();
+    runFileHistUnitTests();
+#endif
 #if 0 && defined(_DEBUG)
     //runCHMUnitTest();
     runTinyDomUnitTests();
@@ -1639,46 +1639,42 @@ int sort_dblstats_by_ch( const void * p1, const void * p2 )
 class CDoubleCharStat2
 { 
 private:
-    lUInt16 * * stats;
+    lUInt16 * stats; // 256x256 table of pair counters, indexed by (c1<<8)|c2
     int total;
-    int items;
 public:
-    CDoubleCharStat2() : stats(NULL), total(0), items(0)
+    CDoubleCharStat2() : stats(NULL), total(0)
     {
     }
     void Add( unsigned char c1, unsigned char c2 )
     {
         if ( !stats ) {
-            stats = new lUInt16* [256];
-            memset( stats, 0, sizeof(lUInt16*)*256);
+            stats = new lUInt16[256*256];
+            memset( stats, 0, sizeof(lUInt16)*256*256 );
         }
         if (c1==' ' && c2==' ')
             return;
         total++;
-        if ( stats[c1]==NULL ) {
-            stats[c1] = new lUInt16[256];
-            memset( stats[c1], 0, sizeof(lUInt16)*256 );
-        }
-        if ( stats[c1][c2]++ == 0)
-            items++;
+        stats[(c1 << 8) | c2]++;
     }
     void GetData( dbl_char_stat_t * pData, int len )
     {
         int count = 0;
+        int items = 0;
+        if ( stats ) {
+            for ( int i=0; i<256*256; i++ )
+                if ( stats[i] )
+                    items++;
+        }
         dbl_char_stat_long_t * pdata = new dbl_char_stat_long_t[items];
         if ( total ) {
-            for ( int i=0; i<256; i++ ) {
-                if ( stats[i] ) {
-                    for ( int j=0; j<256; j++ ) {
-                        if ( stats[i][j]> 0 ) {
-                            pdata[count].ch1 = i;
-                            pdata[count].ch2 = j;
-                            int n = stats[i][j];
-                            n = (int)(n * (lInt64)0x7000 / total);
-                            pdata[count].count = n;
-                            count++;
-                        }
-                    }
+            for ( int i=0; i<256*256; i++ ) {
+                if ( stats[i]> 0 ) {
+                    pdata[count].ch1 = (lUInt8)(i >> 8);
+                    pdata[count].ch2 = (lUInt8)(i & 0xFF);
+                    int n = stats[i];
+                    n = (int)(n * (lInt64)0x7000 / total);
+                    pdata[count].count = n;
+                    count++;
                 }
             }
             qsort(pdata, count, sizeof(dbl_char_stat_long_t), sort_dblstats_by_count);
@@ -1706,9 +1702,6 @@ public:
    void Close()
    {
        if ( stats ) {
-           for ( int i=0; i<256; i++ )
-               if ( stats[i] )
-                   delete[] stats[i];
            delete[] stats;
            stats = NULL;
        }
@@ -1726,9 +1719,12 @@ bool isValidUtf8Data( const unsigned char * buf, int buf_size )
     const unsigned char * start = buf;
     const unsigned char * end_buf = buf + buf_size - 5;
     while ( buf < end_buf ) {
+        // skip run of 7-bit chars
+        buf += lStr_asciiPrefixLength( buf, (int)(end_buf - buf) );
+        if ( buf >= end_buf )
+            break;
         lUInt8 ch = *buf++;
-        if ( (ch & 0x80) == 0 ) {
-        } else if ( (ch & 0xC0) == 0x80 ) {
+        if ( (ch & 0xC0) == 0x80 ) {
             CRLog::trace("unexpected char %02x at position %x, str=%s", ch, (buf-1-start), lString8((const char *)(buf-1), 32).c_str());
             return false;
         } else if ( (ch & 0xE0) == 0xC0 ) {
@@ -1761,9 +1757,22 @@ bool isValidUtf8Data( const unsigned char * buf, int buf_size )
     return true;
 }
 
+/// maps char to itself if it's counted in char pair statistics, to space otherwise
+static void makeDblCharStatMap( unsigned char map[256] )
+{
+    for ( int i=0; i<256; i++ ) {
+        unsigned char ch = (unsigned char)i;
+        if ( ch<128 && ch!='\'' && !( (ch>='a' && ch<='z') || (ch>='A' && ch<='Z')) )
+            ch = ' ';
+        map[i] = ch;
+    }
+}
+
 void MakeDblCharStat(const unsigned char * buf, int buf_size, dbl_char_stat_t * stat, int stat_len, bool skipHtml)
 {
    CDoubleCharStat2 maker;
+   unsigned char map[256];
+   makeDblCharStatMap( map );
    unsigned char ch1=' ';
    unsigned char ch2=' ';
    bool insideTag = false;
@@ -1781,39 +1790,58 @@ void MakeDblCharStat(const unsigned char * buf, int buf_size, dbl_char_stat_t *
       if (insideTag)
           continue;
       ch1 = ch2;
-      ch2 = ch;
-      if ( ch2<128 && ch2!='\'' && !( (ch2>='a' && ch2<='z') || (ch2>='A' && ch2<='Z')) )
-         ch2 = ' ';
+      ch2 = map[(unsigned char)ch];
       //if (i>0)
       maker.Add( ch1, ch2 );
    }
    maker.GetData( stat, stat_len );
 }
 
+/// adds byte counts of buffer to histogram, using 4 interleaved tables to avoid store-to-load stalls
+static void addByteStat( int stat[4][256], const unsigned char * buf, int len )
+{
+   int i = 0;
+   for ( ; i + 4 <= len; i += 4 ) {
+      stat[0][buf[i]]++;
+      stat[1][buf[i+1]]++;
+      stat[2][buf[i+2]]++;
+      stat[3][buf[i+3]]++;
+   }
+   for ( ; i < len; i++ )
+      stat[0][buf[i]]++;
+}
+
 void MakeCharStat(const unsigned char * buf, int buf_size, short stat_table[256], bool skipHtml)
 {
+   int parts[4][256];
+   memset( parts, 0, sizeof(parts) );
+   if ( skipHtml ) {
+      // '<' and '>' are not counted anyway, so only skip text between them
+      const unsigned char * p = buf;
+      const unsigned char * end = buf + buf_size;
+      while ( p < end ) {
+         const unsigned char * tag = (const unsigned char *)memchr( p, '<', end - p );
+         if ( !tag )
+            tag = end;
+         addByteStat( parts, p, (int)(tag - p) );
+         if ( tag >= end )
+            break;
+         const unsigned char * tagEnd = (const unsigned char *)memchr( tag + 1, '>', end - tag - 1 );
+         if ( !tagEnd )
+            break;
+         p = tagEnd + 1;
+      }
+   } else {
+      addByteStat( parts, buf, buf_size );
+   }
    int stat[256];
-   memset( stat, 0, sizeof(int)*256 );
    int total=0;
-   unsigned char ch;
-   bool insideTag = false;
-   for (int i=0; i<buf_size; i++) {
-      ch = buf[i];
-      if (skipHtml) {
-          if (ch == '<') {
-              insideTag = true;
-              continue;
-          }
-          if (ch == '>') {
-              insideTag = false;
-              continue;
-          }
-          if (insideTag)
-              continue;
-      }
+   for (int ch=0; ch<256; ch++) {
       if ( ch>127 || (ch>='a' && ch<='z') || (ch>='A' && ch<='Z') || ch=='\'') {
-         stat[ch]++;
-         total++;
+         stat[ch] = parts[0][ch] + parts[1][ch] + parts[2][ch] + parts[3][ch];
+         total += stat[ch];
+      } else {
+         stat[ch] = 0;
       }
    }
    if (total) {
@@ -15,6 +15,9 @@
 void CRFileHist::clear()
 {
     _records.clear();
+    _index.clear();
+    _saved.clear();
+    _savedFileName.clear();
 }
 
 /// XML parser callback interface
@@ -25,6 +28,7 @@ protected:
     CRFileHist *  _hist;
     CRBookmark * _curr_bookmark;
     CRFileHistRecord * _curr_file;
+    ldomCompactXPointer _curr_compact;
     enum state_t {
         in_xml,
         in_fbm,
@@ -121,7 +125,7 @@ public:
         } else if ( lStr_cmp(tagname, "file")==0 && state==in_file ) {
             state = in_fbm;
             if ( _curr_file )
-                _hist->getRecords().add( _curr_file );
+                _hist->addRecord( _curr_file );
             _curr_file = NULL;
         } else if ( lStr_cmp(tagname, "file-info")==0 && state==in_file_info ) {
             state = in_file;
@@ -152,8 +156,12 @@ public:
             }
         } else if ( lStr_cmp(tagname, "start-point")==0 && state==in_start_point ) {
             state = in_bm;
+            _curr_bookmark->setStartCompactPos( _curr_compact );
+            _curr_compact.clear();
         } else if ( lStr_cmp(tagname, "end-point")==0 && state==in_end_point ) {
             state = in_bm;
+            _curr_bookmark->setEndCompactPos( _curr_compact );
+            _curr_compact.clear();
         } else if ( lStr_cmp(tagname, "header-text")==0 && state==in_header_txt ) {
             state = in_bm;
         } else if ( lStr_cmp(tagname, "selection-text")==0 && state==in_selection_txt ) {
@@ -187,7 +195,7 @@ public:
                 if (attrvalue[i]>='0' && attrvalue[i]<='9')
                     n2 = (attrvalue[i++]-'0')*10;
                 if (attrvalue[i]>='0' && attrvalue[i]<='9')
-                    n2 = (attrvalue[i++]-'0');
+                    n2 += (attrvalue[i++]-'0');
             }
             _curr_bookmark->setPercent( n1*100 + n2 );
         } else if ( lStr_cmp(attrname, "timestamp")==0 && state==in_bm ) {
@@ -198,6 +206,8 @@ public:
             _curr_bookmark->setTimestamp( n1 );
         } else if (lStr_cmp(attrname, "page")==0 && state==in_bm) {
             _curr_bookmark->setBookmarkPage(lString16( attrvalue ).atoi());
+        } else if ( lStr_cmp(attrname, "compact")==0 && (state==in_start_point || state==in_end_point) ) {
+            _curr_compact.fromString( lString16( attrvalue ) );
         }
     }
     /// called on text
@@ -262,11 +272,13 @@ bool CRFileHist::loadFromStream( LVStreamRef stream )
     return true;
 }
 
-static void putTagValue( LVStream * stream, int level, const char * tag, lString16 value )
+static void putTagValue( LVStream * stream, int level, const char * tag, lString16 value, const ldomCompactXPointer * compact = NULL )
 {
     for ( int i=0; i<level; i++ )
         *stream << "  ";
     *stream << "<" << tag;
+    if ( compact && !compact->isNull() && !value.empty() )
+        *stream << " compact=\"" << UnicodeToUtf8( compact->toString() ).c_str() << "\"";
     if ( value.empty() ) {
         *stream << "/>\r\n";
     } else {
@@ -290,8 +302,8 @@ static void putBookmark( LVStream * stream, CRBookmark * bmk )
             bmk->getPercent()/100, bmk->getPercent()%100,
             (int)bmk->getTimestamp(), (int)bmk->getShortcut(), (int)bmk->getBookmarkPage());
     putTag(stream, 3, bmktag);
-    putTagValue( stream, 4, "start-point", bmk->getStartPos() );
-    putTagValue( stream, 4, "end-point", bmk->getEndPos() );
+    putTagValue( stream, 4, "start-point", bmk->getStartPos(), &bmk->getStartCompactPos() );
+    putTagValue( stream, 4, "end-point", bmk->getEndPos(), &bmk->getEndCompactPos() );
     putTagValue( stream, 4, "header-text", bmk->getTitleText() );
     putTagValue( stream, 4, "selection-text", bmk->getPosText() );
     putTagValue( stream, 4, "comment-text", bmk->getCommentText() );
@@ -407,30 +419,66 @@ int CRFileHistRecord::getFirstFreeShortcutBookmark()
     return -1;
 }
 
-int CRFileHist::findEntry( const lString16 & fname, const lString16 & fpath, lvsize_t sz )
+static lString16 recordKey( const lString16 & fname, lvsize_t sz )
+{
+    return fname + ":" + lString16::itoa( (lUInt64)sz );
+}
+
+CRFileHistRecord * CRFileHist::findEntry( const lString16 & fname, const lString16 & fpath, lvsize_t sz )
 {
     CR_UNUSED(fpath);
-    for ( int i=0; i<_records.length(); i++ ) {
-        CRFileHistRecord * rec = _records[i];
-        if ( rec->getFileName().compare(fname) )
-            continue;
-        if ( rec->getFileSize()!=sz ) {
-            CRLog::warn("CRFileHist::findEntry() Filename matched %s but sizes are different %d!=%d", LCSTR(fname), sz, rec->getFileSize() );
-            continue;
-        }
-        return i;
+    CRFileHistRecord * rec = NULL;
+    if ( _index.get( recordKey( fname, sz ), rec ) )
+        return rec;
+    return NULL;
+}
+
+void CRFileHist::makeTop( CRFileHistRecord * rec )
+{
+    // shift records down until old position of rec
+    CRFileHistRecord * prev = rec;
+    for ( int i=0; i<_records.length() && prev; i++ ) {
+        CRFileHistRecord * r = _records[i];
+        _records[i] = prev;
+        prev = r!=rec ? r : NULL;
     }
-    return -1;
 }
 
-void CRFileHist::makeTop( int index )
+void CRFileHist::insertTop( CRFileHistRecord * rec )
+{
+    _records.insert( 0, rec );
+    _index.set( recordKey( rec->getFileName(), rec->getFileSize() ), rec );
+}
+
+/// appends record to end of list, takes ownership
+void CRFileHist::addRecord( CRFileHistRecord * rec )
+{
+    _records.add( rec );
+    lString16 key = recordKey( rec->getFileName(), rec->getFileSize() );
+    CRFileHistRecord * found = NULL;
+    if ( !_index.get( key, found ) )
+        _index.set( key, rec );
+}
+
+/// removes and deletes record
+void CRFileHist::removeRecord( int index )
 {
-    if ( index<=0 || index>=_records.length() )
+    if ( index<0 || index>=_records.length() )
         return;
-    CRFileHistRecord * rec = _records[index];
-    for ( int i=index; i>0; i-- )
-        _records[i] = _records[i-1];
-    _records[0] = rec;
+    CRFileHistRecord * rec = _records.remove( index );
+    lString16 key = recordKey( rec->getFileName(), rec->getFileSize() );
+    CRFileHistRecord * found = NULL;
+    if ( _index.get( key, found ) && found==rec ) {
+        _index.remove( key );
+        // duplicate entry below becomes the indexed one
+        for ( int i=index; i<_records.length(); i++ ) {
+            if ( _records[i]->getFileSize()==rec->getFileSize() && !_records[i]->getFileName().compare( rec->getFileName() ) ) {
+                _index.set( key, _records[i] );
+                break;
+            }
+        }
+    }
+    delete rec;
 }
 
 void CRFileHistRecord::setLastPos( CRBookmark * bmk )
@@ -485,13 +533,13 @@ CRFileHistRecord * CRFileHist::savePosition( lString16 fpathname, size_t sz,
     splitFName( fpathname, path, name );
     CRBookmark bmk( ptr );
     //CRLog::trace("Bookmark created");
-    int index = findEntry( name, path, (lvsize_t)sz );
+    CRFileHistRecord * found = findEntry( name, path, (lvsize_t)sz );
     //CRLog::trace("findEntry exited");
-    if ( index>=0 ) {
-        makeTop( index );
-        _records[0]->setLastPos( &bmk );
-        _records[0]->setLastTime( (time_t)time(0) );
-        return _records[0];
+    if ( found ) {
+        makeTop( found );
+        found->setLastPos( &bmk );
+        found->setLastTime( (time_t)time(0) );
+        return found;
     }
     CRFileHistRecord * rec = new CRFileHistRecord();
     rec->setTitle( title );
@@ -503,7 +551,7 @@ CRFileHistRecord * CRFileHist::savePosition( lString16 fpathname, size_t sz,
     rec->setLastPos( &bmk );
     rec->setLastTime( (time_t)time(0) );
 
-    _records.insert( 0, rec );
+    insertTop( rec );
     //CRLog::trace("CRFileHist::savePosition - exit");
     return rec;
 }
@@ -513,10 +561,10 @@ ldomXPointer CRFileHist::restorePosition( ldomDocument * doc, lString16 fpathnam
     lString16 name;
     lString16 path;
     splitFName( fpathname, path, name );
-    int index = findEntry( name, path, (lvsize_t)sz );
-    if ( index>=0 ) {
-        makeTop( index );
-        return doc->createXPointer( _records[0]->getLastPos()->getStartPos() );
+    CRFileHistRecord * found = findEntry( name, path, (lvsize_t)sz );
+    if ( found ) {
+        makeTop( found );
+        return found->getLastPos()->getStartXPointer( doc );
     }
     return ldomXPointer();
 }
@@ -555,6 +603,7 @@ CRBookmark::CRBookmark (ldomXPointer ptr )
     //CRLog::trace("CRBookmark::CRBookmark() calling getChaptername");
 	setTitleText( CRBookmark::getChapterName( ptr ) );
     _startpos = ptr.toString();
+    _startcompact = ptr.toCompact();
     _timestamp = (time_t)time(0);
     lvPoint endpt = pt;
     endpt.y += 100;
@@ -564,6 +613,22 @@ CRBookmark::CRBookmark (ldomXPointer ptr )
 }
 
 
+/// resolves position using compact form if it's valid for document, otherwise parses string and updates compact form
+ldomXPointer CRBookmark::resolvePos( ldomDocument * doc, const lString16 & pos, ldomCompactXPointer & compact )
+{
+    if ( !compact.isNull() ) {
+        ldomXPointer ptr = doc->createXPointer( compact );
+        if ( !ptr.isNull() )
+            return ptr;
+    }
+    if ( pos.empty() )
+        return ldomXPointer();
+    ldomXPointer ptr = doc->createXPointer( pos );
+    if ( !ptr.isNull() )
+        compact = ptr.toCompact();
+    return ptr;
+}
+
 lString16 CRFileHistRecord::getLastTimeString( bool longFormat )
 {
 
@@ -630,7 +695,7 @@ static lString16 decodeText(lString8 text) {
     lString8 buf;
     bool lastControl = false;
     for (int i=0; i<text.length(); i++) {
-        char ch = buf[i];
+        char ch = text[i];
         if (lastControl) {
             switch (ch) {
             case 'r':
@@ -761,3 +826,499 @@ bool ChangeInfo::findNextRecordBounds(lChar8 * buf, int start, int end, int & re
     recordEnd = endTagPos + lStr_len(END_TAG_BYTES);
     return true;
 }
+
+// history changes journal: records in ChangeInfo format with a few additional fields
+#define JOURNAL_FILE_SUFFIX  ".journal"
+#define FILE_SIZE_TAG        "FILESIZE"
+#define FILE_PATH_TAG        "FILEPATH"
+#define DOC_TITLE_TAG        "DOCTITLE"
+#define DOC_AUTHOR_TAG       "DOCAUTHOR"
+#define DOC_SERIES_TAG       "DOCSERIES"
+#define MOVE_TOP_TAG         "MOVETOP"
+#define PAGE_TAG             "PAGE"
+#define INDEX_TAG            "INDEX"
+#define HASH_TAG             "HASH"
+#define START_COMPACT_TAG    "STARTCOMPACT"
+#define END_COMPACT_TAG      "ENDCOMPACT"
+
+static void crcString( lUInt32 & crc, const lString16 & s )
+{
+    lUInt32 len = s.length();
+    crc = lStr_crc32( crc, &len, sizeof(len) );
+    crc = lStr_crc32( crc, s.c_str(), len * sizeof(lChar16) );
+}
+
+/// identity of bookmark contents; compact positions are cached values and don't count
+static lUInt32 bookmarkHash( CRBookmark * bmk )
+{
+    lInt64 n[5];
+    n[0] = bmk->getType();
+    n[1] = (lInt64)bmk->getTimestamp();
+    n[2] = bmk->getPercent();
+    n[3] = bmk->getShortcut();
+    n[4] = bmk->getBookmarkPage();
+    lUInt32 crc = lStr_crc32( 0, n, sizeof(n) );
+    crcString( crc, bmk->getStartPos() );
+    crcString( crc, bmk->getEndPos() );
+    crcString( crc, bmk->getTitleText() );
+    crcString( crc, bmk->getPosText() );
+    crcString( crc, bmk->getCommentText() );
+    return crc;
+}
+
+CRFileHistSavedState::CRFileHistSavedState( CRFileHistRecord * rec )
+: fileName( rec->getFileName() ), fileSize( rec->getFileSize() )
+{
+    lUInt32 crc = bookmarkHash( rec->getLastPos() );
+    crcString( crc, rec->getFilePath() );
+    crcString( crc, rec->getTitle() );
+    crcString( crc, rec->getAuthor() );
+    crcString( crc, rec->getSeries() );
+    infoHash = crc;
+    LVPtrVector<CRBookmark> & bookmarks = rec->getBookmarks();
+    for ( int i=0; i<bookmarks.length(); i++ )
+        bookmarkHashes.add( bookmarkHash( bookmarks[i] ) );
+}
+
+static void putJournalHeader( lString8 & buf, const lString16 & fileName, lvsize_t fileSize, bool deleted )
+{
+    buf << START_TAG << "\n";
+    buf << FILE_TAG << "=" << encodeText(fileName) << "\n";
+    buf << FILE_SIZE_TAG << "=" << fmt::decimal((lInt64)fileSize) << "\n";
+    buf << ACTION_TAG << "=" << (deleted ? ACTION_DELETE_TAG : ACTION_UPDATE_TAG) << "\n";
+}
+
+static void putJournalBookmark( lString8 & buf, CRBookmark * bmk )
+{
+    buf << TYPE_TAG << "=" << fmt::decimal(bmk->getType()) << "\n";
+    buf << START_POS_TAG << "=" << encodeText(bmk->getStartPos()) << "\n";
+    buf << END_POS_TAG << "=" << encodeText(bmk->getEndPos()) << "\n";
+    buf << TIMESTAMP_TAG << "=" << fmt::decimal((lInt64)bmk->getTimestamp() * 1000) << "\n";
+    buf << PERCENT_TAG << "=" << fmt::decimal(bmk->getPercent()) << "\n";
+    buf << SHORTCUT_TAG << "=" << fmt::decimal(bmk->getShortcut()) << "\n";
+    buf << PAGE_TAG << "=" << fmt::decimal(bmk->getBookmarkPage()) << "\n";
+    buf << TITLE_TEXT_TAG << "=" << encodeText(bmk->getTitleText()) << "\n";
+    buf << POS_TEXT_TAG << "=" << encodeText(bmk->getPosText()) << "\n";
+    buf << COMMENT_TEXT_TAG << "=" << encodeText(bmk->getCommentText()) << "\n";
+    if ( !bmk->getStartCompactPos().isNull() )
+        buf << START_COMPACT_TAG << "=" << UnicodeToUtf8(bmk->getStartCompactPos().toString()) << "\n";
+    if ( !bmk->getEndCompactPos().isNull() )
+        buf << END_COMPACT_TAG << "=" << UnicodeToUtf8(bmk->getEndCompactPos().toString()) << "\n";
+}
+
+/// record info update, creates record if necessary
+static void putJournalRecordInfo( lString8 & buf, CRFileHistRecord * rec, bool moveTop )
+{
+    putJournalHeader( buf, rec->getFileName(), rec->getFileSize(), false );
+    buf << FILE_PATH_TAG << "=" << encodeText(rec->getFilePath()) << "\n";
+    buf << DOC_TITLE_TAG << "=" << encodeText(rec->getTitle()) << "\n";
+    buf << DOC_AUTHOR_TAG << "=" << encodeText(rec->getAuthor()) << "\n";
+    buf << DOC_SERIES_TAG << "=" << encodeText(rec->getSeries()) << "\n";
+    buf << MOVE_TOP_TAG << "=" << (moveTop ? "1" : "0") << "\n";
+    putJournalBookmark( buf, rec->getLastPos() );
+    buf << END_TAG << "\n";
+}
+
+/// appends journal records which turn saved bookmark list into current one
+static void putJournalBookmarkChanges( lString8 & buf, CRFileHistRecord * rec, CRFileHistSavedState * current, CRFileHistSavedState * saved )
+{
+    LVArray<lUInt32> & hashes = current->bookmarkHashes;
+    int count = hashes.length();
+    LVArray<bool> kept( count, false );
+    if ( saved ) {
+        // unchanged bookmarks are matched greedily in list order
+        int j = 0;
+        for ( int i=0; i<saved->bookmarkHashes.length(); i++ ) {
+            lUInt32 hash = saved->bookmarkHashes[i];
+            int k = j;
+            while ( k<count && hashes[k]!=hash )
+                k++;
+            if ( k<count ) {
+                kept[k] = true;
+                j = k + 1;
+            } else {
+                putJournalHeader( buf, rec->getFileName(), rec->getFileSize(), true );
+                buf << HASH_TAG << "=" << fmt::decimal((lInt64)hash) << "\n";
+                buf << END_TAG << "\n";
+            }
+        }
+    }
+    for ( int i=0; i<count; i++ ) {
+        if ( kept[i] )
+            continue;
+        putJournalHeader( buf, rec->getFileName(), rec->getFileSize(), false );
+        putJournalBookmark( buf, rec->getBookmarks()[i] );
+        buf << INDEX_TAG << "=" << fmt::decimal(i) << "\n";
+        buf << END_TAG << "\n";
+    }
+}
+
+bool CRFileHist::applyJournalRecord( const lString8 & record )
+{
+    lString8Collection rows( record, cs8("\n") );
+    if ( rows.length() < 3 || rows[0] != START_TAG || rows[rows.length() - 1] != END_TAG )
+        return false;
+    lString16 fname;
+    lvsize_t size = 0;
+    bool deleted = false;
+    bool hasBookmark = false;
+    bool hasInfo = false;
+    bool hasHash = false;
+    bool moveTop = true;
+    lUInt32 hash = 0;
+    int index = -1;
+    lString16 fpath, title, author, series;
+    ldomCompactXPointer startCompact, endCompact;
+    CRBookmark bmk;
+    for ( int i=1; i<rows.length() - 1; i++ ) {
+        lString8 row = rows[i];
+        int p = row.pos("=");
+        if ( p<1 )
+            continue;
+        lString8 name = row.substr(0, p);
+        lString8 value = row.substr(p + 1);
+        if ( name == FILE_TAG ) {
+            fname = decodeText(value);
+        } else if ( name == FILE_SIZE_TAG ) {
+            size = (lvsize_t)value.atoi64();
+        } else if ( name == ACTION_TAG ) {
+            deleted = (value == ACTION_DELETE_TAG);
+        } else if ( name == FILE_PATH_TAG ) {
+            fpath = decodeText(value);
+            hasInfo = true;
+        } else if ( name == DOC_TITLE_TAG ) {
+            title = decodeText(value);
+        } else if ( name == DOC_AUTHOR_TAG ) {
+            author = decodeText(value);
+        } else if ( name == DOC_SERIES_TAG ) {
+            series = decodeText(value);
+        } else if ( name == MOVE_TOP_TAG ) {
+            moveTop = value.atoi() != 0;
+        } else if ( name == HASH_TAG ) {
+            hash = (lUInt32)value.atoi64();
+            hasHash = true;
+        } else if ( name == TYPE_TAG ) {
+            bmk.setType(value.atoi());
+            hasBookmark = true;
+        } else if ( name == START_POS_TAG ) {
+            bmk.setStartPos(decodeText(value));
+        } else if ( name == END_POS_TAG ) {
+            bmk.setEndPos(decodeText(value));
+        } else if ( name == TIMESTAMP_TAG ) {
+            bmk.setTimestamp((time_t)(value.atoi64() / 1000));
+        } else if ( name == PERCENT_TAG ) {
+            bmk.setPercent(value.atoi());
+        } else if ( name == SHORTCUT_TAG ) {
+            bmk.setShortcut(value.atoi());
+        } else if ( name == PAGE_TAG ) {
+            bmk.setBookmarkPage(value.atoi());
+        } else if ( name == TITLE_TEXT_TAG ) {
+            bmk.setTitleText(decodeText(value));
+        } else if ( name == POS_TEXT_TAG ) {
+            bmk.setPosText(decodeText(value));
+        } else if ( name == COMMENT_TEXT_TAG ) {
+            bmk.setCommentText(decodeText(value));
+        } else if ( name == INDEX_TAG ) {
+            index = value.atoi();
+        } else if ( name == START_COMPACT_TAG ) {
+            startCompact.fromString(Utf8ToUnicode(value));
+        } else if ( name == END_COMPACT_TAG ) {
+            endCompact.fromString(Utf8ToUnicode(value));
+        }
+    }
+    if ( fname.empty() )
+        return false;
+    bmk.setStartCompactPos( startCompact );
+    bmk.setEndCompactPos( endCompact );
+    CRFileHistRecord * rec = findEntry( fname, lString16::empty_str, size );
+    if ( hasInfo ) {
+        if ( !rec ) {
+            rec = new CRFileHistRecord();
+            rec->setFileName( fname );
+            rec->setFileSize( size );
+            insertTop( rec );
+        } else if ( moveTop ) {
+            makeTop( rec );
+        }
+        rec->setFilePath( fpath );
+        rec->setTitle( title );
+        rec->setAuthor( author );
+        rec->setSeries( series );
+        rec->setLastPos( &bmk );
+        return true;
+    }
+    if ( !rec )
+        return false;
+    if ( deleted && !hasHash ) {
+        // whole record removed
+        removeRecord( _records.indexOf( rec ) );
+        return true;
+    }
+    LVPtrVector<CRBookmark> & bookmarks = rec->getBookmarks();
+    if ( deleted ) {
+        for ( int i=0; i<bookmarks.length(); i++ ) {
+            if ( bookmarkHash( bookmarks[i] )==hash ) {
+                bookmarks.erase( i, 1 );
+                return true;
+            }
+        }
+        return false;
+    }
+    if ( !hasBookmark )
+        return false;
+    if ( index<0 || index>bookmarks.length() )
+        index = bookmarks.length();
+    bookmarks.insert( index, new CRBookmark( bmk ) );
+    return true;
+}
+
+void CRFileHist::markSaved( const lString16 & fileName )
+{
+    _saved.clear();
+    for ( int i=0; i<_records.length(); i++ )
+        _saved.add( new CRFileHistSavedState( _records[i] ) );
+    _savedFileName = fileName;
+}
+
+/// loads history file and applies changes journal appended by saveChanges()
+bool CRFileHist::loadFromFile( const lString16 & fileName )
+{
+    clear();
+    bool res = false;
+    if ( LVFileExists( fileName ) ) {
+        LVStreamRef stream = LVOpenFileStream( fileName.c_str(), LVOM_READ );
+        if ( !stream.isNull() )
+            res = loadFromStream( stream );
+    }
+    lString16 journalName = fileName + JOURNAL_FILE_SUFFIX;
+    LVStreamRef journal = LVFileExists( journalName ) ? LVOpenFileStream( journalName.c_str(), LVOM_READ ) : LVStreamRef();
+    if ( !journal.isNull() && journal->GetSize() > 0 ) {
+        int size = (int)journal->GetSize();
+        LVArray<lChar8> buf( size + 1, 0 );
+        lvsize_t bytesRead = 0;
+        if ( journal->Read( buf.get(), size, &bytesRead ) == LVERR_OK && (int)bytesRead == size ) {
+            int count = 0;
+            int start = 0;
+            int recordStart;
+            // end tag is searched at line start only, so that text values cannot end record
+            while ( (recordStart = findBytes( buf.get(), start, size, START_TAG_BYTES )) >= 0 ) {
+                int endTagPos = findBytes( buf.get(), recordStart, size, "\n" END_TAG_BYTES );
+                if ( endTagPos < 0 )
+                    break; // incomplete record at end of journal
+                int recordEnd = endTagPos + 1 + lStr_len( END_TAG_BYTES );
+                if ( applyJournalRecord( lString8( buf.get() + recordStart, recordEnd - recordStart ) ) )
+                    count++;
+                start = recordEnd;
+            }
+            CRLog::debug( "CRFileHist: %d journal records applied", count );
+            res = true;
+        }
+    }
+    markSaved( fileName );
+    return res;
+}
+
+/// writes whole history file and removes changes journal
+bool CRFileHist::saveToFile( const lString16 & fileName )
+{
+    lString16 tmpName = fileName + ".tmp";
+    {
+        LVStreamRef stream = LVOpenFileStream( tmpName.c_str(), LVOM_WRITE );
+        if ( stream.isNull() )
+            return false;
+        if ( !saveToStream( stream.get() ) )
+            return false;
+    }
+    if ( !LVRenameFile( tmpName, fileName ) ) {
+        LVDeleteFile( fileName );
+        if ( !LVRenameFile( tmpName, fileName ) )
+            return false;
+    }
+    lString16 journalName = fileName + JOURNAL_FILE_SUFFIX;
+    if ( LVFileExists( journalName ) )
+        LVDeleteFile( journalName );
+    markSaved( fileName );
+    return true;
+}
+
+/// appends changes made since last loadFromFile()/saveChanges() to journal, merges journal into history file when it grows too big
+bool CRFileHist::saveChanges( const lString16 & fileName )
+{
+    if ( _savedFileName != fileName || !LVFileExists( fileName ) )
+        return saveToFile( fileName );
+    LVHashTable<lString16, int> savedIndex( _saved.length() + 16 );
+    for ( int i=0; i<_saved.length(); i++ ) {
+        lString16 key = recordKey( _saved[i]->fileName, _saved[i]->fileSize );
+        int dummy;
+        if ( savedIndex.get( key, dummy ) )
+            return saveToFile( fileName ); // duplicate entries cannot be addressed by journal
+        savedIndex.set( key, i );
+    }
+    int count = _records.length();
+    LVPtrVector<CRFileHistSavedState> current;
+    LVArray<int> savedPos( count, -1 );
+    LVArray<bool> present( _saved.length(), false );
+    for ( int i=0; i<count; i++ ) {
+        current.add( new CRFileHistSavedState( _records[i] ) );
+        int pos;
+        if ( savedIndex.get( recordKey( _records[i]->getFileName(), _records[i]->getFileSize() ), pos ) ) {
+            if ( present[pos] )
+                return saveToFile( fileName );
+            present[pos] = true;
+            savedPos[i] = pos;
+        }
+    }
+    // journal moves records to top of list: find shortest list head after which records keep saved order
+    int top = count;
+    while ( top>0 && savedPos[top-1]>=0 && (top==count || savedPos[top-1]<savedPos[top]) )
+        top--;
+    lString8 buf;
+    for ( int i=0; i<_saved.length(); i++ ) {
+        if ( !present[i] ) {
+            putJournalHeader( buf, _saved[i]->fileName, _saved[i]->fileSize, true );
+            buf << END_TAG << "\n";
+        }
+    }
+    for ( int i=count-1; i>=0; i-- ) {
+        CRFileHistSavedState * saved = savedPos[i]>=0 ? _saved[savedPos[i]] : NULL;
+        if ( i<top || saved->infoHash!=current[i]->infoHash )
+            putJournalRecordInfo( buf, _records[i], i<top );
+        putJournalBookmarkChanges( buf, _records[i], current[i], saved );
+    }
+    if ( !buf.empty() ) {
+        lString16 journalName = fileName + JOURNAL_FILE_SUFFIX;
+        lvsize_t journalSize = 0;
+        {
+            LVStreamRef journal = LVOpenFileStream( journalName.c_str(), LVOM_APPEND );
+            if ( journal.isNull() || journal->Seek( 0, LVSEEK_END, NULL ) != LVERR_OK )
+                return saveToFile( fileName );
+            lvsize_t bytesWritten = 0;
+            if ( journal->Write( buf.c_str(), buf.length(), &bytesWritten ) != LVERR_OK || (int)bytesWritten != buf.length() )
+                return saveToFile( fileName );
+            journalSize = journal->GetSize();
+        }
+        lvsize_t histSize = 0;
+        {
+            LVStreamRef stream = LVOpenFileStream( fileName.c_str(), LVOM_READ );
+            if ( !stream.isNull() )
+                histSize = stream->GetSize();
+        }
+        if ( journalSize > HIST_JOURNAL_MIN_COMPACT_SIZE && journalSize > histSize / 2 )
+            return saveToFile( fileName );
+    }
+    _saved.clear();
+    for ( int i=0; i<count; i++ ) {
+        _saved.add( current[i] );
+        current[i] = NULL;
+    }
+    return true;
+}
+
+#ifdef _DEBUG
+
+#include "../include/crtest.h"
+
+#define TEST_HIST_FILE_NAME "/tmp/test-hist-file.bmk"
+
+static CRBookmark * testBookmark( int type, const char * start, const char * comment )
+{
+    CRBookmark * bmk = new CRBookmark();
+    bmk->setType( type );
+    bmk->setStartPos( Utf8ToUnicode(start) );
+    bmk->setEndPos( Utf8ToUnicode(start) + "/text()[1].10" );
+    bmk->setCommentText( Utf8ToUnicode(comment) );
+    bmk->setTimestamp( (time_t)1000000 );
+    bmk->setPercent( 1234 );
+    return bmk;
+}
+
+static void compareHist( CRFileHist & h1, CRFileHist & h2 )
+{
+    LVPtrVector<CRFileHistRecord> & r1 = h1.getRecords();
+    LVPtrVector<CRFileHistRecord> & r2 = h2.getRecords();
+    MYASSERT( r1.length()==r2.length(), "hist record count" );
+    for ( int i=0; i<r1.length(); i++ ) {
+        MYASSERT( r1[i]->getFileName()==r2[i]->getFileName(), "hist file name" );
+        MYASSERT( r1[i]->getFilePath()==r2[i]->getFilePath(), "hist file path" );
+        MYASSERT( r1[i]->getFileSize()==r2[i]->getFileSize(), "hist file size" );
+        MYASSERT( r1[i]->getTitle()==r2[i]->getTitle(), "hist title" );
+        MYASSERT( r1[i]->getAuthor()==r2[i]->getAuthor(), "hist author" );
+        LVPtrVector<CRBookmark> & b1 = r1[i]->getBookmarks();
+        LVPtrVector<CRBookmark> & b2 = r2[i]->getBookmarks();
+        MYASSERT( b1.length()==b2.length(), "hist bookmark count" );
+        for ( int j=0; j<b1.length(); j++ ) {
+            MYASSERT( b1[j]->getType()==b2[j]->getType(), "hist bookmark type" );
+            MYASSERT( b1[j]->getStartPos()==b2[j]->getStartPos(), "hist bookmark start" );
+            MYASSERT( b1[j]->getEndPos()==b2[j]->getEndPos(), "hist bookmark end" );
+            MYASSERT( b1[j]->getCommentText()==b2[j]->getCommentText(), "hist bookmark comment" );
+            MYASSERT( b1[j]->getPercent()==b2[j]->getPercent(), "hist bookmark percent" );
+        }
+    }
+}
+
+void runFileHistUnitTests()
+{
+    CRLog::info("Starting CRFileHist journal unit test");
+    lString16 fn( TEST_HIST_FILE_NAME );
+    lString16 journalName = fn + JOURNAL_FILE_SUFFIX;
+    LVDeleteFile( fn );
+    LVDeleteFile( journalName );
+    CRFileHist h1;
+    h1.savePosition( cs16("/books/c.fb2"), 300, cs16("C"), cs16("Author C"), lString16::empty_str, ldomXPointer() );
+    h1.savePosition( cs16("/books/b.fb2"), 200, cs16("B"), cs16("Author B"), lString16::empty_str, ldomXPointer() );
+    h1.savePosition( cs16("/books/a.fb2"), 100, cs16("A"), cs16("Author A"), lString16::empty_str, ldomXPointer() );
+    MYASSERT( h1.saveToFile( fn ), "hist save" );
+    MYASSERT( !LVFileExists( journalName ), "no journal after full save" );
+    {
+        CRFileHist h2;
+        MYASSERT( h2.loadFromFile( fn ), "hist load" );
+        compareHist( h1, h2 );
+    }
+
+    // changes are appended to journal
+    CRFileHistRecord * c = h1.savePosition( cs16("/books/c.fb2"), 300, cs16("C"), cs16("Author C"), lString16::empty_str, ldomXPointer() );
+    MYASSERT( c==h1.getRecords()[0] && h1.getRecords().length()==3, "existing record moved to top" );
+    h1.getRecords()[2]->getBookmarks().add( testBookmark( bmkt_comment, "/FictionBook/body/section[2]/p[3]", "first\ncomment" ) );
+    h1.getRecords()[2]->getBookmarks().add( testBookmark( bmkt_pos, "/FictionBook/body/section[4]/p[1]", "" ) );
+    h1.removeRecord( 1 );
+    h1.savePosition( cs16("/books/d.fb2"), 400, cs16("D"), cs16("Author D"), lString16::empty_str, ldomXPointer() );
+    MYASSERT( h1.saveChanges( fn ), "hist save changes 1" );
+    MYASSERT( LVFileExists( journalName ), "journal written" );
+    {
+        CRFileHist h2;
+        MYASSERT( h2.loadFromFile( fn ), "hist load with journal 1" );
+        compareHist( h1, h2 );
+    }
+
+    // bookmark deletion and info update
+    CRFileHistRecord * b = h1.getRecords()[2];
+    b->getBookmarks().erase( 0, 1 );
+    b->setTitle( cs16("B, second edition") );
+    h1.savePosition( cs16("/books/a.fb2"), 100, cs16("A"), cs16("Author A"), lString16::empty_str, ldomXPointer() );
+    MYASSERT( h1.saveChanges( fn ), "hist save changes 2" );
+    {
+        CRFileHist h2;
+        MYASSERT( h2.loadFromFile( fn ), "hist load with journal 2" );
+        compareHist( h1, h2 );
+        // index of loaded history finds existing records
+        CRFileHistRecord * rec = h2.savePosition( cs16("/books/b.fb2"), 200, cs16("B"), cs16("Author B"), lString16::empty_str, ldomXPointer() );
+        MYASSERT( h2.getRecords().length()==h1.getRecords().length() && rec==h2.getRecords()[0], "loaded record found" );
+        h2.removeRecord( 0 );
+        MYASSERT( h2.getRecords().length()==h1.getRecords().length()-1, "record removed" );
+        rec = h2.savePosition( cs16("/books/b.fb2"), 200, cs16("B"), cs16("Author B"), lString16::empty_str, ldomXPointer() );
+        MYASSERT( h2.getRecords().length()==h1.getRecords().length() && rec->getBookmarks().length()==0, "removed record is not found" );
+    }
+
+    // journal is merged by full save
+    MYASSERT( h1.saveToFile( fn ), "hist save 2" );
+    MYASSERT( !LVFileExists( journalName ), "journal merged" );
+    {
+        CRFileHist h2;
+        MYASSERT( h2.loadFromFile( fn ), "hist load 2" );
+        compareHist( h1, h2 );
+    }
+    LVDeleteFile( fn );
+    CRLog::info("Finished CRFileHist journal unit test");
+}
+
+#endif
@@ -38,6 +38,41 @@ LDOMNameIdMapItem::LDOMNameIdMapItem(LDOMNameIdMapItem & item)
 }
 
 
+// returns true if items have the same id, name and properties
+static bool isSameItem( const LDOMNameIdMapItem * item1, const LDOMNameIdMapItem * item2 )
+{
+    if ( item1->id!=item2->id || item1->value!=item2->value )
+        return false;
+    const css_elem_def_props_t * data1 = item1->getData();
+    const css_elem_def_props_t * data2 = item2->getData();
+    if ( !data1 || !data2 )
+        return data1==data2;
+    return data1->display==data2->display && data1->white_space==data2->white_space
+        && data1->allow_text==data2->allow_text && data1->is_object==data2->is_object;
+}
+
+static inline lUInt32 nameHashChar( lChar8 ch ) { return (lUInt8)ch; }
+static inline lUInt32 nameHashChar( lChar16 ch ) { return ch; }
+
+// the same value for 8-bit and wide string of the same name
+template <typename T> static lUInt32 nameHash( const T * s )
+{
+    lUInt32 a = 2166136261u;
+    for ( ; *s; s++ )
+        a = a * 16777619 ^ nameHashChar( *s );
+    return a;
+}
+
+// search in open addressing hash table
+template <typename T> static const LDOMNameIdMapItem * findInHash( LDOMNameIdMapItem * * hash, int mask, const T * name )
+{
+    for ( lUInt32 n = nameHash( name ) & mask; hash[n]; n = (n + 1) & mask ) {
+        if ( !lStr_cmp( name, hash[n]->value.c_str() ) )
+            return hash[n];
+    }
+    return NULL;
+}
+
 static const char id_map_item_magic[] = "IDMI";
 
 /// serialize to byte array
@@ -103,7 +138,8 @@ void LDOMNameIdMap::serialize( SerialBuf & buf )
         Sort();
     int start = buf.pos();
 	buf.putMagic( id_map_magic );
-    buf << m_count;
+    // items of base map are written too, to keep file independent of base
+    buf << (lUInt16)(m_count + (m_base ? m_base->m_count : 0));
     for ( int i=0; i<m_size; i++ ) {
         if ( m_by_id[i] )
             m_by_id[i]->serialize( buf );
@@ -122,22 +158,39 @@ bool LDOMNameIdMap::deserialize( SerialBuf & buf )
         buf.seterror();
         return false;
     }
-    Clear();
     lUInt16 count;
     buf >> count;
     if ( count>m_size ) {
         buf.seterror();
         return false;
     }
+    LVPtrVector<LDOMNameIdMapItem> items;
+    bool sameAsBase = m_base!=NULL;
     for ( int i=0; i<count; i++ ) {
         LDOMNameIdMapItem * item = LDOMNameIdMapItem::deserialize(buf);
-        if ( !item || (item->id<m_size && m_by_id[item->id]!=NULL ) ) { // invalid entry
-            if ( item )
-                delete item;
+        if ( !item ) {
             buf.seterror();
             return false;
         }
-        AddItem( item );
+        items.add( item );
+        if ( sameAsBase && item->id<m_base->m_size && m_base->m_by_id[item->id] && !isSameItem( item, m_base->m_by_id[item->id] ) )
+            sameAsBase = false;
+    }
+    if ( !sameAsBase && m_base ) {
+        // saved map is not compatible with base
+        m_base = NULL;
+    }
+    Clear();
+    for ( int i=0; i<items.length(); i++ ) {
+        LDOMNameIdMapItem * item = items[i];
+        if ( item->id<m_size && m_by_id[item->id]!=NULL ) {
+            if ( m_base && item->id<m_base->m_size && m_by_id[item->id]==m_base->m_by_id[item->id] )
+                continue; // predefined item
+            // invalid entry
+            buf.seterror();
+            return false;
+        }
+        AddItem( items.remove( i-- ) );
     }
     m_sorted = false;
     buf.checkCRC( buf.pos() - start );
@@ -150,6 +203,9 @@ bool LDOMNameIdMap::deserialize( SerialBuf & buf )
 
 LDOMNameIdMap::LDOMNameIdMap(lUInt16 maxId)
 {
+    m_hash = NULL;
+    m_base = NULL;
+    m_hashMask = 0;
     m_size = maxId+1;
     m_count = 0;
     m_by_id   = new LDOMNameIdMapItem * [m_size];
@@ -164,23 +220,21 @@ LDOMNameIdMap::LDOMNameIdMap(lUInt16 maxId)
 LDOMNameIdMap::LDOMNameIdMap( LDOMNameIdMap & map )
 {
     m_changed = false;
+    m_hash = NULL;
+    m_hashMask = 0;
+    m_base = map.m_base;
     m_size = map.m_size;
     m_count = map.m_count;
     m_by_id   = new LDOMNameIdMapItem * [m_size];
-    int i;
-    for ( i=0; i<m_size; i++ ) {
-        if ( map.m_by_id[i] )
-            m_by_id[i] = new LDOMNameIdMapItem( *map.m_by_id[i] );
-        else
-            m_by_id[i] = NULL;
-    }
+    memset( m_by_id, 0, sizeof(LDOMNameIdMapItem *)*m_size );
     m_by_name = new LDOMNameIdMapItem * [m_size];
-    for ( i=0; i<m_size; i++ ) {
-        if ( map.m_by_name[i] )
-            m_by_name[i] = new LDOMNameIdMapItem( *map.m_by_name[i] );
-        else
-            m_by_name[i] = NULL;
+    memset( m_by_name, 0, sizeof(LDOMNameIdMapItem *)*m_size );
+    // own items are copied, base items are shared
+    for ( int i=0; i<m_count; i++ ) {
+        m_by_name[i] = new LDOMNameIdMapItem( *map.m_by_name[i] );
+        m_by_id[m_by_name[i]->id] = m_by_name[i];
     }
+    FillBaseItems();
     m_sorted = map.m_sorted;
 }
 
@@ -189,6 +243,73 @@ LDOMNameIdMap::~LDOMNameIdMap()
     Clear();
     delete[] m_by_name;
     delete[] m_by_id;
+    if ( m_hash )
+        free( m_hash );
+}
+
+/// sorts map and builds name hash index; map must not be changed after this call
+void LDOMNameIdMap::Freeze()
+{
+    if ( !m_sorted )
+        Sort();
+    if ( m_hash )
+        free( m_hash );
+    int size = 16;
+    while ( size < m_count*2 )
+        size <<= 1;
+    m_hashMask = size - 1;
+    m_hash = (LDOMNameIdMapItem **)calloc( size, sizeof(LDOMNameIdMapItem *) );
+    for ( int i=0; i<m_count; i++ ) {
+        lUInt32 n = nameHash( m_by_name[i]->value.c_str() ) & m_hashMask;
+        while ( m_hash[n] )
+            n = (n + 1) & m_hashMask;
+        m_hash[n] = m_by_name[i];
+    }
+}
+
+/// uses frozen map for predefined items, only items missing in base are stored in this map
+void LDOMNameIdMap::SetBase( const LDOMNameIdMap * base )
+{
+    m_base = base;
+    if ( m_base && m_base->m_size>m_size )
+        Resize( m_base->m_size );
+    FillBaseItems();
+}
+
+/// puts items of base map to id array
+void LDOMNameIdMap::FillBaseItems()
+{
+    if ( !m_base )
+        return;
+    for ( int i=0; i<m_base->m_size && i<m_size; i++ ) {
+        if ( m_base->m_by_id[i] && !m_by_id[i] )
+            m_by_id[i] = m_base->m_by_id[i];
+    }
+}
+
+/// extends id arrays to hold newsize ids
+void LDOMNameIdMap::Resize( lUInt16 newsize )
+{
+    m_by_id = (LDOMNameIdMapItem **)realloc( m_by_id, sizeof(LDOMNameIdMapItem *)*newsize );
+    m_by_name = (LDOMNameIdMapItem **)realloc( m_by_name, sizeof(LDOMNameIdMapItem *)*newsize );
+    for (lUInt16 i = m_size; i<newsize; i++)
+    {
+        m_by_id[i] = NULL;
+        m_by_name[i] = NULL;
+    }
+    m_size = newsize;
+}
+
+/// hashed search in frozen map
+const LDOMNameIdMapItem * LDOMNameIdMap::findHashedItem( const lChar16 * name ) const
+{
+    return findInHash( m_hash, m_hashMask, name );
+}
+
+/// hashed search in frozen map
+const LDOMNameIdMapItem * LDOMNameIdMap::findHashedItem( const lChar8 * name ) const
+{
+    return findInHash( m_hash, m_hashMask, name );
 }
 
 static int compare_items( const void * item1, const void * item2 )
@@ -205,7 +326,16 @@ void LDOMNameIdMap::Sort()
 
 const LDOMNameIdMapItem * LDOMNameIdMap::findItem( const lChar16 * name )
 {
-    if (m_count==0 || !name || !*name)
+    if ( !name || !*name )
+        return NULL;
+    if ( m_hash )
+        return findHashedItem( name );
+    if ( m_base ) {
+        const LDOMNameIdMapItem * item = m_base->findHashedItem( name );
+        if ( item )
+            return item;
+    }
+    if ( m_count==0 )
         return NULL;
     if (!m_sorted)
         Sort();
@@ -230,7 +360,16 @@ const LDOMNameIdMapItem * LDOMNameIdMap::findItem( const lChar16 * name )
 
 const LDOMNameIdMapItem * LDOMNameIdMap::findItem( const lChar8 * name )
 {
-    if (m_count==0 || !name || !*name)
+    if ( !name || !*name )
+        return NULL;
+    if ( m_hash )
+        return findHashedItem( name );
+    if ( m_base ) {
+        const LDOMNameIdMapItem * item = m_base->findHashedItem( name );
+        if ( item )
+            return item;
+    }
+    if ( m_count==0 )
         return NULL;
     if (!m_sorted)
         Sort();
@@ -264,15 +403,7 @@ void LDOMNameIdMap::AddItem( LDOMNameIdMapItem * item )
     if (item->id>=m_size)
     {
         // reallocate storage
-        lUInt16 newsize = item->id+16;
-        m_by_id = (LDOMNameIdMapItem **)realloc( m_by_id, sizeof(LDOMNameIdMapItem *)*newsize );
-        m_by_name = (LDOMNameIdMapItem **)realloc( m_by_name, sizeof(LDOMNameIdMapItem *)*newsize );
-        for (lUInt16 i = m_size; i<newsize; i++)
-        {
-            m_by_id[i] = NULL;
-            m_by_name[i] = NULL;
-        }
-        m_size = newsize;
+        Resize( item->id+16 );
     }
     if (m_by_id[item->id] != NULL)
     {
@@ -306,6 +437,7 @@ void LDOMNameIdMap::Clear()
     }
     memset( m_by_id, 0, sizeof(LDOMNameIdMapItem *)*m_size);
     m_count = 0;
+    FillBaseItems();
 }
 
 void LDOMNameIdMap::dumpUnknownItems( FILE * f, int start_id )
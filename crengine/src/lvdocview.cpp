@@ -27,6 +27,7 @@
 #include "../include/chmfmt.h"
 #include "../include/wordfmt.h"
 #include "../include/pdbfmt.h"
+#include "../include/crconcurrent.h"
 /// to show page bounds rectangles
 //#define SHOW_PAGE_RECT
 
@@ -181,6 +182,10 @@ LVDocView::LVDocView(int bitsPerPixel) :
 #endif
 #endif
 	m_statusColor = 0xFF000000;
+	m_imagePrefetchExecutor = NULL;
+	m_imagePrefetchGeneration = 0;
+	m_imagePrefetchPage = -1;
+	m_docBufferSize = 0;
 	m_defaultFontFace = lString8(DEFAULT_FONT_NAME);
 	m_statusFontFace = lString8(DEFAULT_STATUS_FONT_NAME);
 	m_props = LVCreatePropsContainer();
@@ -203,6 +208,7 @@ LVDocView::LVDocView(int bitsPerPixel) :
 
 LVDocView::~LVDocView() {
 	Clear();
+	cancelImagePrefetch(true);
 }
 
 CRPageSkinRef LVDocView::getPageSkin() {
@@ -532,6 +538,7 @@ void LVDocView::updateDocStyleSheet() {
 void LVDocView::Clear() {
 	{
 		LVLock lock(getMutex());
+		cancelImagePrefetch(true);
 		if (m_doc)
 			delete m_doc;
 		m_doc = NULL;
@@ -663,6 +670,8 @@ LVDocImageRef LVDocView::getPageImage( int delta )
 		ref = m_imageCache.get( -1, p );
 		if ( !ref.isNull() ) {
 			//CRLog::trace("getPageImage: + page [%d] found in cache", offset);
+			if ( delta==0 )
+				prefetchPageImages( p + getVisiblePageCount() );
 			return ref;
 		}
 	} else {
@@ -684,6 +693,8 @@ LVDocImageRef LVDocView::getPageImage( int delta )
 		ref = m_imageCache.get( offset, p );
 	}
 	//CRLog::trace("getPageImage: page [%d] is ready", offset);
+	if ( p>=0 && delta==0 )
+		prefetchPageImages( p + getVisiblePageCount() );
 	return ref;
 }
 
@@ -722,6 +733,8 @@ void LVDocView::Draw(LVDrawBuf & drawbuf, bool autoResize) {
 	//CRLog::trace("Draw() : calling Draw(buf(%d x %d), %d, %d, false)",
 	//		drawbuf.GetWidth(), drawbuf.GetHeight(), offset, p);
 	Draw(drawbuf, offset, p, false, autoResize);
+	if (p >= 0)
+		prefetchPageImages(p + getVisiblePageCount());
 }
 
 #if CR_ENABLE_PAGE_IMAGE_CACHE==1
@@ -874,29 +887,68 @@ int getSectionPage(ldomNode * section, LVRendPageList & pages) {
  }
  */
 
+struct TocItemPos {
+	int y;
+	int index;
+};
+
+static int compareTocItemPos(const void * p1, const void * p2) {
+	const TocItemPos * item1 = (const TocItemPos *)p1;
+	const TocItemPos * item2 = (const TocItemPos *)p2;
+	if (item1->y != item2->y)
+		return item1->y < item2->y ? -1 : 1;
+	return item1->index - item2->index;
+}
+
+static void collectTocItems(LVTocItem * item, LVArray<LVTocItem *> & items) {
+	items.add(item);
+	for (int i = 0; i < item->getChildCount(); i++)
+		collectTocItems(item->getChild(i), items);
+}
+
 /// update page numbers for items
 void LVDocView::updatePageNumbers(LVTocItem * item) {
-	if (!item->getXPointer().isNull()) {
-		lvPoint p = item->getXPointer().toPoint();
-		int y = p.y;
-		int h = GetFullHeight();
-		int page = getBookmarkPage(item->_position);
-		if (page >= 0 && page < getPageCount())
-			item->_page = page;
-		else
-			item->_page = -1;
+	LVLock lock(getMutex());
+	CHECK_RENDER("updatePageNumbers()")
+	LVArray<LVTocItem *> items;
+	collectTocItems(item, items);
+	int count = items.length();
+	// resolve each position once, then assign pages in a single pass over page list
+	LVArray<TocItemPos> positions(count, TocItemPos());
+	int resolved = 0;
+	for (int i = 0; i < count; i++) {
+		LVTocItem * tocItem = items[i];
+		if (tocItem->getXPointer().isNull()) {
+			// unknown position
+			tocItem->_page = -1;
+			tocItem->_percent = -1;
+			continue;
+		}
+		positions[resolved].y = tocItem->_position.toPoint().y;
+		positions[resolved].index = i;
+		resolved++;
+	}
+	qsort(positions.get(), resolved, sizeof(TocItemPos), compareTocItemPos);
+	int h = GetFullHeight();
+	int pageCount = m_pages.length();
+	int page = 0;
+	for (int i = 0; i < resolved; i++) {
+		LVTocItem * tocItem = items[positions[i].index];
+		int y = positions[i].y;
+		if (!pageCount) {
+			tocItem->_page = -1;
+		} else if (y < 0) {
+			tocItem->_page = 0;
+		} else {
+			// same as m_pages.FindNearestPage(y, 0) for ascending y
+			while (page < pageCount - 1 && y >= m_pages[page]->start + m_pages[page]->height)
+				page++;
+			tocItem->_page = page;
+		}
 		if (y >= 0 && y < h && h > 0)
-			item->_percent = (int) ((lInt64) y * 10000 / h); // % * 100
+			tocItem->_percent = (int) ((lInt64) y * 10000 / h); // % * 100
 		else
-			item->_percent = -1;
-	} else {
-		//CRLog::error("Page position is not found for path %s", LCSTR(item->getPath()) );
-		// unknown position
-		item->_page = -1;
-		item->_percent = -1;
-	}
-	for (int i = 0; i < item->getChildCount(); i++) {
-		updatePageNumbers(item->getChild(i));
+			tocItem->_percent = -1;
 	}
 }
 
@@ -2248,6 +2300,9 @@ void LVDocView::Draw(LVDrawBuf & drawbuf, int position, int page, bool rotate, b
 		if (pc == 2 && page >= 0 && page + 1 < m_pages.length())
 			drawPageTo(&drawbuf, *m_pages[page + 1], &m_pageRects[1],
 					m_pages.length(), 1);
+		// next pages are likely to be drawn soon
+		if (page >= 0)
+			prefetchPageData(page + pc);
 	}
 #if CR_INTERNAL_PAGE_ORIENTATION==1
 	if ( rotate ) {
@@ -2437,6 +2492,17 @@ LVRef<ldomXRange> LVDocView::getPageDocumentRange(int pageIndex) {
 	return res;
 }
 
+/// requests reading of node data of page from cache file on background thread
+void LVDocView::prefetchPageData(int pageIndex) {
+	if (pageIndex < 0 || pageIndex >= m_pages.length() || m_pages[pageIndex]->type != PAGE_TYPE_NORMAL)
+		return;
+	// nodes around page are taken from positions recorded by render, document is not accessed
+	ldomRenderPositionIndex::Block first, last;
+	if (!m_doc->getRenderPositions().findBlocks(m_pages[pageIndex]->start, m_pages[pageIndex]->start + m_pages[pageIndex]->height, first, last))
+		return;
+	m_doc->prefetchRange(first.node, last.node, first.text, last.text);
+}
+
 /// returns number of non-space characters on current page
 int LVDocView::getCurrentPageCharCount()
 {
@@ -2476,6 +2542,134 @@ int LVDocView::getCurrentPageImageCount()
     return cnt.get();
 }
 
+/// decodes document image into decoded image cache, unless request is cancelled
+/**
+    Gets decoder as raw pointer: references are taken and released by document view thread only.
+*/
+class LVImagePrefetchTask : public CRRunnable {
+    volatile int * _generation;
+    int _taskGeneration;
+    LVImagePrefetchJob * _job;
+    LVImageSource * _img;
+    int _docIndex;
+    lUInt32 _imageId;
+    int _dx;
+    int _dy;
+public:
+    LVImagePrefetchTask( volatile int * generation, LVImagePrefetchJob * job, int docIndex, lUInt32 imageId, int dx, int dy )
+        : _generation(generation), _taskGeneration(*generation), _job(job), _img(job->img.get())
+        , _docIndex(docIndex), _imageId(imageId), _dx(dx), _dy(dy)
+    {
+    }
+    virtual void run()
+    {
+        if ( *_generation != _taskGeneration )
+            return; // cancelled
+        LVDecodedImageCache::add( _docIndex, _imageId, _img, _dx, _dy );
+    }
+    virtual ~LVImagePrefetchTask()
+    {
+        // decoder may be released by document view thread now
+        IMAGE_CACHE_GUARD
+        _job->finished = true;
+    }
+};
+
+/// decodes images of pages [page, page+count) into decoded image cache in background, cancels previous request
+void LVDocView::prefetchPageImages( int page, int count )
+{
+    if ( !concurrencyProvider || !_imageCacheMutex || !m_doc || !m_is_rendered || !isPageMode() )
+        return;
+    if ( page == m_imagePrefetchPage )
+        return; // already requested
+    cancelImagePrefetch();
+    releaseImagePrefetchJobs();
+    m_imagePrefetchPage = page;
+    // images and sizes they are drawn at are recorded by render, pages are not walked and formatted here
+    ldomRenderPositionIndex & positions = m_doc->getRenderPositions();
+    LVArray<ldomRenderPositionIndex::Image> images;
+    for ( int i=page; i<page+count && i<m_pages.length(); i++ ) {
+        if ( i<0 || m_pages[i]->type != PAGE_TYPE_NORMAL )
+            continue;
+        LVRendPageInfo * p = m_pages[i];
+        positions.findImages( p->start, p->start + p->height, images );
+        for ( int j=0; j<p->footnotes.length(); j++ )
+            positions.findImages( p->footnotes[j].start, p->footnotes[j].start + p->footnotes[j].height, images );
+    }
+    int docIndex = m_doc->getDocIndex();
+    LVArray<lUInt32> queued; // image ids of scheduled jobs, in images order
+    for ( int i=0; i<images.length(); i++ ) {
+        const ldomRenderPositionIndex::Image & image = images[i];
+        ldomNode * node = m_doc->getTinyNode( image.node );
+        lUInt32 imageId = node ? m_doc->getObjectImageId( node ) : 0;
+        queued.add( 0 );
+        if ( !imageId )
+            continue;
+        bool duplicate = false;
+        for ( int j=0; j<i && !duplicate; j++ )
+            duplicate = queued[j] == imageId && images[j].dx == image.dx && images[j].dy == image.dy;
+        if ( duplicate || LVDecodedImageCache::contains( docIndex, imageId, image.dx, image.dy ) )
+            continue;
+        // decoder of memory copy of image data doesn't touch the document
+        LVStreamRef stream = node->getObjectImageStream();
+        int size = stream.isNull() ? 0 : (int)stream->GetSize();
+        if ( size <= 0 )
+            continue;
+        LVImagePrefetchJob * job = new LVImagePrefetchJob();
+        job->data = (lUInt8*)malloc( size );
+        lvsize_t bytesRead = 0;
+        if ( job->data && stream->Seek( 0, LVSEEK_SET, NULL )==LVERR_OK )
+            stream->Read( job->data, size, &bytesRead );
+        if ( (int)bytesRead == size )
+            job->img = LVCreateStreamImageSource( LVCreateMemoryStream( job->data, size ) );
+        if ( job->img.isNull() ) {
+            delete job;
+            continue;
+        }
+        if ( !m_imagePrefetchExecutor )
+            m_imagePrefetchExecutor = new CRThreadExecutor();
+        m_imagePrefetchJobs.add( job );
+        queued[i] = imageId;
+        m_imagePrefetchExecutor->execute( new LVImagePrefetchTask( &m_imagePrefetchGeneration, job, docIndex, imageId, image.dx, image.dy ) );
+    }
+}
+
+/// releases decoders of image prefetch jobs finished by background thread
+void LVDocView::releaseImagePrefetchJobs()
+{
+    for ( int i=m_imagePrefetchJobs.length()-1; i>=0; i-- ) {
+        bool finished = false;
+        {
+            IMAGE_CACHE_GUARD
+            finished = m_imagePrefetchJobs[i]->finished;
+        }
+        if ( finished )
+            delete m_imagePrefetchJobs.remove( i );
+    }
+}
+
+/// cancels scheduled image prefetch tasks; if stop is true, also waits for running task and stops worker thread
+void LVDocView::cancelImagePrefetch( bool stop )
+{
+    m_imagePrefetchGeneration++;
+    m_imagePrefetchPage = -1;
+    if ( stop && m_imagePrefetchExecutor ) {
+        m_imagePrefetchExecutor->stop();
+        delete m_imagePrefetchExecutor;
+        m_imagePrefetchExecutor = NULL;
+    }
+    if ( stop )
+        releaseImagePrefetchJobs();
+}
+
+/// sets memory budget for unpacked data of current and later loaded documents, 0 for default
+void LVDocView::setDocBufferSize( int size )
+{
+    m_docBufferSize = size;
+    if ( m_doc )
+        m_doc->setDocBufferSize( size );
+}
+
 /// get page text, -1 for current page
 lString16 LVDocView::getPageText(bool, int pageIndex) {
 	LVLock lock(getMutex());
@@ -2917,13 +3111,13 @@ lString16 LVDocView::getNavigationPath() {
 }
 
 /// saves position to navigation history, to be able return back
-bool LVDocView::savePosToNavigationHistory(lString16 path) {
+bool LVDocView::savePosToNavigationHistory(lString16 path, const ldomCompactXPointer & pos) {
     if (!path.empty()) {
         lString16 s = getNavigationPath() + NAVIGATION_FILENAME_SEPARATOR
                 + path;
         CRLog::debug("savePosToNavigationHistory(%s)",
                 UnicodeToUtf8(s).c_str());
-        return _navigationHistory.save(s);
+        return _navigationHistory.save(s, pos);
     }
     return false;
 }
@@ -2932,13 +3126,13 @@ bool LVDocView::savePosToNavigationHistory() {
 	ldomXPointer bookmark = getBookmark();
 	if (!bookmark.isNull()) {
 		lString16 path = bookmark.toString();
-        return savePosToNavigationHistory(path);
+        return savePosToNavigationHistory(path, bookmark.toCompact());
 	}
 	return false;
 }
 
 /// navigate to history path URL
-bool LVDocView::navigateTo(lString16 historyPath) {
+bool LVDocView::navigateTo(lString16 historyPath, const ldomCompactXPointer & pos) {
 	CRLog::debug("navigateTo(%s)", LCSTR(historyPath));
 	lString16 fname, path;
 	if (splitNavigationPos(historyPath, fname, path)) {
@@ -2953,7 +3147,9 @@ bool LVDocView::navigateTo(lString16 historyPath) {
 	}
 	if (path.empty())
 		return false;
-	ldomXPointer bookmark = m_doc->createXPointer(path);
+	ldomXPointer bookmark = m_doc->createXPointer(pos);
+	if (bookmark.isNull())
+		bookmark = m_doc->createXPointer(path);
 	if (bookmark.isNull())
 		return false;
 	goToBookmark(bookmark);
@@ -2978,7 +3174,7 @@ bool LVDocView::goBack() {
 	lString16 s = _navigationHistory.back();
 	if (s.empty())
 		return false;
-	return navigateTo(s);
+	return navigateTo(s, _navigationHistory.getCompactPos());
 }
 
 /// go forward. returns true if navigation was successful
@@ -2986,7 +3182,7 @@ bool LVDocView::goForward() {
 	lString16 s = _navigationHistory.forward();
 	if (s.empty())
 		return false;
-	return navigateTo(s);
+	return navigateTo(s, _navigationHistory.getCompactPos());
 }
 
 /// update selection ranges
@@ -3026,13 +3222,13 @@ void LVDocView::updateBookMarksRanges()
             CRBookmark * bmk = bookmarks[i];
             int t = bmk->getType();
             if (t != bmkt_lastpos) {
-                ldomXPointer p = m_doc->createXPointer(bmk->getStartPos());
+                ldomXPointer p = bmk->getStartXPointer(m_doc);
                 if (p.isNull())
                     continue;
                 lvPoint pt = p.toPoint();
                 if (pt.y < 0)
                     continue;
-                ldomXPointer ep = (t == bmkt_pos) ? p : m_doc->createXPointer(bmk->getEndPos());
+                ldomXPointer ep = (t == bmkt_pos) ? p : bmk->getEndXPointer(m_doc);
                 if (ep.isNull())
                     continue;
                 lvPoint ept = ep.toPoint();
@@ -3068,14 +3264,13 @@ void LVDocView::updateBookMarksRanges()
                 CRBookmark * bmk = bookmarks[i];
                 if (bmk->getType() != bmkt_comment && bmk->getType() != bmkt_correction)
                     continue;
-                lString16 pos = bmk->getStartPos();
-                ldomXPointer p = m_doc->createXPointer(pos);
+                ldomXPointer p = bmk->getStartXPointer(m_doc);
                 if (p.isNull())
                     continue;
                 lvPoint pt = p.toPoint();
                 if (pt.y < 0)
                     continue;
-                ldomXPointer ep = m_doc->createXPointer(bmk->getEndPos());
+                ldomXPointer ep = bmk->getEndXPointer(m_doc);
                 if (ep.isNull())
                     continue;
                 lvPoint ept = ep.toPoint();
@@ -3104,11 +3299,9 @@ void LVDocView::updateBookMarksRanges()
                 if ((bmk->getType() != bmkt_comment && bmk->getType() != bmkt_correction) ||
                     bmk->getPercent() != bmi->get(i))
                     continue;
-                lString16 epos = bmk->getEndPos();
-                ldomXPointer ep = m_doc->createXPointer(epos);
+                ldomXPointer ep = bmk->getEndXPointer(m_doc);
                 if (!ep.isNull()) {
-                    lString16 spos = bmk->getStartPos();
-                    ldomXPointer sp = m_doc->createXPointer(spos);
+                    ldomXPointer sp = bmk->getStartXPointer(m_doc);
                     if (!sp.isNull()) {
                         ldomXRange bmk_range(sp, ep);
 
@@ -4117,9 +4310,12 @@ void LVDocView::createEmptyDocument() {
 
 	//m_doc ? m_doc->getDocFlags() : DOC_FLAG_DEFAULTS;
 	m_is_rendered = false;
+	cancelImagePrefetch(true);
 	if (m_doc)
 		delete m_doc;
 	m_doc = new ldomDocument();
+	if (m_docBufferSize)
+		m_doc->setDocBufferSize(m_docBufferSize);
 	m_cursorPos.clear();
 	m_markRanges.clear();
         m_bmkRanges.clear();
@@ -5106,8 +5302,7 @@ bool LVDocView::goToPageShortcutBookmark(int number) {
 	CRBookmark * bmk = rec->getShortcutBookmark(number);
 	if (!bmk)
 		return false;
-	lString16 pos = bmk->getStartPos();
-	ldomXPointer p = m_doc->createXPointer(pos);
+	ldomXPointer p = bmk->getStartXPointer(m_doc);
 	if (p.isNull())
 		return false;
 	if (getCurPage() != getBookmarkPage(p))
@@ -5160,13 +5355,13 @@ CRBookmark * LVDocView::findBookmarkByPoint(lvPoint pt) {
         int t = bmk->getType();
         if (t == bmkt_lastpos)
             continue;
-        ldomXPointer p = m_doc->createXPointer(bmk->getStartPos());
+        ldomXPointer p = bmk->getStartXPointer(m_doc);
         if (p.isNull())
             continue;
         lvRect rc;
         if (!p.getRect(rc))
             continue;
-        ldomXPointer ep = (t == bmkt_pos) ? p : m_doc->createXPointer(bmk->getEndPos());
+        ldomXPointer ep = (t == bmkt_pos) ? p : bmk->getEndXPointer(m_doc);
         if (ep.isNull())
             continue;
         lvRect erc;
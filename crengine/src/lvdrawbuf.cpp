@@ -479,6 +479,23 @@ public:
     virtual void OnStartDecode( LVImageSource * )
     {
     }
+    virtual bool GetTargetSize( LVImageSource *, int & dx, int & dy )
+    {
+        dx = dst_dx;
+        dy = dst_dy;
+        return !isNinePatch;
+    }
+    virtual void OnDecodedSizeReduced( LVImageSource *, int dx, int dy )
+    {
+        src_dx = dx;
+        src_dy = dy;
+        if (xmap)
+            delete[] xmap;
+        if (ymap)
+            delete[] ymap;
+        xmap = src_dx != dst_dx ? GenMap( src_dx, dst_dx ) : NULL;
+        ymap = src_dy != dst_dy ? GenMap( src_dy, dst_dy ) : NULL;
+    }
     virtual bool OnLineDecoded( LVImageSource *, int y, lUInt32 * data )
     {
         //fprintf( stderr, "l_%d ", y );
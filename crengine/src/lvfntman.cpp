@@ -23,6 +23,7 @@
 #include "../include/lvdrawbuf.h"
 #include "../include/lvstyles.h"
 #include "../include/lvthread.h"
+#include "../include/lvhashtable.h"
 
 // define to filter out all fonts except .ttf
 //#define LOAD_TTF_FONTS_ONLY
@@ -399,6 +400,14 @@ public:
         return ((((_size * 31) + _weight)*31  + _italic)*31 + _family)*31 + _name.getHash();
     }
 
+    /// returns key of properties used by font matching, for memoized lookups
+    lString8 getMatchKey() const {
+        lString8 key;
+        key << fmt::decimal(_size) << "," << fmt::decimal(_weight) << "," << fmt::decimal(_italic) << ","
+            << fmt::decimal((int)_family) << "," << fmt::decimal(_documentId) << ":" << _typeface;
+        return key;
+    }
+
     /// returns font file name
     lString8 getName() const { return _name; }
     void setName( lString8 name) {  _name = name; }
@@ -443,13 +452,42 @@ public:
     { }
 };
 
+#ifndef FONT_CACHE_FIND_MEMO_SIZE
+/// max number of memoized font lookups, memo is dropped when exceeded
+#define FONT_CACHE_FIND_MEMO_SIZE 4096
+#endif
+
+/// font cache items by typeface: chains of item indexes in list order
+class LVFontTypefaceIndex
+{
+    LVHashTable< lString8, int > _first;
+    LVArray< int > _next;
+    bool _valid;
+public:
+    void invalidate() { _valid = false; }
+    void update( LVPtrVector< LVFontCacheItem > & list );
+    /// returns index of first item with typeface, -1 if not found
+    int first( const lString8 & typeface ) { int index = -1; _first.get( typeface, index ); return index; }
+    /// returns index of next item with the same typeface, -1 if no more items
+    int next( int index ) { return _next[index]; }
+    LVFontTypefaceIndex() : _first(64), _valid(false) { }
+};
+
 /// font cache
 class LVFontCache
 {
     LVPtrVector< LVFontCacheItem > _registered_list;
     LVPtrVector< LVFontCacheItem > _instance_list;
+    LVFontTypefaceIndex _registered_index;
+    LVFontTypefaceIndex _instance_index;
+    /// results of find() by font properties, dropped on any change of font lists
+    LVHashTable< lString8, LVFontCacheItem * > _find_memo;
+    /// call after adding or removing of list items
+    void changed() { _registered_index.invalidate(); _instance_index.invalidate(); _find_memo.clear(); }
+    void findBestMatch( LVPtrVector< LVFontCacheItem > & list, LVFontTypefaceIndex & index, lString8Collection & faces,
+        LVFontDef & def, int & best_index, int & best_match );
 public:
-    void clear() { _registered_list.clear(); _instance_list.clear(); }
+    void clear() { _registered_list.clear(); _instance_list.clear(); changed(); }
     void gc(); // garbage collector
     void update( const LVFontDef * def, LVFontRef ref );
     void removefont(const LVFontDef * def);
@@ -489,7 +527,7 @@ public:
             _registered_list[i]->getFont()->setFallbackFont(LVFontRef());
         }
     }
-    LVFontCache( )
+    LVFontCache( ) : _find_memo(256)
     { }
     virtual ~LVFontCache() { }
 };
@@ -3813,46 +3851,81 @@ LVFontCacheItem * LVFontCache::findFallback( lString8 face, int size )
     return _registered_list[best_index];
 }
 
+void LVFontTypefaceIndex::update( LVPtrVector< LVFontCacheItem > & list )
+{
+    if ( _valid )
+        return;
+    _first.clear();
+    _next.clear();
+    _next.addSpace( list.length() );
+    for ( int i=list.length()-1; i>=0; i-- ) {
+        lString8 typeface = list[i]->getDef()->getTypeFace();
+        int next = -1;
+        _first.get( typeface, next );
+        _next[i] = next;
+        _first.set( typeface, i );
+    }
+    _valid = true;
+}
+
+/// finds first best matching item, like scanning whole list for each face
+void LVFontCache::findBestMatch( LVPtrVector< LVFontCacheItem > & list, LVFontTypefaceIndex & index, lString8Collection & faces,
+    LVFontDef & def, int & best_index, int & best_match )
+{
+    best_index = -1;
+    best_match = -1;
+    index.update( list );
+    // items of requested faces always score higher than items of other faces, unless they are fonts of other document
+    for ( int nindex=0; nindex==0 || nindex<faces.length(); nindex++ ) {
+        def.setTypeFace( nindex<faces.length() ? faces[nindex] : lString8::empty_str );
+        for ( int i=index.first( def.getTypeFace() ); i>=0; i=index.next( i ) ) {
+            int match = list[i]->_def.CalcMatch( def );
+            if ( match > best_match ) {
+                best_match = match;
+                best_index = i;
+            }
+        }
+    }
+    if ( best_match > 0 )
+        return;
+    // no face found: match of other items doesn't depend on requested face
+    best_index = -1;
+    best_match = -1;
+    def.setTypeFace( faces.length() ? faces[0] : lString8::empty_str );
+    for ( int i=0; i<list.length(); i++ ) {
+        int match = list[i]->_def.CalcMatch( def );
+        if ( match > best_match ) {
+            best_match = match;
+            best_index = i;
+        }
+    }
+}
+
 LVFontCacheItem * LVFontCache::find( const LVFontDef * fntdef )
 {
+    lString8 key = fntdef->getMatchKey();
+    LVFontCacheItem * res = NULL;
+    if ( _find_memo.get( key, res ) )
+        return res;
     int best_index = -1;
     int best_match = -1;
     int best_instance_index = -1;
     int best_instance_match = -1;
-    int i;
     LVFontDef def(*fntdef);
     lString8Collection list;
     splitPropertyValueList( fntdef->getTypeFace().c_str(), list );
-    for (int nindex=0; nindex==0 || nindex<list.length(); nindex++)
-    {
-        if ( nindex<list.length() )
-            def.setTypeFace( list[nindex] );
-        else
-            def.setTypeFace(lString8::empty_str);
-        for (i=0; i<_instance_list.length(); i++)
-        {
-            int match = _instance_list[i]->_def.CalcMatch( def );
-            if (match > best_instance_match)
-            {
-                best_instance_match = match;
-                best_instance_index = i;
-            }
-        }
-        for (i=0; i<_registered_list.length(); i++)
-        {
-            int match = _registered_list[i]->_def.CalcMatch( def );
-            if (match > best_match)
-            {
-                best_match = match;
-                best_index = i;
-            }
-        }
-    }
+    findBestMatch( _instance_list, _instance_index, list, def, best_instance_index, best_instance_match );
+    findBestMatch( _registered_list, _registered_index, list, def, best_index, best_match );
     if (best_index<0)
         return NULL;
     if (best_instance_match >= best_match)
-        return _instance_list[best_instance_index];
-    return _registered_list[best_index];
+        res = _instance_list[best_instance_index];
+    else
+        res = _registered_list[best_index];
+    if ( _find_memo.length() >= FONT_CACHE_FIND_MEMO_SIZE )
+        _find_memo.clear();
+    _find_memo.set( key, res );
+    return res;
 }
 
 void LVFontCache::addInstance( const LVFontDef * def, LVFontRef ref )
@@ -3862,6 +3935,7 @@ void LVFontCache::addInstance( const LVFontDef * def, LVFontRef ref )
     LVFontCacheItem * item = new LVFontCacheItem(*def);
     item->_fnt = ref;
     _instance_list.add( item );
+    changed();
 }
 
 void LVFontCache::removefont(const LVFontDef * def)
@@ -3882,6 +3956,7 @@ void LVFontCache::removefont(const LVFontDef * def)
                 _registered_list.remove(i);
             }
         }
+        changed();
 
 }
 void LVFontCache::update( const LVFontDef * def, LVFontRef ref )
@@ -3895,6 +3970,7 @@ void LVFontCache::update( const LVFontDef * def, LVFontRef ref )
                 if (ref.isNull())
                 {
                     _instance_list.erase(i, 1);
+                    changed();
                 }
                 else
                 {
@@ -3919,6 +3995,7 @@ void LVFontCache::update( const LVFontDef * def, LVFontRef ref )
         LVFontCacheItem * item;
         item = new LVFontCacheItem(*def);
         _registered_list.add( item );
+        changed();
     }
 }
 
@@ -3933,6 +4010,7 @@ void LVFontCache::removeDocumentFonts(int documentId)
         if (_registered_list[i]->_def.getDocumentId() == documentId)
             delete _registered_list.remove(i);
     }
+    changed();
 }
 
 // garbage collector
@@ -3952,6 +4030,8 @@ void LVFontCache::gc()
             usedCount++;
         }
     }
+    if ( droppedCount )
+        changed();
     if ( CRLog::isDebugEnabled() )
         CRLog::debug("LVFontCache::gc() : %d fonts still used, %d fonts dropped", usedCount, droppedCount );
 }
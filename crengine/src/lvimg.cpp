@@ -769,12 +769,25 @@ public:
                  */
                 cinfo.out_color_space = JCS_RGB;
 
+                // decode at reduced size in DCT domain if image is going to be drawn smaller
+                int targetDx = 0;
+                int targetDy = 0;
+                if ( callback->GetTargetSize( this, targetDx, targetDy ) && targetDx>0 && targetDy>0 ) {
+                    int denom = 8;
+                    while ( denom>1 && ((_width + denom - 1) / denom < targetDx || (_height + denom - 1) / denom < targetDy) )
+                        denom >>= 1;
+                    cinfo.scale_num = 1;
+                    cinfo.scale_denom = denom;
+                }
+
                 /* Step 5: Start decompressor */
 
                 (void) jpeg_start_decompress(&cinfo);
                 /* We can ignore the return value since suspension is not possible
                  * with the stdio data source.
                  */
+                if ( (int)cinfo.output_width != _width || (int)cinfo.output_height != _height )
+                    callback->OnDecodedSizeReduced( this, cinfo.output_width, cinfo.output_height );
                 buffer = new lUInt8 [ cinfo.output_width * cinfo.output_components ];
                 row = new lUInt32 [ cinfo.output_width ];
                 /* Step 6: while (scan lines remain to be read) */
@@ -2245,6 +2258,421 @@ LVImageSourceRef LVCreateDrawBufImageSource( LVColorDrawBuf * buf, bool own )
     return LVImageSourceRef( new LVDrawBufImgSource( buf, own ) );
 }
 
+/// decodes image into 32 bpp pixel buffer, scaled to specified size the same way as drawing does
+/**
+    Touches only passed image source and plain memory, so image source which is not
+    used by other threads meanwhile can be decoded on background thread.
+*/
+class LVImageScaler : public LVImageDecoderCallback
+{
+    lUInt32 * _data;
+    int _dx;
+    int _dy;
+    int _srcdx;
+    int _srcdy;
+    int * _xmap;
+public:
+    LVImageScaler( lUInt32 * data, int dx, int dy )
+        : _data(data), _dx(dx), _dy(dy), _srcdx(0), _srcdy(0), _xmap(NULL)
+    {
+    }
+    /// decodes image to buffer, returns false on error
+    bool decode( LVImageSource * src )
+    {
+        _srcdx = src->GetWidth();
+        _srcdy = src->GetHeight();
+        if ( _srcdx<=0 || _srcdy<=0 )
+            return false;
+        // lines not decoded stay transparent
+        for ( int i=_dx*_dy-1; i>=0; i-- )
+            _data[i] = 0xFF000000;
+        _xmap = new int[ _dx ];
+        for ( int x=0; x<_dx; x++ )
+            _xmap[x] = x * _srcdx / _dx;
+        bool res = src->Decode( this );
+        delete[] _xmap;
+        _xmap = NULL;
+        return res;
+    }
+    virtual void OnStartDecode( LVImageSource * )
+    {
+    }
+    virtual bool GetTargetSize( LVImageSource *, int & dx, int & dy )
+    {
+        dx = _dx;
+        dy = _dy;
+        return true;
+    }
+    virtual void OnDecodedSizeReduced( LVImageSource *, int dx, int dy )
+    {
+        _srcdx = dx;
+        _srcdy = dy;
+        for ( int x=0; x<_dx; x++ )
+            _xmap[x] = x * _srcdx / _dx;
+    }
+    virtual bool OnLineDecoded( LVImageSource *, int y, lUInt32 * data )
+    {
+        if ( y<0 || y>=_srcdy )
+            return true;
+        // destination lines yy with yy * _srcdy / _dy == y
+        int yy = (y * _dy + _srcdy - 1) / _srcdy;
+        for ( ; yy<_dy && yy * _srcdy / _dy == y; yy++ ) {
+            lUInt32 * row = _data + yy * _dx;
+            for ( int x=0; x<_dx; x++ )
+                row[x] = data[ _xmap[x] ];
+        }
+        return true;
+    }
+    virtual void OnEndDecode( LVImageSource *, bool )
+    {
+        // some decoders report errors here even on success, rely on Decode() result only
+    }
+};
+
+/// decoded image pixels, shared by decoded image cache and image sources drawing them
+struct LVDecodedImageData
+{
+    lUInt32 * pixels;
+    int dx;
+    int dy;
+    int refCount; // changed only under IMAGE_CACHE_GUARD
+};
+
+/// decodes image scaled to dx*dy, returns NULL on error; result has refCount==1
+static LVDecodedImageData * decodeScaledImage( LVImageSource * src, int dx, int dy )
+{
+    lUInt32 * pixels = (lUInt32*)malloc( dx * dy * sizeof(lUInt32) );
+    if ( !pixels )
+        return NULL;
+    LVImageScaler scaler( pixels, dx, dy );
+    if ( !scaler.decode( src ) ) {
+        free( pixels );
+        return NULL;
+    }
+    LVDecodedImageData * data = new LVDecodedImageData();
+    data->pixels = pixels;
+    data->dx = dx;
+    data->dy = dy;
+    data->refCount = 1;
+    return data;
+}
+
+/// decrements reference counter of decoded image, frees it when not used; call under IMAGE_CACHE_GUARD
+static void releaseDecodedImage( LVDecodedImageData * data )
+{
+    if ( --data->refCount == 0 ) {
+        free( data->pixels );
+        delete data;
+    }
+}
+
+/// image source drawing decoded image pixels
+class LVDecodedImgSource : public LVImageSource
+{
+    LVDecodedImageData * _data;
+public:
+    /// takes reference to data acquired by caller
+    LVDecodedImgSource( LVDecodedImageData * data ) : _data(data) { }
+    virtual ~LVDecodedImgSource()
+    {
+        IMAGE_CACHE_GUARD
+        releaseDecodedImage( _data );
+    }
+    virtual ldomNode * GetSourceNode() { return NULL; }
+    virtual LVStream * GetSourceStream() { return NULL; }
+    virtual void   Compact() { }
+    virtual int    GetWidth() { return _data->dx; }
+    virtual int    GetHeight() { return _data->dy; }
+    virtual bool   Decode( LVImageDecoderCallback * callback )
+    {
+        callback->OnStartDecode( this );
+        for ( int y=0; y<_data->dy; y++ )
+            callback->OnLineDecoded( this, y, _data->pixels + y * _data->dx );
+        callback->OnEndDecode( this, false );
+        return true;
+    }
+};
+
+/// creates decoded 32 bpp memory copy of image, scaled to specified size the same way as drawing does
+LVImageSourceRef LVCreateScaledImageSource( LVImageSourceRef srcImage, int dx, int dy )
+{
+    if ( srcImage.isNull() || dx<=0 || dy<=0 )
+        return LVImageSourceRef();
+    LVDecodedImageData * data = decodeScaledImage( srcImage.get(), dx, dy );
+    if ( !data )
+        return LVImageSourceRef();
+    return LVImageSourceRef( new LVDecodedImgSource( data ) );
+}
+
+/// key of decoded image cache item
+struct LVDecodedImageKey
+{
+    int docIndex;
+    lUInt32 imageId;
+    int dx;
+    int dy;
+    LVDecodedImageKey() : docIndex(0), imageId(0), dx(0), dy(0) { }
+    LVDecodedImageKey( int doc, lUInt32 image, int w, int h ) : docIndex(doc), imageId(image), dx(w), dy(h) { }
+    bool operator == ( const LVDecodedImageKey & v ) const
+    {
+        return docIndex==v.docIndex && imageId==v.imageId && dx==v.dx && dy==v.dy;
+    }
+};
+
+inline lUInt32 getHash( const LVDecodedImageKey & key )
+{
+    return ((((lUInt32)key.docIndex * 31) + key.imageId) * 31 + (lUInt32)key.dx) * 31 + (lUInt32)key.dy;
+}
+
+/// LRU list of decoded images; all methods should be called under IMAGE_CACHE_GUARD
+class LVDecodedImageCacheImpl
+{
+    struct Item {
+        LVDecodedImageKey key;
+        LVDecodedImageData * data;
+        int size;
+        Item * prev; // more recently used
+        Item * next; // less recently used
+    };
+    LVHashTable<LVDecodedImageKey, Item*> _map;
+    Item * _head;
+    Item * _tail;
+    int _size;
+    int _maxSize;
+    int _hits;
+    int _misses;
+
+    void unlink( Item * item )
+    {
+        if ( item->prev )
+            item->prev->next = item->next;
+        else
+            _head = item->next;
+        if ( item->next )
+            item->next->prev = item->prev;
+        else
+            _tail = item->prev;
+        item->prev = item->next = NULL;
+    }
+    void linkFirst( Item * item )
+    {
+        item->prev = NULL;
+        item->next = _head;
+        if ( _head )
+            _head->prev = item;
+        _head = item;
+        if ( !_tail )
+            _tail = item;
+    }
+    void remove( Item * item )
+    {
+        unlink( item );
+        _map.remove( item->key );
+        _size -= item->size;
+        releaseDecodedImage( item->data );
+        delete item;
+    }
+    void reduceSize( int maxSize )
+    {
+        while ( _tail && _size > maxSize )
+            remove( _tail );
+    }
+public:
+    LVDecodedImageCacheImpl()
+        : _map(256), _head(NULL), _tail(NULL), _size(0), _maxSize(DECODED_IMAGE_CACHE_MAX_SIZE), _hits(0), _misses(0)
+    {
+    }
+    ~LVDecodedImageCacheImpl()
+    {
+        clear();
+    }
+    /// returns true if image is cached, doesn't change LRU order and statistics
+    bool contains( const LVDecodedImageKey & key )
+    {
+        Item * item = NULL;
+        return _map.get( key, item );
+    }
+    /// returns cached image with reference added for caller, NULL if not found
+    LVDecodedImageData * find( const LVDecodedImageKey & key, bool countMiss )
+    {
+        Item * item = NULL;
+        if ( !_map.get( key, item ) ) {
+            if ( countMiss )
+                _misses++;
+            return NULL;
+        }
+        _hits++;
+        unlink( item );
+        linkFirst( item );
+        item->data->refCount++;
+        return item->data;
+    }
+    /// adds image taking caller's reference to data; returns cached image with reference added for caller
+    LVDecodedImageData * add( const LVDecodedImageKey & key, LVDecodedImageData * data )
+    {
+        Item * item = NULL;
+        if ( _map.get( key, item ) ) {
+            // added by another thread while decoding
+            releaseDecodedImage( data );
+            unlink( item );
+            linkFirst( item );
+            item->data->refCount++;
+            return item->data;
+        }
+        int size = data->dx * data->dy * sizeof(lUInt32);
+        reduceSize( _maxSize - size );
+        item = new Item();
+        item->key = key;
+        item->data = data;
+        item->size = size;
+        linkFirst( item );
+        _map.set( key, item );
+        _size += size;
+        data->refCount++;
+        return data;
+    }
+    /// returns true if image of this size may be cached: single image doesn't take more than quarter of cache
+    bool accepts( int dx, int dy )
+    {
+        return dx * dy * (int)sizeof(lUInt32) <= _maxSize / 4;
+    }
+    void removeDocument( int docIndex )
+    {
+        if ( _hits || _misses )
+            CRLog::debug("Decoded image cache: %d items, %d bytes, %d hits, %d misses", _map.length(), _size, _hits, _misses);
+        for ( Item * item = _head; item; ) {
+            Item * next = item->next;
+            if ( item->key.docIndex == docIndex )
+                remove( item );
+            item = next;
+        }
+    }
+    void clear()
+    {
+        reduceSize( -1 );
+    }
+    void setMaxSize( int maxSize )
+    {
+        _maxSize = maxSize;
+        reduceSize( _maxSize );
+    }
+    int getMaxSize() { return _maxSize; }
+    void getStats( int & hits, int & misses, int & itemCount, int & size )
+    {
+        hits = _hits;
+        misses = _misses;
+        itemCount = _map.length();
+        size = _size;
+    }
+};
+
+static LVDecodedImageCacheImpl * getDecodedImageCache()
+{
+    static LVDecodedImageCacheImpl * instance = NULL;
+    if ( !instance )
+        instance = new LVDecodedImageCacheImpl();
+    return instance;
+}
+
+/// returns cached image for document image node and size, NULL if not found
+LVImageSourceRef LVDecodedImageCache::find( int docIndex, lUInt32 imageId, int dx, int dy )
+{
+    LVDecodedImageData * data = NULL;
+    {
+        IMAGE_CACHE_GUARD
+        data = getDecodedImageCache()->find( LVDecodedImageKey(docIndex, imageId, dx, dy), false );
+    }
+    if ( !data )
+        return LVImageSourceRef();
+    return LVImageSourceRef( new LVDecodedImgSource( data ) );
+}
+
+/// returns true if image for document image node and size is cached
+bool LVDecodedImageCache::contains( int docIndex, lUInt32 imageId, int dx, int dy )
+{
+    IMAGE_CACHE_GUARD
+    return getDecodedImageCache()->contains( LVDecodedImageKey(docIndex, imageId, dx, dy) );
+}
+
+/// returns cached image, decodes and caches source image if not found; returns source image if it cannot be cached
+LVImageSourceRef LVDecodedImageCache::get( int docIndex, lUInt32 imageId, LVImageSourceRef srcImage, int dx, int dy )
+{
+    if ( srcImage.isNull() || dx<=0 || dy<=0 || srcImage->GetNinePatchInfo() )
+        return srcImage;
+    LVDecodedImageKey key( docIndex, imageId, dx, dy );
+    LVDecodedImageData * data = NULL;
+    {
+        IMAGE_CACHE_GUARD
+        LVDecodedImageCacheImpl * cache = getDecodedImageCache();
+        data = cache->find( key, true );
+        if ( !data && !cache->accepts( dx, dy ) )
+            return srcImage;
+    }
+    if ( !data ) {
+        // decode without holding the lock
+        data = decodeScaledImage( srcImage.get(), dx, dy );
+        if ( !data )
+            return srcImage;
+        IMAGE_CACHE_GUARD
+        data = getDecodedImageCache()->add( key, data );
+    }
+    return LVImageSourceRef( new LVDecodedImgSource( data ) );
+}
+
+/// decodes image scaled to dx*dy and adds it to cache unless already cached; doesn't copy image references, so may be called on background thread
+bool LVDecodedImageCache::add( int docIndex, lUInt32 imageId, LVImageSource * srcImage, int dx, int dy )
+{
+    if ( !srcImage || dx<=0 || dy<=0 || srcImage->GetNinePatchInfo() )
+        return false;
+    LVDecodedImageKey key( docIndex, imageId, dx, dy );
+    {
+        IMAGE_CACHE_GUARD
+        LVDecodedImageCacheImpl * cache = getDecodedImageCache();
+        if ( cache->contains( key ) || !cache->accepts( dx, dy ) )
+            return false;
+    }
+    LVDecodedImageData * data = decodeScaledImage( srcImage, dx, dy );
+    if ( !data )
+        return false;
+    IMAGE_CACHE_GUARD
+    releaseDecodedImage( getDecodedImageCache()->add( key, data ) );
+    return true;
+}
+
+/// removes all cached images of document
+void LVDecodedImageCache::removeDocument( int docIndex )
+{
+    IMAGE_CACHE_GUARD
+    getDecodedImageCache()->removeDocument( docIndex );
+}
+
+/// removes all cached images
+void LVDecodedImageCache::clear()
+{
+    IMAGE_CACHE_GUARD
+    getDecodedImageCache()->clear();
+}
+
+/// sets byte budget of cache, 0 to disable caching
+void LVDecodedImageCache::setMaxSize( int maxSize )
+{
+    IMAGE_CACHE_GUARD
+    getDecodedImageCache()->setMaxSize( maxSize );
+}
+
+/// returns byte budget of cache
+int LVDecodedImageCache::getMaxSize()
+{
+    IMAGE_CACHE_GUARD
+    return getDecodedImageCache()->getMaxSize();
+}
+
+/// returns cache statistics
+void LVDecodedImageCache::getStats( int & hits, int & misses, int & itemCount, int & size )
+{
+    IMAGE_CACHE_GUARD
+    getDecodedImageCache()->getStats( hits, misses, itemCount, size );
+}
 
 /// draws battery icon in specified rectangle of draw buffer; if font is specified, draws charge %
 // first icon is for charging, the rest - indicate progress icon[1] is lowest level, icon[n-1] is full power
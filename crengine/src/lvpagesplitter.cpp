@@ -40,7 +40,7 @@ int LVRendPageList::FindNearestPage( int y, int direction )
 }
 
 LVRendPageContext::LVRendPageContext(LVRendPageList * pageList, int pageHeight)
-    : callback(NULL), totalFinalBlocks(0)
+    : splitState(NULL), callback(NULL), totalFinalBlocks(0)
     , renderedFinalBlocks(0), lastPercent(-1), page_list(pageList), page_h(pageHeight), footNotes(64), curr_note(NULL)
 {
     if ( callback ) {
@@ -99,13 +99,19 @@ void LVRendPageContext::leaveFootNote()
     //CRLog::trace("leaveFootNote()" );
     if ( !curr_note ) {
         CRLog::error("leaveFootNote() w/o current note set");
+    } else {
+        curr_note->setComplete();
     }
     curr_note = NULL;
+    // lines with links to this note may be waiting
+    split( false );
 }
 
 
 void LVRendPageContext::AddLine( int starty, int endy, int flags )
 {
+    if ( !page_list )
+        return;
     if ( curr_note!=NULL )
         flags |= RN_SPLIT_FOOT_NOTE;
     LVRendLineInfo * line = new LVRendLineInfo(starty, endy, flags);
@@ -114,6 +120,7 @@ void LVRendPageContext::AddLine( int starty, int endy, int flags )
         //CRLog::trace("adding line to note (%d)", line->start);
         curr_note->addLine( line );
     }
+    split( false );
 }
 
 #define FOOTNOTE_MARGIN 12
@@ -265,6 +272,12 @@ public:
         }
         last = line;
     }
+    /// returns true if line is referenced by split state
+    bool isUsed( const LVRendLineInfo * line ) const
+    {
+        return line==pagestart || line==pageend || line==next || line==last
+            || line==footstart || line==footend || line==footlast;
+    }
     void Finalize()
     {
         if (last==NULL)
@@ -358,18 +371,38 @@ public:
     }
 };
 
-void LVRendPageContext::split()
+LVRendPageContext::~LVRendPageContext()
+{
+    delete splitState;
+}
+
+/// returns true if line may be passed to splitter: footnotes it refers to won't get more lines
+static bool isFootNoteLinksComplete( LVRendLineInfo * line )
+{
+    LVFootNoteList * links = line->getLinks();
+    if ( !links )
+        return true;
+    for ( int j=0; j<links->length(); j++ )
+        if ( !links->get(j)->isComplete() )
+            return false;
+    return true;
+}
+
+void LVRendPageContext::split( bool finalize )
 {
     if ( !page_list )
         return;
-    PageSplitState s(page_list, page_h);
+    if ( !splitState )
+        splitState = new PageSplitState(page_list, page_h);
+    PageSplitState & s = *splitState;
 
     int lineCount = lines.length();
-
-
-    LVRendLineInfo * line = NULL;
-    for ( int lindex=0; lindex<lineCount; lindex++ ) {
-        line = lines[lindex];
+    int lindex = 0;
+    for ( ; lindex<lineCount; lindex++ ) {
+        LVRendLineInfo * line = lines[lindex];
+        // links are appended to last added line, and footnote height decides where page with link ends
+        if ( !finalize && (lindex==lineCount-1 || !isFootNoteLinksComplete( line )) )
+            break;
         s.AddLine( line );
         // add footnotes for line, if any...
         if ( line->getLinks() ) {
@@ -393,14 +426,45 @@ void LVRendPageContext::split()
             if ( !foundFootNote )
                 line->flags = line->flags & ~RN_SPLIT_FOOT_LINK;
         }
+        // move line out of pending list
+        if ( line->flags & RN_SPLIT_FOOT_NOTE )
+            noteLines.add( line );
+        else
+            splitLines.add( line );
+        lines[lindex] = NULL;
+    }
+    if ( lindex>0 ) {
+        lines.erase( 0, lindex );
+        if ( splitLines.length()>=PAGE_SPLIT_RELEASE_LINES )
+            releaseSplitLines();
     }
-    s.Finalize();
+}
+
+void LVRendPageContext::releaseSplitLines()
+{
+    int count = 0;
+    for ( int i=0; i<splitLines.length(); i++ ) {
+        LVRendLineInfo * line = splitLines[i];
+        splitLines[i] = NULL;
+        if ( splitState->isUsed( line ) )
+            splitLines[count++] = line;
+        else
+            delete line;
+    }
+    splitLines.erase( count, splitLines.length() - count );
 }
 
 void LVRendPageContext::Finalize()
 {
-    split();
+    split( true );
+    if ( splitState ) {
+        splitState->Finalize();
+        delete splitState;
+        splitState = NULL;
+    }
     lines.clear();
+    splitLines.clear();
+    noteLines.clear();
     footNotes.clear();
 }
 
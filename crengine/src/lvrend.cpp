@@ -452,6 +452,20 @@ public:
             nrow->index = i;
             rows.insert(i, nrow);
         }
+        // text length of cells is measured once per document
+        int cellCount = 0;
+        for (i=0; i<rows.length(); i++)
+            cellCount += rows[i]->cells.length();
+        ldomDocument * doc = elem->getDocument();
+        LVArray<lInt32> * cellTextLengths = doc->getTableCellTextLengths( elem );
+        if ( cellTextLengths && cellTextLengths->length()!=cellCount )
+            cellTextLengths = NULL;
+        LVArray<lInt32> * measured = NULL;
+        if ( !cellTextLengths ) {
+            measured = new LVArray<lInt32>( cellCount, 0 );
+            cellTextLengths = measured;
+        }
+        int cellIndex = 0;
         // init CELLS matrix
         cells.SetSize( rows.length(), cols.length(), NULL );
         for (i=0; i<rows.length(); i++) {
@@ -467,8 +481,9 @@ public:
                 }
 
                 // calc cell text size
-                lString16 txt = (cell->elem)->getText();
-                int txtlen = txt.length();
+                if ( measured )
+                    (*measured)[cellIndex] = cell->elem->getTextLength();
+                int txtlen = (*cellTextLengths)[cellIndex++];
                 txtlen = (txtlen+(cell->colspan-1))/(cell->colspan + 1);
                 for (int x=0; x<cell->colspan; x++) {
                     if ( txtlen > cols[x0+x]->txtlen )
@@ -476,6 +491,8 @@ public:
                 }
             }
         }
+        if ( measured )
+            doc->setTableCellTextLengths( elem, measured );
         int npercent=0;
         int sumpercent=0;
         int nwidth = 0;
@@ -1214,8 +1231,8 @@ void renderFinalBlock( ldomNode * enode, LFormattedText * txform, RenderRectAcce
     }
     else if ( enode->isText() )
     {
-        // text nodes
-        lString16 txt = enode->getText();
+        // text nodes: utf-8 text is decoded directly to formatter buffer
+        ldomTextRef txt( enode );
         if ( !txt.empty() )
         {
 
@@ -1269,18 +1286,21 @@ void renderFinalBlock( ldomNode * enode, LFormattedText * txform, RenderRectAcce
             }
             */
             //int offs = 0;
+            const lChar8 * text = txt.text();
+            int textLen = txt.length();
             if ( txform->GetSrcCount()==0 && style->white_space!=css_ws_pre ) {
                 // clear leading spaces for first text of paragraph
                 int i=0;
-                for ( ;txt.length()>i && (txt[i]==' ' || txt[i]=='\t'); i++ )
+                for ( ;textLen>i && (text[i]==' ' || text[i]=='\t'); i++ )
                     ;
                 if ( i>0 ) {
-                    txt.erase(0, i);
+                    text += i;
+                    textLen -= i;
                     //offs = i;
                 }
             }
-            if ( txt.length()>0 )
-                txform->AddSourceLine( txt.c_str(), txt.length(), cl, bgcl, font, baseflags | tflags,
+            if ( textLen>0 )
+                txform->AddSourceLineUtf8( text, textLen, cl, bgcl, font, baseflags | tflags,
                     line_h, ident, enode, 0, letter_spacing );
             baseflags &= ~LTEXT_FLAG_NEWLINE; // clear newline flag
         }
@@ -1579,10 +1599,31 @@ int renderBlockElement( LVRendPageContext & context, ldomNode * enode, int x, in
                 int break_before = CssPageBreak2Flags( before );
                 int break_after = CssPageBreak2Flags( after );
                 int break_inside = CssPageBreak2Flags( inside );
+                // remember sparse block positions for reading node data of page ahead
+                ldomNode * text = enode;
+                while ( text->isElement() && text->getChildCount() )
+                    text = text->getChildNode( 0 );
+                if ( text->isText() )
+                    enode->getDocument()->getRenderPositions().addBlock( rect.top, enode->getDataIndex(), text->getDataIndex() );
+                bool hasObjects = false;
+                for ( int i=0; i<txform->GetSrcCount() && !hasObjects; i++ )
+                    hasObjects = (txform->GetSrcInfo(i)->flags & LTEXT_SRC_IS_OBJECT) != 0;
                 int count = txform->GetLineCount();
                 for (int i=0; i<count; i++)
                 {
                     const formatted_line_t * line = txform->GetLineInfo(i);
+                    if ( hasObjects ) {
+                        // remember images of page for prefetching
+                        for ( int w=0; w<(int)line->word_count; w++ ) {
+                            const formatted_word_t * word = &line->words[w];
+                            if ( !(word->flags & LTEXT_WORD_IS_OBJECT) )
+                                continue;
+                            ldomNode * node = (ldomNode*)txform->GetSrcInfo( word->src_text_index )->object;
+                            if ( node )
+                                enode->getDocument()->getRenderPositions().addImage( rect.top+line->y+padding_top,
+                                        node->getDataIndex(), word->width, word->o.height );
+                        }
+                    }
                     int line_flags = 0; //TODO
                     if (i==0)
                         line_flags |= break_before << RN_SPLIT_BEFORE;
@@ -1813,6 +1854,24 @@ inline void spreadParent( css_length_t & val, css_length_t & parent_val, bool in
 void setNodeStyle( ldomNode * enode, css_style_ref_t parent_style, LVFontRef parent_font )
 {
     CR_UNUSED(parent_font);
+    ldomDocument * doc = enode->getDocument();
+    int baseFontSize = doc->getDefaultFont()->getSize();
+
+    // reuse style computed for element with the same parent style, name and attributes, if possible
+    ldomStyleMemo & memo = doc->getStyleMemo();
+    ldomStyleMemo::Key memoKey;
+    bool memoize = !enode->isRoot() && doc->getStyleSheet()->isContextFree( enode->getNodeId() );
+    if ( memoize ) {
+        memo.validate( doc->getStyleSheet()->getGeneration(), baseFontSize, doc->getDocFlag(DOC_FLAG_ENABLE_INTERNAL_STYLES) );
+        memoKey.init( enode, parent_style );
+        css_style_ref_t memoStyle;
+        if ( memo.find( memoKey, memoStyle ) ) {
+            enode->setStyle( memoStyle );
+            enode->initNodeFont();
+            return;
+        }
+    }
+
     //lvdomElementFormatRec * fmt = node->getRenderData();
     css_style_ref_t style( new css_style_rec_t );
     css_style_rec_t * pstyle = style.get();
@@ -1829,8 +1888,6 @@ void setNodeStyle( ldomNode * enode, css_style_ref_t parent_style, LVFontRef par
         pstyle->white_space = type_ptr->white_space;
     }
 
-    int baseFontSize = enode->getDocument()->getDefaultFont()->getSize();
-
     //////////////////////////////////////////////////////
     // apply style sheet
     //////////////////////////////////////////////////////
@@ -1989,6 +2046,8 @@ void setNodeStyle( ldomNode * enode, css_style_ref_t parent_style, LVFontRef par
         CRLog::error("NULL style set!!!");
         enode->setStyle( style );
     }
+    if ( memoize )
+        memo.add( memoKey, style );
 
     // set font
     enode->initNodeFont();
@@ -30,6 +30,14 @@
 #include <zlib.h>
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LSTR_USE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LSTR_USE_NEON 1
+#endif
+
 #if !defined(__SYMBIAN32__) && defined(_WIN32)
 extern "C" {
 #include <windows.h>
@@ -163,10 +171,10 @@ struct lstring_chunk_slice_t {
         pFree = pChunks;
         for (lstring8_chunk_t * p = pChunks; p<pEnd; ++p)
         {
-            p->buf8 = (char*)(p+1);
-            p->size = 0;
+            p->heap.buf = (char*)(p+1);
+            p->heap.size = 0;
         }
-        (pEnd-1)->buf8 = NULL;
+        (pEnd-1)->heap.buf = NULL;
     }
     ~lstring_chunk_slice_t()
     {
@@ -175,13 +183,13 @@ struct lstring_chunk_slice_t {
     inline lstring8_chunk_t * alloc_chunk()
     {
         lstring8_chunk_t * res = pFree;
-        pFree = (lstring8_chunk_t *)res->buf8;
+        pFree = (lstring8_chunk_t *)res->heap.buf;
         return res;
     }
     inline lstring16_chunk_t * alloc_chunk16()
     {
         lstring16_chunk_t * res = (lstring16_chunk_t *)pFree;
-        pFree = (lstring8_chunk_t *)res->buf16;
+        pFree = (lstring8_chunk_t *)res->heap.buf;
         return res;
     }
     inline bool free_chunk( lstring8_chunk_t * pChunk )
@@ -190,14 +198,14 @@ struct lstring_chunk_slice_t {
             return false; // chunk does not belong to this slice
 /*
 #ifdef LS_DEBUG_CHECK
-        if (!pChunk->size)
+        if (!pChunk->heap.size)
         {
             crFatalError(); // already freed!!!
         }
-        pChunk->size = 0;
+        pChunk->heap.size = 0;
 #endif
 */
-        pChunk->buf8 = (char *)pFree;
+        pChunk->heap.buf = (char *)pFree;
         pFree = pChunk;
         return true;
     }
@@ -207,19 +215,88 @@ struct lstring_chunk_slice_t {
             return false; // chunk does not belong to this slice
 /*
 #ifdef LS_DEBUG_CHECK
-        if (!pChunk->size)
+        if (!pChunk->heap.size)
         {
             crFatalError(); // already freed!!!
         }
-        pChunk->size = 0;
+        pChunk->heap.size = 0;
 #endif
 */
-        pChunk->buf16 = (lChar16 *)pFree;
+        pChunk->heap.buf = (lChar16 *)pFree;
         pFree = (lstring8_chunk_t *)pChunk;
         return true;
     }
 };
 
+// last char of inline buffer is heap buffer flag, it should not overlap heap buffer pointer and size
+typedef char lstring_inline_buf_size_check[ sizeof(void*) + sizeof(lInt32) + sizeof(lChar16) <= LSTRING_INLINE_BUF_SIZE ? 1 : -1 ];
+
+void lstring8_chunk_t::allocBuf( int sz )
+{
+    if ( sz < INLINE_SIZE )
+        inl8[INLINE_SIZE-1] = 0;
+    else
+        setHeapBuf( (lChar8*) ::malloc( sizeof(lChar8) * (sz+1) ), sz );
+}
+
+void lstring8_chunk_t::reallocBuf( int sz )
+{
+    if ( isInline() ) {
+        if ( sz < INLINE_SIZE )
+            return;
+        lChar8 * buf = (lChar8*) ::malloc( sizeof(lChar8) * (sz+1) );
+        memcpy( buf, inl8, sizeof(lChar8) * INLINE_SIZE );
+        setHeapBuf( buf, sz );
+    } else if ( sz < INLINE_SIZE ) {
+        // shrinking: heap buffer is always larger than inline one
+        lChar8 * buf = heap.buf;
+        memcpy( inl8, buf, sizeof(lChar8) * (sz+1) );
+        inl8[INLINE_SIZE-1] = 0;
+        ::free( buf );
+    } else {
+        setHeapBuf( (lChar8*) ::realloc( heap.buf, sizeof(lChar8) * (sz+1) ), sz );
+    }
+}
+
+void lstring8_chunk_t::freeBuf()
+{
+    if ( !isInline() )
+        ::free( heap.buf );
+}
+
+void lstring16_chunk_t::allocBuf( int sz )
+{
+    if ( sz < INLINE_SIZE )
+        inl16[INLINE_SIZE-1] = 0;
+    else
+        setHeapBuf( (lChar16*) ::malloc( sizeof(lChar16) * (sz+1) ), sz );
+}
+
+void lstring16_chunk_t::reallocBuf( int sz )
+{
+    if ( isInline() ) {
+        if ( sz < INLINE_SIZE )
+            return;
+        lChar16 * buf = (lChar16*) ::malloc( sizeof(lChar16) * (sz+1) );
+        memcpy( buf, inl16, sizeof(lChar16) * INLINE_SIZE );
+        setHeapBuf( buf, sz );
+    } else if ( sz < INLINE_SIZE ) {
+        // shrinking: heap buffer is always larger than inline one
+        lChar16 * buf = heap.buf;
+        memcpy( inl16, buf, sizeof(lChar16) * (sz+1) );
+        inl16[INLINE_SIZE-1] = 0;
+        ::free( buf );
+    } else {
+        setHeapBuf( (lChar16*) ::realloc( heap.buf, sizeof(lChar16) * (sz+1) ), sz );
+    }
+}
+
+void lstring16_chunk_t::freeBuf()
+{
+    if ( !isInline() )
+        ::free( heap.buf );
+}
+
 //#define FIRST_SLICE_SIZE 256
 //#define MAX_SLICE_COUNT  20
 #if (LDOM_USE_OWN_MEM_MAN == 1)
@@ -573,8 +650,8 @@ void lString16::free()
     if ( pchunk==EMPTY_STR_16 )
         return;
     CHECK_STARTUP_STAGE;
-    //assert(pchunk->buf16[pchunk->len]==0);
-    ::free(pchunk->buf16);
+    //assert(pchunk->buf16()[pchunk->len]==0);
+    pchunk->freeBuf();
 #if (LDOM_USE_OWN_MEM_MAN == 1)
     for (int i=slices_count-1; i>=0; --i)
     {
@@ -594,9 +671,8 @@ void lString16::alloc(int sz)
 #else
     pchunk = (lstring_chunk_t*)::malloc(sizeof(lstring_chunk_t));
 #endif
-    pchunk->buf16 = (lChar16*) ::malloc( sizeof(lChar16) * (sz+1) );
-    assert( pchunk->buf16!=NULL );
-    pchunk->size = sz;
+    pchunk->allocBuf( sz );
+    assert( pchunk->buf16()!=NULL );
     pchunk->nref = 1;
 }
 
@@ -612,7 +688,7 @@ lString16::lString16(const lChar16 * str)
     size_type len = _lStr_len(str);
     alloc( len );
     pchunk->len = len;
-    _lStr_cpy( pchunk->buf16, str );
+    _lStr_cpy( pchunk->buf16(), str );
 }
 
 lString16::lString16(const lChar8 * str)
@@ -656,7 +732,7 @@ lString16::lString16(const value_type * str, size_type count)
     {
         size_type len = _lStr_nlen(str, count);
         alloc(len);
-        _lStr_ncpy( pchunk->buf16, str, len );
+        _lStr_ncpy( pchunk->buf16(), str, len );
         pchunk->len = len;
     }
 }
@@ -673,8 +749,8 @@ lString16::lString16(const lString16 & str, size_type offset, size_type count)
     else
     {
         alloc(count);
-        _lStr_memcpy( pchunk->buf16, str.pchunk->buf16+offset, count );
-        pchunk->buf16[count]=0;
+        _lStr_memcpy( pchunk->buf16(), str.pchunk->buf16()+offset, count );
+        pchunk->buf16()[count]=0;
         pchunk->len = count;
     }
 }
@@ -690,11 +766,10 @@ lString16 & lString16::assign(const lChar16 * str)
         size_type len = _lStr_len(str);
         if (pchunk->nref==1)
         {
-            if (pchunk->size<=len)
+            if (pchunk->capacity()<len)
             {
                 // resize is necessary
-                pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(len+1) );
-                pchunk->size = len+1;
+                pchunk->reallocBuf( len );
             }
         }
         else
@@ -702,7 +777,7 @@ lString16 & lString16::assign(const lChar16 * str)
             release();
             alloc(len);
         }
-        _lStr_cpy( pchunk->buf16, str );
+        _lStr_cpy( pchunk->buf16(), str );
         pchunk->len = len;
     }
     return *this;
@@ -719,11 +794,10 @@ lString16 & lString16::assign(const lChar8 * str)
         size_type len = _lStr_len(str);
         if (pchunk->nref==1)
         {
-            if (pchunk->size<=len)
+            if (pchunk->capacity()<len)
             {
                 // resize is necessary
-                pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(len+1) );
-                pchunk->size = len+1;
+                pchunk->reallocBuf( len );
             }
         }
         else
@@ -731,7 +805,7 @@ lString16 & lString16::assign(const lChar8 * str)
             release();
             alloc(len);
         }
-        _lStr_cpy( pchunk->buf16, str );
+        _lStr_cpy( pchunk->buf16(), str );
         pchunk->len = len;
     }
     return *this;
@@ -748,11 +822,10 @@ lString16 & lString16::assign(const lChar16 * str, size_type count)
         size_type len = _lStr_nlen(str, count);
         if (pchunk->nref==1)
         {
-            if (pchunk->size<=len)
+            if (pchunk->capacity()<len)
             {
                 // resize is necessary
-                pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(len+1) );
-                pchunk->size = len+1;
+                pchunk->reallocBuf( len );
             }
         }
         else
@@ -760,7 +833,7 @@ lString16 & lString16::assign(const lChar16 * str, size_type count)
             release();
             alloc(len);
         }
-        _lStr_ncpy( pchunk->buf16, str, count );
+        _lStr_ncpy( pchunk->buf16(), str, count );
         pchunk->len = len;
     }
     return *this;
@@ -777,11 +850,10 @@ lString16 & lString16::assign(const lChar8 * str, size_type count)
         size_type len = _lStr_nlen(str, count);
         if (pchunk->nref==1)
         {
-            if (pchunk->size<=len)
+            if (pchunk->capacity()<len)
             {
                 // resize is necessary
-                pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(len+1) );
-                pchunk->size = len+1;
+                pchunk->reallocBuf( len );
             }
         }
         else
@@ -789,7 +861,7 @@ lString16 & lString16::assign(const lChar8 * str, size_type count)
             release();
             alloc(len);
         }
-        _lStr_ncpy( pchunk->buf16, str, count );
+        _lStr_ncpy( pchunk->buf16(), str, count );
         pchunk->len = len;
     }
     return *this;
@@ -814,19 +886,18 @@ lString16 & lString16::assign(const lString16 & str, size_type offset, size_type
             }
             if (offset>0)
             {
-                _lStr_memcpy( pchunk->buf16, str.pchunk->buf16+offset, count );
+                _lStr_memcpy( pchunk->buf16(), str.pchunk->buf16()+offset, count );
             }
-            pchunk->buf16[count]=0;
+            pchunk->buf16()[count]=0;
         }
         else
         {
             if (pchunk->nref==1)
             {
-                if (pchunk->size<=count)
+                if (pchunk->capacity()<count)
                 {
                     // resize is necessary
-                    pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(count+1) );
-                    pchunk->size = count+1;
+                    pchunk->reallocBuf( count );
                 }
             }
             else
@@ -834,8 +905,8 @@ lString16 & lString16::assign(const lString16 & str, size_type offset, size_type
                 release();
                 alloc(count);
             }
-            _lStr_memcpy( pchunk->buf16, str.pchunk->buf16+offset, count );
-            pchunk->buf16[count]=0;
+            _lStr_memcpy( pchunk->buf16(), str.pchunk->buf16()+offset, count );
+            pchunk->buf16()[count]=0;
         }
         pchunk->len = count;
     }
@@ -855,18 +926,18 @@ lString16 & lString16::erase(size_type offset, size_type count)
         size_type newlen = length()-count;
         if (pchunk->nref==1)
         {
-            _lStr_memcpy( pchunk->buf16+offset, pchunk->buf16+offset+count, newlen-offset+1 );
+            _lStr_memcpy( pchunk->buf16()+offset, pchunk->buf16()+offset+count, newlen-offset+1 );
         }
         else
         {
             lstring_chunk_t * poldchunk = pchunk;
             release();
             alloc( newlen );
-            _lStr_memcpy( pchunk->buf16, poldchunk->buf16, offset );
-            _lStr_memcpy( pchunk->buf16+offset, poldchunk->buf16+offset+count, newlen-offset+1 );
+            _lStr_memcpy( pchunk->buf16(), poldchunk->buf16(), offset );
+            _lStr_memcpy( pchunk->buf16()+offset, poldchunk->buf16()+offset+count, newlen-offset+1 );
         }
         pchunk->len = newlen;
-        pchunk->buf16[newlen]=0;
+        pchunk->buf16()[newlen]=0;
     }
     return *this;
 }
@@ -875,18 +946,17 @@ void lString16::reserve(size_type n)
 {
     if (pchunk->nref==1)
     {
-        if (pchunk->size < n)
+        if (pchunk->capacity() < n)
         {
-            pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(n+1) );
-            pchunk->size = n;
+            pchunk->reallocBuf( n );
         }
     }
     else
     {
         lstring_chunk_t * poldchunk = pchunk;
         release();
-        alloc( n );
-        _lStr_memcpy( pchunk->buf16, poldchunk->buf16, poldchunk->len+1 );
+        alloc( n > poldchunk->len ? n : poldchunk->len );
+        _lStr_memcpy( pchunk->buf16(), poldchunk->buf16(), poldchunk->len+1 );
         pchunk->len = poldchunk->len;
     }
 }
@@ -901,8 +971,8 @@ void lString16::lock( size_type newsize )
         size_type len = newsize;
         if (len>poldchunk->len)
             len = poldchunk->len;
-        _lStr_memcpy( pchunk->buf16, poldchunk->buf16, len );
-        pchunk->buf16[len]=0;
+        _lStr_memcpy( pchunk->buf16(), poldchunk->buf16(), len );
+        pchunk->buf16()[len]=0;
         pchunk->len = len;
     }
 }
@@ -910,34 +980,35 @@ void lString16::lock( size_type newsize )
 // lock string, allocate buffer and reset length to 0
 void lString16::reset( size_type size )
 {
-    if (pchunk->nref>1 || pchunk->size<size)
+    if (pchunk->nref>1 || pchunk->capacity()<size)
     {
         release();
         alloc( size );
     }
-    pchunk->buf16[0] = 0;
+    pchunk->buf16()[0] = 0;
     pchunk->len = 0;
 }
 
 void lString16::resize(size_type n, lChar16 e)
 {
     lock( n );
-    if (n>=pchunk->size)
+    if (n>pchunk->capacity())
     {
-        pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(n+1) );
-        pchunk->size = n;
+        pchunk->reallocBuf( n );
     }
     // fill with data if expanded
+    lChar16 * buf = pchunk->buf16();
     for (size_type i=pchunk->len; i<n; i++)
-        pchunk->buf16[i] = e;
-    pchunk->buf16[pchunk->len] = 0;
+        buf[i] = e;
+    pchunk->len = n;
+    buf[n] = 0;
 }
 
 lString16 & lString16::append(const lChar16 * str)
 {
     size_type len = _lStr_len(str);
     reserve( pchunk->len+len );
-    _lStr_memcpy(pchunk->buf16+pchunk->len, str, len+1);
+    _lStr_memcpy(pchunk->buf16()+pchunk->len, str, len+1);
     pchunk->len += len;
     return *this;
 }
@@ -945,7 +1016,7 @@ lString16 & lString16::append(const lChar16 * str)
 lString16 & lString16::append(const lChar16 * str, size_type count)
 {
     reserve(pchunk->len + count);
-    _lStr_ncpy(pchunk->buf16 + pchunk->len, str, count);
+    _lStr_ncpy(pchunk->buf16() + pchunk->len, str, count);
     pchunk->len += count;
     return *this;
 }
@@ -954,7 +1025,7 @@ lString16 & lString16::append(const lChar8 * str)
 {
     size_type len = _lStr_len(str);
     reserve( pchunk->len+len );
-    _lStr_ncpy(pchunk->buf16+pchunk->len, str, len+1);
+    _lStr_ncpy(pchunk->buf16()+pchunk->len, str, len+1);
     pchunk->len += len;
     return *this;
 }
@@ -962,7 +1033,7 @@ lString16 & lString16::append(const lChar8 * str)
 lString16 & lString16::append(const lChar8 * str, size_type count)
 {
     reserve(pchunk->len + count);
-    _lStr_ncpy(pchunk->buf16+pchunk->len, str, count);
+    _lStr_ncpy(pchunk->buf16()+pchunk->len, str, count);
     pchunk->len += count;
     return *this;
 }
@@ -971,7 +1042,7 @@ lString16 & lString16::append(const lString16 & str)
 {
     size_type len2 = pchunk->len + str.pchunk->len;
     reserve( len2 );
-    _lStr_memcpy( pchunk->buf16+pchunk->len, str.pchunk->buf16, str.pchunk->len+1 );
+    _lStr_memcpy( pchunk->buf16()+pchunk->len, str.pchunk->buf16(), str.pchunk->len+1 );
     pchunk->len = len2;
     return *this;
 }
@@ -983,9 +1054,9 @@ lString16 & lString16::append(const lString16 & str, size_type offset, size_type
         if ( offset + count > str.pchunk->len )
             count = str.pchunk->len - offset;
         reserve( pchunk->len+count );
-        _lStr_ncpy(pchunk->buf16 + pchunk->len, str.pchunk->buf16 + offset, count);
+        _lStr_ncpy(pchunk->buf16() + pchunk->len, str.pchunk->buf16() + offset, count);
         pchunk->len += count;
-        pchunk->buf16[pchunk->len] = 0;
+        pchunk->buf16()[pchunk->len] = 0;
     }
     return *this;
 }
@@ -993,9 +1064,9 @@ lString16 & lString16::append(const lString16 & str, size_type offset, size_type
 lString16 & lString16::append(size_type count, lChar16 ch)
 {
     reserve( pchunk->len+count );
-    _lStr_memset(pchunk->buf16+pchunk->len, ch, count);
+    _lStr_memset(pchunk->buf16()+pchunk->len, ch, count);
     pchunk->len += count;
-    pchunk->buf16[pchunk->len] = 0;
+    pchunk->buf16()[pchunk->len] = 0;
     return *this;
 }
 
@@ -1004,11 +1075,10 @@ lString16 & lString16::insert(size_type p0, size_type count, lChar16 ch)
     if (p0>pchunk->len)
         p0 = pchunk->len;
     reserve( pchunk->len+count );
-    for (size_type i=pchunk->len+count; i>p0; i--)
-        pchunk->buf16[i] = pchunk->buf16[i-1];
-    _lStr_memset(pchunk->buf16+p0, ch, count);
+    lChar16 * buf = pchunk->buf16();
+    memmove(buf+p0+count, buf+p0, sizeof(lChar16)*(pchunk->len-p0+1));
+    _lStr_memset(buf+p0, ch, count);
     pchunk->len += count;
-    pchunk->buf16[pchunk->len] = 0;
     return *this;
 }
 
@@ -1018,11 +1088,10 @@ lString16 & lString16::insert(size_type p0, const lString16 & str)
         p0 = pchunk->len;
     int count = str.length();
     reserve( pchunk->len+count );
-    for (size_type i=pchunk->len+count; i>p0; i--)
-        pchunk->buf16[i] = pchunk->buf16[i-1];
-    _lStr_memcpy(pchunk->buf16 + p0, str.c_str(), count);
+    lChar16 * buf = pchunk->buf16();
+    memmove(buf+p0+count, buf+p0, sizeof(lChar16)*(pchunk->len-p0+1));
+    _lStr_memcpy(buf + p0, str.c_str(), count);
     pchunk->len += count;
-    pchunk->buf16[pchunk->len] = 0;
     return *this;
 }
 
@@ -1032,12 +1101,12 @@ lString16 lString16::substr(size_type pos, size_type n) const
         return lString16::empty_str;
     if (pos+n>length())
         n = length() - pos;
-    return lString16( pchunk->buf16+pos, n );
+    return lString16( pchunk->buf16()+pos, n );
 }
 
 lString16 & lString16::pack()
 {
-    if (pchunk->len + 4 < pchunk->size )
+    if (pchunk->len + 4 < pchunk->capacity() )
     {
         if (pchunk->nref>1)
         {
@@ -1045,8 +1114,7 @@ lString16 & lString16::pack()
         }
         else
         {
-            pchunk->buf16 = (lChar16 *) realloc( pchunk->buf16, sizeof(lChar16)*(pchunk->len+1) );
-            pchunk->size = pchunk->len;
+            pchunk->reallocBuf( pchunk->len );
         }
     }
     return *this;
@@ -1062,7 +1130,7 @@ lString16 & lString16::trimNonAlpha()
 {
     int firstns;
     for (firstns = 0; firstns<pchunk->len &&
-        !isAlNum(pchunk->buf16[firstns]); ++firstns)
+        !isAlNum(pchunk->buf16()[firstns]); ++firstns)
         ;
     if (firstns >= pchunk->len)
     {
@@ -1071,7 +1139,7 @@ lString16 & lString16::trimNonAlpha()
     }
     int lastns;
     for (lastns = pchunk->len-1; lastns>0 &&
-        !isAlNum(pchunk->buf16[lastns]); --lastns)
+        !isAlNum(pchunk->buf16()[lastns]); --lastns)
         ;
     int newlen = lastns-firstns+1;
     if (newlen == pchunk->len)
@@ -1079,8 +1147,8 @@ lString16 & lString16::trimNonAlpha()
     if (pchunk->nref == 1)
     {
         if (firstns>0)
-            lStr_memcpy( pchunk->buf16, pchunk->buf16+firstns, newlen );
-        pchunk->buf16[newlen] = 0;
+            lStr_memcpy( pchunk->buf16(), pchunk->buf16()+firstns, newlen );
+        pchunk->buf16()[newlen] = 0;
         pchunk->len = newlen;
     }
     else
@@ -1088,8 +1156,8 @@ lString16 & lString16::trimNonAlpha()
         lstring_chunk_t * poldchunk = pchunk;
         release();
         alloc( newlen );
-        _lStr_memcpy( pchunk->buf16, poldchunk->buf16+firstns, newlen );
-        pchunk->buf16[newlen] = 0;
+        _lStr_memcpy( pchunk->buf16(), poldchunk->buf16()+firstns, newlen );
+        pchunk->buf16()[newlen] = 0;
         pchunk->len = newlen;
     }
     return *this;
@@ -1100,7 +1168,7 @@ lString16 & lString16::trim()
     //
     int firstns;
     for (firstns = 0; firstns<pchunk->len &&
-        (pchunk->buf16[firstns]==' ' || pchunk->buf16[firstns]=='\t'); ++firstns)
+        (pchunk->buf16()[firstns]==' ' || pchunk->buf16()[firstns]=='\t'); ++firstns)
         ;
     if (firstns >= pchunk->len)
     {
@@ -1109,7 +1177,7 @@ lString16 & lString16::trim()
     }
     int lastns;
     for (lastns = pchunk->len-1; lastns>0 &&
-        (pchunk->buf16[lastns]==' ' || pchunk->buf16[lastns]=='\t'); --lastns)
+        (pchunk->buf16()[lastns]==' ' || pchunk->buf16()[lastns]=='\t'); --lastns)
         ;
     int newlen = lastns-firstns+1;
     if (newlen == pchunk->len)
@@ -1117,8 +1185,8 @@ lString16 & lString16::trim()
     if (pchunk->nref == 1)
     {
         if (firstns>0)
-            lStr_memcpy( pchunk->buf16, pchunk->buf16+firstns, newlen );
-        pchunk->buf16[newlen] = 0;
+            lStr_memcpy( pchunk->buf16(), pchunk->buf16()+firstns, newlen );
+        pchunk->buf16()[newlen] = 0;
         pchunk->len = newlen;
     }
     else
@@ -1126,8 +1194,8 @@ lString16 & lString16::trim()
         lstring_chunk_t * poldchunk = pchunk;
         release();
         alloc( newlen );
-        _lStr_memcpy( pchunk->buf16, poldchunk->buf16+firstns, newlen );
-        pchunk->buf16[newlen] = 0;
+        _lStr_memcpy( pchunk->buf16(), poldchunk->buf16()+firstns, newlen );
+        pchunk->buf16()[newlen] = 0;
         pchunk->len = newlen;
     }
     return *this;
@@ -1253,8 +1321,9 @@ bool lString16::atoi( lInt64 &n ) const
 lUInt32 lString16::getHash() const
 {
     lUInt32 res = 0;
+    const lChar16 * buf = pchunk->buf16();
     for (lInt32 i=0; i<pchunk->len; i++)
-        res = res * STRING_HASH_MULT + pchunk->buf16[i];
+        res = res * STRING_HASH_MULT + buf[i];
     return res;
 }
 
@@ -1652,7 +1721,7 @@ void lString8::free()
     if ( pchunk==EMPTY_STR_8 )
         return;
     CHECK_STARTUP_STAGE;
-    ::free(pchunk->buf8);
+    pchunk->freeBuf();
 #if (LDOM_USE_OWN_MEM_MAN == 1)
     for (int i=slices_count-1; i>=0; --i)
     {
@@ -1672,9 +1741,8 @@ void lString8::alloc(int sz)
 #else
     pchunk = (lstring_chunk_t*)::malloc(sizeof(lstring_chunk_t));
 #endif
-    pchunk->buf8 = (lChar8*) ::malloc( sizeof(lChar8) * (sz+1) );
-    assert( pchunk->buf8!=NULL );
-    pchunk->size = sz;
+    pchunk->allocBuf( sz );
+    assert( pchunk->buf8()!=NULL );
     pchunk->nref = 1;
 }
 
@@ -1690,7 +1758,7 @@ lString8::lString8(const lChar8 * str)
     size_type len = _lStr_len(str);
     alloc( len );
     pchunk->len = len;
-    _lStr_cpy( pchunk->buf8, str );
+    _lStr_cpy( pchunk->buf8(), str );
 }
 
 lString8::lString8(const lChar16 * str)
@@ -1705,7 +1773,7 @@ lString8::lString8(const lChar16 * str)
     size_type len = _lStr_len(str);
     alloc( len );
     pchunk->len = len;
-    _lStr_cpy( pchunk->buf8, str );
+    _lStr_cpy( pchunk->buf8(), str );
 }
 
 lString8::lString8(const value_type * str, size_type count)
@@ -1718,7 +1786,7 @@ lString8::lString8(const value_type * str, size_type count)
     {
         size_type len = _lStr_nlen(str, count);
         alloc(len);
-        _lStr_ncpy( pchunk->buf8, str, len );
+        _lStr_ncpy( pchunk->buf8(), str, len );
         pchunk->len = len;
     }
 }
@@ -1735,8 +1803,8 @@ lString8::lString8(const lString8 & str, size_type offset, size_type count)
     else
     {
         alloc(count);
-        _lStr_memcpy( pchunk->buf8, str.pchunk->buf8+offset, count );
-        pchunk->buf8[count]=0;
+        _lStr_memcpy( pchunk->buf8(), str.pchunk->buf8()+offset, count );
+        pchunk->buf8()[count]=0;
         pchunk->len = count;
     }
 }
@@ -1752,11 +1820,10 @@ lString8 & lString8::assign(const lChar8 * str)
         size_type len = _lStr_len(str);
         if (pchunk->nref==1)
         {
-            if (pchunk->size<=len)
+            if (pchunk->capacity()<len)
             {
                 // resize is necessary
-                pchunk->buf8 = (lChar8*) ::realloc( pchunk->buf8, sizeof(lChar8)*(len+1) );
-                pchunk->size = len+1;
+                pchunk->reallocBuf( len );
             }
         }
         else
@@ -1764,7 +1831,7 @@ lString8 & lString8::assign(const lChar8 * str)
             release();
             alloc(len);
         }
-        _lStr_cpy( pchunk->buf8, str );
+        _lStr_cpy( pchunk->buf8(), str );
         pchunk->len = len;
     }
     return *this;
@@ -1781,11 +1848,10 @@ lString8 & lString8::assign(const lChar8 * str, size_type count)
         size_type len = _lStr_nlen(str, count);
         if (pchunk->nref==1)
         {
-            if (pchunk->size<=len)
+            if (pchunk->capacity()<len)
             {
                 // resize is necessary
-                pchunk->buf8 = (lChar8*) ::realloc( pchunk->buf8, sizeof(lChar8)*(len+1) );
-                pchunk->size = len+1;
+                pchunk->reallocBuf( len );
             }
         }
         else
@@ -1793,7 +1859,7 @@ lString8 & lString8::assign(const lChar8 * str, size_type count)
             release();
             alloc(len);
         }
-        _lStr_ncpy( pchunk->buf8, str, count );
+        _lStr_ncpy( pchunk->buf8(), str, count );
         pchunk->len = len;
     }
     return *this;
@@ -1818,19 +1884,18 @@ lString8 & lString8::assign(const lString8 & str, size_type offset, size_type co
             }
             if (offset>0)
             {
-                _lStr_memcpy( pchunk->buf8, str.pchunk->buf8+offset, count );
+                _lStr_memcpy( pchunk->buf8(), str.pchunk->buf8()+offset, count );
             }
-            pchunk->buf8[count]=0;
+            pchunk->buf8()[count]=0;
         }
         else
         {
             if (pchunk->nref==1)
             {
-                if (pchunk->size<=count)
+                if (pchunk->capacity()<count)
                 {
                     // resize is necessary
-                    pchunk->buf8 = (lChar8*) ::realloc( pchunk->buf8, sizeof(lChar8)*(count+1) );
-                    pchunk->size = count+1;
+                    pchunk->reallocBuf( count );
                 }
             }
             else
@@ -1838,8 +1903,8 @@ lString8 & lString8::assign(const lString8 & str, size_type offset, size_type co
                 release();
                 alloc(count);
             }
-            _lStr_memcpy( pchunk->buf8, str.pchunk->buf8+offset, count );
-            pchunk->buf8[count]=0;
+            _lStr_memcpy( pchunk->buf8(), str.pchunk->buf8()+offset, count );
+            pchunk->buf8()[count]=0;
         }
         pchunk->len = count;
     }
@@ -1859,18 +1924,18 @@ lString8 & lString8::erase(size_type offset, size_type count)
         size_type newlen = length()-count;
         if (pchunk->nref==1)
         {
-            _lStr_memcpy( pchunk->buf8+offset, pchunk->buf8+offset+count, newlen-offset+1 );
+            _lStr_memcpy( pchunk->buf8()+offset, pchunk->buf8()+offset+count, newlen-offset+1 );
         }
         else
         {
             lstring_chunk_t * poldchunk = pchunk;
             release();
             alloc( newlen );
-            _lStr_memcpy( pchunk->buf8, poldchunk->buf8, offset );
-            _lStr_memcpy( pchunk->buf8+offset, poldchunk->buf8+offset+count, newlen-offset+1 );
+            _lStr_memcpy( pchunk->buf8(), poldchunk->buf8(), offset );
+            _lStr_memcpy( pchunk->buf8()+offset, poldchunk->buf8()+offset+count, newlen-offset+1 );
         }
         pchunk->len = newlen;
-        pchunk->buf8[newlen]=0;
+        pchunk->buf8()[newlen]=0;
     }
     return *this;
 }
@@ -1879,18 +1944,17 @@ void lString8::reserve(size_type n)
 {
     if (pchunk->nref==1)
     {
-        if (pchunk->size < n)
+        if (pchunk->capacity() < n)
         {
-            pchunk->buf8 = (lChar8*) ::realloc( pchunk->buf8, sizeof(lChar8)*(n+1) );
-            pchunk->size = n;
+            pchunk->reallocBuf( n );
         }
     }
     else
     {
         lstring_chunk_t * poldchunk = pchunk;
         release();
-        alloc( n );
-        _lStr_memcpy( pchunk->buf8, poldchunk->buf8, poldchunk->len+1 );
+        alloc( n > poldchunk->len ? n : poldchunk->len );
+        _lStr_memcpy( pchunk->buf8(), poldchunk->buf8(), poldchunk->len+1 );
         pchunk->len = poldchunk->len;
     }
 }
@@ -1905,8 +1969,8 @@ void lString8::lock( size_type newsize )
         size_type len = newsize;
         if (len>poldchunk->len)
             len = poldchunk->len;
-        _lStr_memcpy( pchunk->buf8, poldchunk->buf8, len );
-        pchunk->buf8[len]=0;
+        _lStr_memcpy( pchunk->buf8(), poldchunk->buf8(), len );
+        pchunk->buf8()[len]=0;
         pchunk->len = len;
     }
 }
@@ -1914,34 +1978,35 @@ void lString8::lock( size_type newsize )
 // lock string, allocate buffer and reset length to 0
 void lString8::reset( size_type size )
 {
-    if (pchunk->nref>1 || pchunk->size<size)
+    if (pchunk->nref>1 || pchunk->capacity()<size)
     {
         release();
         alloc( size );
     }
-    pchunk->buf8[0] = 0;
+    pchunk->buf8()[0] = 0;
     pchunk->len = 0;
 }
 
 void lString8::resize(size_type n, lChar8 e)
 {
     lock( n );
-    if (n>=pchunk->size)
+    if (n>pchunk->capacity())
     {
-        pchunk->buf8 = (lChar8*) ::realloc( pchunk->buf8, sizeof(lChar8)*(n+1) );
-        pchunk->size = n;
+        pchunk->reallocBuf( n );
     }
     // fill with data if expanded
+    lChar8 * buf = pchunk->buf8();
     for (size_type i=pchunk->len; i<n; i++)
-        pchunk->buf8[i] = e;
-    pchunk->buf8[pchunk->len] = 0;
+        buf[i] = e;
+    pchunk->len = n;
+    buf[n] = 0;
 }
 
 lString8 & lString8::append(const lChar8 * str)
 {
     size_type len = _lStr_len(str);
     reserve( pchunk->len+len );
-    _lStr_memcpy(pchunk->buf8+pchunk->len, str, len+1);
+    _lStr_memcpy(pchunk->buf8()+pchunk->len, str, len+1);
     pchunk->len += len;
     return *this;
 }
@@ -2032,7 +2097,7 @@ lString8 & lString8::append(const lChar8 * str, size_type count)
 {
     size_type len = _lStr_nlen(str, count);
     reserve( pchunk->len+len );
-    _lStr_ncpy(pchunk->buf8+pchunk->len, str, len);
+    _lStr_ncpy(pchunk->buf8()+pchunk->len, str, len);
     pchunk->len += len;
     return *this;
 }
@@ -2041,7 +2106,7 @@ lString8 & lString8::append(const lString8 & str)
 {
     size_type len2 = pchunk->len + str.pchunk->len;
     reserve( len2 );
-    _lStr_memcpy( pchunk->buf8+pchunk->len, str.pchunk->buf8, str.pchunk->len+1 );
+    _lStr_memcpy( pchunk->buf8()+pchunk->len, str.pchunk->buf8(), str.pchunk->len+1 );
     pchunk->len = len2;
     return *this;
 }
@@ -2053,9 +2118,9 @@ lString8 & lString8::append(const lString8 & str, size_type offset, size_type co
         if ( offset + count > str.pchunk->len )
             count = str.pchunk->len - offset;
         reserve( pchunk->len+count );
-        _lStr_ncpy(pchunk->buf8 + pchunk->len, str.pchunk->buf8 + offset, count);
+        _lStr_ncpy(pchunk->buf8() + pchunk->len, str.pchunk->buf8() + offset, count);
         pchunk->len += count;
-        pchunk->buf8[pchunk->len] = 0;
+        pchunk->buf8()[pchunk->len] = 0;
     }
     return *this;
 }
@@ -2063,10 +2128,10 @@ lString8 & lString8::append(const lString8 & str, size_type offset, size_type co
 lString8 & lString8::append(size_type count, lChar8 ch)
 {
     reserve( pchunk->len+count );
-    memset( pchunk->buf8+pchunk->len, ch, count );
-    //_lStr_memset(pchunk->buf8+pchunk->len, ch, count);
+    memset( pchunk->buf8()+pchunk->len, ch, count );
+    //_lStr_memset(pchunk->buf8()+pchunk->len, ch, count);
     pchunk->len += count;
-    pchunk->buf8[pchunk->len] = 0;
+    pchunk->buf8()[pchunk->len] = 0;
     return *this;
 }
 
@@ -2075,12 +2140,11 @@ lString8 & lString8::insert(size_type p0, size_type count, lChar8 ch)
     if (p0>pchunk->len)
         p0 = pchunk->len;
     reserve( pchunk->len+count );
-    for (size_type i=pchunk->len+count; i>p0; i--)
-        pchunk->buf8[i] = pchunk->buf8[i-1];
-    //_lStr_memset(pchunk->buf8+p0, ch, count);
-    memset(pchunk->buf8+p0, ch, count);
+    lChar8 * buf = pchunk->buf8();
+    memmove(buf+p0+count, buf+p0, pchunk->len-p0+1);
+    //_lStr_memset(buf+p0, ch, count);
+    memset(buf+p0, ch, count);
     pchunk->len += count;
-    pchunk->buf8[pchunk->len] = 0;
     return *this;
 }
 
@@ -2090,7 +2154,7 @@ lString8 lString8::substr(size_type pos, size_type n) const
         return lString8::empty_str;
     if (pos+n>length())
         n = length() - pos;
-    return lString8( pchunk->buf8+pos, n );
+    return lString8( pchunk->buf8()+pos, n );
 }
 
 int lString8::pos(const lString8 & subStr) const
@@ -2103,7 +2167,7 @@ int lString8::pos(const lString8 & subStr) const
     {
         int flg = 1;
         for (int j=0; j<l; j++)
-            if (pchunk->buf8[i+j]!=subStr.pchunk->buf8[j])
+            if (pchunk->buf8()[i+j]!=subStr.pchunk->buf8()[j])
             {
                 flg = 0;
                 break;
@@ -2127,7 +2191,7 @@ int lString8::rpos(const char * subStr) const
     {
         int flg = 1;
         for (int j=0; j<l; j++)
-            if (pchunk->buf8[i+j] != subStr[j])
+            if (pchunk->buf8()[i+j] != subStr[j])
             {
                 flg = 0;
                 break;
@@ -2151,7 +2215,7 @@ int lString8::pos(const char * subStr) const
     {
         int flg = 1;
         for (int j=0; j<l; j++)
-            if (pchunk->buf8[i+j] != subStr[j])
+            if (pchunk->buf8()[i+j] != subStr[j])
             {
                 flg = 0;
                 break;
@@ -2171,7 +2235,7 @@ int lString8::pos(const lString8 & subStr, int startPos) const
     for (int i = startPos; i <= dl; i++) {
         int flg = 1;
         for (int j=0; j<l; j++)
-            if (pchunk->buf8[i+j]!=subStr.pchunk->buf8[j])
+            if (pchunk->buf8()[i+j]!=subStr.pchunk->buf8()[j])
             {
                 flg = 0;
                 break;
@@ -2191,7 +2255,7 @@ int lString16::pos(const lString16 & subStr, int startPos) const
     for (int i = startPos; i <= dl; i++) {
         int flg = 1;
         for (int j=0; j<l; j++)
-            if (pchunk->buf16[i+j]!=subStr.pchunk->buf16[j])
+            if (pchunk->buf16()[i+j]!=subStr.pchunk->buf16()[j])
             {
                 flg = 0;
                 break;
@@ -2214,7 +2278,7 @@ int lString8::pos(const char * subStr, int startPos) const
     for (int i = startPos; i <= dl; i++) {
         int flg = 1;
         for (int j=0; j<l; j++)
-            if (pchunk->buf8[i+j] != subStr[j])
+            if (pchunk->buf8()[i+j] != subStr[j])
             {
                 flg = 0;
                 break;
@@ -2237,7 +2301,7 @@ int lString16::pos(const lChar16 * subStr, int startPos) const
     for (int i = startPos; i <= dl; i++) {
         int flg = 1;
         for (int j=0; j<l; j++)
-            if (pchunk->buf16[i+j] != subStr[j])
+            if (pchunk->buf16()[i+j] != subStr[j])
             {
                 flg = 0;
                 break;
@@ -2259,7 +2323,7 @@ int lString16::rpos(lString16 subStr) const
     {
         int flg = 1;
         for (int j=0; j<l; j++)
-            if (pchunk->buf16[i+j]!=subStr.pchunk->buf16[j])
+            if (pchunk->buf16()[i+j]!=subStr.pchunk->buf16()[j])
             {
                 flg = 0;
                 break;
@@ -2283,7 +2347,7 @@ int lString16::pos(const lChar16 * subStr) const
     {
         int flg = 1;
         for (int j=0; j<l; j++)
-            if (pchunk->buf16[i+j] != subStr[j])
+            if (pchunk->buf16()[i+j] != subStr[j])
             {
                 flg = 0;
                 break;
@@ -2307,7 +2371,7 @@ int lString16::pos(const lChar8 * subStr) const
     {
         int flg = 1;
         for (int j=0; j<l; j++)
-            if (pchunk->buf16[i+j] != subStr[j])
+            if (pchunk->buf16()[i+j] != subStr[j])
             {
                 flg = 0;
                 break;
@@ -2331,7 +2395,7 @@ int lString16::pos(const lChar8 * subStr, int start) const
     {
         int flg = 1;
         for (int j=0; j<l; j++)
-            if (pchunk->buf16[i+j] != subStr[j])
+            if (pchunk->buf16()[i+j] != subStr[j])
             {
                 flg = 0;
                 break;
@@ -2352,7 +2416,7 @@ int lString16::pos(lString16 subStr) const
     {
         int flg = 1;
         for (int j=0; j<l; j++)
-            if (pchunk->buf16[i+j]!=subStr.pchunk->buf16[j])
+            if (pchunk->buf16()[i+j]!=subStr.pchunk->buf16()[j])
             {
                 flg = 0;
                 break;
@@ -2365,7 +2429,7 @@ int lString16::pos(lString16 subStr) const
 
 lString8 & lString8::pack()
 {
-    if (pchunk->len + 4 < pchunk->size )
+    if (pchunk->len + 4 < pchunk->capacity() )
     {
         if (pchunk->nref>1)
         {
@@ -2373,8 +2437,7 @@ lString8 & lString8::pack()
         }
         else
         {
-            pchunk->buf8 = (lChar8 *) realloc( pchunk->buf8, sizeof(lChar8)*(pchunk->len+1) );
-            pchunk->size = pchunk->len;
+            pchunk->reallocBuf( pchunk->len );
         }
     }
     return *this;
@@ -2386,8 +2449,8 @@ lString8 & lString8::trim()
     int firstns;
     for (firstns = 0;
             firstns < pchunk->len &&
-            (pchunk->buf8[firstns] == ' ' ||
-            pchunk->buf8[firstns] == '\t');
+            (pchunk->buf8()[firstns] == ' ' ||
+            pchunk->buf8()[firstns] == '\t');
             ++firstns)
         ;
     if (firstns >= pchunk->len)
@@ -2398,7 +2461,7 @@ lString8 & lString8::trim()
     size_t lastns;
     for (lastns = pchunk->len-1;
             lastns>0 &&
-            (pchunk->buf8[lastns]==' ' || pchunk->buf8[lastns]=='\t');
+            (pchunk->buf8()[lastns]==' ' || pchunk->buf8()[lastns]=='\t');
             --lastns)
         ;
     int newlen = (int)(lastns - firstns + 1);
@@ -2407,8 +2470,8 @@ lString8 & lString8::trim()
     if (pchunk->nref == 1)
     {
         if (firstns>0)
-            lStr_memcpy( pchunk->buf8, pchunk->buf8+firstns, newlen );
-        pchunk->buf8[newlen] = 0;
+            lStr_memcpy( pchunk->buf8(), pchunk->buf8()+firstns, newlen );
+        pchunk->buf8()[newlen] = 0;
         pchunk->len = newlen;
     }
     else
@@ -2416,8 +2479,8 @@ lString8 & lString8::trim()
         lstring_chunk_t * poldchunk = pchunk;
         release();
         alloc( newlen );
-        _lStr_memcpy( pchunk->buf8, poldchunk->buf8+firstns, newlen );
-        pchunk->buf8[newlen] = 0;
+        _lStr_memcpy( pchunk->buf8(), poldchunk->buf8()+firstns, newlen );
+        pchunk->buf8()[newlen] = 0;
         pchunk->len = newlen;
     }
     return *this;
@@ -2466,6 +2529,7 @@ lInt64 lString8::atoi64() const
     while (*s>='0' && *s<='9')
     {
         n = n * 10 + ( (*s)-'0' );
+        s++;
     }
     return (sgn>0) ? n : -n;
 }
@@ -2596,54 +2660,201 @@ lString16 & lString16::lowercase()
     return *this;
 }
 
-void lStr_uppercase( lChar16 * str, int len )
+static inline lChar16 upperChar( lChar16 ch )
+{
+    if ( ch>='a' && ch<='z' ) {
+        return ch - 0x20;
+    } else if ( ch>=0xE0 && ch<=0xFF ) {
+        return ch - 0x20;
+    } else if ( ch>=0x430 && ch<=0x44F ) {
+        return ch - 0x20;
+    } else if ( ch>=0x3b0 && ch<=0x3cF ) {
+        return ch - 0x20;
+    } else if ( (ch >> 8)==0x1F ) { // greek
+        lChar16 n = ch & 255;
+        if (n<0x70) {
+            return ch | 8;
+        } else if (n<0x80) {
+
+        } else if (n<0xF0) {
+            return ch | 8;
+        }
+    }
+    return ch;
+}
+
+static inline lChar16 lowerChar( lChar16 ch )
 {
-    for ( int i=0; i<len; i++ ) {
-        lChar16 ch = str[i];
-        if ( ch>='a' && ch<='z' ) {
-            str[i] = ch - 0x20;
-        } else if ( ch>=0xE0 && ch<=0xFF ) {
-            str[i] = ch - 0x20;
-        } else if ( ch>=0x430 && ch<=0x44F ) {
-            str[i] = ch - 0x20;
-        } else if ( ch>=0x3b0 && ch<=0x3cF ) {
-            str[i] = ch - 0x20;
-        } else if ( (ch >> 8)==0x1F ) { // greek
-            lChar16 n = ch & 255;
-            if (n<0x70) {
-                str[i] = ch | 8;
-            } else if (n<0x80) {
-
-            } else if (n<0xF0) {
-                str[i] = ch | 8;
-            }
+    if ( ch>='A' && ch<='Z' ) {
+        return ch + 0x20;
+    } else if ( ch>=0xC0 && ch<=0xDF ) {
+        return ch + 0x20;
+    } else if ( ch>=0x410 && ch<=0x42F ) {
+        return ch + 0x20;
+    } else if ( ch>=0x390 && ch<=0x3aF ) {
+        return ch + 0x20;
+    } else if ( (ch >> 8)==0x1F ) { // greek
+        lChar16 n = ch & 255;
+        if (n<0x70) {
+            return ch & (~8);
+        } else if (n<0x80) {
+
+        } else if (n<0xF0) {
+            return ch & (~8);
         }
     }
+    return ch;
+}
+
+void lStr_uppercase( lChar16 * str, int len )
+{
+    for ( int i=0; i<len; i++ )
+        str[i] = upperChar( str[i] );
 }
 
 void lStr_lowercase( lChar16 * str, int len )
 {
-    for ( int i=0; i<len; i++ ) {
-        lChar16 ch = str[i];
-        if ( ch>='A' && ch<='Z' ) {
-            str[i] = ch + 0x20;
-        } else if ( ch>=0xC0 && ch<=0xDF ) {
-            str[i] = ch + 0x20;
-        } else if ( ch>=0x410 && ch<=0x42F ) {
-            str[i] = ch + 0x20;
-        } else if ( ch>=0x390 && ch<=0x3aF ) {
-            str[i] = ch + 0x20;
-        } else if ( (ch >> 8)==0x1F ) { // greek
-            lChar16 n = ch & 255;
-            if (n<0x70) {
-                str[i] = ch & (~8);
-            } else if (n<0x80) {
-
-            } else if (n<0xF0) {
-                str[i] = ch & (~8);
-            }
+    for ( int i=0; i<len; i++ )
+        str[i] = lowerChar( str[i] );
+}
+
+/// returns index of first char in [from, to) equal to a or b, to if none
+static inline int findChar2( const lChar16 * text, int from, int to, lChar16 a, lChar16 b )
+{
+    int i = from;
+#if LSTR_USE_SSE2
+    if ( sizeof(lChar16) == 4 ) {
+        const __m128i va = _mm_set1_epi32( (int)a );
+        const __m128i vb = _mm_set1_epi32( (int)b );
+        for ( ; i + 4 <= to; i += 4 ) {
+            __m128i v = _mm_loadu_si128( (const __m128i *)(text + i) );
+            int mask = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi32( v, va ), _mm_cmpeq_epi32( v, vb ) ) );
+            if ( mask )
+                break;
+        }
+    } else {
+        const __m128i va = _mm_set1_epi16( (short)a );
+        const __m128i vb = _mm_set1_epi16( (short)b );
+        for ( ; i + 8 <= to; i += 8 ) {
+            __m128i v = _mm_loadu_si128( (const __m128i *)(text + i) );
+            int mask = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi16( v, va ), _mm_cmpeq_epi16( v, vb ) ) );
+            if ( mask )
+                break;
+        }
+    }
+#elif LSTR_USE_NEON
+    if ( sizeof(lChar16) == 4 ) {
+        const uint32x4_t va = vdupq_n_u32( (uint32_t)a );
+        const uint32x4_t vb = vdupq_n_u32( (uint32_t)b );
+        for ( ; i + 4 <= to; i += 4 ) {
+            uint32x4_t v = vld1q_u32( (const uint32_t *)(text + i) );
+            uint64x2_t m = vreinterpretq_u64_u32( vorrq_u32( vceqq_u32( v, va ), vceqq_u32( v, vb ) ) );
+            if ( vgetq_lane_u64(m, 0) | vgetq_lane_u64(m, 1) )
+                break;
+        }
+    } else {
+        const uint16x8_t va = vdupq_n_u16( (uint16_t)a );
+        const uint16x8_t vb = vdupq_n_u16( (uint16_t)b );
+        for ( ; i + 8 <= to; i += 8 ) {
+            uint16x8_t v = vld1q_u16( (const uint16_t *)(text + i) );
+            uint64x2_t m = vreinterpretq_u64_u16( vorrq_u16( vceqq_u16( v, va ), vceqq_u16( v, vb ) ) );
+            if ( vgetq_lane_u64(m, 0) | vgetq_lane_u64(m, 1) )
+                break;
+        }
+    }
+#endif
+    for ( ; i < to && text[i] != a && text[i] != b; i++ )
+        ;
+    return i;
+}
+
+lString16SearchPattern::lString16SearchPattern( const lString16 & pattern, bool caseInsensitive )
+: _pattern( pattern ), _caseInsensitive( caseInsensitive )
+{
+    if ( _caseInsensitive )
+        _pattern.lowercase();
+    int m = _pattern.length();
+    const lChar16 * p = _pattern.c_str();
+    for ( int i=0; i<256; i++ ) {
+        _skip[i] = m;
+        _revSkip[i] = m;
+    }
+    for ( int i=0; i<m-1; i++ )
+        _skip[p[i] & 0xFF] = m - 1 - i;
+    for ( int i=m-1; i>0; i-- )
+        _revSkip[p[i] & 0xFF] = i;
+    _first[0] = _first[1] = m ? p[0] : 0;
+    if ( m && _caseInsensitive ) {
+        // the only other char which lowercases to the first pattern char
+        lChar16 up = upperChar( p[0] );
+        if ( lowerChar( up ) == p[0] )
+            _first[1] = up;
+    }
+}
+
+inline bool lString16SearchPattern::matchAt( const lChar16 * text, int from, int to ) const
+{
+    const lChar16 * p = _pattern.c_str();
+    if ( _caseInsensitive ) {
+        for ( int i=from; i<to; i++ )
+            if ( lowerChar( text[i] ) != p[i] )
+                return false;
+    } else {
+        for ( int i=from; i<to; i++ )
+            if ( text[i] != p[i] )
+                return false;
+    }
+    return true;
+}
+
+int lString16SearchPattern::find( const lChar16 * text, int len, int pos ) const
+{
+    int m = _pattern.length();
+    if ( pos < 0 )
+        pos = 0;
+    if ( !m || pos > len - m )
+        return -1;
+    int last = len - m;
+    if ( m < LSTR_SEARCH_BMH_MIN_PATTERN ) {
+        // short pattern: vector scan for first char, then verify
+        for ( int s = pos; s <= last; s++ ) {
+            s = findChar2( text, s, last + 1, _first[0], _first[1] );
+            if ( s > last )
+                break;
+            if ( matchAt( text + s, 1, m ) )
+                return s;
         }
+        return -1;
     }
+    const lChar16 lastCh = _pattern[m - 1];
+    for ( int s = pos; s <= last; ) {
+        lChar16 ch = text[s + m - 1];
+        if ( _caseInsensitive )
+            ch = lowerChar( ch );
+        if ( ch == lastCh && matchAt( text + s, 0, m - 1 ) )
+            return s;
+        s += _skip[ch & 0xFF];
+    }
+    return -1;
+}
+
+int lString16SearchPattern::findRev( const lChar16 * text, int len, int pos ) const
+{
+    int m = _pattern.length();
+    if ( !m || len < m )
+        return -1;
+    if ( pos > len - m )
+        pos = len - m;
+    const lChar16 firstCh = _pattern[0];
+    for ( int s = pos; s >= 0; ) {
+        lChar16 ch = text[s];
+        if ( _caseInsensitive )
+            ch = lowerChar( ch );
+        if ( ch == firstCh && matchAt( text + s, 1, m ) )
+            return s;
+        s -= _revSkip[ch & 0xFF];
+    }
+    return -1;
 }
 
 void lString16Collection::parse( lString16 string, lChar16 delimiter, bool flgTrim )
@@ -2764,8 +2975,9 @@ lString16 lString16::itoa( lUInt64 n )
 lUInt32 lString8::getHash() const
 {
     lUInt32 res = 0;
+    const lChar8 * buf = pchunk->buf8();
     for (int i=0; i < pchunk->len; i++)
-        res = res * STRING_HASH_MULT + pchunk->buf8[i];
+        res = res * STRING_HASH_MULT + buf[i];
     return res;
 }
 
@@ -2885,6 +3097,84 @@ lString16 Utf8ToUnicode( const lString8 & str )
 	return Utf8ToUnicode( str.c_str() );
 }
 
+static inline int asciiPrefixLength( const lUInt8 * buf, int len )
+{
+    int i = 0;
+#if LSTR_USE_SSE2
+    for ( ; i + 16 <= len; i += 16 ) {
+        if ( _mm_movemask_epi8( _mm_loadu_si128( (const __m128i *)(buf + i) ) ) )
+            break;
+    }
+#elif LSTR_USE_NEON
+    for ( ; i + 16 <= len; i += 16 ) {
+        uint64x2_t v = vreinterpretq_u64_u8( vld1q_u8( buf + i ) );
+        if ( (vgetq_lane_u64(v, 0) | vgetq_lane_u64(v, 1)) & 0x8080808080808080ULL )
+            break;
+    }
+#else
+    for ( ; i + 8 <= len; i += 8 ) {
+        lUInt64 v;
+        memcpy( &v, buf + i, 8 );
+        if ( v & 0x8080808080808080ULL )
+            break;
+    }
+#endif
+    for ( ; i < len && !(buf[i] & 0x80); i++ )
+        ;
+    return i;
+}
+
+static inline void asciiToUnicode( lChar16 * dst, const lUInt8 * src, int count )
+{
+    int i = 0;
+#if LSTR_USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for ( ; i + 16 <= count; i += 16 ) {
+        __m128i v = _mm_loadu_si128( (const __m128i *)(src + i) );
+        __m128i lo = _mm_unpacklo_epi8( v, zero );
+        __m128i hi = _mm_unpackhi_epi8( v, zero );
+        if ( sizeof(lChar16) == 2 ) {
+            _mm_storeu_si128( (__m128i *)(dst + i), lo );
+            _mm_storeu_si128( (__m128i *)(dst + i + 8), hi );
+        } else {
+            _mm_storeu_si128( (__m128i *)(dst + i), _mm_unpacklo_epi16( lo, zero ) );
+            _mm_storeu_si128( (__m128i *)(dst + i + 4), _mm_unpackhi_epi16( lo, zero ) );
+            _mm_storeu_si128( (__m128i *)(dst + i + 8), _mm_unpacklo_epi16( hi, zero ) );
+            _mm_storeu_si128( (__m128i *)(dst + i + 12), _mm_unpackhi_epi16( hi, zero ) );
+        }
+    }
+#elif LSTR_USE_NEON
+    for ( ; i + 16 <= count; i += 16 ) {
+        uint8x16_t v = vld1q_u8( src + i );
+        uint16x8_t lo = vmovl_u8( vget_low_u8(v) );
+        uint16x8_t hi = vmovl_u8( vget_high_u8(v) );
+        if ( sizeof(lChar16) == 2 ) {
+            vst1q_u16( (uint16_t *)(dst + i), lo );
+            vst1q_u16( (uint16_t *)(dst + i + 8), hi );
+        } else {
+            vst1q_u32( (uint32_t *)(dst + i), vmovl_u16( vget_low_u16(lo) ) );
+            vst1q_u32( (uint32_t *)(dst + i + 4), vmovl_u16( vget_high_u16(lo) ) );
+            vst1q_u32( (uint32_t *)(dst + i + 8), vmovl_u16( vget_low_u16(hi) ) );
+            vst1q_u32( (uint32_t *)(dst + i + 12), vmovl_u16( vget_high_u16(hi) ) );
+        }
+    }
+#endif
+    for ( ; i < count; i++ )
+        dst[i] = src[i];
+}
+
+/// returns length of leading run of 7-bit ASCII bytes in buffer
+int lStr_asciiPrefixLength( const lUInt8 * buf, int len )
+{
+    return asciiPrefixLength( buf, len );
+}
+
+/// widens 7-bit ASCII bytes to lChar16
+void lStr_asciiToUnicode( lChar16 * dst, const lUInt8 * src, int count )
+{
+    asciiToUnicode( dst, src, count );
+}
+
 #define CONT_BYTE(index,shift) (((lChar16)(s[index]) & 0x3F) << shift)
 
 static void DecodeUtf8(const char * s,  lChar16 * p, int len)
@@ -2939,8 +3229,14 @@ void Utf8ToUnicode(const lUInt8 * src,  int &srclen, lChar16 * dst, int &dstlen)
     while (p < endp && s < ends) {
         ch = *s;
         if ( (ch & 0x80) == 0 ) {
-            *p++ = (char)ch;
-            s++;
+            // copy whole run of 7-bit chars at once
+            int n = (int)(ends - s);
+            if ( n > endp - p )
+                n = (int)(endp - p);
+            n = asciiPrefixLength( s, n );
+            asciiToUnicode( p, s, n );
+            p += n;
+            s += n;
         } else if ( (ch & 0xE0) == 0xC0 ) {
             if (s + 2 > ends)
                 break;
@@ -4261,7 +4557,7 @@ void  lString16::limit( size_type sz )
     if ( length() > sz ) {
         modify();
         pchunk->len = sz;
-        pchunk->buf16[sz] = 0;
+        pchunk->buf16()[sz] = 0;
     }
 }
 
@@ -5103,3 +5399,120 @@ lUInt64 GetCurrentTimeMillis() {
 #endif
 }
 
+
+#ifdef _DEBUG
+
+#include "../include/crtest.h"
+
+// fills string with n chars 'a', 'b', 'c'... one by one
+template <class S> static void makeTestString( S & s, int n )
+{
+    s.clear();
+    for ( int i=0; i<n; i++ )
+        s.append( 1, (typename S::value_type)('a' + i % 26) );
+}
+
+// checks string has n chars made by makeTestString(), starting from char index start, and zero terminator
+template <class S> static bool checkTestString( const S & s, int n, int start = 0 )
+{
+    if ( s.length()!=n )
+        return false;
+    for ( int i=0; i<n; i++ )
+        if ( s[i]!=(typename S::value_type)('a' + (start + i) % 26) )
+            return false;
+    return s.c_str()[n]==0;
+}
+
+// string operations for lengths around size of inline buffer of string chunk
+template <class S> static void testStringBoundaries( int inlineSize )
+{
+    int maxLen = inlineSize * 3 + 2;
+    for ( int n=0; n<=maxLen; n++ ) {
+        S s;
+        makeTestString( s, n );
+        MYASSERT(checkTestString( s, n ), "append char");
+        MYASSERT(s.capacity()>=n, "capacity");
+        S s2;
+        makeTestString( s2, n / 2 );
+        S s3( s.c_str() + n / 2 );
+        s2 += s3;
+        MYASSERT(checkTestString( s2, n ), "append string");
+
+        // copy-on-write
+        {
+            S copy = s;
+            MYASSERT(copy.c_str()==s.c_str(), "copy shares buffer");
+            copy.append( 1, '*' );
+            MYASSERT(checkTestString( s, n ), "source not changed by append to copy");
+            MYASSERT(copy.length()==n+1 && copy[n]=='*' && copy.c_str()[n+1]==0, "append to copy");
+            S copy2 = s;
+            copy2.modify()[0] = '*';
+            MYASSERT(checkTestString( s, n ), "source not changed by modify of copy");
+            S copy3 = s;
+            copy3.insert( 0, 1, '*' );
+            MYASSERT(checkTestString( s, n ), "source not changed by insert to copy");
+            MYASSERT(copy3.length()==n+1 && copy3[0]=='*' && checkTestString( copy3.substr(1), n ), "insert to copy");
+        }
+
+        // insert of 1..3 chars in the middle
+        for ( int k=1; k<=3; k++ ) {
+            S t = s;
+            int p = n / 2;
+            t.insert( p, k, '*' );
+            MYASSERT(t.length()==n+k && t.c_str()[n+k]==0, "insert length");
+            MYASSERT(checkTestString( t.substr(0, p), p ), "insert head");
+            for ( int i=0; i<k; i++ )
+                MYASSERT(t[p+i]=='*', "inserted chars");
+            MYASSERT(checkTestString( t.substr(p+k), n-p, p ), "insert tail");
+            if ( n>p ) {
+                t.erase( p, k );
+                MYASSERT(checkTestString( t, n ), "erase inserted chars");
+            }
+        }
+
+        // reserve and resize across inline buffer size
+        for ( int m=0; m<=maxLen; m++ ) {
+            S t = s;
+            t.reserve( m );
+            MYASSERT(checkTestString( t, n ), "reserve keeps content");
+            MYASSERT(checkTestString( s, n ), "reserve of copy keeps source");
+            MYASSERT(t.capacity()>=m, "reserved capacity");
+            const typename S::value_type * buf = t.c_str();
+            while ( t.length()<m )
+                t.append( 1, (typename S::value_type)('a' + t.length() % 26) );
+            MYASSERT(t.c_str()==buf, "append within reserved capacity");
+            MYASSERT(checkTestString( t, m>n ? m : n ), "append after reserve");
+            t.pack();
+            MYASSERT(checkTestString( t, m>n ? m : n ), "pack");
+
+            S r = s;
+            r.resize( m, '*' );
+            MYASSERT(checkTestString( s, n ), "resize of copy keeps source");
+            MYASSERT(r.length()==m && r.c_str()[m]==0, "resize length");
+            MYASSERT(checkTestString( r.substr(0, m<n ? m : n), m<n ? m : n ), "resize keeps content");
+            for ( int i=n; i<m; i++ )
+                MYASSERT(r[i]=='*', "resize fills new chars");
+            r.pack();
+            MYASSERT(r.length()==m && checkTestString( r.substr(0, m<n ? m : n), m<n ? m : n ), "pack after resize");
+        }
+    }
+}
+
+void runStringUnitTests()
+{
+    CRLog::info("Starting lString unit test");
+    testStringBoundaries<lString8>( LSTRING_INLINE_BUF_SIZE / sizeof(lChar8) );
+    testStringBoundaries<lString16>( LSTRING_INLINE_BUF_SIZE / sizeof(lChar16) );
+    lString16 s("0123456789abcdef0123456789");
+    for ( int len=0; len<=s.length(); len++ ) {
+        lString16 t = s.substr(0, len);
+        lString16 u = t;
+        u.insert( len / 2, lString16("XY") );
+        MYASSERT(u.length()==len+2 && u.substr(len / 2, 2)==lString16("XY"), "insert string");
+        MYASSERT(u.substr(0, len / 2) + u.substr(len / 2 + 2)==t, "insert string keeps content");
+        MYASSERT(t==s.substr(0, len), "insert string into copy keeps source");
+    }
+    CRLog::info("Finished lString unit test");
+}
+
+#endif
@@ -1077,6 +1077,32 @@ bool LVCssSelector::check( const ldomNode * node ) const
     return true;
 }
 
+bool LVCssSelector::getKey( LVCssSelectorRuleType & type, lString16 & value ) const
+{
+    // rules of rightmost compound selector are placed at start of list, before first combinator
+    for ( LVCssSelectorRule * rule = _rules; rule; rule = rule->getNext() ) {
+        LVCssSelectorRuleType t = rule->getType();
+        if ( t==cssrt_parent || t==cssrt_ancessor || t==cssrt_predecessor )
+            break;
+        if ( t==cssrt_class || t==cssrt_id ) {
+            type = t;
+            value = rule->getValue();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LVCssSelector::isContextFree() const
+{
+    for ( LVCssSelectorRule * rule = _rules; rule; rule = rule->getNext() ) {
+        LVCssSelectorRuleType t = rule->getType();
+        if ( t!=cssrt_class && t!=cssrt_id && t!=cssrt_universal )
+            return false;
+    }
+    return true;
+}
+
 bool parse_attr_value( const char * &str, char * buf )
 {
     int pos = 0;
@@ -1187,7 +1213,7 @@ LVCssSelectorRule * parse_attr( const char * &str, lxmlDocBase * doc )
     }
     LVCssSelectorRule * rule = new LVCssSelectorRule(st);
     lString16 s( attrvalue );
-    lUInt16 id = doc->getAttrNameIndex( lString16(attrname).c_str() );
+    lUInt16 id = doc->getAttrNameIndex( attrname );
     rule->setAttr(id, s);
     return rule;
 }
@@ -1231,7 +1257,7 @@ bool LVCssSelector::parse( const char * &str, lxmlDocBase * doc )
             char ident[64];
             if (!parse_ident( str, ident ))
                 return false;
-            _id = doc->getElementNameIndex( lString16(ident).c_str() );
+            _id = doc->getElementNameIndex( ident );
             skip_spaces( str );
         }
         else
@@ -1326,6 +1352,7 @@ LVCssSelector::LVCssSelector( LVCssSelector & v )
 
 void LVStyleSheet::set(LVPtrVector<LVCssSelector> & v  )
 {
+    invalidateIndex();
     _selectors.clear();
     if ( !v.size() )
         return;
@@ -1339,20 +1366,122 @@ void LVStyleSheet::set(LVPtrVector<LVCssSelector> & v  )
     }
 }
 
+static lUInt32 lastStyleSheetGeneration = 0;
+
+LVStyleSheet::LVStyleSheet( lxmlDocBase * doc )
+:   _doc( doc ), _indexed(false), _classIndex(32), _idIndex(32), _universalContextFree(true), _generation(++lastStyleSheetGeneration)
+{
+}
+
 LVStyleSheet::LVStyleSheet( LVStyleSheet & sheet )
-:   _doc( sheet._doc )
+:   _doc( sheet._doc ), _indexed(false), _classIndex(32), _idIndex(32), _universalContextFree(true), _generation(0)
 {
     set( sheet._selectors );
 }
 
+void LVStyleSheet::invalidateIndex()
+{
+    _indexed = false;
+    _generation = ++lastStyleSheetGeneration;
+}
+
+static bool isChainContextFree( LVCssSelector * selector )
+{
+    for ( ; selector; selector = selector->getNext() )
+        if ( !selector->isContextFree() )
+            return false;
+    return true;
+}
+
+bool LVStyleSheet::isContextFree( lUInt16 elementId )
+{
+    if ( !_indexed )
+        buildIndex();
+    if ( !_universalContextFree )
+        return false;
+    return elementId>=_contextFree.length() || _contextFree[elementId];
+}
+
+void LVStyleSheet::buildIndex()
+{
+    _universal.clear();
+    _unkeyed.clear();
+    _classIndex.clear();
+    _idIndex.clear();
+    _buckets.clear();
+    _contextFree.clear();
+    _universalContextFree = true;
+    _indexed = true;
+    if ( !_selectors.length() )
+        return;
+    _universalContextFree = isChainContextFree( _selectors[0] );
+    for ( int i=0; i<_selectors.length(); i++ )
+        _contextFree.add( i==0 || isChainContextFree( _selectors[i] ) );
+    for ( LVCssSelector * p = _selectors[0]; p; p = p->getNext() ) {
+        int pos = _universal.length();
+        _universal.add( p );
+        LVCssSelectorRuleType type;
+        lString16 value;
+        if ( !p->getKey( type, value ) ) {
+            _unkeyed.add( pos );
+            continue;
+        }
+        LVHashTable<lString16, int> & index = type==cssrt_class ? _classIndex : _idIndex;
+        int bucket;
+        if ( !index.get( value, bucket ) ) {
+            bucket = _buckets.length();
+            _buckets.add( new LVArray<int>() );
+            index.set( value, bucket );
+        }
+        _buckets[bucket]->add( pos );
+    }
+}
+
+// returns next candidate of universal chain: item with lowest position from heads of candidate lists
+static inline LVCssSelector * nextUniversalCandidate( LVArray<LVCssSelector*> & universal, LVArray<int> * lists[], int pos[], int listCount )
+{
+    int best = -1;
+    for ( int i=0; i<listCount; i++ ) {
+        if ( pos[i] < lists[i]->length() && (best<0 || lists[i]->get(pos[i]) < lists[best]->get(pos[best])) )
+            best = i;
+    }
+    if ( best<0 )
+        return NULL;
+    return universal[ lists[best]->get( pos[best]++ ) ];
+}
+
 void LVStyleSheet::apply( const ldomNode * node, css_style_rec_t * style )
 {
     if (!_selectors.length())
         return; // no rules!
-        
+    if ( !_indexed )
+        buildIndex();
+
     lUInt16 id = node->getNodeId();
     
-    LVCssSelector * selector_0 = _selectors[0];
+    // universal selectors with .class or #id key which cannot match this node are skipped
+    LVArray<int> * lists[3];
+    int pos[3] = { 0, 0, 0 };
+    int listCount = 0;
+    lists[listCount++] = &_unkeyed;
+    if ( (_classIndex.length() || _idIndex.length()) && node->hasAttributes() ) {
+        int bucket;
+        if ( _classIndex.length() ) {
+            lString16 cls = node->getAttributeValue( attr_class );
+            if ( !cls.empty() ) {
+                cls.lowercase();
+                if ( _classIndex.get( cls, bucket ) )
+                    lists[listCount++] = _buckets[bucket];
+            }
+        }
+        if ( _idIndex.length() ) {
+            const lString16 & nodeId = node->getAttributeValue( attr_id );
+            if ( !nodeId.empty() && _idIndex.get( nodeId, bucket ) )
+                lists[listCount++] = _buckets[bucket];
+        }
+    }
+
+    LVCssSelector * selector_0 = nextUniversalCandidate( _universal, lists, pos, listCount );
     LVCssSelector * selector_id = id>0 && id<_selectors.length() ? _selectors[id] : NULL;
 
     for (;;)
@@ -1363,7 +1492,7 @@ void LVStyleSheet::apply( const ldomNode * node, css_style_rec_t * style )
             {
                 // step by sel_0
                 selector_0->apply( node, style );
-                selector_0 = selector_0->getNext();
+                selector_0 = nextUniversalCandidate( _universal, lists, pos, listCount );
             }
             else
             {
@@ -1427,6 +1556,7 @@ lUInt32 LVStyleSheet::getHash()
 
 bool LVStyleSheet::parse( const char * str )
 {
+    invalidateIndex();
     LVCssSelector * selector = NULL;
     LVCssSelector * prev_selector;
     int err_count = 0;
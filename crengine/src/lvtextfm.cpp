@@ -206,6 +206,37 @@ void lvtextAddSourceLine( formatted_text_fragment_t * pbuffer,
     pline->letter_spacing = letter_spacing;
 }
 
+void lvtextAddSourceLineUtf8( formatted_text_fragment_t * pbuffer,
+   lvfont_handle   font,     /* handle of font to draw string */
+   const lChar8 *  text,     /* pointer to utf-8 text */
+   lUInt32         len,      /* number of bytes in text */
+   lUInt32         color,    /* color */
+   lUInt32         bgcolor,  /* bgcolor */
+   lUInt32         flags,    /* flags */
+   lUInt8          interval, /* interline space, *16 (16=single, 32=double) */
+   lUInt16         margin,   /* first line margin */
+   void *          object,    /* pointer to custom object */
+   lUInt16         offset,
+   lInt8           letter_spacing
+                         )
+{
+    if ( !len )
+        return;
+    /* utf-8 text has at least as many bytes as characters */
+    lChar16 * buf = (lChar16*)malloc( len * sizeof(lChar16) );
+    int srclen = (int)len;
+    int dstlen = (int)len;
+    Utf8ToUnicode( (const lUInt8 *)text, srclen, buf, dstlen );
+    if ( !dstlen ) {
+        free( buf );
+        return;
+    }
+    lvtextAddSourceLine( pbuffer, font, buf, dstlen, color, bgcolor, flags & ~LTEXT_FLAG_OWNTEXT,
+        interval, margin, object, offset, letter_spacing );
+    /* buffer is owned by fragment now */
+    pbuffer->srctext[pbuffer->srctextlen-1].flags |= LTEXT_FLAG_OWNTEXT;
+}
+
 void lvtextAddSourceObject(
    formatted_text_fragment_t * pbuffer,
    lUInt16         width,
@@ -1370,7 +1401,7 @@ void LFormattedText::Draw( LVDrawBuf * buf, int x, int y, ldomMarkedRangeList *
                 {
                     srcline = &m_pbuffer->srctext[word->src_text_index];
                     ldomNode * node = (ldomNode *) srcline->object;
-                    LVImageSourceRef img = node->getObjectImageSource();
+                    LVImageSourceRef img = node->getObjectImageSource( word->width, word->o.height );
                     if ( img.isNull() )
                         img = LVCreateDummyImageSource( node, word->width, word->o.height );
                     int xx = x + frmline->x + word->x;
@@ -13,7 +13,7 @@
 
 /// change in case of incompatible changes in swap/cache file format to avoid using incompatible swap file
 // increment to force complete reload/reparsing of old file
-#define CACHE_FILE_FORMAT_VERSION "3.12.53"
+#define CACHE_FILE_FORMAT_VERSION "3.12.54"
 /// increment following value to force re-formatting of old book after load
 #define FORMATTING_VERSION_ID 0x0003
 
@@ -43,13 +43,17 @@
 
 #define WRITE_CACHE_TOTAL_SIZE    (10*DOC_BUFFER_SIZE/100)
 
-#define TEXT_CACHE_UNPACKED_SPACE (25*DOC_BUFFER_SIZE/100)
+#define TEXT_CACHE_UNPACKED_PERCENT 25
+#define TEXT_CACHE_UNPACKED_SPACE (TEXT_CACHE_UNPACKED_PERCENT*DOC_BUFFER_SIZE/100)
 #define TEXT_CACHE_CHUNK_SIZE     0x008000 // 32K
-#define ELEM_CACHE_UNPACKED_SPACE (45*DOC_BUFFER_SIZE/100)
+#define ELEM_CACHE_UNPACKED_PERCENT 45
+#define ELEM_CACHE_UNPACKED_SPACE (ELEM_CACHE_UNPACKED_PERCENT*DOC_BUFFER_SIZE/100)
 #define ELEM_CACHE_CHUNK_SIZE     0x004000 // 16K
-#define RECT_CACHE_UNPACKED_SPACE (15*DOC_BUFFER_SIZE/100)
+#define RECT_CACHE_UNPACKED_PERCENT 15
+#define RECT_CACHE_UNPACKED_SPACE (RECT_CACHE_UNPACKED_PERCENT*DOC_BUFFER_SIZE/100)
 #define RECT_CACHE_CHUNK_SIZE     0x008000 // 32K
-#define STYLE_CACHE_UNPACKED_SPACE (10*DOC_BUFFER_SIZE/100)
+#define STYLE_CACHE_UNPACKED_PERCENT 10
+#define STYLE_CACHE_UNPACKED_SPACE (STYLE_CACHE_UNPACKED_PERCENT*DOC_BUFFER_SIZE/100)
 #define STYLE_CACHE_CHUNK_SIZE    0x00C000 // 48K
 //--------------------------------------------------------
 
@@ -71,6 +75,30 @@
 #ifndef ENABLE_CACHE_FILE_CONTENTS_VALIDATION
 #define ENABLE_CACHE_FILE_CONTENTS_VALIDATION 1
 #endif
+/// set to 1 to compress and write cache file blocks on background thread (requires concurrencyProvider)
+#ifndef ENABLE_CACHE_FILE_BACKGROUND_WRITING
+#define ENABLE_CACHE_FILE_BACKGROUND_WRITING 0
+#endif
+/// max size of block data queued for background writing; writing thread waits when exceeded
+#ifndef CACHE_FILE_WRITE_QUEUE_SIZE
+#define CACHE_FILE_WRITE_QUEUE_SIZE 0x400000
+#endif
+/// set to 1 to enable reading and unpacking of cache file blocks ahead of sequential access on background thread (requires concurrencyProvider)
+#ifndef ENABLE_CACHE_FILE_PREFETCH
+#define ENABLE_CACHE_FILE_PREFETCH 0
+#endif
+/// max number of prefetched blocks kept in memory until requested
+#ifndef CACHE_FILE_PREFETCH_MAX_BLOCKS
+#define CACHE_FILE_PREFETCH_MAX_BLOCKS 16
+#endif
+/// number of chunks read ahead when sequential access to storage is detected
+#ifndef DOC_PREFETCH_CHUNK_COUNT
+#define DOC_PREFETCH_CHUNK_COUNT 4
+#endif
+/// number of subsequent chunk loads from cache file treated as sequential access
+#ifndef DOC_PREFETCH_SEQUENTIAL_LOADS
+#define DOC_PREFETCH_SEQUENTIAL_LOADS 2
+#endif
 
 #define RECT_DATA_CHUNK_ITEMS_SHIFT 11
 #define STYLE_DATA_CHUNK_ITEMS_SHIFT 12
@@ -126,7 +154,11 @@ enum CacheFileBlockType {
     CBT_STYLE_DATA,
     CBT_BLOB_INDEX, //15
     CBT_BLOB_DATA,
-    CBT_FONT_DATA  //17
+    CBT_FONT_DATA,  //17
+    CBT_BLOCK_GEOMETRY,
+    CBT_SEARCH_INDEX,
+    CBT_TABLE_CELLS,
+    CBT_RENDER_POSITIONS
 };
 
 
@@ -141,9 +173,16 @@ enum CacheFileBlockType {
 #include "../include/chmfmt.h"
 #endif
 #include "../include/crtest.h"
+#include "../include/crconcurrent.h"
 #include <stddef.h>
 #include <math.h>
+#include <time.h>
 #include <zlib.h>
+#ifdef _LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#endif
 
 // define to store new text nodes as persistent text, instead of mutable
 #define USE_PERSISTENT_TEXT 1
@@ -154,6 +193,16 @@ void enableCacheFileContentsValidation(bool enable) {
 	_enableCacheFileContentsValidation = enable;
 }
 
+static bool _enableCacheFileBackgroundWriting = (bool)ENABLE_CACHE_FILE_BACKGROUND_WRITING;
+void enableCacheFileBackgroundWriting(bool enable) {
+	_enableCacheFileBackgroundWriting = enable;
+}
+
+static bool _enableCacheFilePrefetch = (bool)ENABLE_CACHE_FILE_PREFETCH;
+void enableCacheFilePrefetch(bool enable) {
+	_enableCacheFilePrefetch = enable;
+}
+
 static int _nextDocumentIndex = 0;
 ldomDocument * ldomNode::_documentInstances[MAX_DOCUMENT_INSTANCE_COUNT] = {NULL,};
 
@@ -211,6 +260,11 @@ public:
         return _text;
     }
 
+    const lString8 & getTextRef()
+    {
+        return _text;
+    }
+
     lString16 getText16()
     {
         return Utf8ToUnicode(_text);
@@ -391,10 +445,54 @@ struct CacheFileHeader : public SimpleCacheFileHeader
     }
 };
 
+/// block snapshot queued for background writing; index flush request if buf is NULL
+struct CacheFileWriteRequest {
+    lUInt16 type;
+    lUInt16 index;
+    lUInt8 * buf;
+    int size;
+    bool compress;
+    lUInt64 hash;
+    CacheFileWriteRequest( lUInt16 _type, lUInt16 _index, lUInt8 * _buf, int _size, bool _compress, lUInt64 _hash )
+    : type(_type), index(_index), buf(_buf), size(_size), compress(_compress), hash(_hash)
+    {
+    }
+    ~CacheFileWriteRequest()
+    {
+        if ( buf )
+            free( buf );
+    }
+};
+
+/// unpacked block read ahead by background thread
+struct CacheFilePrefetchedBlock {
+    lUInt32 key;
+    lUInt8 * buf;
+    int size;
+    lUInt64 hash;
+    CacheFilePrefetchedBlock( lUInt32 _key, lUInt8 * _buf, int _size, lUInt64 _hash )
+    : key(_key), buf(_buf), size(_size), hash(_hash)
+    {
+    }
+    ~CacheFilePrefetchedBlock()
+    {
+        if ( buf )
+            free( buf );
+    }
+};
+
 /**
  * Cache file implementation.
+ *
+ * When background writing is enabled, write() only copies block data to queue,
+ * compression and file writes (including final index update and sync) are done
+ * by writer thread. All file access is guarded by _writerMonitor then,
+ * queued blocks are returned by read() until they are written.
+ *
+ * The same thread reads and unpacks blocks requested by prefetch() when there
+ * is nothing to write; read() takes prefetched data if block is not changed since.
  */
-class CacheFile
+class CacheFile : public CRRunnable
 {
     int _sectorSize; // block position and size granularity
     int _size;
@@ -404,6 +502,42 @@ class CacheFile
     LVPtrVector<CacheFileItem, true> _index; // full file block index
     LVPtrVector<CacheFileItem, false> _freeIndex; // free file block index
     LVHashTable<lUInt32, CacheFileItem*> _map; // hash map for fast search
+    CRMonitorRef _writerMonitor; // NULL if background writing is not started
+    CRThreadRef _writerThread;
+    LVPtrVector<CacheFileWriteRequest> _writeQueue; // first item is being written
+    int _writeQueueSize; // total size of queued blocks
+    bool _writerStopped;
+    bool _writeError;
+    bool _asyncWrite; // writes are queued for writer thread
+    LVArray<lUInt32> _prefetchQueue; // keys of blocks to read ahead
+    LVPtrVector<CacheFilePrefetchedBlock> _prefetched; // oldest first
+    lUInt32 _prefetchingKey; // block being unpacked by writer thread, 0 if none
+    // starts background writer thread
+    void startWriter();
+    // writes all queued blocks and stops writer thread
+    void stopWriter();
+    // compresses and writes queued block, or updates index
+    bool processWriteRequest( CacheFileWriteRequest * request );
+    // searches for queued snapshot of block
+    CacheFileWriteRequest * findQueuedBlock( lUInt16 type, lUInt16 index );
+    // returns false if block with the same data is already written
+    bool isBlockChanged( lUInt16 type, lUInt16 index, int size, lUInt64 hash );
+    // writes block data (already compressed, if uncompressedSize!=0)
+    bool storeBlock( lUInt16 type, lUInt16 dataIndex, const lUInt8 * buf, int size, lUInt32 uncompressedSize, lUInt64 hash, lUInt64 packedHash );
+    // writes block to file on current thread
+    bool writeBlock( lUInt16 type, lUInt16 dataIndex, const lUInt8 * buf, int size, bool compress );
+    // reads and allocates block in memory, on current thread
+    bool readBlock( lUInt16 type, lUInt16 dataIndex, lUInt8 * &buf, int &size );
+    // reads block data from file as is, on current thread
+    bool readBlockData( CacheFileItem * block, lUInt8 * &buf, int &size );
+    // reads and unpacks block requested by prefetch()
+    void processPrefetchRequest( lUInt32 key );
+    // returns position of block in prefetch queue, -1 if not queued
+    int findPrefetchRequest( lUInt32 key );
+    // removes prefetched copy of block, returns it if it's still valid
+    CacheFilePrefetchedBlock * takePrefetchedBlock( lUInt32 key );
+    // writes index and clears dirty flag
+    bool flushIndex();
     // searches for existing block
     CacheFileItem * findBlock( lUInt16 type, lUInt16 index );
     // alocates block at index, reuses existing one, if possible
@@ -437,8 +571,12 @@ public:
     bool write( lUInt16 type, lUInt16 dataIndex, const lUInt8 * buf, int size, bool compress );
     /// reads and allocates block in memory
     bool read( lUInt16 type, lUInt16 dataIndex, lUInt8 * &buf, int &size );
+    /// requests reading and unpacking of block on background thread, to be returned by next read(); returns false if not supported
+    bool prefetch( lUInt16 type, lUInt16 dataIndex );
     /// reads and validates block
     bool validate( CacheFileItem * block );
+    /// returns true if block is present in file
+    bool hasBlock( lUInt16 type, lUInt16 dataIndex = 0 );
     /// writes content of serial buffer
     bool write( lUInt16 type, lUInt16 index, SerialBuf & buf, bool compress );
     /// reads content of serial buffer
@@ -465,20 +603,26 @@ public:
         return (n + (_sectorSize-1)) & ~(_sectorSize-1);
     }
     void setAutoSyncSize(int sz) {
+        CRGuard guard(_writerMonitor);
+        CR_UNUSED(guard);
         _stream->setAutoSyncSize(sz);
     }
+    /// writer and prefetch thread body
+    virtual void run();
 };
 
 
 // create uninitialized cache file, call open or create to initialize
 CacheFile::CacheFile()
 : _sectorSize( CACHE_FILE_SECTOR_SIZE ), _size(0), _indexChanged(false), _dirty(true), _map(1024)
+, _writeQueueSize(0), _writerStopped(false), _writeError(false), _asyncWrite(false), _prefetchingKey(0)
 {
 }
 
 // free resources
 CacheFile::~CacheFile()
 {
+    stopWriter();
     if ( !_stream.isNull() ) {
         // don't flush -- leave file dirty
         //CRTimerUtil infinite;
@@ -509,14 +653,34 @@ bool CacheFile::setDirtyFlag( bool dirty )
     return true;
 }
 
+// writes index and clears dirty flag
+bool CacheFile::flushIndex()
+{
+    //setDirtyFlag(true);
+    if ( !writeIndex() )
+        return false;
+    setDirtyFlag(false);
+    return true;
+}
+
 // flushes index
 bool CacheFile::flush( bool clearDirtyFlag, CRTimerUtil & maxTime )
 {
+    if ( _asyncWrite ) {
+        // writer thread syncs file itself; index is written after all blocks queued before
+        CRGuard guard(_writerMonitor);
+        CR_UNUSED(guard);
+        if ( clearDirtyFlag && !_writeError ) {
+            _writeQueue.add( new CacheFileWriteRequest( CBT_INDEX, 0, NULL, 0, false, 0 ) );
+            _writerMonitor->notifyAll();
+        }
+        return !_writeError;
+    }
+    CRGuard guard(_writerMonitor);
+    CR_UNUSED(guard);
     if ( clearDirtyFlag ) {
-        //setDirtyFlag(true);
-        if ( !writeIndex() )
+        if ( !flushIndex() )
             return false;
-        setDirtyFlag(false);
     } else {
         _stream->Flush(false, maxTime);
         //CRLog::trace("CacheFile->flush() took %d ms ", (int)timer.elapsed());
@@ -640,7 +804,7 @@ bool CacheFile::writeIndex()
             index[i]._dataSize = 0;
         }
     }
-    bool res = write(CBT_INDEX, 0, (const lUInt8*)index, sz, false);
+    bool res = writeBlock(CBT_INDEX, 0, (const lUInt8*)index, sz, false);
     delete[] index;
 
     indexItem = findBlock(CBT_INDEX, 0);
@@ -683,6 +847,16 @@ void CacheFile::freeBlock( CacheFileItem * block )
 /// reads block as a stream
 LVStreamRef CacheFile::readStream(lUInt16 type, lUInt16 index)
 {
+    if ( !_writerMonitor.isNull() ) {
+        // file stream cannot be shared with background thread: return copy of block
+        lUInt8 * buf = NULL;
+        int size = 0;
+        if ( !hasBlock(type, index) || !read(type, index, buf, size) )
+            return LVStreamRef();
+        LVStreamRef res = LVCreateMemoryStream(buf, size, true);
+        free(buf);
+        return res;
+    }
     CacheFileItem * block = findBlock(type, index);
     if (block && block->_dataSize) {
 #if 0
@@ -697,6 +871,25 @@ LVStreamRef CacheFile::readStream(lUInt16 type, lUInt16 index)
     return LVStreamRef();
 }
 
+/// returns true if block is present in file
+bool CacheFile::hasBlock( lUInt16 type, lUInt16 dataIndex )
+{
+    CRGuard guard(_writerMonitor);
+    CR_UNUSED(guard);
+    return findQueuedBlock( type, dataIndex )!=NULL || findBlock( type, dataIndex )!=NULL;
+}
+
+// searches for queued snapshot of block
+CacheFileWriteRequest * CacheFile::findQueuedBlock( lUInt16 type, lUInt16 index )
+{
+    for ( int i=_writeQueue.length()-1; i>=0; i-- ) {
+        CacheFileWriteRequest * request = _writeQueue[i];
+        if ( request->buf && request->type==type && request->index==index )
+            return request;
+    }
+    return NULL;
+}
+
 // searches for existing block
 CacheFileItem * CacheFile::findBlock( lUInt16 type, lUInt16 index )
 {
@@ -788,32 +981,11 @@ bool CacheFile::validate( CacheFileItem * block )
     return true;
 }
 
-// reads and allocates block in memory
-bool CacheFile::read( lUInt16 type, lUInt16 dataIndex, lUInt8 * &buf, int &size )
+// checks CRC and uncompresses data read for block, frees buffer on error
+static bool unpackCacheFileBlock( CacheFileItem * block, lUInt8 * &buf, int &size )
 {
-    buf = NULL;
-    size = 0;
-    CacheFileItem * block = findBlock( type, dataIndex );
-    if ( !block ) {
-        CRLog::error("CacheFile::read: Block %d:%d not found in file", type, dataIndex);
-        return false;
-    }
-    if ( (int)_stream->SetPos( block->_blockFilePos )!=block->_blockFilePos )
-        return false;
-
-    // read block from file
-    size = block->_dataSize;
-    buf = (lUInt8 *)malloc(size);
-    lvsize_t bytesRead = 0;
-    _stream->Read(buf, size, &bytesRead );
-    if ( (int)bytesRead!=size ) {
-        CRLog::error("CacheFile::read: Cannot read block %d:%d of size %d", type, dataIndex, (int)size);
-        free(buf);
-        buf = NULL;
-        size = 0;
-        return false;
-    }
-
+    int type = block->_dataType;
+    int dataIndex = block->_dataIndex;
     bool compress = block->_uncompressedSize!=0;
 
     if ( compress ) {
@@ -858,49 +1030,248 @@ bool CacheFile::read( lUInt16 type, lUInt16 dataIndex, lUInt8 * &buf, int &size
     return true;
 }
 
-// writes block to file
-bool CacheFile::write( lUInt16 type, lUInt16 dataIndex, const lUInt8 * buf, int size, bool compress )
+// reads and allocates block in memory
+bool CacheFile::read( lUInt16 type, lUInt16 dataIndex, lUInt8 * &buf, int &size )
 {
-    // check whether data is changed
-    lUInt64 newhash = calcHash64( buf, size );
-    CacheFileItem * existingblock = findBlock( type, dataIndex );
+    CRGuard guard(_writerMonitor);
+    CR_UNUSED(guard);
+    CacheFileWriteRequest * request = findQueuedBlock( type, dataIndex );
+    if ( request ) {
+        // block is not written yet
+        size = request->size;
+        buf = (lUInt8 *)malloc(size > 0 ? size : 1);
+        memcpy( buf, request->buf, size );
+        return true;
+    }
+    if ( !_writerMonitor.isNull() ) {
+        lUInt32 key = ((lUInt32)type)<<16 | dataIndex;
+        // don't unpack the same block twice
+        while ( _prefetchingKey==key )
+            _writerMonitor->wait();
+        CacheFilePrefetchedBlock * prefetched = takePrefetchedBlock( key );
+        if ( prefetched ) {
+            buf = prefetched->buf;
+            size = prefetched->size;
+            prefetched->buf = NULL;
+            delete prefetched;
+            return true;
+        }
+        int pos = findPrefetchRequest( key );
+        if ( pos>=0 )
+            _prefetchQueue.erase( pos, 1 );
+    }
+    return readBlock( type, dataIndex, buf, size );
+}
+
+// returns position of block in prefetch queue, -1 if not queued
+int CacheFile::findPrefetchRequest( lUInt32 key )
+{
+    for ( int i=0; i<_prefetchQueue.length(); i++ )
+        if ( _prefetchQueue[i]==key )
+            return i;
+    return -1;
+}
+
+// removes prefetched copy of block, returns it if it's still valid
+CacheFilePrefetchedBlock * CacheFile::takePrefetchedBlock( lUInt32 key )
+{
+    for ( int i=0; i<_prefetched.length(); i++ ) {
+        if ( _prefetched[i]->key!=key )
+            continue;
+        CacheFilePrefetchedBlock * prefetched = _prefetched.remove( i );
+        CacheFileItem * block = findBlock( (lUInt16)(key>>16), (lUInt16)(key & 0xFFFF) );
+        if ( block && block->_dataHash==prefetched->hash )
+            return prefetched;
+        // block is rewritten after prefetch
+        delete prefetched;
+        return NULL;
+    }
+    return NULL;
+}
+
+/// requests reading and unpacking of block on background thread, to be returned by next read(); returns false if not supported
+bool CacheFile::prefetch( lUInt16 type, lUInt16 dataIndex )
+{
+    if ( !_enableCacheFilePrefetch )
+        return false;
+    if ( _writerMonitor.isNull() )
+        startWriter();
+    if ( _writerMonitor.isNull() )
+        return false;
+    lUInt32 key = ((lUInt32)type)<<16 | dataIndex;
+    CRGuard guard(_writerMonitor);
+    CR_UNUSED(guard);
+    if ( _writerStopped || key==_prefetchingKey || findPrefetchRequest( key )>=0 )
+        return true;
+    for ( int i=0; i<_prefetched.length(); i++ )
+        if ( _prefetched[i]->key==key )
+            return true;
+    if ( findQueuedBlock( type, dataIndex ) || !findBlock( type, dataIndex ) )
+        return true;
+    _prefetchQueue.add( key );
+    _writerMonitor->notifyAll();
+    return true;
+}
+
+// reads and unpacks block requested by prefetch()
+void CacheFile::processPrefetchRequest( lUInt32 key )
+{
+    lUInt16 type = (lUInt16)(key>>16);
+    lUInt16 dataIndex = (lUInt16)(key & 0xFFFF);
+    lUInt8 * buf = NULL;
+    int size = 0;
+    CacheFileItem info( type, dataIndex );
+    {
+        CRGuard guard(_writerMonitor);
+        CR_UNUSED(guard);
+        CacheFileItem * block = findBlock( type, dataIndex );
+        if ( !block || findQueuedBlock( type, dataIndex ) || !readBlockData( block, buf, size ) ) {
+            _prefetchingKey = 0;
+            _writerMonitor->notifyAll();
+            return;
+        }
+        info = *block;
+    }
+    // unpacking is done without lock
+    bool res = unpackCacheFileBlock( &info, buf, size );
+    CRGuard guard(_writerMonitor);
+    CR_UNUSED(guard);
+    if ( res ) {
+        if ( _prefetched.length()>=CACHE_FILE_PREFETCH_MAX_BLOCKS )
+            _prefetched.erase( 0, 1 );
+        _prefetched.add( new CacheFilePrefetchedBlock( key, buf, size, info._dataHash ) );
+    }
+    _prefetchingKey = 0;
+    _writerMonitor->notifyAll();
+}
+
+// reads block data from file as is, on current thread
+bool CacheFile::readBlockData( CacheFileItem * block, lUInt8 * &buf, int &size )
+{
+    buf = NULL;
+    size = 0;
+    if ( (int)_stream->SetPos( block->_blockFilePos )!=block->_blockFilePos )
+        return false;
+
+    // read block from file
+    size = block->_dataSize;
+    buf = (lUInt8 *)malloc(size);
+    lvsize_t bytesRead = 0;
+    _stream->Read(buf, size, &bytesRead );
+    if ( (int)bytesRead!=size ) {
+        CRLog::error("CacheFile::read: Cannot read block %d:%d of size %d", block->_dataType, block->_dataIndex, (int)size);
+        free(buf);
+        buf = NULL;
+        size = 0;
+        return false;
+    }
+    return true;
+}
+
+// reads and allocates block in memory, on current thread
+bool CacheFile::readBlock( lUInt16 type, lUInt16 dataIndex, lUInt8 * &buf, int &size )
+{
+    buf = NULL;
+    size = 0;
+    CacheFileItem * block = findBlock( type, dataIndex );
+    if ( !block ) {
+        CRLog::error("CacheFile::read: Block %d:%d not found in file", type, dataIndex);
+        return false;
+    }
+    if ( !readBlockData( block, buf, size ) )
+        return false;
+    return unpackCacheFileBlock( block, buf, size );
+}
 
+
+// returns false if block with the same data is already written
+bool CacheFile::isBlockChanged( lUInt16 type, lUInt16 index, int size, lUInt64 hash )
+{
+    CacheFileItem * existingblock = findBlock( type, index );
     if (existingblock) {
         bool sameSize = ((int)existingblock->_uncompressedSize==size) || (existingblock->_uncompressedSize==0 && (int)existingblock->_dataSize==size);
-        if (sameSize && existingblock->_dataHash == newhash ) {
-            return true;
+        if (sameSize && existingblock->_dataHash == hash ) {
+            return false;
         }
     }
+    return true;
+}
+
+// compresses block data if requested, returns false if data should be written uncompressed
+static bool packCacheFileBlock( const lUInt8 * buf, int size, bool compress, lUInt8 * &dstbuf, lUInt32 &dstsize )
+{
+#if DOC_DATA_COMPRESSION_LEVEL==0
+    CR_UNUSED5(buf, size, compress, dstbuf, dstsize);
+    return false;
+#else
+    return compress && ldomPack( buf, size, dstbuf, dstsize );
+#endif
+}
+
+// writes block to file
+bool CacheFile::write( lUInt16 type, lUInt16 dataIndex, const lUInt8 * buf, int size, bool compress )
+{
+    if ( !_asyncWrite && _enableCacheFileBackgroundWriting ) {
+        if ( _writerMonitor.isNull() )
+            startWriter();
+        _asyncWrite = !_writerMonitor.isNull();
+    }
+    if ( !_asyncWrite ) {
+        CRGuard guard(_writerMonitor);
+        CR_UNUSED(guard);
+        return writeBlock( type, dataIndex, buf, size, compress );
+    }
+
+    lUInt64 newhash = calcHash64( buf, size );
+    CRGuard guard(_writerMonitor);
+    CR_UNUSED(guard);
+    if ( _writeError )
+        return false;
+    // check whether data is changed
+    CacheFileWriteRequest * queued = findQueuedBlock( type, dataIndex );
+    if ( queued ? (queued->size==size && queued->hash==newhash) : !isBlockChanged( type, dataIndex, size, newhash ) )
+        return true;
+    while ( _writeQueueSize > 0 && _writeQueueSize + size > CACHE_FILE_WRITE_QUEUE_SIZE && !_writeError )
+        _writerMonitor->wait();
+    // snapshot of data: caller may change or free its buffer right after return
+    lUInt8 * copy = (lUInt8 *)malloc( size > 0 ? size : 1 );
+    memcpy( copy, buf, size );
+    _writeQueue.add( new CacheFileWriteRequest( type, dataIndex, copy, size, compress, newhash ) );
+    _writeQueueSize += size;
+    _writerMonitor->notifyAll();
+    return true;
+}
+
+// writes block to file on current thread
+bool CacheFile::writeBlock( lUInt16 type, lUInt16 dataIndex, const lUInt8 * buf, int size, bool compress )
+{
+    // check whether data is changed
+    lUInt64 newhash = calcHash64( buf, size );
+    if ( !isBlockChanged( type, dataIndex, size, newhash ) )
+        return true;
 
 #if 0
-    if (existingblock)
-        CRLog::trace("*    oldsz=%d oldhash=%08x", (int)existingblock->_uncompressedSize, (int)existingblock->_dataHash);
     CRLog::trace("* wr block t=%d[%d] sz=%d hash=%08x", type, dataIndex, size, newhash);
 #endif
     setDirtyFlag(true);
 
-    lUInt32 uncompressedSize = 0;
-    lUInt64 newpackedhash = newhash;
-#if DOC_DATA_COMPRESSION_LEVEL==0
-    compress = false;
-#else
-    if ( compress ) {
-        lUInt8 * dstbuf = NULL;
-        lUInt32 dstsize = 0;
-        if ( !ldomPack( buf, size, dstbuf, dstsize ) ) {
-            compress = false;
-        } else {
-            uncompressedSize = size;
-            size = dstsize;
-            buf = dstbuf;
-            newpackedhash = calcHash64( buf, size );
+    lUInt8 * dstbuf = NULL;
+    lUInt32 dstsize = 0;
+    if ( packCacheFileBlock( buf, size, compress, dstbuf, dstsize ) ) {
 #if DEBUG_DOM_STORAGE==1
-            //CRLog::trace("packed block %d:%d : %d to %d bytes (%d%%)", type, dataIndex, srcsize, dstsize, srcsize>0?(100*dstsize/srcsize):0 );
+        //CRLog::trace("packed block %d:%d : %d to %d bytes (%d%%)", type, dataIndex, srcsize, dstsize, srcsize>0?(100*dstsize/srcsize):0 );
 #endif
-        }
+        bool res = storeBlock( type, dataIndex, dstbuf, dstsize, size, newhash, calcHash64( dstbuf, dstsize ) );
+        free( dstbuf );
+        return res;
     }
-#endif
+    return storeBlock( type, dataIndex, buf, size, 0, newhash, newhash );
+}
 
+// writes block data (already compressed, if uncompressedSize!=0)
+bool CacheFile::storeBlock( lUInt16 type, lUInt16 dataIndex, const lUInt8 * buf, int size, lUInt32 uncompressedSize, lUInt64 hash, lUInt64 packedHash )
+{
+    CacheFileItem * existingblock = findBlock( type, dataIndex );
     CacheFileItem * block = NULL;
     if ( existingblock && existingblock->_dataSize>=size ) {
         // reuse existing block
@@ -943,15 +1314,10 @@ bool CacheFile::write( lUInt16 type, lUInt16 dataIndex, const lUInt8 * buf, int
 #endif
     //_stream->Flush(true);
     // update CRC
-    block->_dataHash = newhash;
-    block->_packedHash = newpackedhash;
+    block->_dataHash = hash;
+    block->_packedHash = packedHash;
     block->_uncompressedSize = uncompressedSize;
 
-#if DOC_DATA_COMPRESSION_LEVEL!=0
-    if ( compress ) {
-        free( (void*)buf );
-    }
-#endif
     _indexChanged = true;
 
     //CRLog::error("CacheFile::write: block %d:%d (pos %ds, size %ds) is written (crc=%08x)", type, dataIndex, (int)block->_blockFilePos/_sectorSize, (int)(size+_sectorSize-1)/_sectorSize, block->_dataCRC);
@@ -959,6 +1325,112 @@ bool CacheFile::write( lUInt16 type, lUInt16 dataIndex, const lUInt8 * buf, int
     return true;
 }
 
+// starts background writer thread
+void CacheFile::startWriter()
+{
+    if ( !concurrencyProvider || _stream.isNull() )
+        return;
+    _writerMonitor = concurrencyProvider->createMonitor();
+    _writerThread = concurrencyProvider->createThread( this );
+    _writerThread->start();
+}
+
+// writes all queued blocks and stops writer thread
+void CacheFile::stopWriter()
+{
+    if ( _writerMonitor.isNull() )
+        return;
+    {
+        CRGuard guard(_writerMonitor);
+        CR_UNUSED(guard);
+        _writerStopped = true;
+        _writerMonitor->notifyAll();
+    }
+    _writerThread->join();
+    _writerThread.clear();
+    _writerMonitor.clear();
+}
+
+/// writer and prefetch thread body
+void CacheFile::run()
+{
+    for ( ;; ) {
+        CacheFileWriteRequest * request = NULL;
+        lUInt32 prefetchKey = 0;
+        {
+            CRGuard guard(_writerMonitor);
+            CR_UNUSED(guard);
+            while ( _writeQueue.length()==0 && _prefetchQueue.length()==0 && !_writerStopped )
+                _writerMonitor->wait();
+            if ( _writeQueue.length()==0 ) {
+                if ( _writerStopped )
+                    break;
+                // writing has priority over reading ahead
+                prefetchKey = _prefetchingKey = _prefetchQueue[0];
+                _prefetchQueue.erase( 0, 1 );
+            } else {
+                // request stays in queue until written, to be found by readers
+                request = _writeQueue[0];
+            }
+        }
+        if ( !request ) {
+            processPrefetchRequest( prefetchKey );
+            continue;
+        }
+        bool res = processWriteRequest( request );
+        {
+            CRGuard guard(_writerMonitor);
+            CR_UNUSED(guard);
+            _writeQueue.remove( 0 );
+            _writeQueueSize -= request->size;
+            if ( !res )
+                _writeError = true;
+            _writerMonitor->notifyAll();
+        }
+        delete request;
+    }
+}
+
+// compresses and writes queued block, or updates index
+bool CacheFile::processWriteRequest( CacheFileWriteRequest * request )
+{
+    if ( !request->buf ) {
+        CRGuard guard(_writerMonitor);
+        CR_UNUSED(guard);
+        if ( !flushIndex() ) {
+            CRLog::error("CacheFile: error while updating index");
+            return false;
+        }
+        return true;
+    }
+    {
+        CRGuard guard(_writerMonitor);
+        CR_UNUSED(guard);
+        if ( !isBlockChanged( request->type, request->index, request->size, request->hash ) )
+            return true;
+        setDirtyFlag(true);
+    }
+    // compression is done without lock, readers get queued copy meanwhile
+    lUInt8 * dstbuf = NULL;
+    lUInt32 dstsize = 0;
+    bool packed = packCacheFileBlock( request->buf, request->size, request->compress, dstbuf, dstsize );
+    lUInt64 packedHash = packed ? calcHash64( dstbuf, dstsize ) : request->hash;
+    bool res;
+    {
+        CRGuard guard(_writerMonitor);
+        CR_UNUSED(guard);
+        if ( packed )
+            res = storeBlock( request->type, request->index, dstbuf, dstsize, request->size, request->hash, packedHash );
+        else
+            res = storeBlock( request->type, request->index, request->buf, request->size, 0, request->hash, packedHash );
+    }
+    if ( dstbuf )
+        free( dstbuf );
+    if ( !res )
+        CRLog::error("CacheFile: cannot write block %d:%d", request->type, request->index);
+    return res;
+}
+
 /// writes content of serial buffer
 bool CacheFile::write( lUInt16 type, lUInt16 index, SerialBuf & buf, bool compress )
 {
@@ -1451,8 +1923,12 @@ struct ElementDataStorageItem : public DataStorageItemHeader {
 tinyNodeCollection::tinyNodeCollection()
 : _textCount(0)
 , _textNextFree(0)
+, _textList(NULL)
+, _textListSize(0)
 , _elemCount(0)
 , _elemNextFree(0)
+, _elemList(NULL)
+, _elemListSize(0)
 , _styles(STYLE_HASH_TABLE_SIZE)
 , _fonts(FONT_HASH_TABLE_SIZE)
 , _tinyElementCount(0)
@@ -1473,16 +1949,20 @@ tinyNodeCollection::tinyNodeCollection()
 ,_docFlags(DOC_FLAG_DEFAULTS)
 ,_fontMap(113)
 {
-    memset( _textList, 0, sizeof(_textList) );
-    memset( _elemList, 0, sizeof(_elemList) );
+    growNodeList( _textList, _textListSize, 0 );
+    growNodeList( _elemList, _elemListSize, 0 );
     _docIndex = ldomNode::registerDocument((ldomDocument*)this);
 }
 
 tinyNodeCollection::tinyNodeCollection( tinyNodeCollection & v )
 : _textCount(0)
 , _textNextFree(0)
+, _textList(NULL)
+, _textListSize(0)
 , _elemCount(0)
 , _elemNextFree(0)
+, _elemList(NULL)
+, _elemListSize(0)
 , _styles(STYLE_HASH_TABLE_SIZE)
 , _fonts(FONT_HASH_TABLE_SIZE)
 , _tinyElementCount(0)
@@ -1504,6 +1984,8 @@ tinyNodeCollection::tinyNodeCollection( tinyNodeCollection & v )
 ,_stylesheet(v._stylesheet)
 ,_fontMap(113)
 {
+    growNodeList( _textList, _textListSize, 0 );
+    growNodeList( _elemList, _elemListSize, 0 );
     _docIndex = ldomNode::registerDocument((ldomDocument*)this);
 }
 
@@ -1683,7 +2165,7 @@ lUInt16 tinyNodeCollection::getNodeFontIndex( lUInt32 dataIndex )
 bool tinyNodeCollection::loadNodeData(lUInt16 type, ldomNode ** list, int nodecount)
 {
     int count = ((nodecount + TNC_PART_LEN - 1) >> TNC_PART_SHIFT);
-    for (lUInt16 i=0; i<count; i++) {
+    for (int i=0; i<count; i++) {
         int offs = i*TNC_PART_LEN;
         int sz = TNC_PART_LEN;
         if (offs + sz > nodecount) {
@@ -1692,11 +2174,16 @@ bool tinyNodeCollection::loadNodeData(lUInt16 type, ldomNode ** list, int nodeco
 
         lUInt8 * p;
         int buflen;
-        if (!_cacheFile->read( type, i, p, buflen ))
+        if (!_cacheFile->read( type, (lUInt16)i, p, buflen ))
             return false;
         ldomNode * buf = (ldomNode *)p;
         if (!buf || (unsigned)buflen != sizeof(ldomNode) * sz)
             return false;
+        if (sz < TNC_PART_LEN) {
+            // last part is saved partially: make room for nodes allocated after loading
+            buf = (ldomNode *)realloc(buf, sizeof(ldomNode) * TNC_PART_LEN);
+            memset(buf + sz, 0, sizeof(ldomNode) * (TNC_PART_LEN - sz));
+        }
         list[i] = buf;
         for (int j=0; j<sz; j++) {
             buf[j].setDocumentIndex( _docIndex );
@@ -1714,7 +2201,7 @@ bool tinyNodeCollection::loadNodeData(lUInt16 type, ldomNode ** list, int nodeco
 bool tinyNodeCollection::saveNodeData( lUInt16 type, ldomNode ** list, int nodecount )
 {
     int count = ((nodecount+TNC_PART_LEN-1) >> TNC_PART_SHIFT);
-    for (lUInt16 i=0; i<count; i++) {
+    for (int i=0; i<count; i++) {
         if (!list[i])
             continue;
         int offs = i*TNC_PART_LEN;
@@ -1726,7 +2213,7 @@ bool tinyNodeCollection::saveNodeData( lUInt16 type, ldomNode ** list, int nodec
         memcpy(buf, list[i], sizeof(ldomNode) * sz);
         for (int j = 0; j < sz; j++)
             buf[j].setDocumentIndex(_docIndex);
-        if (!_cacheFile->write(type, i, (lUInt8*)buf, sizeof(ldomNode) * sz, COMPRESS_NODE_DATA))
+        if (!_cacheFile->write(type, (lUInt16)i, (lUInt8*)buf, sizeof(ldomNode) * sz, COMPRESS_NODE_DATA))
             crFatalError(-1, "Cannot write node data");
     }
     return true;
@@ -1758,38 +2245,41 @@ bool tinyNodeCollection::loadNodeData()
     if ( magic != NODE_INDEX_MAGIC ) {
         return false;
     }
-    if ( elemcount<=0 || elemcount>200000 )
-        return false;
-    if ( textcount<=0 || textcount>200000 )
+    if ( elemcount<=0 || elemcount>=TNC_PART_COUNT_MAX*TNC_PART_LEN )
         return false;
-    ldomNode * elemList[TNC_PART_COUNT];
-    memset( elemList, 0, sizeof(elemList) );
-    ldomNode * textList[TNC_PART_COUNT];
-    memset( textList, 0, sizeof(textList) );
-    if ( !loadNodeData( CBT_ELEM_NODE, elemList, elemcount+1 ) ) {
-        for ( int i=0; i<TNC_PART_COUNT; i++ )
-            if ( elemList[i] )
-                free( elemList[i] );
+    if ( textcount<=0 || textcount>=TNC_PART_COUNT_MAX*TNC_PART_LEN )
         return false;
-    }
-    if ( !loadNodeData( CBT_TEXT_NODE, textList, textcount+1 ) ) {
-        for ( int i=0; i<TNC_PART_COUNT; i++ )
-            if ( textList[i] )
-                free( textList[i] );
+    ldomNode ** elemList = NULL;
+    int elemListSize = 0;
+    growNodeList( elemList, elemListSize, elemcount >> TNC_PART_SHIFT );
+    ldomNode ** textList = NULL;
+    int textListSize = 0;
+    growNodeList( textList, textListSize, textcount >> TNC_PART_SHIFT );
+    if ( !loadNodeData( CBT_ELEM_NODE, elemList, elemcount+1 )
+         || !loadNodeData( CBT_TEXT_NODE, textList, textcount+1 ) ) {
+        freeNodeData( elemList, elemListSize );
+        freeNodeData( textList, textListSize );
         return false;
     }
-    for ( int i=0; i<TNC_PART_COUNT; i++ ) {
-        if ( _elemList[i] )
-            free( _elemList[i] );
-        if ( _textList[i] )
-            free( _textList[i] );
-    }
-    memcpy( _elemList, elemList, sizeof(elemList) );
-    memcpy( _textList, textList, sizeof(textList) );
+    freeNodeData( _elemList, _elemListSize );
+    freeNodeData( _textList, _textListSize );
+    _elemList = elemList;
+    _elemListSize = elemListSize;
+    _textList = textList;
+    _textListSize = textListSize;
     _elemCount = elemcount;
     _textCount = textcount;
     return true;
 }
+
+/// frees node parts of list allocated by loadNodeData()
+void tinyNodeCollection::freeNodeData( ldomNode ** list, int size )
+{
+    for ( int i=0; i<size; i++ )
+        if ( list[i] )
+            free( list[i] );
+    free( list );
+}
 #endif
 
 /// get ldomNode instance pointer
@@ -1818,6 +2308,8 @@ ldomNode * tinyNodeCollection::allocTinyNode( int type )
         } else {
             // create new item
             _elemCount++;
+            if ( (_elemCount >> TNC_PART_SHIFT) >= _elemListSize )
+                growNodeList( _elemList, _elemListSize, _elemCount >> TNC_PART_SHIFT );
             ldomNode * part = _elemList[_elemCount >> TNC_PART_SHIFT];
             if ( !part ) {
                 part = (ldomNode*)malloc( sizeof(ldomNode) * TNC_PART_LEN );
@@ -1840,6 +2332,8 @@ ldomNode * tinyNodeCollection::allocTinyNode( int type )
         } else {
             // create new item
             _textCount++;
+            if ( (_textCount >> TNC_PART_SHIFT) >= _textListSize )
+                growNodeList( _textList, _textListSize, _textCount >> TNC_PART_SHIFT );
             ldomNode * part = _textList[_textCount >> TNC_PART_SHIFT];
             if ( !part ) {
                 part = (ldomNode*)malloc( sizeof(ldomNode) * TNC_PART_LEN );
@@ -1855,6 +2349,23 @@ ldomNode * tinyNodeCollection::allocTinyNode( int type )
     return res;
 }
 
+/// grows node part list to have room for part with specified index
+void tinyNodeCollection::growNodeList( ldomNode ** & list, int & size, int partIndex )
+{
+    if ( partIndex < size )
+        return;
+    if ( partIndex >= TNC_PART_COUNT_MAX )
+        crFatalError( 126, "Too many nodes in document" );
+    int newSize = size ? size : TNC_PART_COUNT;
+    while ( newSize <= partIndex )
+        newSize *= 2;
+    if ( newSize > TNC_PART_COUNT_MAX )
+        newSize = TNC_PART_COUNT_MAX;
+    list = (ldomNode **)realloc( list, sizeof(ldomNode *) * newSize );
+    memset( list + size, 0, sizeof(ldomNode *) * (newSize - size) );
+    size = newSize;
+}
+
 void tinyNodeCollection::recycleTinyNode( lUInt32 index )
 {
     if ( index & 1 ) {
@@ -1906,6 +2417,8 @@ tinyNodeCollection::~tinyNodeCollection()
             _textList[partindex] = NULL;
         }
     }
+    free( _elemList );
+    free( _textList );
     ldomNode::unregisterDocument((ldomDocument*)this);
 }
 
@@ -2049,6 +2562,7 @@ bool ldomDataStorageManager::load()
 ldomTextStorageChunk * ldomDataStorageManager::getChunk( lUInt32 address )
 {
     ldomTextStorageChunk * chunk = _chunks[address>>16];
+    chunk->_lastAccess = ldomMemoryGovernor::touch();
     if ( chunk!=_recentChunk ) {
         if ( chunk->_prevRecent )
             chunk->_prevRecent->_nextRecent = chunk->_nextRecent;
@@ -2068,16 +2582,52 @@ void ldomDataStorageManager::setCache( CacheFile * cache )
     _cache = cache;
 }
 
-/// type
-lUInt16 ldomDataStorageManager::cacheType()
+/// called when chunk is read from cache file, reads next chunks ahead on sequential access
+void ldomDataStorageManager::chunkLoaded( int index )
 {
-    switch ( _type ) {
-    case 't':
-        return CBT_TEXT_DATA;
-    case 'e':
-        return CBT_ELEM_DATA;
-    case 'r':
-        return CBT_RECT_DATA;
+#if BUILD_LITE!=1
+    if ( index==_lastLoadedChunk + 1 ) {
+        if ( ++_sequentialLoads>=DOC_PREFETCH_SEQUENTIAL_LOADS )
+            prefetchChunks( index + 1, index + DOC_PREFETCH_CHUNK_COUNT );
+    } else {
+        _sequentialLoads = 0;
+    }
+#endif
+    _lastLoadedChunk = index;
+}
+
+#if BUILD_LITE!=1
+/// requests reading of packed chunks in range (inclusive) from cache file on background thread
+void ldomDataStorageManager::prefetchChunks( int first, int last )
+{
+    if ( !_cache )
+        return;
+    if ( first<0 )
+        first = 0;
+    if ( last>=_chunks.length() )
+        last = _chunks.length() - 1;
+    if ( last>=first + DOC_PREFETCH_CHUNK_COUNT )
+        last = first + DOC_PREFETCH_CHUNK_COUNT - 1;
+    for ( int i=first; i<=last; i++ ) {
+        ldomTextStorageChunk * chunk = _chunks[i];
+        if ( chunk->_buf || !chunk->_saved )
+            continue;
+        if ( !_cache->prefetch( cacheType(), (lUInt16)i ) )
+            break;
+    }
+}
+#endif
+
+/// type
+lUInt16 ldomDataStorageManager::cacheType()
+{
+    switch ( _type ) {
+    case 't':
+        return CBT_TEXT_DATA;
+    case 'e':
+        return CBT_ELEM_DATA;
+    case 'r':
+        return CBT_RECT_DATA;
     case 's':
         return CBT_ELEM_STYLE_DATA;
     }
@@ -2232,6 +2782,29 @@ lString8 ldomDataStorageManager::getText( lUInt32 address )
     return chunk->getText(address&0xFFFF);
 }
 
+/// get pointer to text data
+TextDataStorageItem * ldomDataStorageManager::getTextItem( lUInt32 addr )
+{
+    ldomTextStorageChunk * chunk = getChunk(addr);
+    return chunk->getTextItem(addr&0xFFFF);
+}
+
+/// get pointer to text data, chunk is not packed until unpinText() is called; NULL (and nothing pinned) if not found
+TextDataStorageItem * ldomDataStorageManager::pinText( lUInt32 addr )
+{
+    ldomTextStorageChunk * chunk = getChunk(addr);
+    TextDataStorageItem * item = chunk->getTextItem(addr&0xFFFF);
+    if ( item )
+        chunk->_pinCount++;
+    return item;
+}
+
+/// releases chunk pinned by pinText()
+void ldomDataStorageManager::unpinText( lUInt32 addr )
+{
+    _chunks[addr>>16]->_pinCount--;
+}
+
 /// get pointer to element data
 ElementDataStorageItem * ldomDataStorageManager::getElem( lUInt32 addr )
 {
@@ -2250,11 +2823,17 @@ lUInt32 ldomDataStorageManager::getParent( lUInt32 addr )
 void ldomDataStorageManager::compact( int reservedSpace )
 {
 #if BUILD_LITE!=1
+    if ( ldomMemoryGovernor::getBudget() > 0 && reservedSpace < 0xFFFFFF ) {
+        // storage limits are replaced by process-wide budget
+        ldomMemoryGovernor::compact( this, reservedSpace );
+        return;
+    }
     if ( _uncompressedSize + reservedSpace > _maxUncompressedSize + _maxUncompressedSize/10 ) { // allow +10% overflow
         // do compacting
         int sumsize = reservedSpace;
         for ( ldomTextStorageChunk * p = _recentChunk; p; p = p->_nextRecent ) {
-			if ( (int)p->_bufsize + sumsize < _maxUncompressedSize || (p==_activeChunk && reservedSpace<0xFFFFFFF)) {
+			// most recent chunk may be in use by caller, even if it's larger than limit
+			if ( (int)p->_bufsize + sumsize < _maxUncompressedSize || (p==_activeChunk && reservedSpace<0xFFFFFFF) || p==_recentChunk || p->_pinCount ) {
 				// fits
 				sumsize += p->_bufsize;
 			} else {
@@ -2272,6 +2851,140 @@ void ldomDataStorageManager::compact( int reservedSpace )
 #endif
 }
 
+LVArray<ldomDataStorageManager *> * ldomMemoryGovernor::_storages = NULL;
+lInt64 ldomMemoryGovernor::_budget = DOC_MEMORY_BUDGET;
+lUInt64 ldomMemoryGovernor::_accessCounter = 0;
+
+void ldomMemoryGovernor::registerStorage( ldomDataStorageManager * storage )
+{
+    if ( !_storages )
+        _storages = new LVArray<ldomDataStorageManager *>();
+    _storages->add( storage );
+}
+
+void ldomMemoryGovernor::unregisterStorage( ldomDataStorageManager * storage )
+{
+    if ( !_storages )
+        return;
+    for ( int i=_storages->length()-1; i>=0; i-- ) {
+        if ( _storages->get(i)==storage ) {
+            _storages->erase( i, 1 );
+            break;
+        }
+    }
+    if ( _storages->length()==0 ) {
+        delete _storages;
+        _storages = NULL;
+    }
+}
+
+/// returns total size of unpacked node data in all storages
+lInt64 ldomMemoryGovernor::getUsage()
+{
+    lInt64 usage = 0;
+    for ( int i=0; _storages && i<_storages->length(); i++ )
+        usage += _storages->get(i)->_uncompressedSize;
+    return usage;
+}
+
+struct ldomChunkAccess {
+    lUInt64 lastAccess;
+    ldomTextStorageChunk * chunk;
+};
+
+static int compareChunkAccess( const void * p1, const void * p2 )
+{
+    lUInt64 a1 = ((const ldomChunkAccess *)p1)->lastAccess;
+    lUInt64 a2 = ((const ldomChunkAccess *)p2)->lastAccess;
+    return a1 < a2 ? -1 : (a1 > a2 ? 1 : 0);
+}
+
+/// packs least recently used chunks if usage with reservedSpace exceeds budget; cache file may be created for requesting storage's document only
+void ldomMemoryGovernor::compact( ldomDataStorageManager * requester, int reservedSpace )
+{
+#if BUILD_LITE!=1
+    lInt64 usage = getUsage() + reservedSpace;
+    if ( usage <= _budget + _budget/10 ) // allow +10% overflow, so that compacting is not done on each unpacking
+        return;
+    LVArray<ldomChunkAccess> chunks;
+    for ( int i=0; i<_storages->length(); i++ ) {
+        ldomDataStorageManager * storage = _storages->get(i);
+        // other documents are not made to create cache files, e.g. ones being loaded or rendered
+        if ( !storage->_cache && storage->_owner!=requester->_owner )
+            continue;
+        for ( ldomTextStorageChunk * p = storage->_recentChunk; p; p = p->_nextRecent ) {
+            // most recent chunk of storage may be in use by caller
+            if ( !p->_buf || p==storage->_activeChunk || p==storage->_recentChunk || p->_pinCount )
+                continue;
+            ldomChunkAccess item;
+            item.lastAccess = p->_lastAccess;
+            item.chunk = p;
+            chunks.add( item );
+        }
+    }
+    if ( chunks.length() > 1 )
+        qsort( chunks.get(), chunks.length(), sizeof(ldomChunkAccess), compareChunkAccess );
+    for ( int i=0; i<chunks.length() && usage > _budget; i++ ) {
+        ldomTextStorageChunk * p = chunks[i].chunk;
+        ldomDataStorageManager * storage = p->_manager;
+        if ( !storage->_cache )
+            storage->_owner->createCacheFile();
+        if ( !storage->_cache )
+            continue;
+        int size = p->_bufsize;
+        if ( !p->swapToCache(true) )
+            crFatalError(111, "Swap file writing error!");
+        usage -= size;
+    }
+#else
+    CR_UNUSED2(requester, reservedSpace);
+#endif
+}
+
+/// returns size of unpacked node data of document
+int tinyNodeCollection::getUnpackedDataSize()
+{
+    return _textStorage.getUncompressedSize() + _elemStorage.getUncompressedSize()
+        + _rectStorage.getUncompressedSize() + _styleStorage.getUncompressedSize();
+}
+
+/// requests reading of node data chunks for elements and text nodes between given ones (data indexes, 0 to skip) from cache file on background thread
+void tinyNodeCollection::prefetchRange( lUInt32 fromElement, lUInt32 toElement, lUInt32 fromText, lUInt32 toText )
+{
+#if BUILD_LITE!=1
+    if ( !_cacheFile )
+        return;
+    // node table only: parent of text node is not looked up as it's stored in text chunk
+    ldomNode * from = fromText ? getTinyNode( fromText ) : NULL;
+    ldomNode * to = toText ? getTinyNode( toText ) : NULL;
+    if ( from && to && from->isText() && to->isText() && from->isPersistent() && to->isPersistent() )
+        _textStorage.prefetchChunks( from->_data._ptext_addr>>16, to->_data._ptext_addr>>16 );
+    from = fromElement ? getTinyNode( fromElement ) : NULL;
+    to = toElement ? getTinyNode( toElement ) : NULL;
+    if ( !from || !to || !from->isElement() || !to->isElement() )
+        return;
+    if ( from->isPersistent() && to->isPersistent() )
+        _elemStorage.prefetchChunks( from->_data._pelem_addr>>16, to->_data._pelem_addr>>16 );
+    int first = fromElement>>4; // element sequential index
+    int last = toElement>>4;
+    _rectStorage.prefetchChunks( first>>RECT_DATA_CHUNK_ITEMS_SHIFT, last>>RECT_DATA_CHUNK_ITEMS_SHIFT );
+    _styleStorage.prefetchChunks( first>>STYLE_DATA_CHUNK_ITEMS_SHIFT, last>>STYLE_DATA_CHUNK_ITEMS_SHIFT );
+#else
+    CR_UNUSED4(fromElement, toElement, fromText, toText);
+#endif
+}
+
+/// sets memory budget for unpacked node data, 0 to use default DOC_BUFFER_SIZE
+void tinyNodeCollection::setDocBufferSize( int size )
+{
+    if ( size<=0 )
+        size = DOC_BUFFER_SIZE;
+    _textStorage.setMaxUncompressedSize( (int)((lInt64)size * TEXT_CACHE_UNPACKED_PERCENT / 100) );
+    _elemStorage.setMaxUncompressedSize( (int)((lInt64)size * ELEM_CACHE_UNPACKED_PERCENT / 100) );
+    _rectStorage.setMaxUncompressedSize( (int)((lInt64)size * RECT_CACHE_UNPACKED_PERCENT / 100) );
+    _styleStorage.setMaxUncompressedSize( (int)((lInt64)size * STYLE_CACHE_UNPACKED_PERCENT / 100) );
+}
+
 // max 512K of uncompressed data (~8 chunks)
 #define DEF_MAX_UNCOMPRESSED_SIZE 0x80000
 ldomDataStorageManager::ldomDataStorageManager( tinyNodeCollection * owner, char type, int maxUnpackedSize, int chunkSize )
@@ -2283,11 +2996,15 @@ ldomDataStorageManager::ldomDataStorageManager( tinyNodeCollection * owner, char
 , _maxUncompressedSize(maxUnpackedSize)
 , _chunkSize(chunkSize)
 , _type(type)
+, _lastLoadedChunk(-1)
+, _sequentialLoads(0)
 {
+    ldomMemoryGovernor::registerStorage( this );
 }
 
 ldomDataStorageManager::~ldomDataStorageManager()
 {
+    ldomMemoryGovernor::unregisterStorage( this );
 }
 
 /// create chunk to be read from cache file
@@ -2301,6 +3018,8 @@ ldomTextStorageChunk::ldomTextStorageChunk(ldomDataStorageManager * manager, lUI
 	, _index(index)      /// ? index of chunk in storage
 	, _type( manager->_type )
 	, _saved(true)
+	, _lastAccess(0)
+	, _pinCount(0)
 {
     CR_UNUSED(compsize);
 }
@@ -2315,6 +3034,8 @@ ldomTextStorageChunk::ldomTextStorageChunk(int preAllocSize, ldomDataStorageMana
 	, _index(index)      /// ? index of chunk in storage
 	, _type( manager->_type )
 	, _saved(false)
+	, _lastAccess(ldomMemoryGovernor::touch())
+	, _pinCount(0)
 {
     _buf = (lUInt8*)malloc(preAllocSize);
     memset(_buf, 0, preAllocSize);
@@ -2331,6 +3052,8 @@ ldomTextStorageChunk::ldomTextStorageChunk(ldomDataStorageManager * manager, lUI
 	, _index(index)      /// ? index of chunk in storage
 	, _type( manager->_type )
 	, _saved(false)
+	, _lastAccess(ldomMemoryGovernor::touch())
+	, _pinCount(0)
 {
 }
 
@@ -2550,13 +3273,18 @@ void ldomTextStorageChunk::freeNode( int offset )
 
 /// get text item from buffer by offset
 lString8 ldomTextStorageChunk::getText( int offset )
+{
+    TextDataStorageItem * item = getTextItem( offset );
+    return item ? item->getText8() : lString8::empty_str;
+}
+
+/// get pointer to text item by offset
+TextDataStorageItem * ldomTextStorageChunk::getTextItem( int offset )
 {
     offset <<= 4;
-    if ( offset>=0 && offset<(int)_bufpos ) {
-        TextDataStorageItem * item = (TextDataStorageItem *)(_buf+offset);
-        return item->getText8();
-    }
-    return lString8::empty_str;
+    if ( offset>=0 && offset<(int)_bufpos )
+        return (TextDataStorageItem *)(_buf+offset);
+    return NULL;
 }
 #endif
 
@@ -2648,6 +3376,7 @@ void ldomTextStorageChunk::ensureUnpacked()
                 CRLog::error( "restoreFromCache() failed for chunk %c%d", _type, _index);
                 crFatalError( 111, "restoreFromCache() failed for chunk");
             }
+            _manager->chunkLoaded( _index );
             _manager->compact( 0 );
         }
     } else {
@@ -2781,6 +3510,8 @@ lxmlDocBase::lxmlDocBase( int /*dataBufSize*/ )
 , _attrValueTable( DOC_STRING_HASH_SIZE )
 ,_idNodeMap(8192)
 ,_urlImageMap(1024)
+,_imageNodeIdMap(1024)
+,_urlImageIdMap(1024)
 ,_idAttrId(0)
 ,_nameAttrId(0)
 #if BUILD_LITE!=1
@@ -2900,6 +3631,10 @@ ldomDocument::ldomDocument()
 , _page_height(0)
 , _page_width(0)
 , _rendered(false)
+, _searchIndexBuildPos(0)
+, _searchIndexSaved(false)
+, _searchIndexLoadTried(false)
+, _renderTime(0)
 #endif
 , lists(100)
 {
@@ -2921,6 +3656,8 @@ lxmlDocBase::lxmlDocBase( lxmlDocBase & doc )
 ,   _attrValueTable(doc._attrValueTable)
 ,   _idNodeMap(doc._idNodeMap)
 ,   _urlImageMap(1024)
+,   _imageNodeIdMap(1024)
+,   _urlImageIdMap(1024)
 ,   _idAttrId(doc._idAttrId) // Id for "id" attribute name
 //,   _docFlags(doc._docFlags)
 #if BUILD_LITE!=1
@@ -2939,6 +3676,10 @@ ldomDocument::ldomDocument( ldomDocument & doc )
 , _last_docflags(doc._last_docflags)
 , _page_height(doc._page_height)
 , _page_width(doc._page_width)
+, _searchIndexBuildPos(0)
+, _searchIndexSaved(false)
+, _searchIndexLoadTried(false)
+, _renderTime(0)
 #endif
 , _container(doc._container)
 , lists(100)
@@ -3055,6 +3796,7 @@ ldomDocument::~ldomDocument()
 {
     fontMan->UnregisterDocumentFonts(_docIndex);
 #if BUILD_LITE!=1
+    LVDecodedImageCache::removeDocument(_docIndex);
     updateMap();
 #endif
 }
@@ -3202,6 +3944,7 @@ bool ldomDocument::setRenderProps( int width, int dy, bool /*showCover*/, int /*
 
 void tinyNodeCollection::dropStyles()
 {
+    _styleMemo.clear();
     _styles.clear(-1);
     _fonts.clear(-1);
     resetNodeNumberingProps();
@@ -3289,6 +4032,7 @@ bool ldomDocument::parseStyleSheet(lString16 cssFile)
 int ldomDocument::render( LVRendPageList * pages, LVDocViewCallback * callback, int width, int dy, bool showCover, int y0, font_ref_t def_font, int def_interline_space, CRPropRef props )
 {
     CRLog::info("Render is called for width %d, pageHeight=%d, fontFace=%s, docFlags=%d", width, dy, def_font->getTypeFace().c_str(), getDocFlags() );
+    CRTimerUtil renderTimer;
     CRLog::trace("initializing default style...");
     //persist();
 //    {
@@ -3347,6 +4091,8 @@ int ldomDocument::render( LVRendPageList * pages, LVDocViewCallback * callback,
         _rendered = false;
     }
     if ( !_rendered ) {
+        _blockGeometry.clear();
+        _renderPositions.clear();
         pages->clear();
         if ( showCover )
             pages->add( new LVRendPageInfo( _page_height ) );
@@ -3378,6 +4124,7 @@ int ldomDocument::render( LVRendPageList * pages, LVDocViewCallback * callback,
 
         //persist();
         dumpStatistics();
+        _renderTime = (lUInt32)renderTimer.elapsed();
         return height;
     } else {
         CRLog::info("rendering context is not changed - no render!");
@@ -3392,10 +4139,50 @@ int ldomDocument::render( LVRendPageList * pages, LVDocViewCallback * callback,
 }
 #endif
 
+/// frozen name tables built from static schemes, shared by all documents; never freed
+static LVPtrVector<LDOMNameIdMap> * _sharedNameTables = NULL;
+static LVArray<const void *> * _sharedNameTableSchemes = NULL;
+
+/// returns shared name table built from scheme, NULL if not built yet
+static const LDOMNameIdMap * findSharedNameTable( const void * scheme )
+{
+    if ( !_sharedNameTableSchemes )
+        return NULL;
+    for ( int i=0; i<_sharedNameTableSchemes->length(); i++ )
+        if ( _sharedNameTableSchemes->get(i)==scheme )
+            return _sharedNameTables->get(i);
+    return NULL;
+}
+
+/// freezes name table built from scheme and shares it
+static const LDOMNameIdMap * addSharedNameTable( const void * scheme, LDOMNameIdMap * map )
+{
+    if ( !_sharedNameTables ) {
+        _sharedNameTables = new LVPtrVector<LDOMNameIdMap>();
+        _sharedNameTableSchemes = new LVArray<const void *>();
+    }
+    map->Freeze();
+    _sharedNameTables->add( map );
+    _sharedNameTableSchemes->add( scheme );
+    return map;
+}
+
 void lxmlDocBase::setNodeTypes( const elem_def_t * node_scheme )
 {
     if ( !node_scheme )
         return;
+    if ( _elementNameTable.getOwnItemCount()==0 && !_elementNameTable.getBase() ) {
+        // predefined names are taken from process-wide table, document keeps only unknown ones
+        const LDOMNameIdMap * shared = findSharedNameTable( node_scheme );
+        if ( !shared ) {
+            LDOMNameIdMap * map = new LDOMNameIdMap( MAX_ELEMENT_TYPE_ID );
+            for ( const elem_def_t * p = node_scheme; p->id != 0; ++p )
+                map->AddItem( p->id, lString16(p->name), &p->props );
+            shared = addSharedNameTable( node_scheme, map );
+        }
+        _elementNameTable.SetBase( shared );
+        return;
+    }
     for ( ; node_scheme && node_scheme->id != 0; ++node_scheme )
     {
         _elementNameTable.AddItem(
@@ -3410,12 +4197,23 @@ void lxmlDocBase::setAttributeTypes( const attr_def_t * attr_scheme )
 {
     if ( !attr_scheme )
         return;
-    for ( ; attr_scheme && attr_scheme->id != 0; ++attr_scheme )
-    {
-        _attrNameTable.AddItem(
-            attr_scheme->id,               // ID
-            lString16(attr_scheme->name),  // Name
-            NULL);
+    if ( _attrNameTable.getOwnItemCount()==0 && !_attrNameTable.getBase() ) {
+        const LDOMNameIdMap * shared = findSharedNameTable( attr_scheme );
+        if ( !shared ) {
+            LDOMNameIdMap * map = new LDOMNameIdMap( MAX_ATTRIBUTE_TYPE_ID );
+            for ( const attr_def_t * p = attr_scheme; p->id != 0; ++p )
+                map->AddItem( p->id, lString16(p->name), NULL );
+            shared = addSharedNameTable( attr_scheme, map );
+        }
+        _attrNameTable.SetBase( shared );
+    } else {
+        for ( ; attr_scheme && attr_scheme->id != 0; ++attr_scheme )
+        {
+            _attrNameTable.AddItem(
+                attr_scheme->id,               // ID
+                lString16(attr_scheme->name),  // Name
+                NULL);
+        }
     }
     _idAttrId = _attrNameTable.idByName("id");
 }
@@ -3425,6 +4223,17 @@ void lxmlDocBase::setNameSpaceTypes( const ns_def_t * ns_scheme )
 {
     if ( !ns_scheme )
         return;
+    if ( _nsNameTable.getOwnItemCount()==0 && !_nsNameTable.getBase() ) {
+        const LDOMNameIdMap * shared = findSharedNameTable( ns_scheme );
+        if ( !shared ) {
+            LDOMNameIdMap * map = new LDOMNameIdMap( MAX_NAMESPACE_TYPE_ID );
+            for ( const ns_def_t * p = ns_scheme; p->id != 0; ++p )
+                map->AddItem( p->id, lString16(p->name), NULL );
+            shared = addSharedNameTable( ns_scheme, map );
+        }
+        _nsNameTable.SetBase( shared );
+        return;
+    }
     for ( ; ns_scheme && ns_scheme->id != 0; ++ns_scheme )
     {
         _nsNameTable.AddItem(
@@ -3623,6 +4432,7 @@ static bool IS_FIRST_BODY = false;
 
 ldomElementWriter::ldomElementWriter(ldomDocument * document, lUInt16 nsid, lUInt16 id, ldomElementWriter * parent)
     : _parent(parent), _document(document), _tocItem(NULL), _isBlock(true), _isSection(false), _stylesheetIsSet(false), _bodyEnterCalled(false)
+    , _childSectionCount(0), _sectionIndex(0)
 {
     //logfile << "{c";
     _typeDef = _document->getElementTypePtr( id );
@@ -3630,6 +4440,8 @@ ldomElementWriter::ldomElementWriter(ldomDocument * document, lUInt16 nsid, lUIn
     if ( (_typeDef && _typeDef->white_space==css_ws_pre) || (_parent && _parent->getFlags()&TXTFLG_PRE) )
         _flags |= TXTFLG_PRE;
     _isSection = (id==el_section);
+    if ( _isSection && _parent )
+        _sectionIndex = ++_parent->_childSectionCount;
     _allowText = _typeDef ? _typeDef->allow_text : (_parent?true:false);
     if (_parent)
         _element = _parent->getElement()->insertChildElement( (lUInt32)-1, nsid, id );
@@ -3709,7 +4521,12 @@ lString16 ldomElementWriter::getPath()
 {
     if ( !_path.empty() || _element->isRoot() )
         return _path;
-    _path = _parent->getPath() + "/" + _element->getXPathSegment();
+    // sections are counted while written: getXPathSegment() would read all previous siblings,
+    // which is quadratic for documents with thousands of sections
+    if ( _sectionIndex )
+        _path = _parent->getPath() + "/" + _element->getNodeName() + "[" + fmt::decimal(_sectionIndex) + "]";
+    else
+        _path = _parent->getPath() + "/" + _element->getXPathSegment();
     return _path;
 }
 
@@ -4290,6 +5107,7 @@ ldomDocumentWriter::~ldomDocumentWriter()
     if ( _document->isDefStyleSet() ) {
         if ( _popStyleOnFinish )
             _document->getStyleSheet()->pop();
+        _document->getStyleMemo().clear();
         _document->getRootNode()->initNodeStyle();
         _document->getRootNode()->initNodeFont();
         //if ( !_document->validateDocument() )
@@ -4842,6 +5660,72 @@ ldomXPointer ldomDocument::createXPointer( const lString16 & xPointerStr )
     return createXPointer( getRootNode(), xPointerStr );
 }
 
+/// returns hash of document content used to validate compact xpointers
+lUInt32 ldomDocument::getContentHash()
+{
+    lUInt32 buf[3];
+    buf[0] = (lUInt32)getProps()->getIntDef(DOC_PROP_FILE_CRC32, 0);
+    buf[1] = (lUInt32)_elemCount;
+    buf[2] = (lUInt32)_textCount;
+    return lStr_crc32( 0, buf, sizeof(buf) );
+}
+
+/// create xpointer from compact binary form, returns NULL pointer if it doesn't match this document
+ldomXPointer ldomDocument::createXPointer( const ldomCompactXPointer & pos )
+{
+    if ( pos.isNull() || pos.docHash != getContentHash() )
+        return ldomXPointer();
+    int n = (int)(pos.dataIndex >> 4);
+    if ( n <= 0 || n > ((pos.dataIndex & 1) ? _elemCount : _textCount) )
+        return ldomXPointer();
+    ldomNode * node = getTinyNode( pos.dataIndex );
+    if ( !node || (lUInt32)node->getDataIndex() != pos.dataIndex )
+        return ldomXPointer(); // removed node
+    if ( node->isElement() ? (pos.offset < -1 || pos.offset > (int)node->getChildCount()) : pos.offset < 0 )
+        return ldomXPointer();
+    return ldomXPointer( node, pos.offset );
+}
+
+/// returns compact binary form of pointer
+ldomCompactXPointer ldomXPointer::toCompact() const
+{
+    ldomCompactXPointer res;
+    ldomNode * node = getNode();
+    if ( !node )
+        return res;
+    res.docHash = node->getDocument()->getContentHash();
+    res.dataIndex = (lUInt32)node->getDataIndex();
+    res.offset = getOffset();
+    return res;
+}
+
+/// encodes position as hex digits string
+lString16 ldomCompactXPointer::toString() const
+{
+    char buf[32];
+    sprintf( buf, "%08x%08x%08x", (unsigned)docHash, (unsigned)dataIndex, (unsigned)offset );
+    return Utf8ToUnicode( buf );
+}
+
+/// decodes position from toString() result, returns false if string has wrong format
+bool ldomCompactXPointer::fromString( const lString16 & s )
+{
+    clear();
+    if ( s.length() != 24 )
+        return false;
+    lUInt32 v[3] = { 0, 0, 0 };
+    for ( int i=0; i<24; i++ ) {
+        int d = hexDigit( s[i] );
+        if ( d < 0 )
+            return false;
+        v[i / 8] = (v[i / 8] << 4) | d;
+    }
+    docHash = v[0];
+    dataIndex = v[1];
+    offset = (lInt32)v[2];
+    return true;
+}
+
 #if BUILD_LITE!=1
 
 /// return parent final node, if found
@@ -4868,7 +5752,7 @@ ldomXPointer ldomDocument::createXPointer( lvPoint pt, int direction )
     if ( !finalNode ) {
         if ( pt.y >= getFullHeight()) {
             ldomNode * node = getRootNode()->getLastTextChild();
-            return ldomXPointer(node,node ? node->getText().length() : 0);
+            return ldomXPointer(node,node ? node->getTextLength() : 0);
         } else if ( pt.y <= 0 ) {
             ldomNode * node = getRootNode()->getFirstTextChild();
             return ldomXPointer(node, 0);
@@ -4890,28 +5774,24 @@ ldomXPointer ldomDocument::createXPointer( lvPoint pt, int direction )
         else
             return ldomXPointer( finalNode, finalNode->getChildCount() );
     }
-    // final, format and search
-    LFormattedTextRef txtform;
-    {
-        RenderRectAccessor r( finalNode );
-        finalNode->renderFinalBlock( txtform, &r, r.getWidth() );
-    }
-    int lcount = txtform->GetLineCount();
-    for ( int l = 0; l<lcount; l++ ) {
-        const formatted_line_t * frmline = txtform->GetLineInfo(l);
-        if ( pt.y >= (int)(frmline->y + frmline->height) && l<lcount-1 )
+    // final, search using cached geometry of formatted block
+    ldomBlockGeometry * geometry = getBlockGeometry( finalNode );
+    int lcount = geometry->lines.length();
+    for ( int l = lcount>0 ? geometry->findLine( pt.y ) : 0; l<lcount; l++ ) {
+        const ldomBlockGeometry::Line & frmline = geometry->lines[l];
+        if ( pt.y >= (int)(frmline.y + frmline.height) && l<lcount-1 )
             continue;
-        //CRLog::debug("  point (%d, %d) line found [%d]: (%d..%d)", pt.x, pt.y, l, frmline->y, frmline->y+frmline->height);
+        //CRLog::debug("  point (%d, %d) line found [%d]: (%d..%d)", pt.x, pt.y, l, frmline.y, frmline.y+frmline.height);
         // found line, searching for word
-        int wc = (int)frmline->word_count;
-        int x = pt.x - frmline->x;
+        int wc = (int)frmline.wordCount;
+        int x = pt.x - frmline.x;
         for ( int w=0; w<wc; w++ ) {
-            const formatted_word_t * word = &frmline->words[w];
+            const ldomBlockGeometry::Word * word = &geometry->words[frmline.firstWord + w];
             if ( x < word->x + word->width || w==wc-1 ) {
-                const src_text_fragment_t * src = txtform->GetSrcInfo(word->src_text_index);
-                //CRLog::debug(" word found [%d]: x=%d..%d, start=%d, len=%d  %08X", w, word->x, word->x + word->width, word->t.start, word->t.len, src->object);
+                const ldomBlockGeometry::Src * src = &geometry->srcs[word->src];
+                //CRLog::debug(" word found [%d]: x=%d..%d, start=%d, len=%d  %08X", w, word->x, word->x + word->width, word->start, word->len, src->node);
                 // found word, searching for letters
-                ldomNode * node = (ldomNode *)src->object;
+                ldomNode * node = getTinyNode( src->node );
                 if ( !node )
                     continue;
                 if ( src->flags & LTEXT_SRC_IS_OBJECT ) {
@@ -4924,19 +5804,20 @@ ldomXPointer ldomDocument::createXPointer( lvPoint pt, int direction )
                         node->getNodeIndex() + (( x < word->x + word->width/2 ) ? 0 : 1) );
 #endif
                 }
-                LVFont * font = (LVFont *) src->t.font;
+                // text is formatted using font of parent element
+                LVFont * font = node->getParentNode()->getFont().get();
                 lUInt16 w[512];
                 lUInt8 flg[512];
 
                 lString16 str = node->getText();
-                font->measureText( str.c_str()+word->t.start, word->t.len, w, flg, word->width+50, '?', src->letter_spacing);
-                for ( int i=0; i<word->t.len; i++ ) {
+                font->measureText( str.c_str()+word->start, word->len, w, flg, word->width+50, '?', src->letterSpacing);
+                for ( int i=0; i<word->len; i++ ) {
                     int xx = ( i>0 ) ? (w[i-1] + w[i])/2 : w[i]/2;
                     if ( x < word->x + xx ) {
-                        return ldomXPointer( node, src->t.offset + word->t.start + i );
+                        return ldomXPointer( node, src->offset + word->start + i );
                     }
                 }
-                return ldomXPointer( node, src->t.offset + word->t.start + word->t.len );
+                return ldomXPointer( node, src->offset + word->start + word->len );
             }
         }
     }
@@ -4995,11 +5876,8 @@ bool ldomXPointer::getRect(lvRect & rect) const
             rect.bottom++;
             return true;
         }
-        RenderRectAccessor r( finalNode );
-        //if ( !r )
-        //    return false;
-        LFormattedTextRef txtform;
-        finalNode->renderFinalBlock( txtform, &r, r.getWidth() );
+        ldomDocument * doc = finalNode->getDocument();
+        ldomBlockGeometry * geometry = doc->getBlockGeometry( finalNode );
 
         ldomNode * node = getNode();
         int offset = getOffset();
@@ -5044,18 +5922,19 @@ bool ldomXPointer::getRect(lvRect & rect) const
         int lastLen = -1;
         int lastOffset = -1;
         ldomXPointerEx xp(node, offset);
-        for ( int i=0; i<txtform->GetSrcCount(); i++ ) {
-            const src_text_fragment_t * src = txtform->GetSrcInfo(i);
+        for ( int i=0; i<geometry->srcs.length(); i++ ) {
+            const ldomBlockGeometry::Src * src = &geometry->srcs[i];
+            ldomNode * srcNode = doc->getTinyNode( src->node );
             bool isObject = (src->flags&LTEXT_SRC_IS_OBJECT)!=0;
-            if ( src->object == node ) {
+            if ( srcNode == node ) {
                 srcIndex = i;
-                srcLen = isObject ? 0 : src->t.len;
+                srcLen = isObject ? 0 : src->len;
                 break;
             }
             lastIndex = i;
-            lastLen =  isObject ? 0 : src->t.len;
-            lastOffset = isObject ? 0 : src->t.offset;
-            ldomXPointerEx xp2((ldomNode*)src->object, lastOffset);
+            lastLen =  isObject ? 0 : src->len;
+            lastOffset = isObject ? 0 : src->offset;
+            ldomXPointerEx xp2(srcNode, lastOffset);
             if ( xp2.compare(xp)>0 ) {
                 srcIndex = i;
                 srcLen = lastLen;
@@ -5070,42 +5949,52 @@ bool ldomXPointer::getRect(lvRect & rect) const
             srcLen = lastLen;
             offset = lastOffset;
         }
-        for ( int l = 0; l<txtform->GetLineCount(); l++ ) {
-            const formatted_line_t * frmline = txtform->GetLineInfo(l);
-            for ( int w=0; w<(int)frmline->word_count; w++ ) {
-                const formatted_word_t * word = &frmline->words[w];
-                bool lastWord = (l == txtform->GetLineCount() - 1 && w == frmline->word_count - 1);
-                if ( word->src_text_index>=srcIndex || lastWord ) {
+        int lcount = geometry->lines.length();
+        for ( int l = 0; l<lcount; l++ ) {
+            const ldomBlockGeometry::Line & frmline = geometry->lines[l];
+            for ( int w=0; w<(int)frmline.wordCount; w++ ) {
+                const ldomBlockGeometry::Word * word = &geometry->words[frmline.firstWord + w];
+                bool lastWord = (l == lcount - 1 && w == (int)frmline.wordCount - 1);
+                if ( word->src>=srcIndex || lastWord ) {
                     // found word from same src line
-                    if ( word->src_text_index>srcIndex || offset<=word->t.start ) {
+                    if ( word->src>srcIndex || offset<=word->start ) {
                         // before this word
-                        rect.left = word->x + rc.left + frmline->x;
-                        //rect.top = word->y + rc.top + frmline->y + frmline->baseline;
-                        rect.top = rc.top + frmline->y;
+                        rect.left = word->x + rc.left + frmline.x;
+                        rect.top = rc.top + frmline.y;
                         rect.right = rect.left + 1;
-                        rect.bottom = rect.top + frmline->height;
+                        rect.bottom = rect.top + frmline.height;
                         return true;
-                    } else if ( (offset<word->t.start+word->t.len) || (offset==srcLen && offset==word->t.start+word->t.len) ) {
+                    } else if ( (offset<word->start+word->len) || (offset==srcLen && offset==word->start+word->len) ) {
                         // pointer inside this word
-                        LVFont * font = (LVFont *) txtform->GetSrcInfo(srcIndex)->t.font;
+                        const ldomBlockGeometry::Src * src = &geometry->srcs[srcIndex];
+                        ldomNode * srcNode = doc->getTinyNode( src->node );
+                        LVFont * font;
+                        if ( srcNode && srcNode->isText() ) {
+                            // text is formatted using font of parent element
+                            font = srcNode->getParentNode()->getFont().get();
+                        } else {
+                            // font of generated text is only known to formatter
+                            LFormattedTextRef txtform;
+                            RenderRectAccessor r( finalNode );
+                            finalNode->renderFinalBlock( txtform, &r, r.getWidth() );
+                            font = (LVFont *) txtform->GetSrcInfo(srcIndex)->t.font;
+                        }
                         lUInt16 w[512];
                         lUInt8 flg[512];
                         lString16 str = node->getText();
-                        font->measureText( str.c_str()+word->t.start, offset - word->t.start, w, flg, word->width+50, '?', txtform->GetSrcInfo(srcIndex)->letter_spacing);
-                        int chx = w[ offset - word->t.start - 1 ];
-                        rect.left = word->x + chx + rc.left + frmline->x;
-                        //rect.top = word->y + rc.top + frmline->y + frmline->baseline;
-                        rect.top = rc.top + frmline->y;
+                        font->measureText( str.c_str()+word->start, offset - word->start, w, flg, word->width+50, '?', src->letterSpacing);
+                        int chx = w[ offset - word->start - 1 ];
+                        rect.left = word->x + chx + rc.left + frmline.x;
+                        rect.top = rc.top + frmline.y;
                         rect.right = rect.left + 1;
-                        rect.bottom = rect.top + frmline->height;
+                        rect.bottom = rect.top + frmline.height;
                         return true;
                     } else if (lastWord) {
                         // after last word
-                        rect.left = word->x + rc.left + frmline->x + word->width;
-                        //rect.top = word->y + rc.top + frmline->y + frmline->baseline;
-                        rect.top = rc.top + frmline->y;
+                        rect.left = word->x + rc.left + frmline.x + word->width;
+                        rect.top = rc.top + frmline.y;
                         rect.right = rect.left + 1;
-                        rect.bottom = rect.top + frmline->height;
+                        rect.bottom = rect.top + frmline.height;
                         return true;
                     }
                 }
@@ -5227,7 +6116,7 @@ ldomXPointer ldomDocument::createXPointer( ldomNode * baseNode, const lString16
                 return ldomXPointer(currNode, index);
             } else {
                 // text point
-                if ( index<0 || index>(int)currNode->getText().length() )
+                if ( index<0 || index>(int)currNode->getTextLength() )
                     return ldomXPointer();
                 return ldomXPointer(currNode, index);
             }
@@ -5275,19 +6164,21 @@ lString16 ldomXPointer::toString()
         return path;
     ldomNode * node = getNode();
     int offset = getOffset();
-    if ( offset >= 0 ) {
-        path << "." << fmt::decimal(offset);
-    }
-    ldomNode * p = node;
+    // collect path from root first, then build string once instead of prepending each step
+    LVArray<ldomNode*> nodes;
     ldomNode * mainNode = node->getDocument()->getRootNode();
-    while (p && p!=mainNode) {
+    for ( ldomNode * p = node; p && p!=mainNode; p = p->getParentNode() )
+        nodes.add( p );
+    path.reserve( nodes.length() * 12 + 8 );
+    for ( int n=nodes.length() - 1; n>=0; n-- ) {
+        ldomNode * p = nodes[n];
         ldomNode * parent = p->getParentNode();
         if ( p->isElement() ) {
             // element
-            lString16 name = p->getNodeName();
             lUInt16 id = p->getNodeId();
+            path << "/" << p->getNodeName();
             if ( !parent )
-                return "/" + name + path;
+                continue;
             int index = -1;
             int count = 0;
             for ( int i=0; i<parent->getChildCount(); i++ ) {
@@ -5299,13 +6190,12 @@ lString16 ldomXPointer::toString()
                 }
             }
             if ( count>1 )
-                path = cs16("/") + name + "[" + fmt::decimal(index) + "]" + path;
-            else
-                path = cs16("/") + name + path;
+                path << "[" << fmt::decimal(index) << "]";
         } else {
             // text
+            path << "/text()";
             if ( !parent )
-                return cs16("/text()") + path;
+                continue;
             int index = -1;
             int count = 0;
             for ( int i=0; i<parent->getChildCount(); i++ ) {
@@ -5317,11 +6207,11 @@ lString16 ldomXPointer::toString()
                 }
             }
             if ( count>1 )
-                path = cs16("/text()") + "[" + fmt::decimal(index) + "]" + path;
-            else
-                path = "/text()" + path;
+                path << "[" << fmt::decimal(index) << "]";
         }
-        p = parent;
+    }
+    if ( offset >= 0 ) {
+        path << "." << fmt::decimal(offset);
     }
     return path;
 }
@@ -5577,7 +6467,7 @@ ldomXRangeList::ldomXRangeList( ldomXRangeList & srcList, ldomXRange & filter )
 
 /// copy constructor of full node range
 ldomXRange::ldomXRange( ldomNode * p )
-: _start( p, 0 ), _end( p, p->isText() ? p->getText().length() : p->getChildCount() ), _flags(1)
+: _start( p, 0 ), _end( p, p->isText() ? p->getTextLength() : p->getChildCount() ), _flags(1)
 {
 }
 
@@ -5708,6 +6598,270 @@ void ldomXRangeList::split( ldomXRange * r )
 
 #if BUILD_LITE!=1
 
+static const char * search_index_magic = "CRSEARCHINDEX";
+
+static inline bool isSearchIndexWordChar( lChar16 ch )
+{
+    return (lGetCharProps(ch) & (CH_PROP_ALPHA|CH_PROP_DIGIT))!=0;
+}
+
+/// adds words of text node to index being built; nodes should be added in ascending order
+void ldomTextSearchIndex::addText( lUInt32 nodeNumber, lString16 text )
+{
+    if ( !_termIds ) {
+        clear();
+        _termIds = new LVHashTable<lString16, int>( 4096 );
+    }
+    text.lowercase();
+    const lChar16 * str = text.c_str();
+    int len = text.length();
+    for ( int i=0; i<len; ) {
+        if ( !isSearchIndexWordChar(str[i]) ) {
+            i++;
+            continue;
+        }
+        int start = i;
+        while ( i<len && isSearchIndexWordChar(str[i]) )
+            i++;
+        lString16 term( str + start, i - start );
+        int id;
+        if ( !_termIds->get( term, id ) ) {
+            id = _termNodes.length();
+            _termIds->set( term, id );
+            _termNodes.add( new LVArray<lUInt32>() );
+            _newTerms.add( UnicodeToUtf8(term) );
+        }
+        LVArray<lUInt32> * nodes = _termNodes[id];
+        if ( !nodes->length() || nodes->get(nodes->length()-1)!=nodeNumber )
+            nodes->add( nodeNumber );
+    }
+    if ( nodeNumber > _maxNode )
+        _maxNode = nodeNumber;
+}
+
+/// finishes building, converts index to compact form
+void ldomTextSearchIndex::finishBuild()
+{
+    _terms.clear();
+    _termStart.clear();
+    _postingStart.clear();
+    _postings.clear();
+    int count = _termNodes.length();
+    _termStart.reserve( count );
+    _postingStart.reserve( count + 1 );
+    for ( int i=0; i<count; i++ ) {
+        _termStart.add( _terms.length() );
+        _terms << _newTerms[i] << ' ';
+        _postingStart.add( _postings.length() );
+        LVArray<lUInt32> * nodes = _termNodes[i];
+        lUInt32 prev = 0;
+        for ( int j=0; j<nodes->length(); j++ ) {
+            lUInt32 delta = nodes->get(j) - prev;
+            prev = nodes->get(j);
+            while ( delta >= 0x80 ) {
+                _postings.add( (lUInt8)((delta & 0x7F) | 0x80) );
+                delta >>= 7;
+            }
+            _postings.add( (lUInt8)delta );
+        }
+    }
+    _postingStart.add( _postings.length() );
+    delete _termIds;
+    _termIds = NULL;
+    _termNodes.clear();
+    _newTerms.clear();
+    _ready = true;
+    CRLog::debug("text search index: %d terms, %d bytes of terms, %d bytes of postings", count, _terms.length(), _postings.length());
+}
+
+/// removes all data
+void ldomTextSearchIndex::clear()
+{
+    if ( _termIds ) {
+        delete _termIds;
+        _termIds = NULL;
+    }
+    _termNodes.clear();
+    _newTerms.clear();
+    _terms.clear();
+    _termStart.clear();
+    _postingStart.clear();
+    _postings.clear();
+    _maxNode = 0;
+    _ready = false;
+}
+
+/// sets bits for text nodes which may contain pattern, returns false if index cannot narrow search
+bool ldomTextSearchIndex::findCandidates( lString16 pattern, LVArray<lUInt32> & nodeBits ) const
+{
+    if ( !_ready )
+        return false;
+    pattern.lowercase();
+    const lChar16 * str = pattern.c_str();
+    int len = pattern.length();
+    int words = (_maxNode >> 5) + 1;
+    const char * terms = _terms.c_str();
+    int termCount = _termStart.length();
+    bool found = false;
+    LVArray<lUInt32> fragmentBits;
+    for ( int i=0; i<len; ) {
+        if ( !isSearchIndexWordChar(str[i]) ) {
+            i++;
+            continue;
+        }
+        int start = i;
+        while ( i<len && isSearchIndexWordChar(str[i]) )
+            i++;
+        lString8 fragment = UnicodeToUtf8( lString16( str + start, i - start ) );
+        fragmentBits.clear();
+        memset( fragmentBits.addSpace( words ), 0, sizeof(lUInt32) * words );
+        for ( const char * p = strstr( terms, fragment.c_str() ); p; ) {
+            // find term containing match
+            int pos = (int)(p - terms);
+            int a = 0;
+            int b = termCount - 1;
+            while ( a < b ) {
+                int c = (a + b + 1) / 2;
+                if ( (int)_termStart[c] <= pos )
+                    a = c;
+                else
+                    b = c - 1;
+            }
+            lUInt32 node = 0;
+            for ( int j=_postingStart[a]; j<(int)_postingStart[a+1]; ) {
+                lUInt32 delta = 0;
+                int shift = 0;
+                for ( ;; ) {
+                    lUInt8 n = _postings[j++];
+                    delta |= (lUInt32)(n & 0x7F) << shift;
+                    shift += 7;
+                    if ( !(n & 0x80) )
+                        break;
+                }
+                node += delta;
+                fragmentBits[node >> 5] |= 1 << (node & 31);
+            }
+            // continue from next term
+            if ( a + 1 >= termCount )
+                break;
+            p = strstr( terms + _termStart[a + 1], fragment.c_str() );
+        }
+        if ( !found ) {
+            nodeBits = fragmentBits;
+            found = true;
+        } else {
+            for ( int j=0; j<words; j++ )
+                nodeBits[j] &= fragmentBits[j];
+        }
+    }
+    return found;
+}
+
+/// returns true if text node is set in bitmap filled by findCandidates()
+bool ldomTextSearchIndex::isCandidate( const LVArray<lUInt32> & nodeBits, ldomNode * node )
+{
+    lUInt32 n = node->getDataIndex() >> 4;
+    if ( (int)(n >> 5) >= nodeBits.length() )
+        return true; // node added after index was built
+    return (nodeBits[n >> 5] & (1 << (n & 31)))!=0;
+}
+
+void ldomTextSearchIndex::serialize( SerialBuf & buf ) const
+{
+    int pos = buf.pos();
+    buf.putMagic( search_index_magic );
+    buf << _maxNode << (lUInt32)_termStart.length() << _terms;
+    for ( int i=0; i<_termStart.length(); i++ )
+        buf << _termStart[i];
+    for ( int i=0; i<_postingStart.length(); i++ )
+        buf << _postingStart[i];
+    for ( int i=0; i<_postings.length(); i++ )
+        buf << _postings[i];
+    buf.putCRC( buf.pos() - pos );
+}
+
+bool ldomTextSearchIndex::deserialize( SerialBuf & buf )
+{
+    clear();
+    int pos = buf.pos();
+    if ( !buf.checkMagic( search_index_magic ) )
+        return false;
+    lUInt32 count = 0;
+    buf >> _maxNode >> count >> _terms;
+    for ( lUInt32 i=0; i<count && !buf.error(); i++ ) {
+        lUInt32 n = 0;
+        buf >> n;
+        _termStart.add( n );
+    }
+    for ( lUInt32 i=0; i<=count && !buf.error(); i++ ) {
+        lUInt32 n = 0;
+        buf >> n;
+        _postingStart.add( n );
+    }
+    int size = buf.error() ? 0 : _postingStart[count];
+    lUInt8 * postings = _postings.addSpace( size );
+    for ( int i=0; i<size && !buf.error(); i++ )
+        buf >> postings[i];
+    buf.checkCRC( buf.pos() - pos );
+    if ( buf.error() ) {
+        clear();
+        return false;
+    }
+    _ready = true;
+    return true;
+}
+
+/// adds text nodes to search index, limited by time interval; returns true when index is complete
+bool ldomDocument::buildTextSearchIndex( CRTimerUtil & maxTime )
+{
+    if ( _searchIndex.isReady() )
+        return true;
+    if ( !_searchIndexBuildPos )
+        _searchIndexBuildPos = 1;
+    for ( ; _searchIndexBuildPos <= (lUInt32)_textCount; _searchIndexBuildPos++ ) {
+        ldomNode * node = &_textList[_searchIndexBuildPos >> TNC_PART_SHIFT][_searchIndexBuildPos & TNC_PART_MASK];
+        if ( !node->isNull() )
+            _searchIndex.addText( _searchIndexBuildPos, node->getText() );
+        if ( !(_searchIndexBuildPos & 0xFF) && maxTime.expired() ) {
+            _searchIndexBuildPos++;
+            return false;
+        }
+    }
+    _searchIndex.finishBuild();
+    _searchIndexBuildPos = 0;
+    return true;
+}
+
+/// returns text search index saved in cache file, NULL if not available
+ldomTextSearchIndex * ldomDocument::getTextSearchIndex()
+{
+    if ( !_searchIndex.isReady() && !_searchIndexLoadTried && _searchIndexSaved && _cacheFile ) {
+        _searchIndexLoadTried = true;
+        SerialBuf buf(0, true);
+        if ( !_cacheFile->read( CBT_SEARCH_INDEX, buf ) || !_searchIndex.deserialize( buf ) )
+            CRLog::error("Error while reading text search index");
+    }
+    return _searchIndex.isReady() ? &_searchIndex : NULL;
+}
+
+/// drops text search index after change of document text
+void ldomDocument::dropTextSearchIndex()
+{
+    if ( !_searchIndexSaved && !_searchIndexBuildPos && !_searchIndex.isReady() )
+        return; // nothing built or saved yet, e.g. while document is being parsed
+    _searchIndex.clear();
+    _searchIndexBuildPos = 0;
+    _searchIndexLoadTried = false;
+    _searchIndexSaved = false; // rebuild on next saveChanges()
+}
+
+/// drops data derived from document text, called by node methods which change text or structure of tree
+void ldomDocument::onTreeModified()
+{
+    dropTextSearchIndex();
+    _tableCells.clear();
+}
+
 bool ldomDocument::findText( lString16 pattern, bool caseInsensitive, bool reverse, int minY, int maxY, LVArray<ldomWord> & words, int maxCount, int maxHeight )
 {
     if ( minY<0 )
@@ -5736,55 +6890,120 @@ bool ldomDocument::findText( lString16 pattern, bool caseInsensitive, bool rever
     return range.findText( pattern, caseInsensitive, reverse, words, maxCount, maxHeight );
 }
 
-static bool findText( const lString16 & str, int & pos, const lString16 & pattern )
+#ifndef TEXT_SEARCH_MAX_JUMP_NODES
+/// max number of candidate text nodes visited directly, more candidates are found by walking document tree
+#define TEXT_SEARCH_MAX_JUMP_NODES 256
+#endif
+
+static int compareSearchCandidates( const ldomXPointerEx ** item1, const ldomXPointerEx ** item2 )
 {
-    int len = pattern.length();
-    if ( pos < 0 || pos + len > (int)str.length() )
-        return false;
-    const lChar16 * s1 = str.c_str() + pos;
-    const lChar16 * s2 = pattern.c_str();
-    int nlen = str.length() - pos - len;
-    for ( int j=0; j<nlen; j++ ) {
-        bool matched = true;
-        for ( int i=0; i<len; i++ ) {
-            if ( s1[i] != s2[i] ) {
-                matched = false;
-                break;
-            }
-        }
-        if ( matched )
-            return true;
-        s1++;
-        pos++;
-    }
-    return false;
+    return (*item1)->compare( **item2 );
 }
 
-static bool findTextRev( const lString16 & str, int & pos, const lString16 & pattern )
+/// visible text nodes which may contain search pattern, according to document search index
+class ldomSearchCandidates
 {
-    int len = pattern.length();
-    if ( pos+len>(int)str.length() )
-        pos = str.length()-len;
-    if ( pos < 0 )
-        return false;
-    const lChar16 * s1 = str.c_str() + pos;
-    const lChar16 * s2 = pattern.c_str();
-    int nlen = pos - len;
-    for ( int j=nlen-1; j>=0; j-- ) {
-        bool matched = true;
-        for ( int i=0; i<len; i++ ) {
-            if ( s1[i] != s2[i] ) {
-                matched = false;
-                break;
+    LVArray<lUInt32> _bits;
+    LVPtrVector<ldomXPointerEx> _nodes; // in document order
+    bool _jump; // true if _nodes contains all candidates
+public:
+    ldomSearchCandidates() : _jump(false) { }
+    /// returns false if document has no search index, or index cannot narrow search for pattern
+    bool init( ldomDocument * doc, const lString16 & pattern )
+    {
+        ldomTextSearchIndex * index = doc->getTextSearchIndex();
+        if ( !index || !index->findCandidates( pattern, _bits ) )
+            return false;
+        int count = 0;
+        for ( int i=0; i<_bits.length(); i++ )
+            for ( lUInt32 n = _bits[i]; n; n &= n - 1 )
+                count++;
+        _jump = count <= TEXT_SEARCH_MAX_JUMP_NODES;
+        if ( !_jump )
+            return true;
+        for ( int i=0; i<_bits.length(); i++ ) {
+            for ( int j=0; j<32; j++ ) {
+                if ( !(_bits[i] & (1 << j)) )
+                    continue;
+                ldomNode * node = doc->getTinyNode( (lUInt32)((i << 5) + j) << 4 );
+                if ( node && !node->isNull() && node->isText() )
+                    _nodes.add( new ldomXPointerEx( node, 0 ) );
             }
         }
-        if ( matched )
-            return true;
-        s1--;
-        pos--;
+        _nodes.sort( compareSearchCandidates );
+        return true;
     }
-    return false;
-}
+    /// returns true if text node may contain pattern
+    bool isCandidate( ldomNode * node )
+    {
+        return ldomTextSearchIndex::isCandidate( _bits, node );
+    }
+    /// moves to next visible candidate text node
+    bool next( ldomXPointerEx & p )
+    {
+        if ( !_jump ) {
+            while ( p.nextText() ) {
+                if ( isCandidate( p.getNode() ) && p.isVisible() )
+                    return true;
+            }
+            return false;
+        }
+        // first candidate after current node
+        int a = 0;
+        int b = _nodes.length();
+        while ( a < b ) {
+            int c = (a + b) / 2;
+            if ( _nodes[c]->compare( p ) <= 0 )
+                a = c + 1;
+            else
+                b = c;
+        }
+        for ( ; a<_nodes.length(); a++ ) {
+            if ( _nodes[a]->isVisible() ) {
+                p = *_nodes[a];
+                return true;
+            }
+        }
+        return false;
+    }
+    /// moves to previous visible candidate text node
+    bool prev( ldomXPointerEx & p )
+    {
+        if ( !_jump ) {
+            while ( p.prevText() ) {
+                if ( isCandidate( p.getNode() ) && p.isVisible() )
+                    return true;
+            }
+            return false;
+        }
+        // last candidate before current node
+        int a = 0;
+        int b = _nodes.length();
+        while ( a < b ) {
+            int c = (a + b) / 2;
+            if ( _nodes[c]->compare( p ) < 0 && _nodes[c]->getNode()!=p.getNode() )
+                a = c + 1;
+            else
+                b = c;
+        }
+        for ( a--; a>=0; a-- ) {
+            if ( _nodes[a]->isVisible() ) {
+                p = *_nodes[a];
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/// decodes text of node to buffer, reusing it
+static void getSearchText( ldomNode * node, lString16 & txt )
+{
+    if ( node->isText() )
+        ldomTextRef( node ).decode( txt );
+    else
+        txt = node->getText();
+}
 
 /// searches for specified text inside range
 bool ldomXRange::findText( lString16 pattern, bool caseInsensitive, bool reverse, LVArray<ldomWord> & words, int maxCount, int maxHeight, bool checkMaxFromStart )
@@ -5794,17 +7013,27 @@ bool ldomXRange::findText( lString16 pattern, bool caseInsensitive, bool reverse
     words.clear();
     if ( pattern.empty() )
         return false;
+    lString16SearchPattern matcher( pattern, caseInsensitive );
+    // skip text nodes which cannot contain pattern, if document has search index
+    ldomSearchCandidates candidates;
+    bool useIndex = !isNull() && candidates.init( _start.getNode()->getDocument(), pattern );
+    // text of each node is decoded to the same buffer
+    lString16 txt;
     if ( reverse ) {
         // reverse search
         if ( !_end.isText() ) {
             _end.prevVisibleText();
-            lString16 txt = _end.getNode()->getText();
-            _end.setOffset(txt.length());
+            _end.setOffset( _end.getNode()->getTextLength() );
+        }
+        if ( useIndex && _end.isText() && !candidates.isCandidate( _end.getNode() ) ) {
+            if ( !candidates.prev( _end ) )
+                return false;
+            _end.setOffset( _end.getNode()->getTextLength() );
         }
         int firstFoundTextY = -1;
         while ( !isNull() ) {
 
-            lString16 txt = _end.getNode()->getText();
+            getSearchText( _end.getNode(), txt );
             int offs = _end.getOffset();
 
             if ( firstFoundTextY!=-1 && maxHeight>0 ) {
@@ -5814,10 +7043,7 @@ bool ldomXRange::findText( lString16 pattern, bool caseInsensitive, bool reverse
                     return words.length()>0;
             }
 
-            if ( caseInsensitive )
-                txt.lowercase();
-
-            while ( ::findTextRev( txt, offs, pattern ) ) {
+            while ( (offs = matcher.findRev( txt.c_str(), txt.length(), offs )) >= 0 ) {
                 if ( !words.length() && maxHeight>0 ) {
                     ldomXPointer p( _end.getNode(), offs );
                     firstFoundTextY = p.toPoint().y;
@@ -5825,10 +7051,9 @@ bool ldomXRange::findText( lString16 pattern, bool caseInsensitive, bool reverse
                 words.add( ldomWord(_end.getNode(), offs, offs + pattern.length() ) );
                 offs--;
             }
-            if ( !_end.prevVisibleText() )
+            if ( !(useIndex ? candidates.prev( _end ) : _end.prevVisibleText()) )
                 break;
-            txt = _end.getNode()->getText();
-            _end.setOffset(txt.length());
+            _end.setOffset( _end.getNode()->getTextLength() );
             if ( words.length() >= maxCount )
                 break;
         }
@@ -5841,6 +7066,9 @@ bool ldomXRange::findText( lString16 pattern, bool caseInsensitive, bool reverse
 			ldomXPointer p( _start.getNode(), _start.getOffset() );
 			firstFoundTextY = p.toPoint().y;
 		}
+        if ( useIndex && _start.isText() && !candidates.isCandidate( _start.getNode() )
+                && !candidates.next( _start ) )
+            return false;
         while ( !isNull() ) {
             int offs = _start.getOffset();
 
@@ -5852,11 +7080,8 @@ bool ldomXRange::findText( lString16 pattern, bool caseInsensitive, bool reverse
                     return words.length()>0;
             }
 
-            lString16 txt = _start.getNode()->getText();
-            if ( caseInsensitive )
-                txt.lowercase();
-
-            while ( ::findText( txt, offs, pattern ) ) {
+            getSearchText( _start.getNode(), txt );
+            while ( (offs = matcher.find( txt.c_str(), txt.length(), offs )) >= 0 ) {
                 if ( !words.length() && maxHeight>0 ) {
                     ldomXPointer p( _start.getNode(), offs );
                     int currentTextY = p.toPoint().y;
@@ -5869,7 +7094,7 @@ bool ldomXRange::findText( lString16 pattern, bool caseInsensitive, bool reverse
                 words.add( ldomWord(_start.getNode(), offs, offs + pattern.length() ) );
                 offs++;
             }
-            if ( !_start.nextVisibleText() )
+            if ( !(useIndex ? candidates.next( _start ) : _start.nextVisibleText()) )
                 break;
             if ( words.length() >= maxCount )
                 break;
@@ -8027,8 +9252,18 @@ void ldomDocument::clear()
 {
 #if BUILD_LITE!=1
     clearRendBlockCache();
+    _blockGeometry.clear();
+    _tableCells.clear();
+    _renderPositions.clear();
+    _searchIndex.clear();
+    _searchIndexBuildPos = 0;
+    _searchIndexSaved = false;
+    _searchIndexLoadTried = false;
     _rendered = false;
     _urlImageMap.clear();
+    _imageNodeIdMap.clear();
+    _urlImageIdMap.clear();
+    LVDecodedImageCache::removeDocument(_docIndex);
     _fontList.clear();
     fontMan->UnregisterDocumentFonts(_docIndex);
 #endif
@@ -8162,6 +9397,28 @@ bool ldomDocument::loadCacheFileContent(CacheLoadingCallback * formatCallback)
         return false;
     }
 
+    CRLog::trace("ldomDocument::loadCacheFileContent() - block geometry");
+    {
+        // optional: missing in cache files written before it was introduced
+        SerialBuf buf(0, true);
+        if ( !_cacheFile->read( CBT_BLOCK_GEOMETRY, buf ) || !_blockGeometry.deserialize( buf ) )
+            CRLog::trace("No block geometry data in cache file");
+    }
+    {
+        // optional as well
+        SerialBuf buf(0, true);
+        if ( !_cacheFile->read( CBT_TABLE_CELLS, buf ) || !_tableCells.deserialize( buf ) )
+            CRLog::trace("No table cell data in cache file");
+    }
+    {
+        // optional as well
+        SerialBuf buf(0, true);
+        if ( !_cacheFile->read( CBT_RENDER_POSITIONS, buf ) || !_renderPositions.deserialize( buf ) )
+            CRLog::trace("No render position data in cache file");
+    }
+    // text search index is loaded on first search
+    _searchIndexSaved = _cacheFile->hasBlock( CBT_SEARCH_INDEX );
+
     CRLog::trace("ldomDocument::loadCacheFileContent() - TOC");
     {
         SerialBuf tocbuf(0,true);
@@ -8398,6 +9655,66 @@ ContinuousOperationResult ldomDocument::saveChanges( CRTimerUtil & maxTime )
             CHECK_EXPIRATION("saving embedded fonts")
         }
         // fall through
+    case 111:
+        _mapSavingStage = 111;
+        if ( _blockGeometry.isChanged() ) {
+            CRLog::trace("ldomDocument::saveChanges() - block geometry");
+            SerialBuf buf(4096);
+            _blockGeometry.serialize(buf);
+            // stored uncompressed: may exceed size limit of packed blocks
+            if (!_cacheFile->write(CBT_BLOCK_GEOMETRY, buf, false) ) {
+                CRLog::error("Error while saving block geometry data");
+                return CR_ERROR;
+            }
+            CHECK_EXPIRATION("saving block geometry")
+        }
+        // fall through
+    case 112:
+        _mapSavingStage = 112;
+        if ( !_searchIndexSaved && _textCount >= TEXT_SEARCH_INDEX_MIN_TEXT_NODES ) {
+            CRLog::trace("ldomDocument::saveChanges() - text search index");
+            if ( !buildTextSearchIndex( maxTime ) ) {
+                CRLog::info("timer expired while building text search index");
+                return CR_TIMEOUT;
+            }
+            SerialBuf buf(4096);
+            _searchIndex.serialize(buf);
+            if (!_cacheFile->write(CBT_SEARCH_INDEX, buf, false) ) {
+                CRLog::error("Error while saving text search index");
+                return CR_ERROR;
+            }
+            _searchIndexSaved = true;
+            CHECK_EXPIRATION("saving text search index")
+        }
+        // fall through
+    case 113:
+        _mapSavingStage = 113;
+        if ( _tableCells.isChanged() ) {
+            CRLog::trace("ldomDocument::saveChanges() - table cells");
+            SerialBuf buf(4096);
+            _tableCells.serialize(buf);
+            // stored uncompressed: may exceed size limit of packed blocks
+            if (!_cacheFile->write(CBT_TABLE_CELLS, buf, false) ) {
+                CRLog::error("Error while saving table cell data");
+                return CR_ERROR;
+            }
+            CHECK_EXPIRATION("saving table cells")
+        }
+        // fall through
+    case 114:
+        _mapSavingStage = 114;
+        if ( _renderPositions.isChanged() ) {
+            CRLog::trace("ldomDocument::saveChanges() - render positions");
+            SerialBuf buf(4096);
+            _renderPositions.serialize(buf);
+            // stored uncompressed: may exceed size limit of packed blocks
+            if (!_cacheFile->write(CBT_RENDER_POSITIONS, buf, false) ) {
+                CRLog::error("Error while saving render position data");
+                return CR_ERROR;
+            }
+            CHECK_EXPIRATION("saving render positions")
+        }
+        // fall through
     case 12:
         _mapSavingStage = 12;
         CRLog::trace("ldomDocument::saveChanges() - flush");
@@ -8664,6 +9981,14 @@ bool tinyNodeCollection::updateLoadedStyles( bool enabled )
     return res;
 }
 
+/// passes size and render time of saved cache file to document cache index
+static void updateDocCacheFileInfo( CRPropRef props, lUInt32 docFlags, int cacheFileSize, lUInt32 renderTime )
+{
+    lString16 fname = props->getStringDef( DOC_PROP_FILE_NAME, "noname" );
+    lUInt32 crc = props->getIntDef( DOC_PROP_FILE_CRC32, 0 );
+    ldomDocCache::updateFileInfo( fname, crc, docFlags, (lUInt32)cacheFileSize, renderTime );
+}
+
 /// swaps to cache file or saves changes, limited by time interval
 ContinuousOperationResult ldomDocument::swapToCache( CRTimerUtil & maxTime )
 {
@@ -8691,6 +10016,8 @@ ContinuousOperationResult ldomDocument::swapToCache( CRTimerUtil & maxTime )
         return CR_ERROR;
     }
     CRLog::info("Successfully saved document to cache file: %dK", _cacheFile->getSize()/1024 );
+    if ( res==CR_DONE )
+        updateDocCacheFileInfo( getProps(), getPersistenceFlags(), _cacheFile->getSize(), _renderTime );
     return res;
 }
 
@@ -8709,6 +10036,7 @@ ContinuousOperationResult ldomDocument::updateMap(CRTimerUtil & maxTime)
 
     if ( res==CR_DONE ) {
         CRLog::info("Cache file updated successfully");
+        updateDocCacheFileInfo( getProps(), getPersistenceFlags(), _cacheFile->getSize(), _renderTime );
         dumpStatistics();
     }
     return res;
@@ -8716,24 +10044,104 @@ ContinuousOperationResult ldomDocument::updateMap(CRTimerUtil & maxTime)
 
 #endif
 
-static const char * doccache_magic = "CoolReader3 Document Cache Directory Index\nV1.00\n";
+static const char * doccache_magic_v100 = "CoolReader3 Document Cache Directory Index\nV1.00\n";
+static const char * doccache_magic = "CoolReader3 Document Cache Directory Index\nV1.01\n";
+static const char * doccache_journal_magic = "CoolReader3 Document Cache Index Journal\nV1.00\n";
+
+#ifndef DOC_CACHE_MIN_REBUILD_TIME
+/// rebuild time, ms, added to recorded render time of cache file when choosing files to remove
+#define DOC_CACHE_MIN_REBUILD_TIME 500
+#endif
+
+#ifndef DOC_CACHE_IDLE_TIME_UNIT
+/// time since last access, seconds, which halves value of cache file compared to just opened one
+#define DOC_CACHE_IDLE_TIME_UNIT 3600
+#endif
+
+#ifndef DOC_CACHE_JOURNAL_MAX_SIZE
+/// size of index journal file, bytes, after which journal is merged into index file
+#define DOC_CACHE_JOURNAL_MAX_SIZE 16384
+#endif
+
+/// exclusive lock of cache directory index, for processes sharing the same cache directory
+class ldomDocCacheLock
+{
+#ifdef _LINUX
+    int _fd;
+public:
+    ldomDocCacheLock( const lString16 & cacheDir )
+    {
+        _fd = open( UnicodeToLocal(cacheDir + "cr3cache.lck").c_str(), O_RDWR | O_CREAT, 0666 );
+        if ( _fd>=0 && flock( _fd, LOCK_EX )!=0 ) {
+            ::close( _fd );
+            _fd = -1;
+        }
+        if ( _fd<0 )
+            CRLog::warn("Cannot lock document cache directory %s", LCSTR(cacheDir));
+    }
+    ~ldomDocCacheLock()
+    {
+        if ( _fd>=0 ) {
+            flock( _fd, LOCK_UN );
+            ::close( _fd );
+        }
+    }
+#else
+public:
+    ldomDocCacheLock( const lString16 & cacheDir )
+    {
+        CR_UNUSED(cacheDir);
+    }
+#endif
+};
 
 /// document cache
+/**
+    Index file lists cache files, most recently used first. Changes of the list are
+    appended to journal file as records, which are merged into index file when journal
+    grows larger than DOC_CACHE_JOURNAL_MAX_SIZE. All operations lock cache directory,
+    read journal records added by other processes (or whole index after merge),
+    apply own change and append its records, so several processes may share cache directory.
+*/
 class ldomDocCacheImpl : public ldomDocCache
 {
     lString16 _cacheDir;
     lvsize_t _maxSize;
     lUInt32 _oldStreamSize;
     lUInt32 _oldStreamCRC;
+    ldomDocCacheStats _stats;
 
     struct FileItem {
         lString16 filename;
         lUInt32 size;
+        lUInt32 lastAccess; // time of last opening, seconds since epoch
+        lUInt32 renderTime; // time of document rendering, ms, 0 if unknown
+        lUInt32 hits;       // number of openings from cache
+        FileItem() : size(0), lastAccess(0), renderTime(0), hits(0) { }
     };
     LVPtrVector<FileItem> _files;
+
+    enum {
+        JOURNAL_MOVE_TO_TOP = 1, ///< file is opened or created: set its info and move it to beginning of list
+        JOURNAL_UPDATE = 2,      ///< size or render time of file is changed
+        JOURNAL_REMOVE = 3       ///< file is removed from cache
+    };
+    SerialBuf _journal;          // records of own changes not written to journal file yet
+    lUInt32 _journalGeneration;  // changed each time journal is merged into index file, 0 if there is no journal
+    lUInt32 _journalPos;         // size of journal file part already applied to _files
+    bool _journalBroken;         // damaged record found, journal is to be merged into index file
+
+    /// value of keeping file in cache: cost of rebuild per KB, falls with time since last access
+    double getKeepValue( FileItem * item, lUInt32 now )
+    {
+        double idle = now > item->lastAccess ? (double)(now - item->lastAccess) : 0.0;
+        double cost = (double)item->renderTime + DOC_CACHE_MIN_REBUILD_TIME;
+        return cost / ((double)item->size / 1024 + 1) / (idle + DOC_CACHE_IDLE_TIME_UNIT);
+    }
 public:
     ldomDocCacheImpl( lString16 cacheDir, lvsize_t maxSize )
         : _cacheDir( cacheDir ), _maxSize( maxSize ), _oldStreamSize(0), _oldStreamCRC(0)
+        , _journal( 1024, true ), _journalGeneration(0), _journalPos(0), _journalBroken(false)
     {
         LVAppendPathDelimiter( _cacheDir );
         CRLog::trace("ldomDocCacheImpl(%s maxSize=%d)", LCSTR(_cacheDir), (int)maxSize);
@@ -8742,14 +10150,6 @@ public:
     bool writeIndex()
     {
         lString16 filename = _cacheDir + "cr3cache.inx";
-        if (_oldStreamSize == 0)
-        {
-            LVStreamRef oldStream = LVOpenFileStream(filename.c_str(), LVOM_READ);
-            if (!oldStream.isNull()) {
-                _oldStreamSize = (lUInt32)oldStream->GetSize();
-                _oldStreamCRC = (lUInt32)oldStream->getcrc32();
-            }
-        }
 
         // fill buffer
         SerialBuf buf( 16384, true );
@@ -8761,12 +10161,15 @@ public:
             FileItem * item = _files[i];
             buf << item->filename;
             buf << item->size;
+            buf << item->lastAccess;
+            buf << item->renderTime;
+            buf << item->hits;
             CRLog::trace("cache item: %s %d", LCSTR(item->filename), (int)item->size);
         }
         buf.putCRC( buf.pos() - start );
         if ( buf.error() )
             return false;
-        lUInt32 newCRC = buf.getCRC();
+        lUInt32 newCRC = lStr_crc32( 0, buf.buf(), buf.pos() );
         lUInt32 newSize = buf.pos();
 
         // check to avoid rewritting of identical file
@@ -8781,10 +10184,141 @@ public:
             _oldStreamCRC = newCRC;
             _oldStreamSize = newSize;
         }
+        _journal.reset();
+        return resetJournal();
+    }
+
+    /// starts new journal after index file is written, unless current one is empty
+    bool resetJournal()
+    {
+        SerialBuf buf( 64, true );
+        buf.putMagic( doccache_journal_magic );
+        if ( _journalGeneration && !_journalBroken && _journalPos==(lUInt32)buf.pos() + 4 )
+            return true;
+        lUInt32 generation = _journalGeneration + 1;
+        if ( !generation )
+            generation = 1;
+        buf << generation;
+        LVStreamRef stream = LVOpenFileStream( (_cacheDir + "cr3cache.jnl").c_str(), LVOM_WRITE );
+        if ( !stream || stream->Write( buf.buf(), buf.pos(), NULL )!=LVERR_OK )
+            return false;
+        _journalGeneration = generation;
+        _journalPos = buf.pos();
+        _journalBroken = false;
+        return true;
+    }
+
+    /// adds record of change of file to journal buffer, call before removing item from list
+    void addJournalRecord( lUInt8 op, FileItem * item )
+    {
+        int start = _journal.pos();
+        _journal << op << item->filename << item->size << item->lastAccess << item->renderTime << item->hits;
+        _journal.putCRC( _journal.pos() - start );
+    }
+
+    /// reads journal record and applies it to file list, returns false if record is damaged
+    bool applyJournalRecord( SerialBuf & buf )
+    {
+        int start = buf.pos();
+        lUInt8 op = 0;
+        FileItem rec;
+        buf >> op >> rec.filename >> rec.size >> rec.lastAccess >> rec.renderTime >> rec.hits;
+        if ( !buf.checkCRC( buf.pos() - start ) )
+            return false;
+        int index = findFileIndex( rec.filename );
+        switch ( op ) {
+        case JOURNAL_MOVE_TO_TOP:
+            {
+                FileItem * item = moveFileToTop( rec.filename, rec.size );
+                item->lastAccess = rec.lastAccess;
+                item->renderTime = rec.renderTime;
+                item->hits = rec.hits;
+            }
+            break;
+        case JOURNAL_UPDATE:
+            if ( index>=0 ) {
+                _files[index]->size = rec.size;
+                _files[index]->renderTime = rec.renderTime;
+            }
+            break;
+        case JOURNAL_REMOVE:
+            if ( index>=0 )
+                _files.erase( index, 1 );
+            break;
+        default:
+            return false;
+        }
+        return true;
+    }
+
+    /// appends own changes to journal file; merges journal into index file if it's too large or damaged
+    bool writeChanges()
+    {
+        if ( !_journal.pos() )
+            return true;
+        if ( _journalBroken || !_journalGeneration || _journalPos + _journal.pos() > DOC_CACHE_JOURNAL_MAX_SIZE )
+            return writeIndex();
+        LVStreamRef stream = LVOpenFileStream( (_cacheDir + "cr3cache.jnl").c_str(), LVOM_APPEND );
+        if ( !stream || stream->GetSize()!=_journalPos )
+            return writeIndex();
+        lvsize_t bytesWritten = 0;
+        if ( stream->Seek( _journalPos, LVSEEK_SET, NULL )!=LVERR_OK || stream->Write( _journal.buf(), _journal.pos(), &bytesWritten )!=LVERR_OK
+                || bytesWritten!=(lvsize_t)_journal.pos() ) {
+            _journalBroken = true;
+            return writeIndex();
+        }
+        _journalPos += _journal.pos();
+        _journal.reset();
+        return true;
+    }
+
+    /// reads journal records added since last reading; rereads index file if journal is merged into it by another process
+    bool readIndex()
+    {
+        LVStreamRef stream = LVOpenFileStream( (_cacheDir + "cr3cache.jnl").c_str(), LVOM_READ );
+        LVStreamBufferRef sb;
+        if ( !stream.isNull() )
+            sb = stream->GetReadBuffer( 0, stream->GetSize() );
+        SerialBuf buf( sb.isNull() ? NULL : sb->getReadOnly(), sb.isNull() ? 0 : (int)sb->getSize() );
+        lUInt32 generation = 0;
+        if ( !buf.checkMagic( doccache_journal_magic ) || (buf >> generation).error() )
+            generation = 0;
+        if ( generation!=_journalGeneration ) {
+            // journal is merged into index file
+            _oldStreamCRC = 0;
+            _oldStreamSize = 0;
+        }
+        bool reloaded = false;
+        if ( !readIndexFile( reloaded ) )
+            return false;
+        if ( !generation ) {
+            _journalGeneration = 0;
+            _journalBroken = !stream.isNull();
+            return true;
+        }
+        if ( reloaded || generation!=_journalGeneration ) {
+            _journalGeneration = generation;
+            _journalPos = buf.pos();
+            _journalBroken = false;
+        }
+        if ( _journalPos > (lUInt32)buf.size() )
+            _journalBroken = true; // truncated by someone else
+        if ( _journalBroken )
+            return true; // will be merged into index file on next change
+        buf.setPos( _journalPos );
+        while ( buf.pos() < buf.size() ) {
+            if ( !applyJournalRecord( buf ) ) {
+                CRLog::error("Damaged record in cache index journal");
+                _journalBroken = true;
+                break;
+            }
+            _journalPos = buf.pos();
+        }
         return true;
     }
 
-    bool readIndex(  )
+    /// reads index file; if it's not changed since last reading or writing, keeps current list
+    bool readIndexFile( bool & reloaded )
     {
         lString16 filename = _cacheDir + "cr3cache.inx";
         // read index
@@ -8794,20 +10328,34 @@ public:
             LVStreamBufferRef sb = instream->GetReadBuffer(0, instream->GetSize() );
             if ( !sb )
                 return false;
+            lUInt32 crc = lStr_crc32( 0, sb->getReadOnly(), (int)sb->getSize() );
+            if ( crc==_oldStreamCRC && (lUInt32)sb->getSize()==_oldStreamSize )
+                return true;
             SerialBuf buf( sb->getReadOnly(), sb->getSize() );
+            bool v100 = false;
             if ( !buf.checkMagic( doccache_magic ) ) {
-                CRLog::error("wrong cache index file format");
-                return false;
+                buf.reset();
+                if ( !buf.checkMagic( doccache_magic_v100 ) ) {
+                    CRLog::error("wrong cache index file format");
+                    return false;
+                }
+                v100 = true;
             }
 
+            LVPtrVector<FileItem> files;
             lUInt32 start = buf.pos();
             lUInt32 count;
             buf >> count;
             for (lUInt32 i=0; i < count && !buf.error(); i++) {
                 FileItem * item = new FileItem();
-                _files.add( item );
+                files.add( item );
                 buf >> item->filename;
                 buf >> item->size;
+                if ( !v100 ) {
+                    buf >> item->lastAccess;
+                    buf >> item->renderTime;
+                    buf >> item->hits;
+                }
                 CRLog::trace("cache %d: %s [%d]", i, UnicodeToUtf8(item->filename).c_str(), (int)item->size );
                 totalSize += item->size;
             }
@@ -8819,6 +10367,12 @@ public:
             if ( buf.error() )
                 return false;
 
+            _files.clear();
+            while ( files.length() )
+                _files.add( files.remove(0) );
+            _oldStreamCRC = v100 ? 0 : crc;
+            _oldStreamSize = v100 ? 0 : (lUInt32)sb->getSize();
+            reloaded = true;
             CRLog::info( "Document cache index file read ok, %d files in cache, %d bytes", _files.length(), totalSize );
             return true;
         } else {
@@ -8861,32 +10415,52 @@ public:
         return true;
     }
 
-    // remove all extra files to add new one of specified size
+    // remove files with least keep value to add new one of specified size
     bool reserve( lvsize_t allocSize )
     {
         bool res = true;
-        // remove extra files specified in list
+        // drop entries of missing files
         lvsize_t dirsize = allocSize;
         for ( int i=0; i<_files.length(); ) {
             if ( LVFileExists( _cacheDir + _files[i]->filename ) ) {
-                if ( (i>0 || allocSize>0) && dirsize+_files[i]->size > _maxSize ) {
-                    if ( LVDeleteFile( _cacheDir + _files[i]->filename ) ) {
-                        _files.erase(i, 1);
-                    } else {
-                        CRLog::error("Cannot delete cache file %s", UnicodeToUtf8(_files[i]->filename).c_str() );
-                        dirsize += _files[i]->size;
-                        res = false;
-                        i++;
-                    }
-                } else {
-                    dirsize += _files[i]->size;
-                    i++;
-                }
+                dirsize += _files[i]->size;
+                i++;
             } else {
                 CRLog::error("File %s is found in cache index, but does not exist", UnicodeToUtf8(_files[i]->filename).c_str() );
+                addJournalRecord( JOURNAL_REMOVE, _files[i] );
                 _files.erase(i, 1);
             }
         }
+        // most recently used file is kept unless space for new file is necessary
+        lUInt32 now = (lUInt32)time(NULL);
+        LVArray<bool> locked( _files.length(), false );
+        while ( dirsize > _maxSize ) {
+            int victim = -1;
+            double victimValue = 0;
+            for ( int i=(allocSize>0 ? 0 : 1); i<_files.length(); i++ ) {
+                if ( locked[i] )
+                    continue;
+                double value = getKeepValue( _files[i], now );
+                if ( victim<0 || value<victimValue ) {
+                    victim = i;
+                    victimValue = value;
+                }
+            }
+            if ( victim<0 )
+                break;
+            if ( LVDeleteFile( _cacheDir + _files[victim]->filename ) ) {
+                CRLog::info("Removing cache file %s (%d bytes)", UnicodeToUtf8(_files[victim]->filename).c_str(), (int)_files[victim]->size );
+                dirsize -= _files[victim]->size;
+                addJournalRecord( JOURNAL_REMOVE, _files[victim] );
+                _files.erase(victim, 1);
+                locked.erase(victim, 1);
+                _stats.evicted++;
+            } else {
+                CRLog::error("Cannot delete cache file %s", UnicodeToUtf8(_files[victim]->filename).c_str() );
+                locked[victim] = true;
+                res = false;
+            }
+        }
         return res;
     }
 
@@ -8899,24 +10473,26 @@ public:
         return -1;
     }
 
-    bool moveFileToTop( lString16 filename, lUInt32 size )
+    FileItem * moveFileToTop( lString16 filename, lUInt32 size )
     {
         int index = findFileIndex( filename );
         if ( index<0 ) {
             FileItem * item = new FileItem();
             item->filename = filename;
-            item->size = size;
             _files.insert( 0, item );
         } else {
             _files.move( 0, index );
-            _files[0]->size = size;
         }
-        return writeIndex();
+        _files[0]->size = size;
+        _files[0]->lastAccess = (lUInt32)time(NULL);
+        return _files[0];
     }
 
     bool init()
     {
         CRLog::info("Initialize document cache in directory %s", UnicodeToUtf8(_cacheDir).c_str() );
+        LVCreateDirectory( _cacheDir );
+        ldomDocCacheLock lock( _cacheDir );
         // read index
         if ( readIndex(  ) ) {
             // read successfully
@@ -8939,8 +10515,10 @@ public:
     /// remove all files
     bool clear()
     {
+        ldomDocCacheLock lock( _cacheDir );
+        readIndex();
         for ( int i=0; i<_files.length(); i++ )
-            LVDeleteFile( _files[i]->filename );
+            LVDeleteFile( _cacheDir + _files[i]->filename );
         _files.clear();
         return writeIndex();
     }
@@ -8982,14 +10560,18 @@ public:
     {
         lString16 fn = makeFileName( filename, crc, docFlags );
         CRLog::debug("ldomDocCache::openExisting(%s)", LCSTR(fn));
+        ldomDocCacheLock lock( _cacheDir );
+        readIndex();
         LVStreamRef res;
         if ( findFileIndex( fn ) < 0 ) {
             CRLog::error( "ldomDocCache::openExisting - File %s is not found in cache index", UnicodeToUtf8(fn).c_str() );
+            _stats.misses++;
             return res;
         }
         res = LVOpenFileStream( (_cacheDir+fn).c_str(), LVOM_APPEND|LVOM_FLAG_SYNC );
         if ( !res ) {
             CRLog::error( "ldomDocCache::openExisting - File %s is listed in cache index, but cannot be opened", UnicodeToUtf8(fn).c_str() );
+            _stats.misses++;
             return res;
         }
 
@@ -9007,7 +10589,11 @@ public:
 #endif
 
         lUInt32 fileSize = (lUInt32) res->GetSize();
-        moveFileToTop( fn, fileSize );
+        FileItem * item = moveFileToTop( fn, fileSize );
+        item->hits++;
+        addJournalRecord( JOURNAL_MOVE_TO_TOP, item );
+        writeChanges();
+        _stats.hits++;
         return res;
     }
 
@@ -9017,14 +10603,21 @@ public:
         lString16 fn = makeFileName( filename, crc, docFlags );
         LVStreamRef res;
         lString16 pathname( _cacheDir+fn );
-        if ( findFileIndex( pathname ) >= 0 )
+        ldomDocCacheLock lock( _cacheDir );
+        readIndex();
+        int index = findFileIndex( fn );
+        if ( index >= 0 ) {
             LVDeleteFile( pathname );
+            addJournalRecord( JOURNAL_REMOVE, _files[index] );
+            _files.erase( index, 1 );
+        }
         reserve( fileSize/10 );
         //res = LVMapFileStream( (_cacheDir+fn).c_str(), LVOM_APPEND, fileSize );
         LVDeleteFile( pathname ); // try to delete, ignore errors
         res = LVOpenFileStream( pathname.c_str(), LVOM_APPEND|LVOM_FLAG_SYNC );
         if ( !res ) {
             CRLog::error( "ldomDocCache::createNew - file %s is cannot be created", UnicodeToUtf8(fn).c_str() );
+            writeChanges();
             return res;
         }
 #if ENABLED_BLOCK_WRITE_CACHE
@@ -9038,10 +10631,39 @@ public:
         res = LVCreateCompareTestStream(res, stream2);
 #endif
 #endif
-        moveFileToTop( fn, fileSize );
+        addJournalRecord( JOURNAL_MOVE_TO_TOP, moveFileToTop( fn, fileSize ) );
+        writeChanges();
         return res;
     }
 
+    /// updates size and render time of saved cache file
+    bool updateFileInfo( lString16 filename, lUInt32 crc, lUInt32 docFlags, lUInt32 cacheFileSize, lUInt32 renderTime )
+    {
+        lString16 fn = makeFileName( filename, crc, docFlags );
+        ldomDocCacheLock lock( _cacheDir );
+        readIndex();
+        int index = findFileIndex( fn );
+        if ( index<0 )
+            return false;
+        _files[index]->size = cacheFileSize;
+        if ( renderTime )
+            _files[index]->renderTime = renderTime;
+        addJournalRecord( JOURNAL_UPDATE, _files[index] );
+        return writeChanges();
+    }
+
+    /// returns statistics, file list is reread if changed by another process
+    void getStats( ldomDocCacheStats & stats )
+    {
+        ldomDocCacheLock lock( _cacheDir );
+        readIndex();
+        stats = _stats;
+        stats.fileCount = _files.length();
+        stats.totalSize = 0;
+        for ( int i=0; i<_files.length(); i++ )
+            stats.totalSize += _files[i]->size;
+    }
+
     virtual ~ldomDocCacheImpl()
     {
     }
@@ -9088,6 +10710,23 @@ LVStreamRef ldomDocCache::createNew( lString16 filename, lUInt32 crc, lUInt32 do
     return _cacheInstance->createNew( filename, crc, docFlags, fileSize );
 }
 
+/// records size and render time of saved cache file, used to choose files to remove when cache is full
+bool ldomDocCache::updateFileInfo( lString16 filename, lUInt32 crc, lUInt32 docFlags, lUInt32 cacheFileSize, lUInt32 renderTime )
+{
+    if ( !_cacheInstance )
+        return false;
+    return _cacheInstance->updateFileInfo( filename, crc, docFlags, cacheFileSize, renderTime );
+}
+
+/// returns hit/miss counters since init() and current size of cache
+bool ldomDocCache::getStats( ldomDocCacheStats & stats )
+{
+    if ( !_cacheInstance )
+        return false;
+    _cacheInstance->getStats( stats );
+    return true;
+}
+
 /// delete all cache files
 bool ldomDocCache::clear()
 {
@@ -10050,6 +11689,93 @@ lString8 ldomNode::getText8( lChar8 blockDelimiter, int maxSize ) const
     return lString8::empty_str;
 }
 
+/// returns UTF-8 text of text node, storage chunk of persistent node is not packed until unpinText()
+const lChar8 * ldomNode::pinText( int & len ) const
+{
+    ASSERT_NODE_NOT_NULL;
+    switch ( TNTYPE ) {
+#if BUILD_LITE!=1
+    case NT_PTEXT:
+        {
+            TextDataStorageItem * item = getDocument()->_textStorage.pinText( _data._ptext_addr );
+            if ( !item ) {
+                // bad address: nothing is pinned, unpinText() is not expected
+                len = 0;
+                return NULL;
+            }
+            len = item->length;
+            return item->text;
+        }
+#endif
+    case NT_TEXT:
+        len = _data._text_ptr->getTextRef().length();
+        return _data._text_ptr->getTextRef().c_str();
+    }
+    len = 0;
+    return NULL;
+}
+
+/// releases text returned by pinText()
+void ldomNode::unpinText() const
+{
+#if BUILD_LITE!=1
+    if ( TNTYPE==NT_PTEXT )
+        getDocument()->_textStorage.unpinText( _data._ptext_addr );
+#endif
+}
+
+/// returns number of characters in node text (same as getText().length()), without conversion of whole text
+int ldomNode::getTextLength() const
+{
+    if ( !isText() ) {
+        // same as getText().length(), without concatenation of children text
+        int count = 0;
+        int cc = getChildCount();
+        for ( int i=0; i<cc; i++ )
+            count += getChildNode(i)->getTextLength();
+        return count;
+    }
+    ldomTextRef txt( this );
+    // every character has exactly one byte which is not UTF-8 continuation byte
+    const lUInt8 * p = (const lUInt8 *)txt.text();
+    int count = 0;
+    for ( int i=0; i<txt.length(); i++ )
+        if ( (p[i] & 0xC0)!=0x80 )
+            count++;
+    return count;
+}
+
+ldomTextRef::ldomTextRef( const ldomNode * node )
+: _node(node), _text(NULL), _len(0)
+{
+    _text = _node->pinText( _len );
+    // stored text may have trailing zero, string conversions stop there
+    const void * end = _len ? memchr( _text, 0, _len ) : NULL;
+    if ( end )
+        _len = (int)((const lChar8 *)end - _text);
+}
+
+ldomTextRef::~ldomTextRef()
+{
+    if ( _text )
+        _node->unpinText();
+}
+
+/// decodes text to dst, reusing its buffer
+void ldomTextRef::decode( lString16 & dst ) const
+{
+    // UTF-8 text has at least as many bytes as characters
+    dst.reset( _len );
+    if ( !_len )
+        return;
+    dst.append( _len, 0 );
+    int srclen = _len;
+    int dstlen = _len;
+    Utf8ToUnicode( (const lUInt8 *)_text, srclen, dst.modify(), dstlen );
+    if ( dstlen < _len )
+        dst.erase( dstlen, _len - dstlen );
+}
+
 /// sets text node text as wide string
 void ldomNode::setText( lString16 str )
 {
@@ -10079,6 +11805,9 @@ void ldomNode::setText( lString16 str )
         }
         break;
     }
+#if BUILD_LITE!=1
+    getDocument()->onTreeModified();
+#endif
 }
 
 /// sets text node text as utf8 string
@@ -10110,6 +11839,9 @@ void ldomNode::setText8( lString8 utf8 )
         }
         break;
     }
+#if BUILD_LITE!=1
+    getDocument()->onTreeModified();
+#endif
 }
 
 #if BUILD_LITE!=1
@@ -10228,7 +11960,9 @@ static void updateStyleDataRecursive( ldomNode * node )
 void ldomNode::initNodeStyleRecursive()
 {
     getDocument()->_fontMap.clear();
+    getDocument()->_styleMemo.clear();
     updateStyleDataRecursive( this );
+    getDocument()->_styleMemo.clear();
     //recurseElements( updateStyleData );
 }
 #endif
@@ -10486,6 +12220,81 @@ bool ldomNode::initNodeFont()
     return true;
 }
 
+void ldomStyleMemo::Key::init( ldomNode * node, css_style_ref_t & parentStyle )
+{
+    _parentStyle = parentStyle;
+    _elementId = node->getNodeId();
+    _class.clear();
+    _id.clear();
+    _style.clear();
+    if ( node->hasAttributes() ) {
+        _class = node->getAttributeValue( attr_class );
+        _id = node->getAttributeValue( attr_id );
+        _style = node->getAttributeValue( attr_style );
+    }
+    lUInt32 h = getHash( (void*)parentStyle.get() );
+    h = h * 31 + _elementId;
+    h = h * 31 + _class.getHash();
+    h = h * 31 + _id.getHash();
+    h = h * 31 + _style.getHash();
+    _hash = h;
+}
+
+void ldomStyleMemo::validate( lUInt32 sheetGeneration, int baseFontSize, bool internalStyles )
+{
+    if ( sheetGeneration==_sheetGeneration && baseFontSize==_baseFontSize && internalStyles==_internalStyles )
+        return;
+    clear();
+    _sheetGeneration = sheetGeneration;
+    _baseFontSize = baseFontSize;
+    _internalStyles = internalStyles;
+}
+
+bool ldomStyleMemo::find( const Key & key, css_style_ref_t & style )
+{
+    int index;
+    if ( _index.get( key._hash, index ) ) {
+        for ( ; index>=0; index = _items[index]->next ) {
+            Item * item = _items[index];
+            if ( item->key==key ) {
+                style = item->style;
+                _hits++;
+                return true;
+            }
+        }
+    }
+    _misses++;
+    return false;
+}
+
+void ldomStyleMemo::add( const Key & key, css_style_ref_t & style )
+{
+    if ( _items.length()>=STYLE_MEMO_MAX_ITEMS ) {
+        lUInt32 generation = _sheetGeneration;
+        clear();
+        _sheetGeneration = generation;
+    }
+    Item * item = new Item();
+    item->key = key;
+    item->style = style;
+    item->next = -1;
+    int first;
+    if ( _index.get( key._hash, first ) )
+        item->next = first;
+    _index.set( key._hash, _items.length() );
+    _items.add( item );
+}
+
+void ldomStyleMemo::clear()
+{
+    if ( _hits || _misses )
+        CRLog::debug("style memo: %d items, %d hits, %d misses", _items.length(), _hits, _misses);
+    _items.clear();
+    _index.clear();
+    _hits = _misses = 0;
+    _sheetGeneration = 0;
+}
+
 void ldomNode::initNodeStyle()
 {
     // assume all parent styles already initialized
@@ -10503,11 +12312,12 @@ void ldomNode::initNodeStyle()
         {
             ldomNode * parent = getParentNode();
 
-            // DEBUG TEST
+#if DEBUG_DOM_STORAGE==1
+            // linear search in parent's children: quadratic for flat documents like huge text files
             if ( parent->getChildIndex( getDataIndex() )<0 ) {
                 CRLog::error("Invalid parent->child relation for nodes %d->%d", parent->getDataIndex(), getDataIndex() );
             }
-
+#endif
 
             //lvdomElementFormatRec * parent_fmt = node->getParentNode()->getRenderData();
             css_style_ref_t style = parent->getStyle();
@@ -10751,6 +12561,9 @@ void ldomNode::moveItemsTo( ldomNode * destination, int startChildIndex, int end
         item->setParentNode(destination);
         destination->addChild( item->getDataIndex() );
     }
+#if BUILD_LITE!=1
+    getDocument()->onTreeModified();
+#endif
     // TODO: renumber rest of children in necessary
 /*#ifdef _DEBUG
     if ( !_document->checkConsistency( false ) )
@@ -10814,6 +12627,9 @@ ldomNode * ldomNode::insertChildElement( lUInt32 index, lUInt16 nsid, lUInt16 id
             index = me->_children.length();
         ldomNode * node = getDocument()->allocTinyElement( this, nsid, id );
         me->_children.insert( index, node->getDataIndex() );
+#if BUILD_LITE!=1
+        getDocument()->onTreeModified();
+#endif
         return node;
     }
     readOnlyError();
@@ -10829,6 +12645,9 @@ ldomNode * ldomNode::insertChildElement( lUInt16 id )
             modify();
         ldomNode * node = getDocument()->allocTinyElement( this, LXML_NS_NONE, id );
         NPELEM->_children.insert( NPELEM->_children.length(), node->getDataIndex() );
+#if BUILD_LITE!=1
+        getDocument()->onTreeModified();
+#endif
         return node;
     }
     readOnlyError();
@@ -10856,6 +12675,9 @@ ldomNode * ldomNode::insertChildText( lUInt32 index, const lString16 & value )
         node->_data._ptext_addr = getDocument()->_textStorage.allocText( node->_handle._dataIndex, _handle._dataIndex, s8 );
 #endif
         me->_children.insert( index, node->getDataIndex() );
+#if BUILD_LITE!=1
+        getDocument()->onTreeModified();
+#endif
         return node;
     }
     readOnlyError();
@@ -10880,6 +12702,9 @@ ldomNode * ldomNode::insertChildText( const lString16 & value )
         node->_data._ptext_addr = getDocument()->_textStorage.allocText( node->_handle._dataIndex, _handle._dataIndex, s8 );
 #endif
         me->_children.insert( me->_children.length(), node->getDataIndex() );
+#if BUILD_LITE!=1
+        getDocument()->onTreeModified();
+#endif
         return node;
     }
     readOnlyError();
@@ -10902,6 +12727,9 @@ ldomNode * ldomNode::insertChildText(const lString8 & s8)
         node->_data._ptext_addr = getDocument()->_textStorage.allocText( node->_handle._dataIndex, _handle._dataIndex, s8 );
 #endif
         me->_children.insert( me->_children.length(), node->getDataIndex() );
+#if BUILD_LITE!=1
+        getDocument()->onTreeModified();
+#endif
         return node;
     }
     readOnlyError();
@@ -10917,6 +12745,9 @@ ldomNode * ldomNode::removeChild( lUInt32 index )
             modify();
         lUInt32 removedIndex = NPELEM->_children.remove(index);
         ldomNode * node = getTinyNode( removedIndex );
+#if BUILD_LITE!=1
+        getDocument()->onTreeModified();
+#endif
         return node;
     }
     readOnlyError();
@@ -11068,6 +12899,22 @@ LVImageSourceRef ldomNode::getObjectImageSource()
     return ref;
 }
 
+/// returns object image source decoded and scaled to size it's drawn at, using decoded image cache
+LVImageSourceRef ldomNode::getObjectImageSource( int dx, int dy )
+{
+    int docIndex = getDocument()->getDocIndex();
+    lUInt32 imageId = getDocument()->getObjectImageId( this );
+    if ( !imageId )
+        return LVImageSourceRef();
+    LVImageSourceRef ref = LVDecodedImageCache::find( docIndex, imageId, dx, dy );
+    if ( !ref.isNull() )
+        return ref;
+    ref = getObjectImageSource();
+    if ( ref.isNull() )
+        return ref;
+    return LVDecodedImageCache::get( docIndex, imageId, ref, dx, dy );
+}
+
 /// register embedded document fonts in font manager, if any exist in document
 void ldomDocument::registerEmbeddedFonts()
 {
@@ -11153,6 +13000,21 @@ LVStreamRef ldomDocument::getObjectImageStream( lString16 refName )
     return ref;
 }
 
+/// returns id of image referenced by node, same for all nodes referencing the same image, 0 if none
+lUInt32 ldomDocument::getObjectImageId( ldomNode * node )
+{
+    lUInt32 id = 0;
+    if ( _imageNodeIdMap.get( node->getDataIndex(), id ) )
+        return id;
+    lString16 refName = node->getObjectImageRefName();
+    if ( !refName.empty() && !_urlImageIdMap.get( refName, id ) ) {
+        id = _urlImageIdMap.length() + 1;
+        _urlImageIdMap.set( refName, id );
+    }
+    _imageNodeIdMap.set( node->getDataIndex(), id );
+    return id;
+}
+
 /// returns object image source
 LVImageSourceRef ldomDocument::getObjectImageSource( lString16 refName )
 {
@@ -11177,6 +13039,440 @@ void ldomDocument::setNodeNumberingProps( lUInt32 nodeDataIndex, ListNumberingPr
     lists.set(nodeDataIndex, v);
 }
 
+static const char * block_geometry_magic = "CRGEOMETRY";
+
+/// copies layout of formatted text
+void ldomBlockGeometry::init( LFormattedText * txtform )
+{
+    srcs.clear();
+    lines.clear();
+    words.clear();
+    int srcCount = txtform->GetSrcCount();
+    srcs.reserve( srcCount );
+    for ( int i=0; i<srcCount; i++ ) {
+        const src_text_fragment_t * src = txtform->GetSrcInfo(i);
+        Src item;
+        ldomNode * node = (ldomNode *)src->object;
+        item.node = node ? node->getDataIndex() : 0;
+        item.flags = src->flags;
+        item.offset = src->t.offset;
+        item.len = src->t.len;
+        item.letterSpacing = src->letter_spacing;
+        srcs.add( item );
+    }
+    int lineCount = txtform->GetLineCount();
+    lines.reserve( lineCount );
+    for ( int l=0; l<lineCount; l++ ) {
+        const formatted_line_t * frmline = txtform->GetLineInfo(l);
+        Line line;
+        line.y = frmline->y;
+        line.x = frmline->x;
+        line.height = frmline->height;
+        line.firstWord = words.length();
+        line.wordCount = frmline->word_count;
+        lines.add( line );
+        for ( int w=0; w<(int)frmline->word_count; w++ ) {
+            const formatted_word_t * frmword = &frmline->words[w];
+            Word word;
+            word.src = frmword->src_text_index;
+            word.x = frmword->x;
+            word.width = frmword->width;
+            word.start = frmword->t.start;
+            word.len = frmword->t.len;
+            words.add( word );
+        }
+    }
+}
+
+/// returns index of first line with bottom below y, last line if none
+int ldomBlockGeometry::findLine( int y ) const
+{
+    int a = 0;
+    int b = lines.length() - 1;
+    while ( a < b ) {
+        int c = (a + b) / 2;
+        if ( y >= (int)(lines[c].y + lines[c].height) )
+            a = c + 1;
+        else
+            b = c;
+    }
+    return a;
+}
+
+/// returns approximate size of memory used
+int ldomBlockGeometry::getSize() const
+{
+    return sizeof(*this) + srcs.length() * sizeof(Src) + lines.length() * sizeof(Line) + words.length() * sizeof(Word);
+}
+
+void ldomBlockGeometry::serialize( SerialBuf & buf ) const
+{
+    buf << (lUInt32)srcs.length();
+    for ( int i=0; i<srcs.length(); i++ ) {
+        const Src & src = srcs[i];
+        buf << src.node << src.flags << src.offset << src.len << (lUInt8)src.letterSpacing;
+    }
+    buf << (lUInt32)lines.length();
+    for ( int i=0; i<lines.length(); i++ ) {
+        const Line & line = lines[i];
+        buf << line.y << line.x << line.height << line.wordCount;
+    }
+    for ( int i=0; i<words.length(); i++ ) {
+        const Word & word = words[i];
+        buf << word.src << word.x << word.width << word.start << word.len;
+    }
+}
+
+bool ldomBlockGeometry::deserialize( SerialBuf & buf )
+{
+    srcs.clear();
+    lines.clear();
+    words.clear();
+    lUInt32 count = 0;
+    buf >> count;
+    for ( lUInt32 i=0; i<count && !buf.error(); i++ ) {
+        Src src;
+        lUInt8 letterSpacing = 0;
+        buf >> src.node >> src.flags >> src.offset >> src.len >> letterSpacing;
+        src.letterSpacing = (lInt8)letterSpacing;
+        srcs.add( src );
+    }
+    buf >> count;
+    lUInt32 wordCount = 0;
+    for ( lUInt32 i=0; i<count && !buf.error(); i++ ) {
+        Line line;
+        buf >> line.y >> line.x >> line.height >> line.wordCount;
+        line.firstWord = wordCount;
+        wordCount += line.wordCount;
+        lines.add( line );
+    }
+    for ( lUInt32 i=0; i<wordCount && !buf.error(); i++ ) {
+        Word word;
+        buf >> word.src >> word.x >> word.width >> word.start >> word.len;
+        words.add( word );
+    }
+    return !buf.error();
+}
+
+/// returns geometry of block, NULL if not found
+ldomBlockGeometry * ldomBlockGeometryCache::get( lUInt32 nodeIndex )
+{
+    ldomBlockGeometry * geometry = NULL;
+    _map.get( nodeIndex, geometry );
+    return geometry;
+}
+
+/// stores geometry of block (takes ownership)
+void ldomBlockGeometryCache::set( lUInt32 nodeIndex, ldomBlockGeometry * geometry )
+{
+    int size = geometry->getSize();
+    if ( _size + size > BLOCK_GEOMETRY_CACHE_MAX_SIZE ) {
+        CRLog::debug("block geometry cache: %d blocks, %d bytes - resetting", _map.length(), _size);
+        clear();
+    }
+    remove( nodeIndex );
+    _map.set( nodeIndex, geometry );
+    _size += size;
+    _changed = true;
+}
+
+/// forget geometry of block
+void ldomBlockGeometryCache::remove( lUInt32 nodeIndex )
+{
+    ldomBlockGeometry * geometry = NULL;
+    if ( _map.get( nodeIndex, geometry ) ) {
+        _size -= geometry->getSize();
+        delete geometry;
+        _map.remove( nodeIndex );
+        _changed = true;
+    }
+}
+
+/// removes all items
+void ldomBlockGeometryCache::clear()
+{
+    if ( !_map.length() )
+        return;
+    LVHashTable<lUInt32, ldomBlockGeometry*>::pair * pair;
+    for ( LVHashTable<lUInt32, ldomBlockGeometry*>::iterator p = _map.forwardIterator(); (pair=p.next())!=NULL; )
+        delete pair->value;
+    _map.clear();
+    _size = 0;
+    _changed = true;
+}
+
+void ldomBlockGeometryCache::serialize( SerialBuf & buf )
+{
+    int pos = buf.pos();
+    buf.putMagic( block_geometry_magic );
+    buf << (lUInt32)_map.length();
+    LVHashTable<lUInt32, ldomBlockGeometry*>::pair * pair;
+    for ( LVHashTable<lUInt32, ldomBlockGeometry*>::iterator p = _map.forwardIterator(); (pair=p.next())!=NULL; ) {
+        buf << pair->key;
+        pair->value->serialize( buf );
+    }
+    buf.putCRC( buf.pos() - pos );
+    _changed = false;
+}
+
+bool ldomBlockGeometryCache::deserialize( SerialBuf & buf )
+{
+    clear();
+    int pos = buf.pos();
+    if ( !buf.checkMagic( block_geometry_magic ) )
+        return false;
+    lUInt32 count = 0;
+    buf >> count;
+    for ( lUInt32 i=0; i<count && !buf.error(); i++ ) {
+        lUInt32 nodeIndex = 0;
+        buf >> nodeIndex;
+        ldomBlockGeometry * geometry = new ldomBlockGeometry();
+        if ( !geometry->deserialize( buf ) ) {
+            delete geometry;
+            break;
+        }
+        set( nodeIndex, geometry );
+    }
+    buf.checkCRC( buf.pos() - pos );
+    if ( buf.error() ) {
+        clear();
+        _changed = false;
+        return false;
+    }
+    _changed = false;
+    return true;
+}
+
+static const char * table_cells_magic = "CRTABLECELLS";
+
+/// returns text lengths of cells in table order, NULL if not measured yet
+LVArray<lInt32> * ldomTableCellCache::get( lUInt32 tableIndex )
+{
+    LVArray<lInt32> * lengths = NULL;
+    _map.get( tableIndex, lengths );
+    return lengths;
+}
+
+/// stores text lengths of table cells (takes ownership)
+void ldomTableCellCache::set( lUInt32 tableIndex, LVArray<lInt32> * lengths )
+{
+    LVArray<lInt32> * old = NULL;
+    if ( _map.get( tableIndex, old ) )
+        delete old;
+    _map.set( tableIndex, lengths );
+    _changed = true;
+}
+
+/// removes all items
+void ldomTableCellCache::clear()
+{
+    if ( !_map.length() )
+        return;
+    LVHashTable<lUInt32, LVArray<lInt32>*>::pair * pair;
+    for ( LVHashTable<lUInt32, LVArray<lInt32>*>::iterator p = _map.forwardIterator(); (pair=p.next())!=NULL; )
+        delete pair->value;
+    _map.clear();
+    _changed = true;
+}
+
+void ldomTableCellCache::serialize( SerialBuf & buf )
+{
+    int pos = buf.pos();
+    buf.putMagic( table_cells_magic );
+    buf << (lUInt32)_map.length();
+    LVHashTable<lUInt32, LVArray<lInt32>*>::pair * pair;
+    for ( LVHashTable<lUInt32, LVArray<lInt32>*>::iterator p = _map.forwardIterator(); (pair=p.next())!=NULL; ) {
+        LVArray<lInt32> * lengths = pair->value;
+        buf << pair->key << (lUInt32)lengths->length();
+        for ( int i=0; i<lengths->length(); i++ )
+            buf << (lUInt32)lengths->get(i);
+    }
+    buf.putCRC( buf.pos() - pos );
+    _changed = false;
+}
+
+bool ldomTableCellCache::deserialize( SerialBuf & buf )
+{
+    clear();
+    int pos = buf.pos();
+    if ( !buf.checkMagic( table_cells_magic ) )
+        return false;
+    lUInt32 count = 0;
+    buf >> count;
+    for ( lUInt32 i=0; i<count && !buf.error(); i++ ) {
+        lUInt32 tableIndex = 0;
+        lUInt32 cellCount = 0;
+        buf >> tableIndex >> cellCount;
+        LVArray<lInt32> * lengths = new LVArray<lInt32>();
+        for ( lUInt32 j=0; j<cellCount && !buf.error(); j++ ) {
+            lUInt32 len = 0;
+            buf >> len;
+            lengths->add( (lInt32)len );
+        }
+        set( tableIndex, lengths );
+    }
+    buf.checkCRC( buf.pos() - pos );
+    if ( buf.error() )
+        clear();
+    _changed = false;
+    return !buf.error();
+}
+
+static const char * render_positions_magic = "CRRENDPOS2";
+
+/// adds image drawn at line starting at y
+void ldomRenderPositionIndex::addImage( int y, lUInt32 node, int dx, int dy )
+{
+    Image img;
+    img.y = y;
+    img.node = node;
+    img.dx = dx;
+    img.dy = dy;
+    // blocks are rendered in document order, so it's normally appended
+    int pos = _images.length();
+    while ( pos>0 && _images[pos-1].y > y )
+        pos--;
+    _images.insert( pos, img );
+    _changed = true;
+}
+
+/// appends images with line top in range [y0, y1) to list
+void ldomRenderPositionIndex::findImages( int y0, int y1, LVArray<Image> & images ) const
+{
+    // first image with y >= y0
+    int a = 0;
+    int b = _images.length();
+    while ( a < b ) {
+        int c = (a + b) / 2;
+        if ( _images[c].y < y0 )
+            a = c + 1;
+        else
+            b = c;
+    }
+    for ( int i=a; i<_images.length() && _images[i].y < y1; i++ )
+        images.add( _images[i] );
+}
+
+/// adds final block starting at y unless previous recorded block is closer than RENDER_POSITION_BLOCK_STEP
+void ldomRenderPositionIndex::addBlock( int y, lUInt32 node, lUInt32 text )
+{
+    // blocks are rendered in document order, top to bottom
+    if ( _blocks.length() && y < _blocks[_blocks.length()-1].y + RENDER_POSITION_BLOCK_STEP )
+        return;
+    Block block;
+    block.y = y;
+    block.node = node;
+    block.text = text;
+    _blocks.add( block );
+    _changed = true;
+}
+
+/// finds recorded blocks around range [y0, y1): last one starting at or before y0 and first one starting at or after y1; false if none recorded
+bool ldomRenderPositionIndex::findBlocks( int y0, int y1, Block & first, Block & last ) const
+{
+    if ( _blocks.empty() )
+        return false;
+    // first block with y > y0
+    int a = 0;
+    int b = _blocks.length();
+    while ( a < b ) {
+        int c = (a + b) / 2;
+        if ( _blocks[c].y <= y0 )
+            a = c + 1;
+        else
+            b = c;
+    }
+    first = _blocks[a>0 ? a-1 : 0];
+    while ( a < _blocks.length() - 1 && _blocks[a].y < y1 )
+        a++;
+    last = _blocks[a < _blocks.length() ? a : a-1];
+    return true;
+}
+
+/// removes all items
+void ldomRenderPositionIndex::clear()
+{
+    if ( _images.empty() && _blocks.empty() )
+        return;
+    _images.clear();
+    _blocks.clear();
+    _changed = true;
+}
+
+void ldomRenderPositionIndex::serialize( SerialBuf & buf )
+{
+    int pos = buf.pos();
+    buf.putMagic( render_positions_magic );
+    buf << (lUInt32)_images.length();
+    for ( int i=0; i<_images.length(); i++ ) {
+        const Image & img = _images[i];
+        buf << (lUInt32)img.y << img.node << (lUInt32)img.dx << (lUInt32)img.dy;
+    }
+    buf << (lUInt32)_blocks.length();
+    for ( int i=0; i<_blocks.length(); i++ ) {
+        const Block & block = _blocks[i];
+        buf << (lUInt32)block.y << block.node << block.text;
+    }
+    buf.putCRC( buf.pos() - pos );
+    _changed = false;
+}
+
+bool ldomRenderPositionIndex::deserialize( SerialBuf & buf )
+{
+    _images.clear();
+    _blocks.clear();
+    int pos = buf.pos();
+    if ( !buf.checkMagic( render_positions_magic ) )
+        return false;
+    lUInt32 count = 0;
+    buf >> count;
+    for ( lUInt32 i=0; i<count && !buf.error(); i++ ) {
+        lUInt32 y, node, dx, dy;
+        buf >> y >> node >> dx >> dy;
+        Image img;
+        img.y = (lInt32)y;
+        img.node = node;
+        img.dx = (lInt32)dx;
+        img.dy = (lInt32)dy;
+        _images.add( img );
+    }
+    count = 0;
+    buf >> count;
+    for ( lUInt32 i=0; i<count && !buf.error(); i++ ) {
+        lUInt32 y, node, text;
+        buf >> y >> node >> text;
+        Block block;
+        block.y = (lInt32)y;
+        block.node = node;
+        block.text = text;
+        _blocks.add( block );
+    }
+    buf.checkCRC( buf.pos() - pos );
+    if ( buf.error() ) {
+        _images.clear();
+        _blocks.clear();
+    }
+    _changed = false;
+    return !buf.error();
+}
+
+/// returns line/word geometry of final block, formats block if not cached
+ldomBlockGeometry * ldomDocument::getBlockGeometry( ldomNode * finalNode )
+{
+    ldomBlockGeometry * geometry = _blockGeometry.get( finalNode->getDataIndex() );
+    if ( geometry )
+        return geometry;
+    LFormattedTextRef txtform;
+    {
+        RenderRectAccessor r( finalNode );
+        finalNode->renderFinalBlock( txtform, &r, r.getWidth() );
+    }
+    geometry = new ldomBlockGeometry();
+    geometry->init( txtform.get() );
+    _blockGeometry.set( finalNode->getDataIndex(), geometry );
+    return geometry;
+}
+
 /// formats final block
 int ldomNode::renderFinalBlock(  LFormattedTextRef & frmtext, RenderRectAccessor * fmt, int width )
 {
@@ -11219,6 +13515,7 @@ bool ldomNode::refreshFinalBlock()
     // TODO: implement reformatting of one node
     CVRendBlockCache & cache = getDocument()->getRendBlockCache();
     cache.remove( this );
+    getDocument()->_blockGeometry.remove( getDataIndex() );
     RenderRectAccessor fmt( this );
     lvRect oldRect, newRect;
     fmt.getRect( oldRect );
@@ -11511,6 +13808,241 @@ void testCacheFile()
 #endif
 }
 
+static bool isSameSearchResult( ldomTextSearchIndex & index1, ldomTextSearchIndex & index2, const lChar16 * pattern )
+{
+    LVArray<lUInt32> bits1;
+    LVArray<lUInt32> bits2;
+    bool found1 = index1.findCandidates( lString16(pattern), bits1 );
+    bool found2 = index2.findCandidates( lString16(pattern), bits2 );
+    if ( found1 != found2 || bits1.length() != bits2.length() )
+        return false;
+    for ( int i=0; i<bits1.length(); i++ )
+        if ( bits1[i] != bits2[i] )
+            return false;
+    return true;
+}
+
+void testTextSearchIndexSerialization()
+{
+#if BUILD_LITE!=1
+    CRLog::info("Starting text search index serialization unit test");
+    static const lChar16 * texts[] = {
+        L"The quick brown fox jumps over the lazy dog.",
+        L"Съешь же ещё этих мягких французских булок",
+        L"Chapter 12: brown bears",
+        L"Nothing to see here, 42 times",
+        NULL
+    };
+    ldomTextSearchIndex index;
+    for ( int i=0; texts[i]; i++ )
+        index.addText( (lUInt32)(i * 3 + 1), lString16(texts[i]) );
+    index.finishBuild();
+    MYASSERT(index.isReady(), "search index built");
+    SerialBuf buf(4096);
+    index.serialize( buf );
+    MYASSERT(!buf.error(), "search index serialize");
+    SerialBuf rbuf( buf.buf(), buf.pos() );
+    ldomTextSearchIndex index2;
+    MYASSERT(index2.deserialize( rbuf ), "search index deserialize");
+    MYASSERT(index2.isReady(), "search index loaded");
+    static const lChar16 * patterns[] = {
+        L"brown", L"BROWN fox", L"французских", L"булок", L"12", L"own", L"absent", L"ere, 42", NULL
+    };
+    for ( int i=0; patterns[i]; i++ )
+        MYASSERT(isSameSearchResult( index, index2, patterns[i] ), "search index candidates");
+    LVArray<lUInt32> bits;
+    MYASSERT(index2.findCandidates( lString16(L"brown"), bits ), "search index find");
+    MYASSERT((bits[0] & (1 << 1))!=0 && (bits[0] & (1 << 7))!=0, "search index matching nodes");
+    MYASSERT((bits[0] & (1 << 4))==0 && (bits[0] & (1 << 10))==0, "search index other nodes");
+    CRLog::info("Finished text search index serialization unit test");
+#endif
+}
+
+void testBlockGeometrySerialization()
+{
+#if BUILD_LITE!=1
+    CRLog::info("Starting block geometry serialization unit test");
+    ldomBlockGeometryCache cache;
+    for ( int n=1; n<=3; n++ ) {
+        ldomBlockGeometry * g = new ldomBlockGeometry();
+        for ( int i=0; i<n; i++ ) {
+            ldomBlockGeometry::Src src;
+            src.node = (lUInt32)((n * 10 + i) << 4);
+            src.flags = 0x1000 + i;
+            src.offset = (lUInt16)(i * 7);
+            src.len = (lUInt16)(100 + i);
+            src.letterSpacing = (lInt8)(i - 1);
+            g->srcs.add( src );
+            ldomBlockGeometry::Line line;
+            line.y = i * 20;
+            line.x = (lUInt16)i;
+            line.height = 20;
+            line.firstWord = i * 2;
+            line.wordCount = 2;
+            g->lines.add( line );
+            for ( int j=0; j<2; j++ ) {
+                ldomBlockGeometry::Word word;
+                word.src = (lUInt16)i;
+                word.x = (lUInt16)(j * 50);
+                word.width = 45;
+                word.start = (lUInt16)(j * 6);
+                word.len = 5;
+                g->words.add( word );
+            }
+        }
+        cache.set( (lUInt32)((n << 4) | 1), g );
+    }
+    SerialBuf buf(4096);
+    cache.serialize( buf );
+    MYASSERT(!buf.error(), "geometry serialize");
+    SerialBuf rbuf( buf.buf(), buf.pos() );
+    ldomBlockGeometryCache cache2;
+    MYASSERT(cache2.deserialize( rbuf ), "geometry deserialize");
+    for ( int n=1; n<=3; n++ ) {
+        ldomBlockGeometry * g1 = cache.get( (lUInt32)((n << 4) | 1) );
+        ldomBlockGeometry * g2 = cache2.get( (lUInt32)((n << 4) | 1) );
+        MYASSERT(g1 && g2, "geometry found");
+        MYASSERT(g1->srcs.length()==g2->srcs.length() && g1->lines.length()==g2->lines.length() && g1->words.length()==g2->words.length(), "geometry item counts");
+        for ( int i=0; i<g1->srcs.length(); i++ ) {
+            ldomBlockGeometry::Src & a = g1->srcs[i];
+            ldomBlockGeometry::Src & b = g2->srcs[i];
+            MYASSERT(a.node==b.node && a.flags==b.flags && a.offset==b.offset && a.len==b.len && a.letterSpacing==b.letterSpacing, "geometry src");
+        }
+        for ( int i=0; i<g1->lines.length(); i++ ) {
+            ldomBlockGeometry::Line & a = g1->lines[i];
+            ldomBlockGeometry::Line & b = g2->lines[i];
+            MYASSERT(a.y==b.y && a.x==b.x && a.height==b.height && a.firstWord==b.firstWord && a.wordCount==b.wordCount, "geometry line");
+        }
+        for ( int i=0; i<g1->words.length(); i++ ) {
+            ldomBlockGeometry::Word & a = g1->words[i];
+            ldomBlockGeometry::Word & b = g2->words[i];
+            MYASSERT(a.src==b.src && a.x==b.x && a.width==b.width && a.start==b.start && a.len==b.len, "geometry word");
+        }
+    }
+    MYASSERT(cache2.get( 5 << 4 )==NULL, "geometry not found");
+    CRLog::info("Finished block geometry serialization unit test");
+#endif
+}
+
+void testTableCellSerialization()
+{
+#if BUILD_LITE!=1
+    CRLog::info("Starting table cell cache serialization unit test");
+    ldomTableCellCache cache;
+    for ( int n=1; n<=3; n++ ) {
+        LVArray<lInt32> * lengths = new LVArray<lInt32>();
+        for ( int i=0; i<n * 5; i++ )
+            lengths->add( i * n - 3 );
+        cache.set( (lUInt32)((n << 4) | 1), lengths );
+    }
+    SerialBuf buf(4096);
+    cache.serialize( buf );
+    MYASSERT(!buf.error(), "table cells serialize");
+    SerialBuf rbuf( buf.buf(), buf.pos() );
+    ldomTableCellCache cache2;
+    MYASSERT(cache2.deserialize( rbuf ), "table cells deserialize");
+    for ( int n=1; n<=3; n++ ) {
+        LVArray<lInt32> * a = cache.get( (lUInt32)((n << 4) | 1) );
+        LVArray<lInt32> * b = cache2.get( (lUInt32)((n << 4) | 1) );
+        MYASSERT(a && b && a->length()==b->length(), "table cells count");
+        for ( int i=0; i<a->length(); i++ )
+            MYASSERT((*a)[i]==(*b)[i], "table cell length");
+    }
+    MYASSERT(cache2.get( 5 << 4 )==NULL, "table cells not found");
+    CRLog::info("Finished table cell cache serialization unit test");
+#endif
+}
+
+void testRenderPositionSerialization()
+{
+#if BUILD_LITE!=1
+    CRLog::info("Starting render positions serialization unit test");
+    ldomRenderPositionIndex index;
+    for ( int i=0; i<20; i++ ) {
+        index.addImage( i * 300, (lUInt32)(((i + 1) << 4) | 1), 100 + i, 200 + i );
+        index.addBlock( i * 150, (lUInt32)(((i + 1) << 4) | 1), (lUInt32)((i + 1) << 4) );
+    }
+    SerialBuf buf(4096);
+    index.serialize( buf );
+    MYASSERT(!buf.error(), "render positions serialize");
+    SerialBuf rbuf( buf.buf(), buf.pos() );
+    ldomRenderPositionIndex index2;
+    MYASSERT(index2.deserialize( rbuf ), "render positions deserialize");
+    MYASSERT(index.getImageCount()==index2.getImageCount(), "render positions image count");
+    MYASSERT(index.getBlockCount()==index2.getBlockCount(), "render positions block count");
+    LVArray<ldomRenderPositionIndex::Image> images1;
+    LVArray<ldomRenderPositionIndex::Image> images2;
+    index.findImages( 0, 20 * 300, images1 );
+    index2.findImages( 0, 20 * 300, images2 );
+    MYASSERT(images1.length()==20 && images1.length()==images2.length(), "render positions images");
+    for ( int i=0; i<images1.length(); i++ ) {
+        ldomRenderPositionIndex::Image & a = images1[i];
+        ldomRenderPositionIndex::Image & b = images2[i];
+        MYASSERT(a.y==b.y && a.node==b.node && a.dx==b.dx && a.dy==b.dy, "render positions image");
+    }
+    for ( int y=0; y<20 * 150; y+=100 ) {
+        ldomRenderPositionIndex::Block first1, last1, first2, last2;
+        bool found1 = index.findBlocks( y, y + 400, first1, last1 );
+        bool found2 = index2.findBlocks( y, y + 400, first2, last2 );
+        MYASSERT(found1 && found2, "render positions blocks found");
+        MYASSERT(first1.y==first2.y && first1.node==first2.node && first1.text==first2.text, "render positions first block");
+        MYASSERT(last1.y==last2.y && last1.node==last2.node && last1.text==last2.text, "render positions last block");
+    }
+    // damaged block should be rejected
+    buf.buf()[buf.pos() / 2] ^= 0x55;
+    SerialBuf rbuf2( buf.buf(), buf.pos() );
+    ldomRenderPositionIndex index3;
+    MYASSERT(!index3.deserialize( rbuf2 ), "render positions damaged block");
+    CRLog::info("Finished render positions serialization unit test");
+#endif
+}
+
+void testCompactXPointer()
+{
+#if BUILD_LITE!=1
+    CRLog::info("Starting compact xpointer unit test");
+    ldomCompactXPointer pos;
+    pos.docHash = 0x12345678;
+    pos.dataIndex = 0xABC0;
+    pos.offset = -1;
+    lString16 s = pos.toString();
+    MYASSERT(s.length()==24, "compact xpointer string length");
+    ldomCompactXPointer pos2;
+    MYASSERT(pos2.fromString( s ), "compact xpointer fromString");
+    MYASSERT(pos2.docHash==pos.docHash && pos2.dataIndex==pos.dataIndex && pos2.offset==pos.offset, "compact xpointer fields");
+    ldomCompactXPointer bad;
+    MYASSERT(!bad.fromString( lString16(L"/body/DocFragment[1]") ), "compact xpointer bad string");
+    MYASSERT(!bad.fromString( s.substr(0, 23) ), "compact xpointer short string");
+    MYASSERT(!bad.fromString( s.substr(0, 23) + L"g" ), "compact xpointer bad digit");
+
+    ldomDocument * doc = new ldomDocument();
+    ldomNode * root = doc->getRootNode();
+    int el_p = doc->getElementNameIndex(L"p");
+    ldomNode * el1 = root->insertChildElement(el_p);
+    el1->insertChildText(lString16(L"First paragraph."));
+    ldomNode * el2 = root->insertChildElement(el_p);
+    ldomNode * text2 = el2->insertChildText(lString16(L"Second paragraph."));
+    ldomXPointer ptr1( text2, 7 );
+    ldomXPointer ptr2( el2, 0 );
+    ldomCompactXPointer c1 = ptr1.toCompact();
+    ldomCompactXPointer c2 = ptr2.toCompact();
+    MYASSERT(c1.docHash==doc->getContentHash() && c1.dataIndex==(lUInt32)text2->getDataIndex() && c1.offset==7, "compact xpointer from text");
+    ldomCompactXPointer c3;
+    MYASSERT(c3.fromString( c1.toString() ), "compact xpointer text string");
+    ldomXPointer p1 = doc->createXPointer( c3 );
+    ldomXPointer p2 = doc->createXPointer( c2 );
+    MYASSERT(p1.getNode()==text2 && p1.getOffset()==7, "compact xpointer text node");
+    MYASSERT(p2.getNode()==el2 && p2.getOffset()==0, "compact xpointer element node");
+    MYASSERT(p1.toString()==ptr1.toString(), "compact xpointer same position");
+    c3.docHash ^= 1;
+    MYASSERT(doc->createXPointer( c3 ).isNull(), "compact xpointer other document");
+    el1->insertChildText(lString16(L" More text."));
+    MYASSERT(doc->createXPointer( c1 ).isNull(), "compact xpointer changed document");
+    delete doc;
+    CRLog::info("Finished compact xpointer unit test");
+#endif
+}
+
 #ifdef _WIN32
 #define TEST_FN_TO_OPEN "/projects/test/bibl.fb2.zip"
 #else
@@ -11986,6 +14518,11 @@ void runTinyDomUnitTests()
 
     CRLog::info("==========================");
     testCacheFile();
+    testTextSearchIndexSerialization();
+    testCompactXPointer();
+    testRenderPositionSerialization();
+    testTableCellSerialization();
+    testBlockGeometrySerialization();
 
     runFileCacheTest();
     CRLog::info("==========================");
@@ -43,6 +43,131 @@ typedef unsigned int ucs4_t;
 #define MIN_BUF_DATA_SIZE 4096
 #define CP_AUTODETECT_BUF_SIZE 0x20000
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XML_SCAN_USE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define XML_SCAN_USE_NEON 1
+#endif
+
+/// returns true for chars which stop plain text run in LVXMLParser::ReadText()
+static inline bool isXmlTextRunStopChar( lChar16 ch )
+{
+    return ch=='<' || ch=='&' || ch==' ' || ch=='\t' || ch=='\r' || ch=='\n' || ch==160;
+}
+
+/// returns number of leading chars of buffer which are neither markup nor whitespace (up to len)
+static int xmlTextRunLength( const lChar16 * s, int len )
+{
+    int i = 0;
+#if XML_SCAN_USE_SSE2
+    if ( sizeof(lChar16) == 2 ) {
+        const __m128i c0 = _mm_set1_epi16('<');
+        const __m128i c1 = _mm_set1_epi16('&');
+        const __m128i c2 = _mm_set1_epi16(' ');
+        const __m128i c3 = _mm_set1_epi16('\t');
+        const __m128i c4 = _mm_set1_epi16('\r');
+        const __m128i c5 = _mm_set1_epi16('\n');
+        const __m128i c6 = _mm_set1_epi16(160);
+        for ( ; i + 8 <= len; i += 8 ) {
+            __m128i v = _mm_loadu_si128( (const __m128i *)(s + i) );
+            __m128i m = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi16(v, c0), _mm_cmpeq_epi16(v, c1) ),
+                                      _mm_or_si128( _mm_cmpeq_epi16(v, c2), _mm_cmpeq_epi16(v, c3) ) );
+            m = _mm_or_si128( m, _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi16(v, c4), _mm_cmpeq_epi16(v, c5) ),
+                                               _mm_cmpeq_epi16(v, c6) ) );
+            if ( _mm_movemask_epi8(m) )
+                break;
+        }
+    } else {
+        const __m128i c0 = _mm_set1_epi32('<');
+        const __m128i c1 = _mm_set1_epi32('&');
+        const __m128i c2 = _mm_set1_epi32(' ');
+        const __m128i c3 = _mm_set1_epi32('\t');
+        const __m128i c4 = _mm_set1_epi32('\r');
+        const __m128i c5 = _mm_set1_epi32('\n');
+        const __m128i c6 = _mm_set1_epi32(160);
+        for ( ; i + 4 <= len; i += 4 ) {
+            __m128i v = _mm_loadu_si128( (const __m128i *)(s + i) );
+            __m128i m = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi32(v, c0), _mm_cmpeq_epi32(v, c1) ),
+                                      _mm_or_si128( _mm_cmpeq_epi32(v, c2), _mm_cmpeq_epi32(v, c3) ) );
+            m = _mm_or_si128( m, _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi32(v, c4), _mm_cmpeq_epi32(v, c5) ),
+                                               _mm_cmpeq_epi32(v, c6) ) );
+            if ( _mm_movemask_epi8(m) )
+                break;
+        }
+    }
+#elif XML_SCAN_USE_NEON
+    if ( sizeof(lChar16) == 2 ) {
+        for ( ; i + 8 <= len; i += 8 ) {
+            uint16x8_t v = vld1q_u16( (const uint16_t *)(s + i) );
+            uint16x8_t m = vorrq_u16( vorrq_u16( vceqq_u16(v, vdupq_n_u16('<')), vceqq_u16(v, vdupq_n_u16('&')) ),
+                                      vorrq_u16( vceqq_u16(v, vdupq_n_u16(' ')), vceqq_u16(v, vdupq_n_u16('\t')) ) );
+            m = vorrq_u16( m, vorrq_u16( vorrq_u16( vceqq_u16(v, vdupq_n_u16('\r')), vceqq_u16(v, vdupq_n_u16('\n')) ),
+                                         vceqq_u16(v, vdupq_n_u16(160)) ) );
+            uint64x2_t m64 = vreinterpretq_u64_u16(m);
+            if ( vgetq_lane_u64(m64, 0) | vgetq_lane_u64(m64, 1) )
+                break;
+        }
+    } else {
+        for ( ; i + 4 <= len; i += 4 ) {
+            uint32x4_t v = vld1q_u32( (const uint32_t *)(s + i) );
+            uint32x4_t m = vorrq_u32( vorrq_u32( vceqq_u32(v, vdupq_n_u32('<')), vceqq_u32(v, vdupq_n_u32('&')) ),
+                                      vorrq_u32( vceqq_u32(v, vdupq_n_u32(' ')), vceqq_u32(v, vdupq_n_u32('\t')) ) );
+            m = vorrq_u32( m, vorrq_u32( vorrq_u32( vceqq_u32(v, vdupq_n_u32('\r')), vceqq_u32(v, vdupq_n_u32('\n')) ),
+                                         vceqq_u32(v, vdupq_n_u32(160)) ) );
+            uint64x2_t m64 = vreinterpretq_u64_u32(m);
+            if ( vgetq_lane_u64(m64, 0) | vgetq_lane_u64(m64, 1) )
+                break;
+        }
+    }
+#endif
+    // tail, and exact position inside of block where stop char is found
+    for ( ; i < len && !isXmlTextRunStopChar(s[i]); i++ )
+        ;
+    return i;
+}
+
+/// returns index of first occurence of char in buffer, or len if not found
+static int xmlFindChar( const lChar16 * s, int len, lChar16 ch )
+{
+    int i = 0;
+#if XML_SCAN_USE_SSE2
+    if ( sizeof(lChar16) == 2 ) {
+        const __m128i c = _mm_set1_epi16( (short)ch );
+        for ( ; i + 8 <= len; i += 8 ) {
+            if ( _mm_movemask_epi8( _mm_cmpeq_epi16( _mm_loadu_si128( (const __m128i *)(s + i) ), c ) ) )
+                break;
+        }
+    } else {
+        const __m128i c = _mm_set1_epi32( (int)ch );
+        for ( ; i + 4 <= len; i += 4 ) {
+            if ( _mm_movemask_epi8( _mm_cmpeq_epi32( _mm_loadu_si128( (const __m128i *)(s + i) ), c ) ) )
+                break;
+        }
+    }
+#elif XML_SCAN_USE_NEON
+    if ( sizeof(lChar16) == 2 ) {
+        const uint16x8_t c = vdupq_n_u16( (uint16_t)ch );
+        for ( ; i + 8 <= len; i += 8 ) {
+            uint64x2_t m64 = vreinterpretq_u64_u16( vceqq_u16( vld1q_u16( (const uint16_t *)(s + i) ), c ) );
+            if ( vgetq_lane_u64(m64, 0) | vgetq_lane_u64(m64, 1) )
+                break;
+        }
+    } else {
+        const uint32x4_t c = vdupq_n_u32( (uint32_t)ch );
+        for ( ; i + 4 <= len; i += 4 ) {
+            uint64x2_t m64 = vreinterpretq_u64_u32( vceqq_u32( vld1q_u32( (const uint32_t *)(s + i) ), c ) );
+            if ( vgetq_lane_u64(m64, 0) | vgetq_lane_u64(m64, 1) )
+                break;
+        }
+    }
+#endif
+    for ( ; i < len && s[i] != ch; i++ )
+        ;
+    return i;
+}
+
 
 
 int CalcTabCount(const lChar16 * str, int nlen);
@@ -391,9 +516,21 @@ int LVTextFileBase::ReadChars( lChar16 * buf, int maxsize )
     case ce_8bit_cp:
     case ce_utf8:
         if ( m_conv_table!=NULL ) {
-            for ( ; count<maxsize && m_buf_pos<m_buf_len; count++ ) {
-                lUInt16 ch = m_buf[m_buf_pos++];
-                buf[count] = ( (ch & 0x80) == 0 ) ? ch : m_conv_table[ch&0x7F];
+            while ( count<maxsize && m_buf_pos<m_buf_len ) {
+                lUInt16 ch = m_buf[m_buf_pos];
+                if ( (ch & 0x80) == 0 ) {
+                    // copy whole run of 7-bit chars at once
+                    int n = m_buf_len - m_buf_pos;
+                    if ( n > maxsize - count )
+                        n = maxsize - count;
+                    n = lStr_asciiPrefixLength( m_buf + m_buf_pos, n );
+                    lStr_asciiToUnicode( buf + count, m_buf + m_buf_pos, n );
+                    count += n;
+                    m_buf_pos += n;
+                } else {
+                    buf[count++] = m_conv_table[ch&0x7F];
+                    m_buf_pos++;
+                }
             }
             return count;
         } else  {
@@ -3591,6 +3728,21 @@ bool LVXMLParser::ReadText()
             }
         }
         for ( ; m_read_buffer_pos+i<m_read_buffer_len; i++ ) {
+            if ( !m_eof && tlen < TEXT_SPLIT_SIZE ) {
+                // fast path: skip plain text run which has no markup and no split points
+                int maxrun = m_read_buffer_len - m_read_buffer_pos - i;
+                if ( maxrun > TEXT_SPLIT_SIZE - tlen )
+                    maxrun = TEXT_SPLIT_SIZE - tlen;
+                int run = xmlTextRunLength( m_read_buffer + m_read_buffer_pos + i, maxrun );
+                if ( run > 0 ) {
+                    i += run;
+                    tlen += run;
+                    last_eol = false;
+                    splitParas = false;
+                    if ( m_read_buffer_pos + i >= m_read_buffer_len )
+                        break;
+                }
+            }
             lChar16 ch = m_read_buffer[m_read_buffer_pos + i];
             lChar16 nextch = m_read_buffer_pos + i + 1 < m_read_buffer_len ? m_read_buffer[m_read_buffer_pos + i + 1] : 0;
             flgBreak = ch=='<' || m_eof;
@@ -3683,20 +3835,35 @@ bool LVXMLParser::ReadText()
 
 bool LVXMLParser::SkipSpaces()
 {
-    for ( lUInt16 ch = PeekCharFromBuffer(); !m_eof; ch = PeekNextCharFromBuffer() ) {
-        if ( !IsSpaceChar(ch) )
-            break; // char found!
+    for ( ;; ) {
+        PeekCharFromBuffer(); // refill buffer if necessary
+        if ( m_eof )
+            return false; // EOF
+        // whitespace runs between tags are short (indentation), so plain scan
+        // of buffered chars is enough - no per-char buffer bounds check
+        const lChar16 * p = m_read_buffer + m_read_buffer_pos;
+        int available = m_read_buffer_len - m_read_buffer_pos;
+        int n = 0;
+        while ( n < available && IsSpaceChar(p[n]) )
+            n++;
+        m_read_buffer_pos += n;
+        if ( n < available )
+            return true; // char found!
     }
-    return (!m_eof);
 }
 
 bool LVXMLParser::SkipTillChar( lChar16 charToFind )
 {
-    for ( lUInt16 ch = PeekCharFromBuffer(); !m_eof; ch = PeekNextCharFromBuffer() ) {
-        if ( ch == charToFind )
+    for ( ;; ) {
+        PeekCharFromBuffer(); // refill buffer if necessary
+        if ( m_eof )
+            return false; // EOF
+        int available = m_read_buffer_len - m_read_buffer_pos;
+        int n = xmlFindChar( m_read_buffer + m_read_buffer_pos, available, charToFind );
+        m_read_buffer_pos += n;
+        if ( n < available )
             return true; // char found!
     }
-    return false; // EOF
 }
 
 inline bool isValidIdentChar( lChar16 ch )
@@ -3730,20 +3897,27 @@ bool LVXMLParser::ReadIdent( lString16 & ns, lString16 & name )
 
     name += ReadCharFromBuffer();
 
-    for ( lUInt16 ch = PeekCharFromBuffer(); !m_eof; ch = PeekNextCharFromBuffer() ) {
-        if ( !isValidIdentChar(ch) )
+    // append whole runs of ident chars found in buffer instead of char by char
+    for ( ;; ) {
+        PeekCharFromBuffer(); // refill buffer if necessary
+        if ( m_eof )
             break;
-        if (ch == ':')
-        {
-            if ( ns.empty() )
-                name.swap( ns ); // add namespace
-            else
-                break; // error
-        }
-        else
-        {
-            name += ch;
-        }
+        const lChar16 * p = m_read_buffer + m_read_buffer_pos;
+        int available = m_read_buffer_len - m_read_buffer_pos;
+        int n = 0;
+        while ( n < available && p[n] != ':' && isValidIdentChar(p[n]) )
+            n++;
+        if ( n )
+            name.append( p, n );
+        m_read_buffer_pos += n;
+        if ( n == available )
+            continue; // ident may continue in next buffer
+        if ( p[n] != ':' )
+            break;
+        if ( !ns.empty() )
+            break; // error
+        name.swap( ns ); // add namespace
+        m_read_buffer_pos++;
     }
     lChar16 ch = PeekCharFromBuffer();
     return (!name.empty()) && (ch==' ' || ch=='/' || ch=='>' || ch=='?' || ch=='=' || ch==0 || ch == '\r' || ch == '\n');
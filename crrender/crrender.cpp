@@ -0,0 +1,328 @@
+/*******************************************************
+
+   CoolReader Engine
+
+   crrender.cpp: headless page rendering server
+
+   Reads requests from stdin or local socket, one per line:
+     <tag> add <docId> <width> <height> <bufferKb> <file path>
+     <tag> open <docId>
+     <tag> render <docId> <page> <output file .png|.ppm>
+     <tag> close <docId>
+     <tag> flush
+     quit
+   and writes "<tag> ok [pageCount]" or "<tag> error" lines as requests complete.
+
+   This source code is distributed under the terms of
+   GNU General Public License
+   See LICENSE file for details
+
+*******************************************************/
+
+#include "crrenderservice.h"
+#include "lvfntman.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/// writes responses; called from worker threads, so it uses C strings only
+class ResponseWriter : public CRRenderServiceCallback {
+    CRMutexRef _mutex;
+    int _fd;
+    void writeAll( const char * p )
+    {
+        int len = (int)strlen( p );
+        while ( len>0 ) {
+            ssize_t n = ::write( _fd, p, len );
+            if ( n<=0 )
+                break;
+            p += n;
+            len -= (int)n;
+        }
+    }
+public:
+    ResponseWriter() : _fd(1) { _mutex = concurrencyProvider->createMutex(); }
+    void setOutput( int fd )
+    {
+        CRGuard guard( _mutex );
+        CR_UNUSED(guard);
+        _fd = fd;
+    }
+    void write( const char * tag, const char * text )
+    {
+        CRGuard guard( _mutex );
+        CR_UNUSED(guard);
+        writeAll( tag );
+        writeAll( " " );
+        writeAll( text );
+        writeAll( "\n" );
+    }
+    virtual void onDocumentOpened( const char * tag, const char * docId, int pageCount )
+    {
+        CR_UNUSED(docId);
+        char text[32];
+        if ( pageCount>=0 )
+            sprintf( text, "ok %d", pageCount );
+        else
+            strcpy( text, "error" );
+        write( tag, text );
+    }
+    virtual void onPageRendered( const char * tag, const char * docId, int page, bool success )
+    {
+        CR_UNUSED2(docId, page);
+        write( tag, success ? "ok" : "error" );
+    }
+};
+
+/// returns next space separated word of line and moves p after it, NULL if there are no more words
+static char * nextWord( char * & p )
+{
+    while ( *p==' ' )
+        p++;
+    if ( !*p )
+        return NULL;
+    char * word = p;
+    while ( *p && *p!=' ' )
+        p++;
+    if ( *p )
+        *p++ = 0;
+    return word;
+}
+
+/// returns rest of line after leading spaces, NULL if it's empty
+static char * restOfLine( char * & p )
+{
+    while ( *p==' ' )
+        p++;
+    return *p ? p : NULL;
+}
+
+/// executes request line, returns false on quit
+/**
+    Requests are parsed without lString: workers use engine strings concurrently under engine lock.
+*/
+static bool processRequest( CRRenderService & service, ResponseWriter & writer, char * line, int defaultBufferKb )
+{
+    char * p = line;
+    char * tag = nextWord( p );
+    if ( !tag )
+        return true;
+    if ( !strcmp( tag, "quit" ) )
+        return false;
+    char * cmd = nextWord( p );
+    bool res = false;
+    if ( cmd && !strcmp( cmd, "add" ) ) {
+        char * docId = nextWord( p );
+        char * dx = nextWord( p );
+        char * dy = nextWord( p );
+        char * bufferKb = nextWord( p );
+        // file path is the rest of line and may contain spaces
+        char * fileName = restOfLine( p );
+        if ( fileName ) {
+            int kb = atoi( bufferKb );
+            service.addDocument( docId, fileName, atoi( dx ), atoi( dy ), (kb>0 ? kb : defaultBufferKb) * 1024 );
+            writer.write( tag, "ok" );
+            return true;
+        }
+    } else if ( cmd && !strcmp( cmd, "open" ) ) {
+        char * docId = nextWord( p );
+        if ( docId && !nextWord( p ) )
+            res = service.openDocument( tag, docId );
+    } else if ( cmd && !strcmp( cmd, "render" ) ) {
+        char * docId = nextWord( p );
+        char * page = nextWord( p );
+        char * fileName = restOfLine( p );
+        if ( fileName )
+            res = service.renderPage( tag, docId, atoi( page ), fileName );
+    } else if ( cmd && !strcmp( cmd, "close" ) ) {
+        char * docId = nextWord( p );
+        if ( docId && !nextWord( p ) && service.removeDocument( docId ) ) {
+            writer.write( tag, "ok" );
+            return true;
+        }
+    } else if ( cmd && !strcmp( cmd, "flush" ) ) {
+        service.flush();
+        writer.write( tag, "ok" );
+        return true;
+    }
+    if ( !res )
+        writer.write( tag, "error" );
+    return true;
+}
+
+/// reads request lines from file descriptor until end of input or quit command, returns false on quit
+static bool processInput( CRRenderService & service, ResponseWriter & writer, int fd, int defaultBufferKb )
+{
+    LVArray<char> pending;
+    char buf[4096];
+    for ( ;; ) {
+        ssize_t n = read( fd, buf, sizeof(buf) );
+        if ( n<=0 )
+            break;
+        pending.add( buf, (int)n );
+        int start = 0;
+        for ( int i=0; i<pending.length(); i++ ) {
+            if ( pending[i]!='\n' )
+                continue;
+            pending[i] = 0;
+            if ( i>start && pending[i - 1]=='\r' )
+                pending[i - 1] = 0;
+            if ( !processRequest( service, writer, pending.get() + start, defaultBufferKb ) )
+                return false;
+            start = i + 1;
+        }
+        if ( start>0 )
+            pending.erase( 0, start );
+    }
+    if ( pending.length()>0 ) {
+        pending.add( '\0' );
+        return processRequest( service, writer, pending.get(), defaultBufferKb );
+    }
+    return true;
+}
+
+static void registerFonts( const lString8 & dir )
+{
+    LVContainerRef container = LVOpenDirectory( dir );
+    if ( container.isNull() ) {
+        CRLog::error( "Cannot open font directory %s", dir.c_str() );
+        return;
+    }
+    for ( int i=0; i<container->GetObjectCount(); i++ ) {
+        const LVContainerItemInfo * item = container->GetObjectInfo( i );
+        lString16 name = item->GetName();
+        lString16 lname = name;
+        lname.lowercase();
+        if ( item->IsContainer() || !(lname.endsWith(".ttf") || lname.endsWith(".otf")) )
+            continue;
+        lString8 fn = UnicodeToLocal( LVCombinePaths( Utf8ToUnicode(dir), name ) );
+        if ( !fontMan->RegisterFont( fn ) )
+            CRLog::error( "Cannot register font %s", fn.c_str() );
+    }
+}
+
+static void usage()
+{
+    printf( "usage: crrender [options]\n"
+            "  -f <dir>    register fonts from directory, may be repeated\n"
+            "  -c <dir>    document cache directory\n"
+            "  -s <file>   stylesheet\n"
+            "  -t <n>      number of worker threads; pages are drawn one at a time,\n"
+            "              threads overlap image encoding only (default 4)\n"
+            "  -m <n>      max number of open documents, up to %d (default %d)\n"
+            "  -b <kb>     default memory budget per document, KB (default %d)\n"
+            "  -g <kb>     memory budget shared by all documents, KB, replaces -b\n"
+            "  -l <path>   listen on local socket instead of reading stdin\n"
+            "  -v          log to stderr\n",
+            MAX_DOCUMENT_INSTANCE_COUNT - 2, RENDER_SERVICE_MAX_OPEN_DOCUMENTS, RENDER_SERVICE_DOC_BUFFER_SIZE / 1024 );
+}
+
+int main( int argc, char ** argv )
+{
+    lString8Collection fontDirs;
+    lString8 cacheDir;
+    lString8 cssFile;
+    lString8 socketPath;
+    int threadCount = 4;
+    int maxDocs = RENDER_SERVICE_MAX_OPEN_DOCUMENTS;
+    int bufferKb = RENDER_SERVICE_DOC_BUFFER_SIZE / 1024;
+    int globalBudgetKb = 0;
+    bool verbose = false;
+    for ( int i=1; i<argc; i++ ) {
+        lString8 opt( argv[i] );
+        if ( opt=="-v" ) {
+            verbose = true;
+            continue;
+        }
+        if ( i + 1>=argc || opt.length()!=2 || opt[0]!='-' ) {
+            usage();
+            return 1;
+        }
+        lString8 value( argv[++i] );
+        switch ( opt[1] ) {
+        case 'f': fontDirs.add( value ); break;
+        case 'c': cacheDir = value; break;
+        case 's': cssFile = value; break;
+        case 't': threadCount = value.atoi(); break;
+        case 'm': maxDocs = value.atoi(); break;
+        case 'b': bufferKb = value.atoi(); break;
+        case 'g': globalBudgetKb = value.atoi(); break;
+        case 'l': socketPath = value; break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if ( verbose ) {
+        CRLog::setStderrLogger();
+        CRLog::setLogLevel( CRLog::LL_INFO );
+    }
+    concurrencyProvider = new CRPosixConcurrencyProvider();
+    CRSetupEngineConcurrency();
+    InitFontManager( lString8::empty_str );
+    if ( fontDirs.length()==0 )
+        fontDirs.add( cs8("/usr/share/fonts/truetype") );
+    for ( int i=0; i<fontDirs.length(); i++ )
+        registerFonts( fontDirs[i] );
+    if ( !fontMan->GetFontCount() ) {
+        fprintf( stderr, "No fonts registered\n" );
+        return 2;
+    }
+    if ( !cacheDir.empty() ) {
+        ldomDocCache::init( Utf8ToUnicode(cacheDir), 0x10000000 );
+        enableCacheFileBackgroundWriting( true );
+    }
+    if ( globalBudgetKb>0 )
+        ldomMemoryGovernor::setBudget( (lInt64)globalBudgetKb * 1024 );
+    ResponseWriter writer;
+    int res = 0;
+    {
+        CRRenderService service( threadCount, maxDocs );
+        service.setCallback( &writer );
+        if ( !cssFile.empty() ) {
+            lString8 css;
+            if ( LVLoadStylesheetFile( Utf8ToUnicode(cssFile), css ) )
+                service.setStyleSheet( css );
+            else
+                CRLog::error( "Cannot load stylesheet %s", cssFile.c_str() );
+        }
+        if ( socketPath.empty() ) {
+            processInput( service, writer, 0, bufferKb );
+            service.flush();
+        } else {
+            int server = socket( AF_UNIX, SOCK_STREAM, 0 );
+            sockaddr_un addr;
+            memset( &addr, 0, sizeof(addr) );
+            addr.sun_family = AF_UNIX;
+            strncpy( addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1 );
+            unlink( socketPath.c_str() );
+            if ( server<0 || bind( server, (sockaddr*)&addr, sizeof(addr) )!=0 || listen( server, 4 )!=0 ) {
+                fprintf( stderr, "Cannot listen on %s\n", socketPath.c_str() );
+                res = 3;
+            } else {
+                // clients are served one at a time, their requests are executed concurrently
+                for ( ;; ) {
+                    int client = accept( server, NULL, NULL );
+                    if ( client<0 )
+                        break;
+                    writer.setOutput( client );
+                    bool quit = !processInput( service, writer, client, bufferKb );
+                    service.flush();
+                    writer.setOutput( 1 );
+                    close( client );
+                    if ( quit )
+                        break;
+                }
+                unlink( socketPath.c_str() );
+            }
+            if ( server>=0 )
+                close( server );
+        }
+    }
+    ldomDocCache::close();
+    ShutdownFontManager();
+    return res;
+}